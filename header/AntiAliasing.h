@@ -0,0 +1,133 @@
+#pragma once
+#include <vulkan/vulkan.h>
+#include <cstdint>
+#include <vector>
+#include <glm/glm.hpp>
+#include "FrameScheduler.h"
+#include "DeletionQueue.h"
+#include "RenderGraph.h"
+#include "DescriptorAllocator.h"
+#include "macro.h"
+
+namespace Clan
+{
+	enum class AntiAliasingMode : uint8_t {
+		None,
+		MSAA2x,
+		MSAA4x,
+		MSAA8x,
+		FXAA,
+		TAA,
+		Count,
+	};
+
+	const char* antiAliasingModeName(AntiAliasingMode mode);
+
+	//Accepts the names returned by antiAliasingModeName, case insensitive
+	bool parseAntiAliasingMode(const char* name, AntiAliasingMode& mode);
+
+	//MSAA renders to multisampled attachments that are resolved at the end of the forward pass.
+	//FXAA and TAA are compute passes over a single sampled HDR scene color, their result is
+	//blitted to the backbuffer because swapchain images usually can't be storage images.
+	class AntiAliasing
+	{
+	public:
+		AntiAliasing() = default;
+
+		AntiAliasing(const AntiAliasing&) = delete;
+
+		AntiAliasing& operator=(const AntiAliasing&) = delete;
+
+		~AntiAliasing() = default;
+
+		//Empty shader code disables the matching post-process mode
+		void init(VkDevice device, VkPhysicalDevice physicalDevice, DeletionQueue* pDeletionQueue, Timeline* pTimeline,
+			const std::vector<char>& fxaaCode, const std::vector<char>& taaCode);
+
+		void destroy();
+
+		//Selects a mode, an unsupported one falls back to the closest supported one. The post-process
+		//modes need a backbuffer that can be a blit destination. Returns the mode in use.
+		AntiAliasingMode setMode(AntiAliasingMode mode, bool backbufferBlitSupported);
+
+		inline AntiAliasingMode mode() const { return m_mode; }
+
+		VkSampleCountFlagBits samples() const;
+
+		inline bool isPostProcess() const { return m_mode == AntiAliasingMode::FXAA || m_mode == AntiAliasingMode::TAA; }
+
+		//TAA reprojects with the depth of the forward pass, it has to be stored and sampled
+		inline bool readsDepth() const { return m_mode == AntiAliasingMode::TAA; }
+
+		//Format of the color attachment of the forward pass
+		VkFormat sceneFormat(VkFormat backbufferFormat) const;
+
+		//Sub-pixel offset of this frame's projection in NDC, zero unless TAA is on
+		glm::vec2 jitter(VkExtent2D extent) const;
+
+		//Adds the post-process passes reading the forward pass output and writing the backbuffer.
+		//Their descriptor sets come from 'frameDescriptors', which has to live until the frame is done.
+		//'reprojection' maps this frame's unjittered NDC to the previous frame's clip space.
+		void addPasses(RenderGraph& graph, DescriptorAllocator& frameDescriptors, VkExtent2D extent,
+			GraphResource sceneColor, GraphResource depth, GraphResource backbuffer, const glm::mat4& reprojection);
+
+		//Advances the jitter sequence and the history ping-pong, call once per submitted frame
+		void endFrame();
+
+		inline VkDeviceSize historyMemoryBytes() const { return m_historyBytes; }
+
+		//Descriptors of one post-process set
+		static std::vector<VkDescriptorPoolSize> descriptorSizes();
+
+	private:
+		struct HistoryImage {
+			VkImage image{};
+			VkDeviceMemory memory{};
+			VkImageView view{};
+		};
+
+		struct PostProcessConstants {
+			glm::mat4 reprojection;
+			glm::vec2 invExtent;
+			glm::vec2 jitter;
+			float historyWeight;
+			uint32_t historyValid;
+		};
+
+		VkPipeline createComputePipeline(const std::vector<char>& code);
+
+		void createHistory(VkExtent2D extent);
+
+		void releaseHistory();
+
+		DescriptorWriter descriptors(VkImageView color, VkImageView depth, VkImageView history, VkImageView output) const;
+
+		void dispatch(VkCommandBuffer commandBuffer, VkPipeline pipeline, VkDescriptorSet set,
+			VkExtent2D extent, const PostProcessConstants& constants);
+
+		uint32_t findMemoryType(uint32_t typeFilter, VkMemoryPropertyFlags properties) const;
+
+	private:
+		static constexpr VkFormat POST_PROCESS_FORMAT = VK_FORMAT_R16G16B16A16_SFLOAT;
+		static constexpr uint32_t JITTER_PHASES = 8;
+
+		VkDevice m_device{};
+		VkPhysicalDeviceMemoryProperties m_memoryProperties{};
+		DeletionQueue* m_pDeletionQueue{ nullptr };
+		Timeline* m_pTimeline{ nullptr };
+		VkSampleCountFlags m_supportedSamples{ VK_SAMPLE_COUNT_1_BIT };
+		AntiAliasingMode m_mode{ AntiAliasingMode::None };
+		VkDescriptorSetLayout m_setLayout{};
+		VkPipelineLayout m_pipelineLayout{};
+		VkPipeline m_fxaaPipeline{};
+		VkPipeline m_taaPipeline{};
+		VkSampler m_linearSampler{};
+		//depth is fetched, and D32 isn't required to support linear filtering
+		VkSampler m_pointSampler{};
+		HistoryImage m_history[2]{};
+		VkExtent2D m_historyExtent{};
+		VkDeviceSize m_historyBytes{ 0 };
+		bool m_historyValid{ false };
+		uint32_t m_frame{ 0 };
+	};
+}
@@ -0,0 +1,116 @@
+#pragma once
+#include <cstdint>
+#include <cstddef>
+#include <string>
+#include <vector>
+#include <istream>
+#include <streambuf>
+#include "MappedFile.h"
+#include "macro.h"
+
+namespace Clan
+{
+	struct AssetSpan {
+		const uint8_t* data{ nullptr };
+		size_t size{ 0 };
+	};
+
+	enum class AssetCompression : uint32_t {
+		None,
+		Lz4,
+	};
+
+	//Pack file of many assets, read through a memory mapping. Entries are found by the hash of
+	//their path in a table at the front of the file and start on 4K boundaries, so a stored entry
+	//is handed out as a span of the mapping without copying. Paths are relative to the working
+	//directory with either kind of slash, the same strings the loaders use for loose files.
+	class AssetArchive
+	{
+	public:
+		AssetArchive() = default;
+
+		AssetArchive(const AssetArchive&) = delete;
+
+		AssetArchive& operator=(const AssetArchive&) = delete;
+
+		~AssetArchive() = default;
+
+		//Maps the archive and prefetches it as a whole. False if it's missing or not a valid archive.
+		bool open(const std::string& path);
+
+		void close();
+
+		bool contains(const std::string& path) const;
+
+		//Points into the mapping, empty for a missing or compressed entry
+		AssetSpan view(const std::string& path) const;
+
+		//The view of a stored entry, a compressed entry is inflated into 'storage'. Empty if the entry
+		//is missing or broken.
+		AssetSpan load(const std::string& path, std::vector<char>& storage) const;
+
+		//Copies the contents into 'out', false if the entry is missing or broken
+		bool read(const std::string& path, std::vector<char>& out) const;
+
+		inline bool isOpen() const { return m_file.isOpen(); }
+
+		inline uint32_t entryCount() const { return m_entryCount; }
+
+	private:
+		friend class AssetArchiveWriter;
+
+		struct Entry;
+
+		const Entry* find(const std::string& path) const;
+
+	private:
+		MappedFile m_file{};
+		const Entry* m_pSlots{ nullptr };
+		uint32_t m_slotCount{ 0 };
+		uint32_t m_entryCount{ 0 };
+		const char* m_pNames{ nullptr };
+	};
+
+	//Collects files and writes them as an archive, a build step rather than a runtime path
+	class AssetArchiveWriter
+	{
+	public:
+		//Reads the file at 'path', it's found in the archive under the same path. False if it can't
+		//be read.
+		bool add(const std::string& path, bool compress = true);
+
+		//Adds every file below 'directory', returns the number of files added
+		uint32_t addDirectory(const std::string& directory, bool compress = true);
+
+		//Entries that don't shrink by at least an eighth are stored uncompressed
+		bool write(const std::string& archivePath) const;
+
+		inline size_t size() const { return m_sources.size(); }
+
+	private:
+		struct Source {
+			std::string path{};
+			std::vector<char> data{};
+			bool compress{ true };
+		};
+
+		std::vector<Source> m_sources{};
+	};
+
+	//Read-only stream over a span, for parsers that only take streams
+	class AssetStreamBuffer : public std::streambuf
+	{
+	public:
+		explicit AssetStreamBuffer(AssetSpan span)
+		{
+			char* pBegin = const_cast<char*>(reinterpret_cast<const char*>(span.data));
+			setg(pBegin, pBegin, pBegin + span.size);
+		}
+	};
+
+	class AssetStream : private AssetStreamBuffer, public std::istream
+	{
+	public:
+		explicit AssetStream(AssetSpan span) : AssetStreamBuffer(span), std::istream(this) {}
+	};
+}
@@ -0,0 +1,97 @@
+#pragma once
+#include <cstdint>
+#include <cstddef>
+#include <string>
+#include <vector>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <condition_variable>
+#include "ThreadPool.h"
+#include "macro.h"
+
+namespace Clan
+{
+	//Runs on the thread calling poll() or wait(). 'bytesRead' is short when the file ends first.
+	using FileReadCallback = std::function<void(size_t bytesRead, bool success)>;
+
+	struct FileReadRequest {
+		std::string path{};
+		uint64_t offset{ 0 };
+		//any memory the caller owns, staging memory included, it must stay valid until the callback
+		void* pDst{ nullptr };
+		size_t size{ 0 };
+		FileReadCallback onComplete{};
+	};
+
+	//Reads file ranges into caller buffers in batches. On Linux the batch goes to the kernel through
+	//io_uring in one call, elsewhere, or when the kernel has no io_uring, every read is a blocking
+	//read on the thread pool. The callbacks can queue more reads, or hand the data to the pool for
+	//decoding, so disk, decode and upload overlap.
+	class AsyncFileReader
+	{
+	public:
+		AsyncFileReader() = default;
+
+		AsyncFileReader(const AsyncFileReader&) = delete;
+
+		AsyncFileReader& operator=(const AsyncFileReader&) = delete;
+
+		~AsyncFileReader() = default;
+
+		//'queueDepth' is the number of reads in flight at once
+		void init(ThreadPool* pPool, uint32_t queueDepth = 64);
+
+		//Waits for the reads in flight, their callbacks still run
+		void destroy();
+
+		//Queued until the next submit()
+		void read(FileReadRequest request);
+
+		//Hands every queued read to the kernel or the pool, reads beyond the queue depth follow as
+		//earlier ones complete
+		void submit();
+
+		//Runs the callbacks of the finished reads without blocking, returns how many ran
+		uint32_t poll();
+
+		//Blocks until every read, including those queued by callbacks, finished and its callback ran
+		void wait();
+
+		inline bool usesIoUring() const { return m_pRing != nullptr; }
+
+		inline bool idle() const { return m_inFlight == 0 && m_queued.empty(); }
+
+		//0 if the file doesn't exist
+		static uint64_t fileSize(const std::string& path);
+
+	private:
+		struct Ring;
+
+		struct Completion {
+			FileReadCallback onComplete;
+			size_t bytesRead;
+			bool success;
+		};
+
+		void submitBlocking();
+
+		void submitRing();
+
+		//Moves finished ring reads to the completions, blocking for at least one when 'block' is set
+		void reapRing(bool block);
+
+		uint32_t runCompletions();
+
+	private:
+		ThreadPool* m_pPool{ nullptr };
+		Ring* m_pRing{ nullptr };
+		uint32_t m_queueDepth{ 0 };
+		std::deque<FileReadRequest> m_queued{};
+		//submitted reads whose callback hasn't run yet
+		uint32_t m_inFlight{ 0 };
+		std::mutex m_mutex{};
+		std::condition_variable m_completionReady{};
+		std::vector<Completion> m_completions{};
+	};
+}
@@ -0,0 +1,116 @@
+#pragma once
+#include <vulkan/vulkan.h>
+#include <cstdint>
+#include <vector>
+#include <functional>
+#include <unordered_map>
+#include "FrameScheduler.h"
+#include "macro.h"
+
+namespace Clan
+{
+	//A buffer range written by async work and then consumed by the graphics queue or another async queue
+	struct BufferHandoff {
+		VkBuffer buffer{};
+		VkDeviceSize offset{ 0 };
+		VkDeviceSize size{ VK_WHOLE_SIZE };
+		VkPipelineStageFlags dstStage{ VK_PIPELINE_STAGE_VERTEX_INPUT_BIT };
+		VkAccessFlags dstAccess{ VK_ACCESS_VERTEX_ATTRIBUTE_READ_BIT };
+	};
+
+	//An image written by async work, left in 'layout', then consumed by the graphics queue or another async queue
+	struct ImageHandoff {
+		VkImage image{};
+		VkImageSubresourceRange range{ VK_IMAGE_ASPECT_COLOR_BIT, 0, VK_REMAINING_MIP_LEVELS, 0, VK_REMAINING_ARRAY_LAYERS };
+		VkImageLayout layout{ VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL };
+		VkPipelineStageFlags dstStage{ VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT };
+		VkAccessFlags dstAccess{ VK_ACCESS_SHADER_READ_BIT };
+	};
+
+	//Submits work (culling, skinning, mip generation, uploads...) to a compute or transfer queue
+	//on its own timeline. Queue family ownership transfers and the cross-queue semaphore waits
+	//for resources handed to the graphics queue, or from one async queue to another, are emitted
+	//automatically.
+	class AsyncQueue
+	{
+	public:
+		using RecordFunc = std::function<void(VkCommandBuffer)>;
+
+		AsyncQueue() = default;
+
+		AsyncQueue(const AsyncQueue&) = delete;
+
+		AsyncQueue& operator=(const AsyncQueue&) = delete;
+
+		~AsyncQueue() = default;
+
+		//'workStages' are the stages the queue's work runs in (compute shader, transfer)
+		void init(VkDevice device, VkQueue queue, uint32_t queueFamily, FrameScheduler* pGraphics,
+			uint32_t graphicsFamily, VkPipelineStageFlags workStages);
+
+		void destroy();
+
+		//Records and submits work, it waits for the graphics frames that still read the handed
+		//over resources. Returns the timeline value signaled on completion.
+		uint64_t submit(const RecordFunc& record,
+			const std::vector<BufferHandoff>& buffers = {},
+			const std::vector<ImageHandoff>& images = {});
+
+		//Like submit(), but the resources go to 'consumer' instead of the graphics queue. Its next
+		//submission acquires them and waits for this one.
+		uint64_t submitTo(AsyncQueue& consumer, const RecordFunc& record,
+			const std::vector<BufferHandoff>& buffers = {},
+			const std::vector<ImageHandoff>& images = {});
+
+		//Records the acquire barriers for every pending handoff into the graphics command buffer
+		//and makes the next graphics submission wait for the async work
+		void acquireOnGraphics(VkCommandBuffer graphicsCommandBuffer);
+
+		inline Timeline& timeline() { return m_timeline; }
+
+		inline uint32_t queueFamily() const { return m_family; }
+
+		//True when the work runs on a different queue family than graphics
+		inline bool isDedicated() const { return m_family != m_graphicsFamily; }
+
+	private:
+		struct InFlightCommandBuffer {
+			VkCommandBuffer commandBuffer;
+			uint64_t value;
+		};
+
+		//handed over by another async queue, acquired by the next submission
+		struct IncomingHandoff {
+			uint32_t family;
+			VkSemaphore semaphore;
+			uint64_t value;
+			std::vector<BufferHandoff> buffers;
+			std::vector<ImageHandoff> images;
+		};
+
+		//Acquires the incoming handoffs, records the work and releases the handoffs to 'dstFamily'
+		uint64_t submitWork(const RecordFunc& record, uint32_t dstFamily,
+			const std::vector<BufferHandoff>& buffers, const std::vector<ImageHandoff>& images);
+
+		VkCommandBuffer acquireCommandBuffer();
+
+		uint64_t lastGraphicsUse(uint64_t handle) const;
+
+	private:
+		VkDevice m_device{};
+		VkCommandPool m_commandPool{};
+		Timeline m_timeline{};
+		FrameScheduler* m_pGraphics{ nullptr };
+		uint32_t m_family{ 0 };
+		uint32_t m_graphicsFamily{ 0 };
+		VkPipelineStageFlags m_workStages{ VK_PIPELINE_STAGE_ALL_COMMANDS_BIT };
+		std::vector<InFlightCommandBuffer> m_inFlight{};
+		std::vector<VkCommandBuffer> m_freeCommandBuffers{};
+		std::vector<BufferHandoff> m_pendingBuffers{};
+		std::vector<ImageHandoff> m_pendingImages{};
+		uint64_t m_pendingValue{ 0 };
+		std::vector<IncomingHandoff> m_incoming{};
+		//handle -> graphics timeline value of the frame that last read it
+		std::unordered_map<uint64_t, uint64_t> m_graphicsUse{};
+	};
+}
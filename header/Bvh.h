@@ -0,0 +1,84 @@
+#pragma once
+#include <cstdint>
+#include <vector>
+#include <atomic>
+#include <glm/glm.hpp>
+#include "TransformKernels.h"
+#include "macro.h"
+
+namespace Clan
+{
+	struct Ray {
+		glm::vec3 origin{ 0.0f };
+		glm::vec3 direction{ 0.0f, 0.0f, 1.0f };
+	};
+
+	struct RayHit {
+		uint32_t object{ ~0u };
+		float distance{ 0.0f };
+	};
+
+	//Four children per node with their boxes stored as structure of arrays, one query tests all
+	//four boxes with a single SIMD instruction per plane or slab
+	struct BvhNode {
+		float minX[4], minY[4], minZ[4];
+		float maxX[4], maxY[4], maxZ[4];
+		//a node index when 'count' is 0, otherwise the first of 'count' leaf objects
+		uint32_t child[4];
+		uint32_t count[4];
+	};
+
+	//Bounding volume hierarchy over object boxes, built top-down with binned SAH. Objects are the
+	//indices of the boxes passed to build(). A moving object only needs refit(), the tree is
+	//rebuilt when the boxes moved so far that the queries get slow.
+	class Bvh
+	{
+	public:
+		Bvh() = default;
+
+		Bvh(const Bvh&) = delete;
+
+		Bvh& operator=(const Bvh&) = delete;
+
+		~Bvh() = default;
+
+		//Subtrees over 'parallelThreshold' objects are built on their own thread
+		void build(const BoundsArrays& bounds, uint32_t parallelThreshold = 4096);
+
+		//Recomputes every box bottom-up for the moved objects, the topology stays
+		void refit(const BoundsArrays& bounds);
+
+		void clear();
+
+		//Appends the objects whose box intersects the frustum, returns how many were added
+		size_t cullFrustum(const Frustum& frustum, std::vector<uint32_t>& visible) const;
+
+		//Closest object box hit by the ray within 'maxDistance', the direction doesn't need to be normalized
+		bool raycast(const Ray& ray, float maxDistance, RayHit& hit) const;
+
+		inline size_t nodeCount() const { return m_nodes.size(); }
+
+		inline size_t objectCount() const { return m_objects.size(); }
+
+	private:
+		struct Range {
+			uint32_t begin;
+			uint32_t end;
+		};
+
+		uint32_t buildNode(uint32_t begin, uint32_t end, uint32_t parallelThreshold);
+
+		//Binned SAH split of the objects in the range, returns the first object of the right half
+		uint32_t split(uint32_t begin, uint32_t end);
+
+		void appendSubtree(uint32_t node, std::vector<uint32_t>& visible) const;
+
+	private:
+		std::vector<BvhNode> m_nodes{};
+		std::atomic<uint32_t> m_nodeCount{ 0 };
+		//leaf object ranges point into this permutation of the object indices
+		std::vector<uint32_t> m_objects{};
+		std::vector<glm::vec3> m_objectMin{};
+		std::vector<glm::vec3> m_objectMax{};
+	};
+}
@@ -0,0 +1,69 @@
+#pragma once
+#include <vulkan/vulkan.h>
+#include <cstdint>
+#include <vector>
+#include "macro.h"
+
+namespace Clan
+{
+	//Defers vkDestroy*/vkFreeMemory calls until the GPU timeline passed the value at which
+	//the handle was last used, so resources can be released at runtime without idling the device.
+	class DeletionQueue
+	{
+	public:
+		DeletionQueue() = default;
+
+		DeletionQueue(const DeletionQueue&) = delete;
+
+		DeletionQueue& operator=(const DeletionQueue&) = delete;
+
+		~DeletionQueue() = default;
+
+		void init(VkDevice device);
+
+		//Queues a handle of the given object type, 'bytes' is the memory it keeps alive
+		template<VkObjectType Type, typename Handle>
+		inline void retire(Handle handle, uint64_t lastUseValue, VkDeviceSize bytes = 0);
+
+		//Queues a buffer and its dedicated memory, the memory size is counted as pending bytes
+		void retireBuffer(VkBuffer buffer, VkDeviceMemory memory, uint64_t lastUseValue);
+
+		//Queues an image and its dedicated memory, the memory size is counted as pending bytes
+		void retireImage(VkImage image, VkDeviceMemory memory, uint64_t lastUseValue);
+
+		//Destroys every handle whose last use is <= completedValue, returns how many were freed
+		uint32_t flush(uint64_t completedValue);
+
+		//Destroys everything. The caller must guarantee the device is idle
+		void flushAll();
+
+		inline VkDeviceSize pendingBytes() const { return m_pendingBytes; }
+
+		inline size_t pendingCount() const { return m_entries.size(); }
+
+	private:
+		struct Entry {
+			uint64_t value;
+			uint64_t handle;
+			VkDeviceSize bytes;
+			VkObjectType type;
+		};
+
+		void push(VkObjectType type, uint64_t handle, uint64_t lastUseValue, VkDeviceSize bytes);
+
+		void destroy(const Entry& entry);
+
+	private:
+		VkDevice m_device{};
+		std::vector<Entry> m_entries{};
+		VkDeviceSize m_pendingBytes{ 0 };
+		uint64_t m_minPendingValue{ UINT64_MAX };
+	};
+
+	template<VkObjectType Type, typename Handle>
+	inline void DeletionQueue::retire(Handle handle, uint64_t lastUseValue, VkDeviceSize bytes)
+	{
+		if (handle == VK_NULL_HANDLE) return;
+		push(Type, (uint64_t)handle, lastUseValue, bytes);
+	}
+}
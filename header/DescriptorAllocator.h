@@ -0,0 +1,99 @@
+#pragma once
+#include <vulkan/vulkan.h>
+#include <cstdint>
+#include <vector>
+#include <unordered_map>
+#include "macro.h"
+
+namespace Clan
+{
+	//The descriptors of one set, by value, so equal contents give equal keys
+	class DescriptorWriter
+	{
+	public:
+		DescriptorWriter& buffer(uint32_t binding, VkDescriptorType type, VkBuffer buffer, VkDeviceSize offset, VkDeviceSize range);
+
+		DescriptorWriter& image(uint32_t binding, VkDescriptorType type, VkImageView view, VkSampler sampler, VkImageLayout layout);
+
+		void update(VkDevice device, VkDescriptorSet set) const;
+
+		inline const std::vector<uint32_t>& key() const { return m_key; }
+
+		inline size_t size() const { return m_writes.size(); }
+
+		inline VkDescriptorType type(size_t index) const { return m_writes[index].type; }
+
+	private:
+		struct Write {
+			uint32_t binding{ 0 };
+			VkDescriptorType type{};
+			VkDescriptorBufferInfo bufferInfo{};
+			VkDescriptorImageInfo imageInfo{};
+			bool isImage{ false };
+		};
+
+	private:
+		std::vector<Write> m_writes{};
+		std::vector<uint32_t> m_key{};
+	};
+
+	//Allocates descriptor sets from a list of pools that never runs out: a full pool is put aside
+	//and the next one is taken, every new pool holds twice the sets of the one before, and its
+	//descriptor counts follow what the sets written through get() used so far. reset() returns
+	//every set at once with vkResetDescriptorPool, which makes one allocator per frame in flight
+	//the cheap way to get transient descriptors.
+	class DescriptorAllocator
+	{
+	public:
+		DescriptorAllocator() = default;
+
+		DescriptorAllocator(const DescriptorAllocator&) = delete;
+
+		DescriptorAllocator& operator=(const DescriptorAllocator&) = delete;
+
+		~DescriptorAllocator() = default;
+
+		//The first pool holds 'setsPerPool' sets of 'sizesPerSet' descriptors
+		void init(VkDevice device, uint32_t setsPerPool, const std::vector<VkDescriptorPoolSize>& sizesPerSet);
+
+		void destroy();
+
+		VkDescriptorSet allocate(VkDescriptorSetLayout layout);
+
+		//A set of 'layout' holding 'writer', the same contents return the same set until reset()
+		VkDescriptorSet get(VkDescriptorSetLayout layout, const DescriptorWriter& writer);
+
+		//Every set is freed, the GPU must be done with them
+		void reset();
+
+		inline size_t poolCount() const { return m_usedPools.size() + m_freePools.size(); }
+
+		inline size_t cachedSetCount() const { return m_cache.size(); }
+
+	private:
+		using Key = std::vector<uint32_t>;
+
+		struct KeyHash {
+			size_t operator()(const Key& key) const;
+		};
+
+		//A reset pool when there is one, a new larger one otherwise
+		VkDescriptorPool nextPool();
+
+		VkDescriptorPool createPool(uint32_t setCount);
+
+	private:
+		static constexpr uint32_t MAX_SETS_PER_POOL = 4096;
+
+		VkDevice m_device{};
+		VkDescriptorPool m_currentPool{};
+		std::vector<VkDescriptorPool> m_usedPools{};
+		std::vector<VkDescriptorPool> m_freePools{};
+		uint32_t m_setsPerPool{ 0 };
+		//descriptors per set, given to init() and counted by get()
+		std::unordered_map<VkDescriptorType, float> m_initialRatios{};
+		std::unordered_map<VkDescriptorType, uint64_t> m_writtenDescriptors{};
+		uint64_t m_writtenSets{ 0 };
+		std::unordered_map<Key, VkDescriptorSet, KeyHash> m_cache{};
+	};
+}
@@ -0,0 +1,117 @@
+#pragma once
+#include <vulkan/vulkan.h>
+#include <cstdint>
+#include <vector>
+#include "macro.h"
+
+namespace Clan
+{
+	//A wait on either a timeline value or a binary semaphore (value is ignored for binary ones)
+	struct SemaphoreWait {
+		VkSemaphore semaphore{};
+		uint64_t value{ 0 };
+		VkPipelineStageFlags stage{ VK_PIPELINE_STAGE_ALL_COMMANDS_BIT };
+	};
+
+	//One timeline semaphore per queue. Each submission signals the next value, so a single
+	//monotonically increasing number identifies any point of the queue's GPU progress.
+	class Timeline
+	{
+	public:
+		Timeline() = default;
+
+		Timeline(const Timeline&) = delete;
+
+		Timeline& operator=(const Timeline&) = delete;
+
+		~Timeline() = default;
+
+		void init(VkDevice device, VkQueue queue);
+
+		void destroy();
+
+		//Submits the command buffers and signals the next timeline value, which is returned
+		uint64_t submit(const VkCommandBuffer* pCommandBuffers, uint32_t count,
+			const std::vector<SemaphoreWait>& waits = {},
+			const std::vector<VkSemaphore>& binarySignals = {});
+
+		//Returns the last value the GPU has signaled, refreshing the cached one
+		uint64_t completedValue();
+
+		inline bool isComplete(uint64_t value);
+
+		//Blocks the CPU until the GPU reached 'value'
+		void wait(uint64_t value);
+
+		inline uint64_t lastSubmitted() const { return m_lastSubmitted; }
+
+		inline VkSemaphore handle() const { return m_semaphore; }
+
+		inline VkQueue queue() const { return m_queue; }
+
+	private:
+		VkDevice m_device{};
+		VkQueue m_queue{};
+		VkSemaphore m_semaphore{};
+		uint64_t m_lastSubmitted{ 0 };
+		uint64_t m_lastCompleted{ 0 };
+	};
+
+	//Paces the frames in flight with the graphics timeline instead of a fence per frame.
+	//The CPU only waits for the value signaled by the frame that last used the same slot.
+	class FrameScheduler
+	{
+	public:
+		FrameScheduler() = default;
+
+		FrameScheduler(const FrameScheduler&) = delete;
+
+		FrameScheduler& operator=(const FrameScheduler&) = delete;
+
+		~FrameScheduler() = default;
+
+		void init(VkDevice device, VkQueue graphicsQueue, uint32_t framesInFlight);
+
+		void destroy();
+
+		//Waits until the resources of 'frameIndex' are no longer used by the GPU
+		void beginFrame(uint32_t frameIndex);
+
+		//Adds a wait to the next frame submission (swapchain acquire, other queues' timelines...)
+		inline void addWait(VkSemaphore semaphore, uint64_t value, VkPipelineStageFlags stage);
+
+		//Adds a binary semaphore the next frame submission signals (e.g. for present)
+		inline void addSignal(VkSemaphore semaphore);
+
+		//Submits the frame and returns the timeline value it will signal
+		uint64_t submit(const VkCommandBuffer* pCommandBuffers, uint32_t count);
+
+		inline Timeline& timeline() { return m_timeline; }
+
+		inline uint64_t completedValue() { return m_timeline.completedValue(); }
+
+		inline uint64_t currentFrameValue() const { return m_frameValues[m_frameIndex]; }
+
+	private:
+		Timeline m_timeline{};
+		std::vector<uint64_t> m_frameValues{};
+		std::vector<SemaphoreWait> m_pendingWaits{};
+		std::vector<VkSemaphore> m_pendingSignals{};
+		uint32_t m_frameIndex{ 0 };
+	};
+
+	inline bool Timeline::isComplete(uint64_t value)
+	{
+		return value <= m_lastCompleted || value <= completedValue();
+	}
+
+	inline void FrameScheduler::addWait(VkSemaphore semaphore, uint64_t value, VkPipelineStageFlags stage)
+	{
+		m_pendingWaits.push_back({ semaphore, value, stage });
+	}
+
+	inline void FrameScheduler::addSignal(VkSemaphore semaphore)
+	{
+		m_pendingSignals.push_back(semaphore);
+	}
+}
@@ -0,0 +1,108 @@
+#pragma once
+#include <vulkan/vulkan.h>
+#include <cstdint>
+#include <cstring>
+#include <type_traits>
+#include <vector>
+#include "MemoryTracker.h"
+#include "macro.h"
+
+namespace Clan
+{
+	//Place of one mesh in the arena, the values of its draw calls
+	struct GeometryMesh {
+		int32_t vertexOffset{ 0 };
+		//in indices of 'indexType'
+		uint32_t firstIndex{ 0 };
+		uint32_t vertexCount{ 0 };
+		uint32_t indexCount{ 0 };
+		VkIndexType indexType{ VK_INDEX_TYPE_UINT32 };
+	};
+
+	//One device-local buffer holding the vertices and indices of many meshes. Meshes are placed
+	//one after the other and drawn with vertexOffset/firstIndex, so they all share one vertex
+	//bind and one index bind per index type: the vertex and index buffers are bound at offset 0
+	//and every mesh is aligned to its vertex stride and index size.
+	class GeometryArena
+	{
+	public:
+		GeometryArena() = default;
+
+		GeometryArena(const GeometryArena&) = delete;
+
+		GeometryArena& operator=(const GeometryArena&) = delete;
+
+		~GeometryArena() = default;
+
+		void init(VkDevice device, VkPhysicalDevice physicalDevice, VkDeviceSize capacity, uint32_t vertexStride);
+
+		void destroy();
+
+		//Meshes with up to 65536 vertices get 16 bit indices
+		static VkIndexType indexTypeFor(uint32_t vertexCount);
+
+		//Places a mesh whose indices count from its first vertex. The data is kept until the next
+		//recordUpload(). False when the arena is full.
+		template<typename Index>
+		bool add(const void* pVertices, uint32_t vertexCount, const Index* pIndices, uint32_t indexCount, GeometryMesh& mesh);
+
+		//Bytes recordUpload() needs in its staging buffer
+		inline VkDeviceSize pendingSize() const { return m_pending.size(); }
+
+		//Writes the meshes added since the last upload to 'pStaging', the mapping of 'stagingBuffer',
+		//and records one copy of them into the arena. The copy has to finish before they are drawn.
+		void recordUpload(VkCommandBuffer commandBuffer, VkBuffer stagingBuffer, void* pStaging);
+
+		void bindVertices(VkCommandBuffer commandBuffer) const;
+
+		void bindIndices(VkCommandBuffer commandBuffer, VkIndexType indexType) const;
+
+		inline VkBuffer buffer() const { return m_buffer; }
+
+		inline VkDeviceSize usedBytes() const { return m_usedBytes; }
+
+		inline VkDeviceSize capacity() const { return m_capacity; }
+
+		//Bytes the 16 bit indices saved over 32 bit ones
+		inline VkDeviceSize savedIndexBytes() const { return m_savedIndexBytes; }
+
+	private:
+		//Reserves the ranges of a mesh and returns where its data goes in m_pending
+		bool reserve(uint32_t vertexCount, uint32_t indexCount, GeometryMesh& mesh, uint8_t*& pVertexDst, uint8_t*& pIndexDst);
+
+	private:
+		VkDevice m_device{};
+		VkBuffer m_buffer{};
+		VkDeviceMemory m_memory{};
+		VkDeviceSize m_capacity{ 0 };
+		uint32_t m_vertexStride{ 0 };
+		VkDeviceSize m_usedBytes{ 0 };
+		//arena bytes from m_uploadedBytes to m_usedBytes, waiting for recordUpload()
+		TrackedVector<uint8_t, MemoryTag::Geometry> m_pending{};
+		VkDeviceSize m_uploadedBytes{ 0 };
+		VkDeviceSize m_savedIndexBytes{ 0 };
+	};
+
+	template<typename Index>
+	bool GeometryArena::add(const void* pVertices, uint32_t vertexCount, const Index* pIndices, uint32_t indexCount, GeometryMesh& mesh)
+	{
+		static_assert(std::is_same_v<Index, uint16_t> || std::is_same_v<Index, uint32_t>, "16 or 32 bit indices");
+		uint8_t* pVertexDst = nullptr;
+		uint8_t* pIndexDst = nullptr;
+		if (!reserve(vertexCount, indexCount, mesh, pVertexDst, pIndexDst)) return false;
+		std::memcpy(pVertexDst, pVertices, static_cast<size_t>(vertexCount) * m_vertexStride);
+		if (mesh.indexType == VK_INDEX_TYPE_UINT16) {
+			uint16_t* pDst = reinterpret_cast<uint16_t*>(pIndexDst);
+			for (uint32_t i = 0; i < indexCount; ++i) {
+				pDst[i] = static_cast<uint16_t>(pIndices[i]);
+			}
+		}
+		else {
+			uint32_t* pDst = reinterpret_cast<uint32_t*>(pIndexDst);
+			for (uint32_t i = 0; i < indexCount; ++i) {
+				pDst[i] = static_cast<uint32_t>(pIndices[i]);
+			}
+		}
+		return true;
+	}
+}
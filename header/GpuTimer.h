@@ -0,0 +1,44 @@
+#pragma once
+#include <vulkan/vulkan.h>
+#include <cstdint>
+#include <vector>
+#include "macro.h"
+
+namespace Clan
+{
+	//Measures the GPU time of every frame with a pair of timestamp queries per frame in flight.
+	//A slot is read back when it comes around again, its previous submission is complete by then.
+	class GpuTimer
+	{
+	public:
+		GpuTimer() = default;
+
+		GpuTimer(const GpuTimer&) = delete;
+
+		GpuTimer& operator=(const GpuTimer&) = delete;
+
+		~GpuTimer() = default;
+
+		void init(VkDevice device, VkPhysicalDevice physicalDevice, uint32_t queueFamily, uint32_t framesInFlight);
+
+		void destroy();
+
+		//Resets the slot and writes the first timestamp, must be recorded outside of a render pass
+		void begin(VkCommandBuffer commandBuffer, uint32_t frameIndex);
+
+		void end(VkCommandBuffer commandBuffer, uint32_t frameIndex);
+
+		//GPU milliseconds of the last frame recorded in the slot, false if there is none yet
+		bool collect(uint32_t frameIndex, double& milliseconds);
+
+		//False when the queue family has no timestamp support, begin/end are no-ops then
+		inline bool isSupported() const { return m_queryPool != VK_NULL_HANDLE; }
+
+	private:
+		VkDevice m_device{};
+		VkQueryPool m_queryPool{};
+		double m_nanosecondsPerTick{ 1.0 };
+		uint64_t m_validMask{ ~0ull };
+		std::vector<bool> m_recorded{};
+	};
+}
@@ -0,0 +1,52 @@
+#pragma once
+#include <vulkan/vulkan.h>
+#include <cstdint>
+#include <vector>
+#include <unordered_map>
+#include "ShaderReflection.h"
+#include "macro.h"
+
+namespace Clan
+{
+	//Descriptor set layouts and pipeline layouts keyed by a hash of their description, so every
+	//pipeline with a compatible interface shares the same objects. They live until destroy().
+	class LayoutCache
+	{
+	public:
+		LayoutCache() = default;
+
+		LayoutCache(const LayoutCache&) = delete;
+
+		LayoutCache& operator=(const LayoutCache&) = delete;
+
+		~LayoutCache() = default;
+
+		void init(VkDevice device);
+
+		void destroy();
+
+		VkDescriptorSetLayout descriptorSetLayout(const std::vector<VkDescriptorSetLayoutBinding>& bindings);
+
+		VkPipelineLayout pipelineLayout(const std::vector<VkDescriptorSetLayout>& setLayouts,
+			const std::vector<VkPushConstantRange>& pushConstantRanges);
+
+		//Layouts of a reflected program, 'pSetLayouts' receives the layout of every set
+		VkPipelineLayout pipelineLayout(const ShaderReflection& reflection, std::vector<VkDescriptorSetLayout>* pSetLayouts = nullptr);
+
+		inline size_t descriptorSetLayoutCount() const { return m_setLayouts.size(); }
+
+		inline size_t pipelineLayoutCount() const { return m_pipelineLayouts.size(); }
+
+	private:
+		using Key = std::vector<uint32_t>;
+
+		struct KeyHash {
+			size_t operator()(const Key& key) const;
+		};
+
+	private:
+		VkDevice m_device{};
+		std::unordered_map<Key, VkDescriptorSetLayout, KeyHash> m_setLayouts{};
+		std::unordered_map<Key, VkPipelineLayout, KeyHash> m_pipelineLayouts{};
+	};
+}
@@ -0,0 +1,216 @@
+#pragma once
+#include <cstdint>
+#include <cstddef>
+#include <atomic>
+#include <memory>
+#include <utility>
+#include "macro.h"
+
+namespace Clan
+{
+	//indices written by different threads are kept this far apart so they don't share a line
+	constexpr size_t CACHE_LINE_SIZE = 64;
+
+	//Bounded ring for one producer and one consumer thread. Each side caches the other's index and
+	//only reloads it when the ring looks full or empty, so most operations touch no shared line.
+	template<typename T>
+	class SpscRing
+	{
+	public:
+		SpscRing() = default;
+
+		SpscRing(const SpscRing&) = delete;
+
+		SpscRing& operator=(const SpscRing&) = delete;
+
+		~SpscRing() = default;
+
+		//'capacity' is a power of two. Not thread safe, call it before the threads start.
+		void init(uint32_t capacity)
+		{
+			ASSERT(capacity > 0 && (capacity & (capacity - 1)) == 0);
+			m_cells = std::make_unique<T[]>(capacity);
+			m_mask = capacity - 1;
+			m_tail.store(0, std::memory_order_relaxed);
+			m_head.store(0, std::memory_order_relaxed);
+			m_headCache = 0;
+			m_tailCache = 0;
+		}
+
+		void destroy() { m_cells.reset(); }
+
+		//Producer side, false when the ring is full
+		template<typename U>
+		bool tryPush(U&& value)
+		{
+			uint64_t tail = m_tail.load(std::memory_order_relaxed);
+			if (tail - m_headCache > m_mask) {
+				m_headCache = m_head.load(std::memory_order_acquire);
+				if (tail - m_headCache > m_mask) return false;
+			}
+			m_cells[tail & m_mask] = std::forward<U>(value);
+			m_tail.store(tail + 1, std::memory_order_release);
+			return true;
+		}
+
+		//Consumer side, false when the ring is empty
+		bool tryPop(T& value)
+		{
+			uint64_t head = m_head.load(std::memory_order_relaxed);
+			if (head == m_tailCache) {
+				m_tailCache = m_tail.load(std::memory_order_acquire);
+				if (head == m_tailCache) return false;
+			}
+			value = std::move(m_cells[head & m_mask]);
+			m_head.store(head + 1, std::memory_order_release);
+			return true;
+		}
+
+		inline uint32_t capacity() const { return static_cast<uint32_t>(m_mask + 1); }
+
+	private:
+		std::unique_ptr<T[]> m_cells{};
+		uint64_t m_mask{ 0 };
+		//written by the producer
+		alignas(CACHE_LINE_SIZE) std::atomic<uint64_t> m_tail{ 0 };
+		uint64_t m_headCache{ 0 };
+		//written by the consumer
+		alignas(CACHE_LINE_SIZE) std::atomic<uint64_t> m_head{ 0 };
+		uint64_t m_tailCache{ 0 };
+	};
+
+	//Bounded queue for any number of producers and consumers. Every cell carries a sequence number
+	//telling whether it's free for the push or filled for the pop at a position, so a thread claims
+	//a position with one compare-exchange and never waits for another thread to finish its copy.
+	template<typename T>
+	class MpmcQueue
+	{
+	public:
+		MpmcQueue() = default;
+
+		MpmcQueue(const MpmcQueue&) = delete;
+
+		MpmcQueue& operator=(const MpmcQueue&) = delete;
+
+		~MpmcQueue() = default;
+
+		//'capacity' is a power of two. Not thread safe, call it before the threads start.
+		void init(uint32_t capacity)
+		{
+			ASSERT(capacity > 0 && (capacity & (capacity - 1)) == 0);
+			m_cells = std::make_unique<Cell[]>(capacity);
+			m_mask = capacity - 1;
+			for (uint32_t i = 0; i < capacity; ++i) {
+				m_cells[i].sequence.store(i, std::memory_order_relaxed);
+			}
+			m_enqueue.store(0, std::memory_order_relaxed);
+			m_dequeue.store(0, std::memory_order_relaxed);
+		}
+
+		void destroy() { m_cells.reset(); }
+
+		//False when the queue is full
+		template<typename U>
+		bool tryPush(U&& value)
+		{
+			uint64_t position = m_enqueue.load(std::memory_order_relaxed);
+			while (true) {
+				Cell& cell = m_cells[position & m_mask];
+				int64_t difference = static_cast<int64_t>(cell.sequence.load(std::memory_order_acquire) - position);
+				if (difference == 0) {
+					if (m_enqueue.compare_exchange_weak(position, position + 1, std::memory_order_relaxed)) {
+						cell.value = std::forward<U>(value);
+						cell.sequence.store(position + 1, std::memory_order_release);
+						return true;
+					}
+				}
+				else if (difference < 0) {
+					return false;
+				}
+				else {
+					position = m_enqueue.load(std::memory_order_relaxed);
+				}
+			}
+		}
+
+		//False when the queue is empty
+		bool tryPop(T& value)
+		{
+			uint64_t position = m_dequeue.load(std::memory_order_relaxed);
+			while (true) {
+				Cell& cell = m_cells[position & m_mask];
+				int64_t difference = static_cast<int64_t>(cell.sequence.load(std::memory_order_acquire) - (position + 1));
+				if (difference == 0) {
+					if (m_dequeue.compare_exchange_weak(position, position + 1, std::memory_order_relaxed)) {
+						value = std::move(cell.value);
+						//free for the push one lap later
+						cell.sequence.store(position + m_mask + 1, std::memory_order_release);
+						return true;
+					}
+				}
+				else if (difference < 0) {
+					return false;
+				}
+				else {
+					position = m_dequeue.load(std::memory_order_relaxed);
+				}
+			}
+		}
+
+		inline uint32_t capacity() const { return static_cast<uint32_t>(m_mask + 1); }
+
+	private:
+		struct Cell {
+			std::atomic<uint64_t> sequence{ 0 };
+			T value{};
+		};
+
+	private:
+		std::unique_ptr<Cell[]> m_cells{};
+		uint64_t m_mask{ 0 };
+		alignas(CACHE_LINE_SIZE) std::atomic<uint64_t> m_enqueue{ 0 };
+		alignas(CACHE_LINE_SIZE) std::atomic<uint64_t> m_dequeue{ 0 };
+	};
+
+	//Link embedded in the items of an IntrusiveMpscQueue, an item is in at most one queue at a time
+	struct MpscNode {
+		std::atomic<MpscNode*> next{ nullptr };
+	};
+
+	//Unbounded queue of caller-owned nodes for any number of producers and one consumer. A push is
+	//one exchange and never fails, nothing is allocated. The items derive from MpscNode and are
+	//cast back after pop().
+	class IntrusiveMpscQueue
+	{
+	public:
+		IntrusiveMpscQueue() = default;
+
+		IntrusiveMpscQueue(const IntrusiveMpscQueue&) = delete;
+
+		IntrusiveMpscQueue& operator=(const IntrusiveMpscQueue&) = delete;
+
+		~IntrusiveMpscQueue() = default;
+
+		//Not thread safe, call it before the threads start
+		void init();
+
+		//Any thread, 'pNode' must stay alive until it's popped
+		void push(MpscNode* pNode);
+
+		//Consumer side, null when empty. Also null for a moment while a push is halfway done, the
+		//node shows up on a later call.
+		MpscNode* pop();
+
+	private:
+		//always in the queue, so a push never sees it empty
+		MpscNode m_stub{};
+		//newest node, exchanged by the producers
+		alignas(CACHE_LINE_SIZE) std::atomic<MpscNode*> m_head{ &m_stub };
+		//oldest node, only the consumer touches it
+		alignas(CACHE_LINE_SIZE) MpscNode* m_tail{ &m_stub };
+	};
+
+	//Throughput of the queues with different numbers of producer and consumer threads, next to a
+	//std::deque behind a mutex. Prints a table.
+	void benchmarkQueues(uint32_t itemsPerProducer);
+}
@@ -0,0 +1,17 @@
+#pragma once
+#include <cstdint>
+#include <cstddef>
+
+namespace Clan
+{
+	//LZ4 block format, without the frame around it. The sizes are kept by the caller.
+
+	//Worst case size of compressing 'size' bytes
+	size_t lz4CompressBound(size_t size);
+
+	//Greedy single pass compressor. Returns the compressed size, 0 if it doesn't fit into 'dstCapacity'.
+	size_t lz4Compress(const uint8_t* pSrc, size_t srcSize, uint8_t* pDst, size_t dstCapacity);
+
+	//False if the block is malformed or doesn't inflate to exactly 'dstSize' bytes
+	bool lz4Decompress(const uint8_t* pSrc, size_t srcSize, uint8_t* pDst, size_t dstSize);
+}
@@ -0,0 +1,43 @@
+#pragma once
+#include <cstdint>
+#include <cstddef>
+#include <string>
+#include "macro.h"
+
+namespace Clan
+{
+	//Read-only memory mapping of a whole file, the pages are read on first access
+	class MappedFile
+	{
+	public:
+		MappedFile() = default;
+
+		MappedFile(const MappedFile&) = delete;
+
+		MappedFile& operator=(const MappedFile&) = delete;
+
+		~MappedFile() = default;
+
+		//False when the file can't be opened or is empty
+		bool open(const std::string& path);
+
+		void close();
+
+		//Asks the OS to read the whole file ahead in large sequential reads instead of page by page
+		void prefetch() const;
+
+		inline const uint8_t* data() const { return m_pData; }
+
+		inline size_t size() const { return m_size; }
+
+		inline bool isOpen() const { return m_pData != nullptr; }
+
+	private:
+		const uint8_t* m_pData{ nullptr };
+		size_t m_size{ 0 };
+#ifdef _WIN32
+		void* m_file{ nullptr };
+		void* m_mapping{ nullptr };
+#endif
+	};
+}
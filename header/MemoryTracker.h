@@ -0,0 +1,108 @@
+#pragma once
+#include <vulkan/vulkan.h>
+#include <cstdint>
+#include <cstddef>
+#include <new>
+#include <string>
+#include <vector>
+#include "macro.h"
+
+#define CLAN_STRINGIFY_IMPL(x) #x
+#define CLAN_STRINGIFY(x) CLAN_STRINGIFY_IMPL(x)
+
+//Tracked host allocation, counted under 'tag' and under the file and line it is made from
+#define TRACKED_ALLOC(size, alignment, tag) \
+	::Clan::trackedAlloc(size, alignment, tag, []() { \
+		static const uint16_t callsite = ::Clan::memoryCallsite(__FILE__ ":" CLAN_STRINGIFY(__LINE__)); \
+		return callsite; \
+	}())
+
+namespace Clan
+{
+	enum class MemoryTag : uint8_t {
+		//global operator new, the STL containers without a tracked allocator. Only counted in builds
+		//with CLAN_TRACK_MEMORY, it stays empty otherwise.
+		Untagged,
+		Geometry,
+		StackAllocator,
+		//blocks the Vulkan driver allocates through vulkanAllocator()
+		Driver,
+		//allocations the driver only reports, made outside of the callbacks
+		DriverInternal,
+		Count,
+	};
+
+	const char* memoryTagName(MemoryTag tag);
+
+	struct MemoryStats {
+		int64_t currentBytes{ 0 };
+		int64_t peakBytes{ 0 };
+		uint64_t allocationCount{ 0 };
+	};
+
+	//Host memory. Every block carries a small header with its size, tag and callsite, so any tracked
+	//block can be freed with trackedFree() alone. 'alignment' must be a power of two.
+	void* trackedAlloc(size_t size, size_t alignment, MemoryTag tag, uint16_t callsite);
+
+	void trackedFree(void* pointer);
+
+	//Index of a named callsite, the same name always gets the same index. Meant to be cached, see
+	//TRACKED_ALLOC.
+	uint16_t memoryCallsite(const char* name);
+
+	MemoryStats hostMemoryStats(MemoryTag tag);
+
+	//Standard allocator counting a container's memory under 'Tag'
+	template<typename T, MemoryTag Tag>
+	struct TrackedAllocator {
+		using value_type = T;
+
+		template<typename U>
+		struct rebind {
+			using other = TrackedAllocator<U, Tag>;
+		};
+
+		TrackedAllocator() = default;
+
+		template<typename U>
+		TrackedAllocator(const TrackedAllocator<U, Tag>&) {}
+
+		T* allocate(size_t count)
+		{
+			static const uint16_t callsite = memoryCallsite(memoryTagName(Tag));
+			void* pointer = trackedAlloc(count * sizeof(T), alignof(T), Tag, callsite);
+			if (pointer == nullptr) throw std::bad_alloc();
+			return static_cast<T*>(pointer);
+		}
+
+		void deallocate(T* pointer, size_t) { trackedFree(pointer); }
+
+		template<typename U>
+		bool operator==(const TrackedAllocator<U, Tag>&) const { return true; }
+	};
+
+	template<typename T, MemoryTag Tag>
+	using TrackedVector = std::vector<T, TrackedAllocator<T, Tag>>;
+
+	//Passed to every vkCreate*/vkDestroy*, counts the driver's host memory per allocation scope
+	const VkAllocationCallbacks* vulkanAllocator();
+
+	//Device memory is counted per heap. With VK_EXT_memory_budget enabled on the device the counts
+	//are checked against the budget the driver reports, otherwise against the heap sizes.
+	void initDeviceMemoryTracking(VkPhysicalDevice physicalDevice, bool budgetSupported);
+
+	//vkAllocateMemory and vkFreeMemory with the accounting
+	VkResult allocateDeviceMemory(VkDevice device, const VkMemoryAllocateInfo* pAllocateInfo, VkDeviceMemory* pMemory);
+
+	void freeDeviceMemory(VkDevice device, VkDeviceMemory memory);
+
+	MemoryStats deviceMemoryStats(uint32_t heapIndex);
+
+	//Warns once per heap when its usage goes over budget, returns false while any heap is over
+	bool checkMemoryBudget();
+
+	//Host tags, host callsites and device heaps as JSON
+	std::string memoryReportJson();
+
+	bool writeMemoryReport(const std::string& path);
+}
@@ -0,0 +1,57 @@
+#pragma once
+#include <vulkan/vulkan.h>
+#include <cstdint>
+#include <vector>
+#include "DescriptorAllocator.h"
+#include "macro.h"
+
+namespace Clan
+{
+	//Fills the mip chain of RGBA8 sRGB textures with a compute shader, so it runs on a compute
+	//queue instead of blitting on the graphics one. Every level is the box filtered level above,
+	//averaged in linear space. The images need VK_IMAGE_CREATE_MUTABLE_FORMAT_BIT and
+	//VK_IMAGE_CREATE_EXTENDED_USAGE_BIT: the levels are written through UNORM storage views.
+	class MipGenerator
+	{
+	public:
+		MipGenerator() = default;
+
+		MipGenerator(const MipGenerator&) = delete;
+
+		MipGenerator& operator=(const MipGenerator&) = delete;
+
+		~MipGenerator() = default;
+
+		//Empty shader code leaves the generator unavailable
+		void init(VkDevice device, const std::vector<char>& code);
+
+		void destroy();
+
+		inline bool isAvailable() const { return m_pipeline != VK_NULL_HANDLE; }
+
+		//Level 0 has to be in SHADER_READ_ONLY_OPTIMAL, every level is left in it
+		void record(VkCommandBuffer commandBuffer, VkImage image, uint32_t width, uint32_t height, uint32_t mipLevels);
+
+		//Frees the views and descriptor sets of every recorded image, the GPU must be done with them
+		void reset();
+
+		//Down to 1x1
+		static uint32_t mipLevels(uint32_t width, uint32_t height);
+
+	private:
+		VkImageView createView(VkImage image, VkFormat format, VkImageUsageFlags usage, uint32_t level);
+
+	private:
+		static constexpr VkFormat SAMPLED_FORMAT = VK_FORMAT_R8G8B8A8_SRGB;
+		static constexpr VkFormat STORAGE_FORMAT = VK_FORMAT_R8G8B8A8_UNORM;
+		static constexpr uint32_t GROUP_SIZE = 8;
+
+		VkDevice m_device{};
+		VkDescriptorSetLayout m_setLayout{};
+		VkPipelineLayout m_pipelineLayout{};
+		VkPipeline m_pipeline{};
+		VkSampler m_sampler{};
+		DescriptorAllocator m_descriptors{};
+		std::vector<VkImageView> m_views{};
+	};
+}
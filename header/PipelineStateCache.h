@@ -0,0 +1,133 @@
+#pragma once
+#include <vulkan/vulkan.h>
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <unordered_map>
+#include <unordered_set>
+#include "LayoutCache.h"
+#include "AssetArchive.h"
+#include "macro.h"
+
+namespace Clan
+{
+	enum class BlendMode : uint8_t {
+		Opaque,
+		Alpha,
+		Additive,
+	};
+
+	struct SpecializationConstant {
+		uint32_t id{ 0 };
+		uint32_t value{ 0 };
+
+		bool operator==(const SpecializationConstant&) const = default;
+	};
+
+	//Everything a graphics pipeline is built from. Shaders are .spv files of the shader directory,
+	//the pipeline layout is reflected from them. Viewport and scissor are always dynamic.
+	struct PipelineKey {
+		std::string vertexShader{};
+		std::string fragmentShader{};
+		//size of the interleaved vertex the shader inputs are read from
+		uint32_t vertexStride{ 0 };
+		VkPrimitiveTopology topology{ VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST };
+		VkPolygonMode polygonMode{ VK_POLYGON_MODE_FILL };
+		VkCullModeFlags cullMode{ VK_CULL_MODE_NONE };
+		VkFrontFace frontFace{ VK_FRONT_FACE_COUNTER_CLOCKWISE };
+		bool depthTest{ true };
+		bool depthWrite{ true };
+		VkCompareOp depthCompare{ VK_COMPARE_OP_LESS };
+		BlendMode blendMode{ BlendMode::Opaque };
+		VkFormat colorFormat{ VK_FORMAT_UNDEFINED };
+		VkFormat depthFormat{ VK_FORMAT_UNDEFINED };
+		VkSampleCountFlagBits samples{ VK_SAMPLE_COUNT_1_BIT };
+		//shared by every stage, a stage ignores the ids it doesn't declare
+		std::vector<SpecializationConstant> constants{};
+
+		bool operator==(const PipelineKey&) const = default;
+
+		uint64_t hash() const;
+
+		//One line of text, the format of the recorded key lists
+		std::string serialize() const;
+
+		bool deserialize(const std::string& line);
+	};
+
+	struct PipelineKeyHash {
+		inline size_t operator()(const PipelineKey& key) const { return static_cast<size_t>(key.hash()); }
+	};
+
+	//Builds pipeline variants on demand and keeps them, each distinct key is compiled once. The
+	//driver's pipeline cache is saved to disk, and the keys used in a run can be recorded and
+	//precompiled at the next start so the variants are ready before the first frame.
+	class PipelineStateCache
+	{
+	public:
+		PipelineStateCache() = default;
+
+		PipelineStateCache(const PipelineStateCache&) = delete;
+
+		PipelineStateCache& operator=(const PipelineStateCache&) = delete;
+
+		~PipelineStateCache() = default;
+
+		//'cacheFile' holds the driver's pipeline cache between runs, data of another device is ignored.
+		//Shaders are read from 'pArchive' when it has them, until they are invalidated.
+		void init(VkDevice device, VkPhysicalDevice physicalDevice, LayoutCache* pLayoutCache,
+			const std::string& shaderDirectory, const std::string& cacheFile, const AssetArchive* pArchive = nullptr);
+
+		//Saves the pipeline cache and destroys every variant
+		void destroy();
+
+		//Returns the variant of 'key', building it on a miss. A null render pass builds for dynamic
+		//rendering with the formats of the key. Returns VK_NULL_HANDLE if the build fails.
+		VkPipeline get(const PipelineKey& key, VkRenderPass renderPass);
+
+		VkPipelineLayout layout(const PipelineKey& key);
+
+		//Builds without touching the variants, thread safe. For pipelines built on other threads
+		//from freshly compiled code.
+		VkPipeline build(const PipelineKey& key, VkRenderPass renderPass, VkPipelineLayout layout,
+			const std::vector<char>& vertexCode, const std::vector<char>& fragmentCode) const;
+
+		//Takes ownership of a pipeline built for 'key', returns the variant it replaces if any
+		VkPipeline insert(const PipelineKey& key, VkPipeline pipeline);
+
+		//Forgets the code of a shader and removes the variants using it, the caller retires them
+		std::vector<VkPipeline> invalidateShader(const std::string& shader);
+
+		//Writes the key of every variant, one per line
+		bool saveKeys(const std::string& path) const;
+
+		//Builds the variants of a recorded key list. With a render pass, only the keys matching its
+		//color format and sample count can be built. Returns the number of variants built.
+		uint32_t precompile(const std::string& path, VkRenderPass renderPass, VkFormat colorFormat, VkSampleCountFlagBits samples);
+
+		inline size_t variantCount() const { return m_variants.size(); }
+
+		inline uint32_t missCount() const { return m_misses; }
+
+	private:
+		const std::vector<char>& shaderCode(const std::string& shader);
+
+		void savePipelineCache();
+
+		VkShaderModule createShaderModule(const std::vector<char>& code) const;
+
+	private:
+		VkDevice m_device{};
+		VkPhysicalDeviceProperties m_properties{};
+		LayoutCache* m_pLayoutCache{ nullptr };
+		std::string m_shaderDirectory{};
+		const AssetArchive* m_pArchive{ nullptr };
+		//rebuilt since the archive was written, read from the shader directory
+		std::unordered_set<std::string> m_looseShaders{};
+		std::string m_cacheFile{};
+		VkPipelineCache m_pipelineCache{};
+		std::unordered_map<std::string, std::vector<char>> m_shaderCode{};
+		std::unordered_map<PipelineKey, VkPipeline, PipelineKeyHash> m_variants{};
+		uint32_t m_misses{ 0 };
+	};
+}
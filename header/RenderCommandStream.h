@@ -0,0 +1,205 @@
+#pragma once
+#include <cstdint>
+#include <cstring>
+#include <atomic>
+#include <memory>
+#include <type_traits>
+#include <glm/glm.hpp>
+#include <glm/gtc/quaternion.hpp>
+#include "LockFreeQueue.h"
+#include "SceneGraph.h"
+#include "macro.h"
+
+namespace Clan
+{
+	enum class RenderCommandType : uint16_t {
+		SetNodeTransform,
+		SetNodePosition,
+		SetNodeRotation,
+		SetNodeScale,
+	};
+
+	//Precedes every command in a chunk, 'size' is the payload in bytes, a multiple of 4
+	struct RenderCommandHeader {
+		RenderCommandType type{};
+		uint16_t size{ 0 };
+	};
+
+	struct SetNodeTransformCommand {
+		static constexpr RenderCommandType TYPE = RenderCommandType::SetNodeTransform;
+		SceneNode node{ INVALID_SCENE_NODE };
+		glm::vec3 position{ 0.0f };
+		glm::quat rotation{ 1.0f, 0.0f, 0.0f, 0.0f };
+		glm::vec3 scale{ 1.0f };
+	};
+
+	struct SetNodePositionCommand {
+		static constexpr RenderCommandType TYPE = RenderCommandType::SetNodePosition;
+		SceneNode node{ INVALID_SCENE_NODE };
+		glm::vec3 position{ 0.0f };
+	};
+
+	struct SetNodeRotationCommand {
+		static constexpr RenderCommandType TYPE = RenderCommandType::SetNodeRotation;
+		SceneNode node{ INVALID_SCENE_NODE };
+		glm::quat rotation{ 1.0f, 0.0f, 0.0f, 0.0f };
+	};
+
+	struct SetNodeScaleCommand {
+		static constexpr RenderCommandType TYPE = RenderCommandType::SetNodeScale;
+		SceneNode node{ INVALID_SCENE_NODE };
+		glm::vec3 scale{ 1.0f };
+	};
+
+	//Block of encoded commands, written by one thread and then read by the render thread
+	struct RenderCommandChunk : MpscNode {
+		static constexpr uint32_t CAPACITY = 4096 - 64;
+
+		uint32_t used{ 0 };
+		alignas(16) uint8_t bytes[CAPACITY]{};
+	};
+
+	//Commands from any number of game threads to the render thread. Every writer fills a chunk of
+	//its own and hands it over whole: filled chunks go to the render thread through an intrusive
+	//MPSC queue, the render thread returns them through an MPMC free list. No thread ever waits,
+	//a write fails when every chunk is in flight and the writer decides to retry or drop it.
+	//Commands of one writer arrive in order, the chunks of different writers interleave.
+	class RenderCommandStream
+	{
+	public:
+		RenderCommandStream() = default;
+
+		RenderCommandStream(const RenderCommandStream&) = delete;
+
+		RenderCommandStream& operator=(const RenderCommandStream&) = delete;
+
+		~RenderCommandStream() = default;
+
+		//Commands in flight are limited to 'chunkCount' chunks
+		void init(uint32_t chunkCount);
+
+		void destroy();
+
+		//Writer side, null when every chunk is in flight
+		RenderCommandChunk* acquireChunk();
+
+		//Writer side, hands a chunk from acquireChunk() to the render thread
+		void submit(RenderCommandChunk* pChunk);
+
+		//Render thread, calls visitor(command) for every submitted command with the command struct
+		//of its type and returns the chunks. Returns the number of commands.
+		template<typename Visitor>
+		uint32_t consume(Visitor&& visitor);
+
+		inline void countFailedWrite() { m_failedWrites.fetch_add(1, std::memory_order_relaxed); }
+
+		//Writes that found no free chunk
+		inline uint64_t failedWrites() const { return m_failedWrites.load(std::memory_order_relaxed); }
+
+	private:
+		template<typename Command>
+		static Command decode(const uint8_t* pPayload)
+		{
+			Command command;
+			std::memcpy(&command, pPayload, sizeof(Command));
+			return command;
+		}
+
+	private:
+		std::unique_ptr<RenderCommandChunk[]> m_chunks{};
+		MpmcQueue<RenderCommandChunk*> m_freeChunks{};
+		IntrusiveMpscQueue m_submitted{};
+		std::atomic<uint64_t> m_failedWrites{ 0 };
+	};
+
+	//Encodes the commands of one thread into chunks of a stream. Each writing thread has its own.
+	class RenderCommandWriter
+	{
+	public:
+		RenderCommandWriter() = default;
+
+		RenderCommandWriter(const RenderCommandWriter&) = delete;
+
+		RenderCommandWriter& operator=(const RenderCommandWriter&) = delete;
+
+		~RenderCommandWriter() = default;
+
+		void init(RenderCommandStream& stream);
+
+		//Submits what's written and gives up the chunk
+		void destroy();
+
+		//False, and counted on the stream, when no chunk was free. The render thread only sees the
+		//command after the next flush().
+		template<typename Command>
+		bool write(const Command& command)
+		{
+			static_assert(std::is_trivially_copyable_v<Command>, "commands are copied as bytes");
+			constexpr uint32_t SIZE = (sizeof(Command) + 3) & ~3u;
+			constexpr uint32_t RECORD_SIZE = sizeof(RenderCommandHeader) + SIZE;
+			static_assert(RECORD_SIZE <= RenderCommandChunk::CAPACITY, "command larger than a chunk");
+			if (m_pChunk != nullptr && m_pChunk->used + RECORD_SIZE > RenderCommandChunk::CAPACITY) {
+				flush();
+			}
+			if (m_pChunk == nullptr) {
+				m_pChunk = m_pStream->acquireChunk();
+				if (m_pChunk == nullptr) {
+					m_pStream->countFailedWrite();
+					return false;
+				}
+			}
+			RenderCommandHeader header{ Command::TYPE, static_cast<uint16_t>(SIZE) };
+			uint8_t* pRecord = m_pChunk->bytes + m_pChunk->used;
+			std::memcpy(pRecord, &header, sizeof(header));
+			std::memcpy(pRecord + sizeof(header), &command, sizeof(Command));
+			m_pChunk->used += RECORD_SIZE;
+			return true;
+		}
+
+		//Hands the written commands to the render thread
+		void flush();
+
+	private:
+		RenderCommandStream* m_pStream{ nullptr };
+		RenderCommandChunk* m_pChunk{ nullptr };
+	};
+
+	template<typename Visitor>
+	uint32_t RenderCommandStream::consume(Visitor&& visitor)
+	{
+		uint32_t count = 0;
+		while (MpscNode* pNode = m_submitted.pop()) {
+			RenderCommandChunk* pChunk = static_cast<RenderCommandChunk*>(pNode);
+			for (uint32_t offset = 0; offset < pChunk->used; ++count) {
+				RenderCommandHeader header{};
+				std::memcpy(&header, pChunk->bytes + offset, sizeof(header));
+				const uint8_t* pPayload = pChunk->bytes + offset + sizeof(header);
+				switch (header.type) {
+				case RenderCommandType::SetNodeTransform:
+					visitor(decode<SetNodeTransformCommand>(pPayload));
+					break;
+				case RenderCommandType::SetNodePosition:
+					visitor(decode<SetNodePositionCommand>(pPayload));
+					break;
+				case RenderCommandType::SetNodeRotation:
+					visitor(decode<SetNodeRotationCommand>(pPayload));
+					break;
+				case RenderCommandType::SetNodeScale:
+					visitor(decode<SetNodeScaleCommand>(pPayload));
+					break;
+				default:
+					ASSERT(false);
+					break;
+				}
+				offset += sizeof(header) + header.size;
+			}
+			pChunk->used = 0;
+			//the free list has room for every chunk, it can't be full
+			m_freeChunks.tryPush(pChunk);
+		}
+		return count;
+	}
+
+	//Throughput of game threads writing commands while the render thread consumes them. Prints a table.
+	void benchmarkRenderCommandStream(uint32_t commandsPerWriter);
+}
@@ -0,0 +1,213 @@
+#pragma once
+#include <vulkan/vulkan.h>
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <functional>
+#include "FrameScheduler.h"
+#include "DeletionQueue.h"
+#include "macro.h"
+
+namespace Clan
+{
+	//How a pass accesses an image. Decides the layout, stages and access masks of the barriers.
+	enum class ImageUsage : uint8_t {
+		ColorAttachment,
+		DepthAttachment,
+		DepthRead,
+		SampledFragment,
+		SampledCompute,
+		StorageRead,
+		StorageWrite,
+		TransferSrc,
+		TransferDst,
+		Present,
+	};
+
+	struct ImageState {
+		VkPipelineStageFlags2 stage{ VK_PIPELINE_STAGE_2_NONE };
+		VkAccessFlags2 access{ VK_ACCESS_2_NONE };
+		VkImageLayout layout{ VK_IMAGE_LAYOUT_UNDEFINED };
+	};
+
+	//Synchronization scope of an image usage
+	ImageState imageStateForUsage(ImageUsage usage);
+
+	//Synchronization scope of the accesses usually done to an image in 'layout'
+	ImageState imageStateForLayout(VkImageLayout layout);
+
+	bool isWriteUsage(ImageUsage usage);
+
+	VkImageAspectFlags aspectForFormat(VkFormat format);
+
+	struct TransientImageDesc {
+		VkFormat format{ VK_FORMAT_R8G8B8A8_UNORM };
+		VkExtent2D extent{};
+		VkSampleCountFlagBits samples{ VK_SAMPLE_COUNT_1_BIT };
+	};
+
+	using GraphResource = uint32_t;
+
+	//Per-frame graph of passes that declare which images they read and write. compile() culls
+	//passes that don't contribute to an output, computes the minimal set of sync2 barriers and
+	//places transient images with disjoint lifetimes in the same memory.
+	class RenderGraph
+	{
+	private:
+		struct Pass;
+
+	public:
+		using ExecuteFunc = std::function<void(VkCommandBuffer)>;
+
+		class PassBuilder
+		{
+		public:
+			inline void read(GraphResource resource, ImageUsage usage);
+
+			inline void write(GraphResource resource, ImageUsage usage);
+
+			//Keeps the pass even if nothing reads its outputs
+			inline void sideEffect();
+
+		private:
+			friend class RenderGraph;
+			Pass* m_pPass{ nullptr };
+		};
+
+		using SetupFunc = std::function<void(PassBuilder&)>;
+
+		RenderGraph() = default;
+
+		RenderGraph(const RenderGraph&) = delete;
+
+		RenderGraph& operator=(const RenderGraph&) = delete;
+
+		~RenderGraph() = default;
+
+		void init(VkDevice device, VkPhysicalDevice physicalDevice, DeletionQueue* pDeletionQueue, Timeline* pTimeline);
+
+		void destroy();
+
+		//Starts recording a new frame. Transient memory is kept while the graph shape is unchanged
+		void reset();
+
+		//Imports an image owned elsewhere. 'initial' is its state when the frame starts and
+		//'finalLayout' the layout it must be left in (UNDEFINED to leave it as the last pass did)
+		GraphResource importImage(const std::string& name, VkImage image, VkImageView view,
+			VkImageAspectFlags aspect, ImageState initial, VkImageLayout finalLayout = VK_IMAGE_LAYOUT_UNDEFINED);
+
+		//Declares an image that only lives during the frame
+		GraphResource createImage(const std::string& name, const TransientImageDesc& desc);
+
+		void addPass(const std::string& name, const SetupFunc& setup, const ExecuteFunc& execute);
+
+		//Marks a resource as consumed outside of the graph (presented, read back...)
+		void markOutput(GraphResource resource);
+
+		void compile();
+
+		void execute(VkCommandBuffer commandBuffer);
+
+		VkImage image(GraphResource resource) const;
+
+		VkImageView imageView(GraphResource resource) const;
+
+		inline uint32_t culledPassCount() const { return m_culledPasses; }
+
+		inline VkDeviceSize transientMemoryBytes() const { return m_transientBytes; }
+
+		//Like transientMemoryBytes, but lazily allocated slots only count what the driver committed
+		VkDeviceSize transientCommittedBytes() const;
+
+	private:
+		struct Access {
+			GraphResource resource;
+			ImageUsage usage;
+		};
+
+		struct Pass {
+			std::string name;
+			std::vector<Access> accesses;
+			ExecuteFunc execute;
+			std::vector<VkImageMemoryBarrier2> barriers;
+			bool sideEffect{ false };
+			bool culled{ false };
+		};
+
+		struct Resource {
+			std::string name;
+			bool transient{ false };
+			bool output{ false };
+			TransientImageDesc desc{};
+			VkImageUsageFlags usageFlags{ 0 };
+			VkImageAspectFlags aspect{ VK_IMAGE_ASPECT_COLOR_BIT };
+			VkImage image{};
+			VkImageView view{};
+			ImageState initial{};
+			VkImageLayout finalLayout{ VK_IMAGE_LAYOUT_UNDEFINED };
+			uint32_t firstPass{ UINT32_MAX };
+			uint32_t lastPass{ 0 };
+			uint32_t memorySlot{ UINT32_MAX };
+		};
+
+		struct MemorySlot {
+			VkDeviceMemory memory{};
+			VkDeviceSize size{ 0 };
+			uint32_t memoryTypeBits{ ~0u };
+			std::vector<uint32_t> resources{};
+			bool lazy{ false };
+			//last accesses to the memory, the next user of the slot waits for them
+			VkPipelineStageFlags2 lastWriteStage{ VK_PIPELINE_STAGE_2_NONE };
+			VkAccessFlags2 lastWriteAccess{ VK_ACCESS_2_NONE };
+			VkPipelineStageFlags2 lastReadStages{ VK_PIPELINE_STAGE_2_NONE };
+		};
+
+		void cullPasses();
+
+		void computeLifetimes();
+
+		void allocateTransients();
+
+		void releaseTransients();
+
+		void buildBarriers();
+
+		uint32_t findMemoryType(uint32_t typeFilter, VkMemoryPropertyFlags properties) const;
+
+		std::vector<uint64_t> transientSignature() const;
+
+	private:
+		VkDevice m_device{};
+		VkPhysicalDeviceMemoryProperties m_memoryProperties{};
+		DeletionQueue* m_pDeletionQueue{ nullptr };
+		Timeline* m_pTimeline{ nullptr };
+		std::vector<Pass> m_passes{};
+		std::vector<Resource> m_resources{};
+		std::vector<VkImageMemoryBarrier2> m_finalBarriers{};
+		//physical transient images, reused while the signature doesn't change
+		std::vector<uint64_t> m_signature{};
+		std::vector<VkImage> m_transientImages{};
+		std::vector<VkImageView> m_transientViews{};
+		std::vector<uint32_t> m_transientSlots{};
+		std::vector<MemorySlot> m_slots{};
+		VkDeviceSize m_transientBytes{ 0 };
+		uint32_t m_culledPasses{ 0 };
+	};
+
+	inline void RenderGraph::PassBuilder::read(GraphResource resource, ImageUsage usage)
+	{
+		ASSERT(!isWriteUsage(usage));
+		m_pPass->accesses.push_back({ resource, usage });
+	}
+
+	inline void RenderGraph::PassBuilder::write(GraphResource resource, ImageUsage usage)
+	{
+		ASSERT(isWriteUsage(usage));
+		m_pPass->accesses.push_back({ resource, usage });
+	}
+
+	inline void RenderGraph::PassBuilder::sideEffect()
+	{
+		m_pPass->sideEffect = true;
+	}
+}
@@ -0,0 +1,68 @@
+#pragma once
+#include <vulkan/vulkan.h>
+#include <cstdint>
+#include <cstddef>
+#include <limits>
+#include <string>
+#include <type_traits>
+#include "macro.h"
+
+//Compile-time choices of the renderer, set them on the compiler command line for a specialized build
+#ifndef CLAN_FRAMES_IN_FLIGHT
+	#define CLAN_FRAMES_IN_FLIGHT 2
+#endif
+//type the loaded indices are kept in, with uint16_t a shape with more than 65536 unique vertices
+//is loaded as several meshes. The geometry arena picks 16 bit indices for small meshes either way.
+#ifndef CLAN_INDEX_TYPE
+	#define CLAN_INDEX_TYPE uint32_t
+#endif
+
+namespace Clan
+{
+	//Choices the hot paths depend on. They are constants, so the per-frame code has no branch on
+	//them and the loops over the frames in flight have a known length.
+	template<uint32_t FramesInFlight, typename IndexT, typename VertexT>
+	struct RenderPolicy {
+		static_assert(FramesInFlight >= 1 && FramesInFlight <= 4, "1 to 4 frames in flight");
+
+		static constexpr uint32_t FRAMES_IN_FLIGHT = FramesInFlight;
+
+		static_assert(std::is_same_v<IndexT, uint16_t> || std::is_same_v<IndexT, uint32_t>, "16 or 32 bit indices");
+
+		using Index = IndexT;
+
+		//unique vertices an index can address
+		static constexpr size_t MAX_VERTICES = static_cast<size_t>(std::numeric_limits<IndexT>::max()) + 1;
+
+		//the attributes are read from the vertex shader, the layout only has to match them
+		using Vertex = VertexT;
+
+		static constexpr uint32_t VERTEX_STRIDE = sizeof(VertexT);
+	};
+
+	//Settings that can change between deployments without a rebuild. They are read from a file of
+	//"key = value" lines, '#' starts a comment, and single keys can be set from the command line.
+	struct RendererConfig {
+		uint32_t windowWidth{ 800 };
+		uint32_t windowHeight{ 600 };
+		std::string modelPath{ "resources/objects/room.obj" };
+		//for the materials of the model without a texture of their own
+		std::string texturePath{ "resources/textures/room.png" };
+		//fixed steps of the simulation thread, independent of the frame rate
+		uint32_t simulationRate{ 60 };
+#ifdef NDEBUG
+		bool enableValidation{ false };
+#else
+		bool enableValidation{ true };
+#endif // NDEBUG
+
+		//False when the file can't be opened, bad lines are reported and skipped
+		bool load(const std::string& path);
+
+		//False for an unknown key or a value that doesn't parse, the setting is left as it was
+		bool set(const std::string& key, const std::string& value);
+
+		//"key=value", as given to --set
+		bool set(const std::string& assignment);
+	};
+}
@@ -0,0 +1,48 @@
+#pragma once
+#include <vulkan/vulkan.h>
+#include <cstdint>
+#include <vector>
+#include <unordered_map>
+#include "macro.h"
+
+namespace Clan
+{
+	//Samplers keyed by a hash of their create info, so materials with the same sampling state
+	//share one sampler however many textures they use. They live until destroy().
+	class SamplerCache
+	{
+	public:
+		SamplerCache() = default;
+
+		SamplerCache(const SamplerCache&) = delete;
+
+		SamplerCache& operator=(const SamplerCache&) = delete;
+
+		~SamplerCache() = default;
+
+		//'maxSamplers' is the device's maxSamplerAllocationCount
+		void init(VkDevice device, uint32_t maxSamplers);
+
+		void destroy();
+
+		//Extension structures aren't part of the key and can't be given. Once the device limit is
+		//reached, new states get the first sampler created.
+		VkSampler get(const VkSamplerCreateInfo& info);
+
+		//Samplers created, the states sharing the first one aren't counted
+		inline size_t size() const { return m_created.size(); }
+
+	private:
+		using Key = std::vector<uint32_t>;
+
+		struct KeyHash {
+			size_t operator()(const Key& key) const;
+		};
+
+	private:
+		VkDevice m_device{};
+		uint32_t m_maxSamplers{ 0 };
+		std::vector<VkSampler> m_created{};
+		std::unordered_map<Key, VkSampler, KeyHash> m_samplers{};
+	};
+}
@@ -0,0 +1,90 @@
+#pragma once
+#include <cstdint>
+#include <vector>
+#include <glm/glm.hpp>
+#include <glm/gtc/quaternion.hpp>
+#include "TransformKernels.h"
+#include "macro.h"
+
+namespace Clan
+{
+	using SceneNode = uint32_t;
+
+	constexpr SceneNode INVALID_SCENE_NODE = ~0u;
+
+	//Transform hierarchy stored as structure of arrays sorted by depth, parents always come before
+	//their children. update() only recomputes the subtrees below changed nodes, depth by depth
+	//with the batch kernels, and every world matrix remembers the version it last changed in so
+	//the GPU copies only receive the changed ones. A node handle is also its instance index.
+	class SceneGraph
+	{
+	public:
+		SceneGraph() = default;
+
+		SceneGraph(const SceneGraph&) = delete;
+
+		SceneGraph& operator=(const SceneGraph&) = delete;
+
+		~SceneGraph() = default;
+
+		void init(uint32_t capacity, SimdLevel level = detectSimdLevel());
+
+		void destroy();
+
+		//New node with an identity transform, a root without a parent
+		SceneNode createNode(SceneNode parent = INVALID_SCENE_NODE);
+
+		void setTransform(SceneNode node, const glm::vec3& position, const glm::quat& rotation, const glm::vec3& scale);
+
+		void setPosition(SceneNode node, const glm::vec3& position);
+
+		void setRotation(SceneNode node, const glm::quat& rotation);
+
+		void setScale(SceneNode node, const glm::vec3& scale);
+
+		//Recomputes the world matrices of the changed nodes and their descendants, returns how many
+		uint32_t update();
+
+		//Writes the world matrices changed since 'syncedVersion' to dst[node] and advances it.
+		//Each GPU copy keeps its own version. Returns the number of matrices written.
+		uint32_t copyChanged(glm::mat4* dst, uint64_t& syncedVersion) const;
+
+		inline const glm::mat4& worldMatrix(SceneNode node) const { return m_world[m_handleToIndex[node]]; }
+
+		inline SceneNode parent(SceneNode node) const
+		{
+			uint32_t parentIndex = m_parent[m_handleToIndex[node]];
+			return parentIndex == INVALID_SCENE_NODE ? INVALID_SCENE_NODE : m_indexToHandle[parentIndex];
+		}
+
+		inline uint32_t nodeCount() const { return static_cast<uint32_t>(m_indexToHandle.size()); }
+
+		inline uint64_t version() const { return m_version; }
+
+	private:
+		void markDirty(SceneNode node);
+
+		//Restores the depth order after nodes were created below deeper ones, finds the depth ranges
+		void sortByDepth();
+
+	private:
+		const TransformKernels* m_pKernels{ nullptr };
+		//per node handle
+		std::vector<uint32_t> m_handleToIndex{};
+		//per index, in depth order
+		std::vector<SceneNode> m_indexToHandle{};
+		std::vector<uint32_t> m_parent{};
+		std::vector<uint32_t> m_depth{};
+		std::vector<uint8_t> m_dirty{};
+		std::vector<uint64_t> m_worldVersion{};
+		TransformArrays m_local{};
+		std::vector<glm::mat4> m_world{};
+		std::vector<glm::mat4> m_parentWorld{};
+		//first index of every depth, plus the end
+		std::vector<uint32_t> m_depthStart{};
+		uint32_t m_dirtyCount{ 0 };
+		//nodes were created since the last update
+		bool m_structureChanged{ false };
+		uint64_t m_version{ 0 };
+	};
+}
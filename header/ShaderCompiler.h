@@ -0,0 +1,59 @@
+#pragma once
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <shaderc/shaderc.h>
+#include "macro.h"
+
+namespace Clan
+{
+	enum class ShaderStage : uint8_t {
+		Vertex,
+		Fragment,
+		Compute,
+		Unknown,
+	};
+
+	//Stage of a GLSL source from its extension: .vert, .frag or .comp
+	ShaderStage shaderStageForPath(const std::string& path);
+
+	//Compiles GLSL to SPIR-V with shaderc. The shared library is loaded at runtime so the application
+	//still starts without it, it then runs on the prebuilt .spv files and compile() always fails.
+	class ShaderCompiler
+	{
+	public:
+		ShaderCompiler() = default;
+
+		ShaderCompiler(const ShaderCompiler&) = delete;
+
+		ShaderCompiler& operator=(const ShaderCompiler&) = delete;
+
+		~ShaderCompiler() = default;
+
+		//Returns false when the shaderc shared library can't be found
+		bool init();
+
+		void destroy();
+
+		inline bool isAvailable() const { return m_compiler != nullptr; }
+
+		//Thread safe. On errors returns false with the compiler output in 'log'
+		bool compile(const std::string& path, std::vector<char>& spirv, std::string& log) const;
+
+	private:
+		void* m_library{ nullptr };
+		shaderc_compiler_t m_compiler{ nullptr };
+		decltype(&shaderc_compiler_initialize) m_compilerInitialize{ nullptr };
+		decltype(&shaderc_compiler_release) m_compilerRelease{ nullptr };
+		decltype(&shaderc_compile_options_initialize) m_optionsInitialize{ nullptr };
+		decltype(&shaderc_compile_options_release) m_optionsRelease{ nullptr };
+		decltype(&shaderc_compile_options_set_target_env) m_optionsSetTargetEnv{ nullptr };
+		decltype(&shaderc_compile_options_set_optimization_level) m_optionsSetOptimizationLevel{ nullptr };
+		decltype(&shaderc_compile_into_spv) m_compileIntoSpv{ nullptr };
+		decltype(&shaderc_result_release) m_resultRelease{ nullptr };
+		decltype(&shaderc_result_get_length) m_resultGetLength{ nullptr };
+		decltype(&shaderc_result_get_bytes) m_resultGetBytes{ nullptr };
+		decltype(&shaderc_result_get_compilation_status) m_resultGetStatus{ nullptr };
+		decltype(&shaderc_result_get_error_message) m_resultGetErrorMessage{ nullptr };
+	};
+}
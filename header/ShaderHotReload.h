@@ -0,0 +1,123 @@
+#pragma once
+#include <vulkan/vulkan.h>
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <functional>
+#include <unordered_map>
+#include <thread>
+#include <mutex>
+#include <atomic>
+#include <filesystem>
+#include "ShaderCompiler.h"
+#include "macro.h"
+
+namespace Clan
+{
+	//Reports the files of a directory that were written. Uses inotify on Linux, elsewhere the
+	//modification times are polled.
+	class FileWatcher
+	{
+	public:
+		FileWatcher() = default;
+
+		FileWatcher(const FileWatcher&) = delete;
+
+		FileWatcher& operator=(const FileWatcher&) = delete;
+
+		~FileWatcher() = default;
+
+		bool init(const std::string& directory);
+
+		void destroy();
+
+		//Waits up to 'timeoutMs' for writes and returns the names of the modified files
+		std::vector<std::string> wait(uint32_t timeoutMs);
+
+	private:
+		std::string m_directory{};
+#ifdef __linux__
+		int m_fd{ -1 };
+#else
+		std::unordered_map<std::string, std::filesystem::file_time_type> m_writeTimes{};
+#endif
+	};
+
+	//Recompiles the GLSL sources of a directory when they are saved and rebuilds the pipelines
+	//using them, all on a worker thread. The render thread only swaps the finished pipelines in.
+	class ShaderHotReload
+	{
+	public:
+		//Builds a pipeline from SPIR-V, one entry per source in the order they were declared.
+		//Runs on the worker: it must only use state it captured and return null on failure.
+		using BuildFunc = std::function<VkPipeline(const std::vector<std::vector<char>>&)>;
+
+		struct ReloadedPipeline {
+			std::string name;
+			VkPipeline pipeline;
+		};
+
+		ShaderHotReload() = default;
+
+		ShaderHotReload(const ShaderHotReload&) = delete;
+
+		ShaderHotReload& operator=(const ShaderHotReload&) = delete;
+
+		~ShaderHotReload() = default;
+
+		//Starts the worker, does nothing when shaderc or the directory aren't available
+		void init(VkDevice device, const std::string& shaderDirectory);
+
+		void destroy();
+
+		inline bool isEnabled() const { return m_running; }
+
+		//(Re)declares a pipeline built from GLSL sources of the shader directory. Pipelines rebuilt
+		//for a previous declaration and not collected yet are dropped.
+		void watch(const std::string& name, const std::vector<std::string>& sources, const BuildFunc& build);
+
+		//Waits for the build in progress and holds the next ones, call before retiring objects
+		//captured by the build functions. Pipelines not collected yet are dropped.
+		void suspend();
+
+		void resume();
+
+		//Call at a frame boundary: returns the pipelines rebuilt since the last call, the caller
+		//swaps them in and retires the ones they replace
+		std::vector<ReloadedPipeline> collect();
+
+	private:
+		struct Watched {
+			std::vector<std::string> sources;
+			BuildFunc build;
+			uint32_t generation{ 0 };
+		};
+
+		void run();
+
+		void rebuild(const std::vector<std::string>& changedFiles);
+
+		void dropReloaded(const std::string* pName);
+
+	private:
+		//merges the burst of writes an editor does on save
+		static constexpr uint32_t SETTLE_MILLISECONDS = 30;
+		static constexpr uint32_t WAIT_MILLISECONDS = 100;
+
+		VkDevice m_device{};
+		std::filesystem::path m_directory{};
+		ShaderCompiler m_compiler{};
+		FileWatcher m_watcher{};
+		std::thread m_worker{};
+		std::atomic<bool> m_running{ false };
+		//held by the worker while it compiles and builds, and between suspend() and resume()
+		std::mutex m_buildMutex{};
+		//guards m_watched and m_reloaded
+		std::mutex m_mutex{};
+		std::unordered_map<std::string, Watched> m_watched{};
+		std::vector<ReloadedPipeline> m_reloaded{};
+		uint32_t m_generation{ 0 };
+		//SPIR-V of the sources compiled so far, only touched by the worker
+		std::unordered_map<std::string, std::vector<char>> m_spirv{};
+	};
+}
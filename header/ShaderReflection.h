@@ -0,0 +1,69 @@
+#pragma once
+#include <vulkan/vulkan.h>
+#include <cstdint>
+#include <string>
+#include <vector>
+#include "macro.h"
+
+namespace Clan
+{
+	struct ReflectedBinding {
+		uint32_t set{ 0 };
+		uint32_t binding{ 0 };
+		VkDescriptorType type{ VK_DESCRIPTOR_TYPE_MAX_ENUM };
+		uint32_t count{ 1 };
+		VkShaderStageFlags stages{ 0 };
+		//name of the variable, or of its block type when the variable is anonymous
+		std::string name{};
+	};
+
+	struct ReflectedVertexInput {
+		uint32_t location{ 0 };
+		VkFormat format{ VK_FORMAT_UNDEFINED };
+		uint32_t size{ 0 };
+		std::string name{};
+	};
+
+	//Interface of SPIR-V modules read straight from the bytecode: descriptor bindings, push
+	//constants and vertex inputs. Several stages of a program are merged into one.
+	class ShaderReflection
+	{
+	public:
+		//Replaces the content with the interface of 'spirv', returns false if it isn't SPIR-V
+		bool parse(const std::vector<char>& spirv);
+
+		//Adds the interface of another stage, bindings used by both get both stage bits
+		void merge(const ShaderReflection& other);
+
+		inline VkShaderStageFlags stages() const { return m_stages; }
+
+		inline const std::vector<ReflectedBinding>& bindings() const { return m_bindings; }
+
+		inline const std::vector<ReflectedVertexInput>& vertexInputs() const { return m_vertexInputs; }
+
+		const ReflectedBinding* findBinding(const std::string& name) const;
+
+		//Number of descriptor sets, including the unused ones below the highest set
+		uint32_t setCount() const;
+
+		std::vector<VkDescriptorSetLayoutBinding> setLayoutBindings(uint32_t set) const;
+
+		//All stages share one range covering every push constant block
+		std::vector<VkPushConstantRange> pushConstantRanges() const;
+
+		//Descriptors needed by 'setCopies' allocations of every set
+		std::vector<VkDescriptorPoolSize> poolSizes(uint32_t setCopies) const;
+
+		//Vertex inputs interleaved in one buffer, tightly packed in location order
+		VkVertexInputBindingDescription vertexBinding(uint32_t binding = 0) const;
+
+		std::vector<VkVertexInputAttributeDescription> vertexAttributes(uint32_t binding = 0) const;
+
+	private:
+		VkShaderStageFlags m_stages{ 0 };
+		std::vector<ReflectedBinding> m_bindings{};
+		std::vector<ReflectedVertexInput> m_vertexInputs{};
+		uint32_t m_pushConstantOffset{ UINT32_MAX };
+		uint32_t m_pushConstantEnd{ 0 };
+	};
+}
@@ -0,0 +1,85 @@
+#pragma once
+#include <cstdint>
+#include <atomic>
+#include <chrono>
+#include <functional>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <glm/glm.hpp>
+#include <glm/gtc/quaternion.hpp>
+#include "TripleBuffer.h"
+#include "macro.h"
+
+namespace Clan
+{
+	//Everything the simulation owns. The render thread only sees copies of it.
+	struct SimulationState {
+		uint64_t tick{ 0 };
+		glm::quat modelRotation{ 1.0f, 0.0f, 0.0f, 0.0f };
+	};
+
+	//'alpha' 0 gives 'from', 1 gives 'to'
+	SimulationState interpolate(const SimulationState& from, const SimulationState& to, float alpha);
+
+	//Runs the simulation in fixed steps on its own thread, independent of the frame rate. After
+	//every batch of steps the last two states are published through a triple buffer, the render
+	//thread interpolates between them one step behind the wall clock. Neither thread ever waits
+	//for the other, a slow simulation only makes the motion coarser.
+	class Simulation
+	{
+	public:
+		using Clock = std::chrono::steady_clock;
+
+		//Advances the state by one step of the given length, runs on the simulation thread
+		using StepFunction = std::function<void(SimulationState& state, float stepSeconds)>;
+
+		Simulation() = default;
+
+		Simulation(const Simulation&) = delete;
+
+		Simulation& operator=(const Simulation&) = delete;
+
+		~Simulation() = default;
+
+		//Starts the thread, the first step is due one step after the call
+		void init(uint32_t stepsPerSecond, const SimulationState& initial, StepFunction step);
+
+		//Stops and joins the thread without waiting for the next step
+		void destroy();
+
+		//The state at 'now' minus one step. Call it from one thread only, it never blocks.
+		SimulationState sample(Clock::time_point now);
+
+		inline float stepSeconds() const { return m_stepSeconds; }
+
+		//Steps skipped because the simulation fell too far behind
+		inline uint64_t droppedSteps() const { return m_droppedSteps.load(std::memory_order_relaxed); }
+
+	private:
+		struct Snapshot {
+			SimulationState previous{};
+			SimulationState current{};
+			//when 'current' was due
+			Clock::time_point time{};
+		};
+
+		void threadLoop(SimulationState initial);
+
+	private:
+		TripleBuffer<Snapshot> m_snapshots{};
+		StepFunction m_step{};
+		Clock::duration m_stepDuration{};
+		float m_stepSeconds{ 0.0f };
+		std::thread m_thread{};
+		//only wakes the simulation thread early for destroy(), the render thread doesn't take it
+		std::mutex m_mutex{};
+		std::condition_variable m_stopRequested{};
+		bool m_stop{ false };
+		std::atomic<uint64_t> m_droppedSteps{ 0 };
+	};
+
+	//Hammers a triple buffer from two threads and checks that the reader never sees a torn or older
+	//value, then runs a simulation that keeps up and one that doesn't. Prints a table.
+	void benchmarkSimulation(uint32_t publishes);
+}
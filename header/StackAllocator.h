@@ -83,7 +83,8 @@ namespace Clan
 			uint8_t* pAlignedMem = reinterpret_cast<uint8_t*>(pointer);
 			int64_t shift = pAlignedMem[-1];
 			uint8_t* pRawMem = pAlignedMem - shift;
-			delete[] pRawMem;
+			//the block lives inside the stack, it is rolled back rather than deleted
+			free(pRawMem);
 		}
 	}
 
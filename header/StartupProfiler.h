@@ -0,0 +1,59 @@
+#pragma once
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <chrono>
+#include "macro.h"
+
+namespace Clan
+{
+	struct StartupStep {
+		std::string name{};
+		double milliseconds{ 0.0 };
+	};
+
+	//Wall clock time of the steps of the start, one after the other. Starting a step ends the
+	//running one, so a sequence of calls needs one line per step.
+	class StartupProfiler
+	{
+	public:
+		//The total is measured from here
+		void start();
+
+		//Ends the running step, if any, and starts 'name'
+		void beginStep(const char* name);
+
+		void endStep();
+
+		//From start() to the end of the last step
+		inline double totalMilliseconds() const { return m_totalMilliseconds; }
+
+		inline const std::vector<StartupStep>& steps() const { return m_steps; }
+
+		//{"totalMilliseconds": ..., "steps": [{"name": ..., "milliseconds": ...}, ...]}
+		std::string toJson() const;
+
+		bool writeJson(const std::string& path) const;
+
+	private:
+		using Clock = std::chrono::steady_clock;
+
+		Clock::time_point m_start{};
+		Clock::time_point m_stepStart{};
+		std::vector<StartupStep> m_steps{};
+		double m_totalMilliseconds{ 0.0 };
+		bool m_inStep{ false };
+	};
+
+	//What a cold start goes without: the caches are deleted, the assets are dropped from the OS
+	//file cache where the OS lets a process do that
+	struct ColdStartFiles {
+		std::vector<std::string> caches{};
+		//files or directories
+		std::vector<std::string> assets{};
+	};
+
+	//Starts 'executable --headless --startup-report <file>' 'runs' times cold, then 'runs' times warm,
+	//and collects the reports in 'reportPath' with the median total of both
+	bool benchmarkStartup(const std::string& executable, uint32_t runs, const ColdStartFiles& files, const std::string& reportPath);
+}
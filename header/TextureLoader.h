@@ -0,0 +1,124 @@
+#pragma once
+#include <vulkan/vulkan.h>
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <memory>
+#include <functional>
+#include <unordered_map>
+#include "MappedFile.h"
+#include "AssetArchive.h"
+#include "ThreadPool.h"
+#include "macro.h"
+
+namespace Clan
+{
+	struct TextureLoadStats {
+		uint32_t textureCount{ 0 };
+		uint32_t failedCount{ 0 };
+		//files with the same contents as an earlier one, decoded once
+		uint32_t duplicateCount{ 0 };
+		//results stb converted after decoding, so they were copied into the staging memory
+		uint32_t copiedCount{ 0 };
+		uint64_t fileBytes{ 0 };
+		uint64_t decodedBytes{ 0 };
+		double milliseconds{ 0.0 };
+
+		inline double fileMegabytesPerSecond() const { return milliseconds > 0.0 ? fileBytes / (milliseconds * 1000.0) : 0.0; }
+
+		inline double decodedMegabytesPerSecond() const { return milliseconds > 0.0 ? decodedBytes / (milliseconds * 1000.0) : 0.0; }
+	};
+
+	//RGBA8 texels of one texture inside the staging buffer
+	struct TextureRegion {
+		uint32_t width{ 1 };
+		uint32_t height{ 1 };
+		VkDeviceSize offset{ 0 };
+	};
+
+	//Decodes a set of image files on a thread pool into one staging buffer. The files are memory
+	//mapped, so reading them costs no copy, the headers are read first so every texture knows its
+	//place in the staging buffer before decoding starts, and the decoder writes the texels straight
+	//into that place.
+	class TextureBatch
+	{
+	public:
+		TextureBatch() = default;
+
+		TextureBatch(const TextureBatch&) = delete;
+
+		TextureBatch& operator=(const TextureBatch&) = delete;
+
+		~TextureBatch() = default;
+
+		//Maps the files and parses their headers on the pool. Paths found in 'pArchive' are read from
+		//it, loose files are memory mapped and read ahead. An empty path, or a file that can't be
+		//read, becomes a white texel. Files with the same contents are only decoded once, see
+		//duplicateOf().
+		void open(const std::vector<std::string>& paths, ThreadPool& pool, const AssetArchive* pArchive = nullptr);
+
+		//Unmaps the files
+		void close();
+
+		//Decodes every image into its region of 'pStaging', which holds stagingSize() bytes.
+		//'onDecoded' runs on the calling thread for each texture as soon as its region is written,
+		//so it can be uploaded while the others still decode. Duplicates have no region and no call.
+		TextureLoadStats decode(ThreadPool& pool, void* pStaging, const std::function<void(size_t index)>& onDecoded = {});
+
+		inline VkDeviceSize stagingSize() const { return m_stagingSize; }
+
+		inline const TextureRegion& region(size_t index) const { return m_regions[index]; }
+
+		inline size_t size() const { return m_regions.size(); }
+
+		//The first texture with the same file contents, 'index' itself when there is none
+		inline size_t duplicateOf(size_t index) const { return m_duplicateOf[index]; }
+
+	private:
+		void readHeader(size_t index);
+
+		//Points every file at the first one with the same contents and releases the copies
+		void findDuplicates();
+
+	private:
+		std::vector<std::string> m_paths{};
+		std::unique_ptr<MappedFile[]> m_files{};
+		//encoded images, in a mapped file, the archive, or m_storage
+		std::vector<AssetSpan> m_sources{};
+		//entries inflated from the archive
+		std::vector<std::vector<char>> m_storage{};
+		std::vector<TextureRegion> m_regions{};
+		//false for the white texels
+		std::vector<uint8_t> m_valid{};
+		//of the encoded files, hashed along with the headers
+		std::vector<uint64_t> m_contentHashes{};
+		std::vector<size_t> m_duplicateOf{};
+		VkDeviceSize m_stagingSize{ 0 };
+	};
+
+	//Textures by path, and after loading by contents: a material library naming the same image
+	//under several paths, or one path several times, gets one texture for all of them.
+	class TextureRegistry
+	{
+	public:
+		//Index of the texture at 'path', the same path always gives the same index
+		uint32_t find(const std::string& path);
+
+		//Maps every texture the batch found a duplicate for to the first one with its contents
+		void merge(const TextureBatch& batch);
+
+		//The texture holding the image of 'index'
+		inline uint32_t resolve(uint32_t index) const { return m_resolved[index]; }
+
+		inline const std::vector<std::string>& paths() const { return m_paths; }
+
+		inline size_t size() const { return m_paths.size(); }
+
+		void clear();
+
+	private:
+		std::vector<std::string> m_paths{};
+		std::unordered_map<std::string, uint32_t> m_indices{};
+		std::vector<uint32_t> m_resolved{};
+	};
+}
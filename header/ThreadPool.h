@@ -0,0 +1,52 @@
+#pragma once
+#include <cstdint>
+#include <vector>
+#include <deque>
+#include <functional>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include "macro.h"
+
+namespace Clan
+{
+	//Fixed set of worker threads taking tasks from one queue. Meant for batches: submit the
+	//tasks, then wait() for all of them.
+	class ThreadPool
+	{
+	public:
+		ThreadPool() = default;
+
+		ThreadPool(const ThreadPool&) = delete;
+
+		ThreadPool& operator=(const ThreadPool&) = delete;
+
+		~ThreadPool() = default;
+
+		//0 starts one thread per hardware thread
+		void init(uint32_t threadCount = 0);
+
+		//Finishes the queued tasks and joins the threads
+		void destroy();
+
+		void submit(std::function<void()> task);
+
+		//Blocks until every submitted task has finished
+		void wait();
+
+		inline uint32_t threadCount() const { return static_cast<uint32_t>(m_threads.size()); }
+
+	private:
+		void workerLoop();
+
+	private:
+		std::vector<std::thread> m_threads{};
+		std::deque<std::function<void()>> m_tasks{};
+		std::mutex m_mutex{};
+		std::condition_variable m_taskReady{};
+		std::condition_variable m_idle{};
+		//queued plus running
+		uint32_t m_pending{ 0 };
+		bool m_stop{ false };
+	};
+}
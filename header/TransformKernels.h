@@ -0,0 +1,86 @@
+#pragma once
+#include <cstdint>
+#include <cstddef>
+#include <vector>
+#include <glm/glm.hpp>
+#include <glm/gtc/quaternion.hpp>
+#include "macro.h"
+
+namespace Clan
+{
+	enum class SimdLevel : uint8_t {
+		Scalar,
+		SSE2,
+		AVX2,
+		Count,
+	};
+
+	const char* simdLevelName(SimdLevel level);
+
+	//Highest level supported by the CPU and the OS, detected once with CPUID
+	SimdLevel detectSimdLevel();
+
+	//Local transforms as structure of arrays, so the kernels load 4 or 8 objects per instruction
+	struct TransformArrays {
+		std::vector<float> positionX{}, positionY{}, positionZ{};
+		std::vector<float> rotationX{}, rotationY{}, rotationZ{}, rotationW{};
+		std::vector<float> scaleX{}, scaleY{}, scaleZ{};
+
+		void resize(size_t count);
+
+		void set(size_t index, const glm::vec3& position, const glm::quat& rotation, const glm::vec3& scale);
+
+		inline size_t size() const { return positionX.size(); }
+	};
+
+	//Axis aligned boxes as center and half extent, the form that transforms and culls cheapest
+	struct BoundsArrays {
+		std::vector<float> centerX{}, centerY{}, centerZ{};
+		std::vector<float> extentX{}, extentY{}, extentZ{};
+
+		void resize(size_t count);
+
+		void set(size_t index, const glm::vec3& min, const glm::vec3& max);
+
+		inline size_t size() const { return centerX.size(); }
+	};
+
+	//Planes point inwards, xyz is the unit normal and w the distance
+	struct Frustum {
+		glm::vec4 planes[6]{};
+
+		//Planes of a Vulkan clip space projection, depth from 0 to 1
+		static Frustum fromMatrix(const glm::mat4& viewProjection);
+	};
+
+	//Batch kernels of one instruction set. The ranges are [begin, end) and every output has room
+	//for 'end' elements, a range can be split across threads.
+	struct TransformKernels {
+		//out[i] = translate(position) * rotate(rotation) * scale(scale)
+		void (*compose)(const TransformArrays& transforms, size_t begin, size_t end, glm::mat4* out);
+
+		//out[i] = a[i] * b[i], 'out' may alias 'a' or 'b'
+		void (*multiply)(const glm::mat4* a, const glm::mat4* b, glm::mat4* out, size_t count);
+
+		//out[i] = a * b[i], 'out' may alias 'b'
+		void (*multiplyLeft)(const glm::mat4& a, const glm::mat4* b, glm::mat4* out, size_t count);
+
+		//Box of the transformed local box, matrices must be affine
+		void (*transformBounds)(const glm::mat4* matrices, const BoundsArrays& local, BoundsArrays& world, size_t begin, size_t end);
+
+		//visible[i] is 1 when box i intersects the frustum, returns the number of visible boxes
+		size_t (*cullBounds)(const Frustum& frustum, const BoundsArrays& bounds, size_t begin, size_t end, uint8_t* visible);
+
+		SimdLevel level;
+	};
+
+	//Kernels of 'level', clamped to the detected one
+	const TransformKernels& transformKernels(SimdLevel level);
+
+	//Kernels of the detected level
+	const TransformKernels& transformKernels();
+
+	//Runs every kernel over 'count' random transforms at every supported level, prints the
+	//milliseconds per frame next to the glm scalar path and the largest deviation from it
+	void benchmarkTransformKernels(uint32_t count, uint32_t iterations);
+}
@@ -0,0 +1,66 @@
+#pragma once
+#include <atomic>
+#include <cstdint>
+#include "macro.h"
+
+namespace Clan
+{
+	//Hands the latest value from one writer thread to one reader thread without locks or waits.
+	//Each side owns one of three slots, the third is swapped with an atomic exchange: the writer
+	//swaps in the slot it just filled, the reader swaps it out when it's newer than its own. The
+	//reader always sees a complete value, values it was too slow for are skipped.
+	template<typename T>
+	class TripleBuffer
+	{
+	public:
+		TripleBuffer() = default;
+
+		TripleBuffer(const TripleBuffer&) = delete;
+
+		TripleBuffer& operator=(const TripleBuffer&) = delete;
+
+		~TripleBuffer() = default;
+
+		//Every slot starts as 'value', before anything is published the reader gets it. Not
+		//thread safe, call it before the threads start.
+		void reset(const T& value)
+		{
+			for (T& slot : m_slots) {
+				slot = value;
+			}
+			m_write = 0;
+			m_read = 1;
+			m_shared.store(2, std::memory_order_relaxed);
+		}
+
+		//Writer side, the slot to fill for the next publish()
+		inline T& back() { return m_slots[m_write]; }
+
+		//Writer side, makes back() the latest value. The new back() holds an older value.
+		void publish()
+		{
+			m_write = m_shared.exchange(m_write | FRESH, std::memory_order_acq_rel) & INDEX_MASK;
+		}
+
+		//Reader side, the latest published value. It stays valid and unchanged until the next call.
+		const T& read()
+		{
+			if (m_shared.load(std::memory_order_relaxed) & FRESH) {
+				m_read = m_shared.exchange(m_read, std::memory_order_acq_rel) & INDEX_MASK;
+			}
+			return m_slots[m_read];
+		}
+
+	private:
+		//set on the shared index while it holds a value the reader hasn't taken
+		static constexpr uint8_t FRESH = 4;
+		static constexpr uint8_t INDEX_MASK = 3;
+
+	private:
+		T m_slots[3]{};
+		//own cache lines, so the sides don't share one with the slots they write
+		alignas(64) std::atomic<uint8_t> m_shared{ 2 };
+		alignas(64) uint8_t m_write{ 0 };
+		alignas(64) uint8_t m_read{ 1 };
+	};
+}
@@ -5,7 +5,33 @@
 #include <vector>
 #include <array>
 #include <string>
+#include <chrono>
 #include <glm/glm.hpp>
+#include "FrameScheduler.h"
+#include "DeletionQueue.h"
+#include "AsyncQueue.h"
+#include "MipGenerator.h"
+#include "RenderGraph.h"
+#include "AntiAliasing.h"
+#include "GpuTimer.h"
+#include "ShaderHotReload.h"
+#include "ShaderReflection.h"
+#include "LayoutCache.h"
+#include "PipelineStateCache.h"
+#include "SceneGraph.h"
+#include "Bvh.h"
+#include "ThreadPool.h"
+#include "AssetArchive.h"
+#include "AsyncFileReader.h"
+#include "StartupProfiler.h"
+#include "MemoryTracker.h"
+#include "RendererConfig.h"
+#include "GeometryArena.h"
+#include "DescriptorAllocator.h"
+#include "TextureLoader.h"
+#include "SamplerCache.h"
+#include "Simulation.h"
+#include "RenderCommandStream.h"
 
 namespace Clan
 {
@@ -23,45 +49,100 @@ namespace Clan
 		bool operator==(const Vertex& v)const {
 			return position == v.position && color == v.color && texCoord == v.texCoord;
 		}
-
-		static VkVertexInputBindingDescription getBindingDescription() {
-			VkVertexInputBindingDescription bindingDescription{};
-			bindingDescription.binding = 0;
-			bindingDescription.stride = sizeof(Vertex);
-			bindingDescription.inputRate = VK_VERTEX_INPUT_RATE_VERTEX;
-			return bindingDescription;
-		}
-
-		static std::array<VkVertexInputAttributeDescription, 3> getAttributeDescriptions() {
-			std::array<VkVertexInputAttributeDescription, 3> attributeDescriptions{};
-			attributeDescriptions[0].binding = 0;
-			attributeDescriptions[0].location = 0;
-			attributeDescriptions[0].format = VK_FORMAT_R32G32B32_SFLOAT;
-			attributeDescriptions[0].offset = offsetof(Vertex, position);
-			attributeDescriptions[1].binding = 0;
-			attributeDescriptions[1].location = 1;
-			attributeDescriptions[1].format = VK_FORMAT_R32G32B32_SFLOAT;
-			attributeDescriptions[1].offset = offsetof(Vertex, color);
-			attributeDescriptions[2].binding = 0;
-			attributeDescriptions[2].location = 2;
-			attributeDescriptions[2].format = VK_FORMAT_R32G32_SFLOAT;
-			attributeDescriptions[2].offset = offsetof(Vertex, texCoord);
-			return attributeDescriptions;
-		}
 	};
 
+	using ActiveRenderPolicy = RenderPolicy<CLAN_FRAMES_IN_FLIGHT, CLAN_INDEX_TYPE, Vertex>;
+
 	class HelloTriangleApplication {
 	public:
 		HelloTriangleApplication() = default;
 		HelloTriangleApplication(const HelloTriangleApplication&) = delete;
 		HelloTriangleApplication& operator=(const HelloTriangleApplication&) = delete;
 		void run();
+
+		//Anti-aliasing used from the first frame, the device may not support it and pick a lower one
+		void setAntiAliasing(AntiAliasingMode mode);
+
+		//Renders 'framesPerMode' frames in every anti-aliasing mode, prints their cost and quits
+		void enableAntiAliasingBenchmark(uint32_t framesPerMode);
+
+		//Runs with a hidden window and quits after the first frame
+		void setHeadless(bool enabled);
+
+		//Writes the time of every startup step to 'path' as JSON once the first frame is done
+		void setStartupReport(const std::string& path);
+
+		//Window size, model and validation, read before run()
+		void setConfig(const RendererConfig& config);
+
+		//Writes the memory report to 'path' after cleanup, what is left in it leaked. Pressing M
+		//writes it while running.
+		void setMemoryReport(const std::string& path);
+
+		//The caches and assets a cold start has to do without
+		static ColdStartFiles coldStartFiles();
 		~HelloTriangleApplication() = default;
 
 	private:
 		struct QueueFamilyIndices;
 		struct SwapChainSupportDetails;
 
+		struct AntiAliasingBenchmark {
+			uint32_t framesPerMode{ 0 };
+			uint32_t frame{ 0 };
+			uint8_t mode{ 0 };
+			double cpuMilliseconds{ 0.0 };
+			double gpuMilliseconds{ 0.0 };
+			uint32_t gpuFrames{ 0 };
+			std::chrono::steady_clock::time_point lastFrame{};
+		};
+
+		//Vertices and indices of one OBJ shape in the global arrays, its indices count from its first
+		//vertex. 'geometry' is its place in the arena, 'node' its transform below the model's.
+		struct Mesh {
+			uint32_t firstVertex{ 0 };
+			uint32_t vertexCount{ 0 };
+			uint32_t firstIndex{ 0 };
+			uint32_t indexCount{ 0 };
+			GeometryMesh geometry{};
+			SceneNode node{ INVALID_SCENE_NODE };
+		};
+
+		//Index range of one mesh drawn with one material, 'firstIndex' is relative to the mesh
+		struct Submesh {
+			uint32_t mesh{ 0 };
+			uint32_t firstIndex{ 0 };
+			uint32_t indexCount{ 0 };
+			uint32_t material{ 0 };
+		};
+
+		struct Material {
+			uint32_t texture{ 0 };
+			//from the MTL -clamp option, the texture isn't tiled
+			bool clampToEdge{ false };
+			VkSampler sampler{};
+		};
+
+		//Adjacent draw commands of one index type and material, drawn with one multi-draw. Sorted by
+		//index type first, so the index buffer is bound at most once per type.
+		struct DrawBatch {
+			VkIndexType indexType{ VK_INDEX_TYPE_UINT16 };
+			uint32_t material{ 0 };
+			uint32_t firstDraw{ 0 };
+			uint32_t drawCount{ 0 };
+			//commands of this frame with a visible mesh, the batch isn't drawn without any
+			uint32_t visibleCount{ 0 };
+		};
+
+		//An empty path is a white texel, for materials that only have a diffuse color
+		struct Texture {
+			std::string path{};
+			VkImage image{};
+			VkDeviceMemory memory{};
+			VkImageView view{};
+			uint32_t mipLevels{ 1 };
+		};
+
 		static VKAPI_ATTR VkBool32 VKAPI_CALL debugCallback(
 			VkDebugUtilsMessageSeverityFlagBitsEXT messageSeverity,
 			VkDebugUtilsMessageTypeFlagsEXT messageType,
@@ -69,12 +150,16 @@ namespace Clan
 			void* pUserData);
 
 
-		static std::vector<char> readBinaryFile(const std::string& filename);
+		//the asset archive first, then the loose file
+		std::vector<char> readBinaryFile(const std::string& filename);
 
 		void initWindow();
 
 		void initVulkan();
 
+		//Starts the reads that don't need the device, they run while it is created
+		void startAssetLoading();
+
 		void mainLoop();
 
 		void cleanup();
@@ -101,6 +186,8 @@ namespace Clan
 
 		bool checkDeviceExtensions(const VkPhysicalDevice& physicalDevice);
 
+		bool checkDeviceExtension(const VkPhysicalDevice& physicalDevice, const char* extensionName);
+
 		SwapChainSupportDetails querySwapChainSupport(const VkPhysicalDevice& physicalDevice);
 
 		VkSurfaceFormatKHR chooseSwapSurfaceFormat(const std::vector<VkSurfaceFormatKHR>& formats);
@@ -113,9 +200,11 @@ namespace Clan
 
 		void createImageViews();
 
-		void createGraphicsPipeline();
+		void createPipelineCache();
 
-		VkShaderModule createShaderModule(const std::vector<char>& bytecode);
+		void createShaderHotReload();
+
+		void createGraphicsPipeline();
 		
 		void createRenderPass();
 
@@ -127,17 +216,42 @@ namespace Clan
 
 		void recordCommandBuffer(VkCommandBuffer commandBuffer, uint32_t imageIndex);
 
+		void recordDrawCommands(VkCommandBuffer commandBuffer);
+
+		void createAntiAliasing();
+
+		//Reports when the device or the missing shaders make it fall back to another mode
+		void setAntiAliasingMode(AntiAliasingMode mode);
+
+		//Rebuilds everything that depends on the sample count and the scene format
+		void applyAntiAliasing(AntiAliasingMode mode);
+
+		//Returns false once every mode has been measured
+		bool advanceAntiAliasingBenchmark();
+
 		void drawFrame();
 
 		void createSyncObjects();
 
+		//The model spins on the simulation thread, the render thread only samples it
+		void startSimulation();
+
+		//One fixed step of the simulation, runs on its thread
+		static void simulate(SimulationState& state, float stepSeconds);
+
 		void recreateSwapChain();
 
 		void cleanupSwapChain();
 
+		void cleanupAttachments();
+
 		void createBuffer(VkDeviceSize size, VkBufferUsageFlags usage, VkMemoryPropertyFlags properties, VkBuffer& buffer, VkDeviceMemory& bufferMemory);
 
-		void createVertIDBuffer();
+		//Uploads every mesh into the geometry arena
+		void createGeometryArena();
+
+		//One indexed draw command per submesh, grouped by material, in a buffer per frame in flight
+		void createDrawCommandBuffers();
 
 		uint32_t findMemoryType(uint32_t typeFilter, VkMemoryPropertyFlags properties);
 
@@ -155,9 +269,9 @@ namespace Clan
 
 		void createTextureImage();
 
-		void createImage(uint32_t width, uint32_t height, VkFormat format, 
+		void createImage(uint32_t width, uint32_t height, VkSampleCountFlagBits numSamples, VkFormat format,
 			VkImageTiling tiling, VkImageUsageFlags usage, VkMemoryPropertyFlags properties, 
-			VkImage& image, VkDeviceMemory &imageMemory);
+			VkImage& image, VkDeviceMemory &imageMemory, uint32_t mipLevels = 1, VkImageCreateFlags flags = 0);
 
 		VkCommandBuffer beginSingleTimeCommands();
 
@@ -165,33 +279,58 @@ namespace Clan
 
 		void transitionImageLayout(VkImage image, VkFormat format, VkImageLayout oldLayout, VkImageLayout newLayout);
 
-		void copyBufferToImage(VkBuffer buffer, VkImage image, uint32_t width, uint32_t height);
+		//records the copy with its layout transitions, for a queue without graphics stages
+		void recordTextureUpload(VkCommandBuffer commandBuffer, VkBuffer buffer, VkImage image, uint32_t width, uint32_t height, VkDeviceSize bufferOffset);
 
 		void createTextureImageView();
 
 		void createTextureSampler();
 
+		void createColorResources();
+
 		void createDepthResources();
 
-		VkImageView createImageView(VkImage image, VkFormat format, VkImageAspectFlags aspectFlags);
+		//Lazily allocated when the device has such memory, for attachments that are never stored
+		VkMemoryPropertyFlags transientAttachmentMemory();
+
+		//a 0 'usage' is the image's usage
+		VkImageView createImageView(VkImage image, VkFormat format, VkImageAspectFlags aspectFlags,
+			uint32_t mipLevels = 1, VkImageUsageFlags usage = 0);
 
 		void loadModel();
 
+		void createScene();
+
+		//Prints the object under the cursor
+		void pickObject();
+
 	private:
-		static constexpr uint32_t WINDOW_WIDTH = 800;
-		static constexpr uint32_t WINDOW_HEIGHT = 600;
-		static constexpr uint32_t MAX_FRAMES_IN_FLIGHT = 2;
-		static constexpr const char* MODEL_PATH = "resources/objects/room.obj";
-		static constexpr const char* TEXTURE_PATH = "resources/textures/room.png";
-#ifdef NDEBUG
-		static constexpr bool enableValidationLayers = false;
-#else
-		static constexpr bool enableValidationLayers = true;
-#endif // NDEBUG
+		using Policy = ActiveRenderPolicy;
+		static constexpr uint32_t MAX_FRAMES_IN_FLIGHT = Policy::FRAMES_IN_FLIGHT;
+		//grows to the loaded meshes when they don't fit
+		static constexpr VkDeviceSize GEOMETRY_ARENA_BYTES = 64ull * 1024 * 1024;
+		//4K each, commands written by other threads between two frames
+		static constexpr uint32_t RENDER_COMMAND_CHUNKS = 64;
+		//the budget query isn't free, a few times a second is enough
+		static constexpr std::chrono::milliseconds MEMORY_BUDGET_INTERVAL{ 250 };
+		static constexpr VkFormat DEPTH_FORMAT = VK_FORMAT_D32_SFLOAT;
+		//use VK_KHR_dynamic_rendering (core in 1.3) instead of VkRenderPass/VkFramebuffer when supported
+		static constexpr bool preferDynamicRendering = true;
+		//frames rendered after an anti-aliasing switch before the benchmark starts measuring
+		static constexpr uint32_t ANTI_ALIASING_WARMUP_FRAMES = 30;
+		static constexpr const char* SHADER_DIRECTORY = "shaders";
+		static constexpr const char* FORWARD_PIPELINE = "forward";
+		//driver pipeline cache and the pipeline keys used by the last run, to precompile them
+		static constexpr const char* PIPELINE_CACHE_PATH = "pipeline_cache.bin";
+		//written by --pack-assets, loose files are used when it is missing
+		static constexpr const char* ASSET_ARCHIVE_PATH = "assets.pak";
+		static constexpr const char* PIPELINE_KEYS_PATH = "pipeline_keys.txt";
 		static const std::vector<const char*> validationLayers;
 		static const std::vector<const char*> deviceExtensions;
 
+		RendererConfig config{};
 		GLFWwindow* window{};
+		bool useDynamicRendering{ false };
 
 		VkInstance instance{};
 		VkDebugUtilsMessengerEXT debugMessenger{};
@@ -199,6 +338,8 @@ namespace Clan
 		VkDevice device{};
 		VkQueue graphicsQueue{};
 		VkQueue presentQueue{};
+		VkQueue computeQueue{};
+		VkQueue transferQueue{};
 		VkSurfaceKHR surface{};
 		VkSwapchainKHR swapChain{};
 		std::vector<VkImage> swapChainImages{};
@@ -206,30 +347,103 @@ namespace Clan
 		VkExtent2D swapChainExtent{};
 		std::vector<VkImageView> swapChainImageViews{};
 		VkRenderPass renderPass{};
+		//interface of the forward shaders, the descriptor and pipeline layouts are derived from it
+		ShaderReflection forwardReflection{};
+		LayoutCache layoutCache{};
 		VkDescriptorSetLayout descriptorSetLayout{};
 		VkPipelineLayout pipelineLayout{};
+		//owned by pipelineStates
 		VkPipeline graphicsPipeline{};
+		PipelineKey forwardKey{};
+		PipelineStateCache pipelineStates{};
+		ShaderHotReload shaderHotReload{};
 		std::vector<VkFramebuffer> swapChainFramebuffers{};
 		VkCommandPool commandPool{};
 		std::vector<VkCommandBuffer> commandBuffers{};
 		std::vector<VkSemaphore> imageAvailableSemaphores{};
 		std::vector<VkSemaphore> renderFinishedSemaphores{};
-		std::vector<VkFence> inFlightFences{};
+		FrameScheduler frameScheduler{};
+		DeletionQueue deletionQueue{};
+		AsyncQueue asyncCompute{};
+		AsyncQueue asyncTransfer{};
+		RenderGraph renderGraph{};
 		uint32_t currentFrame{0};
-		VkBuffer VertIDBuffer{};
-		VkDeviceMemory VertIDBufferMemory{};
+		GeometryArena geometryArena{};
 		std::vector<VkBuffer> uniformBuffers{};
 		std::vector<VkDeviceMemory> uniformBuffersMemory{};
-		VkDescriptorPool descriptorPool{};
+		//model matrices of the objects drawn in a frame, indexed by the draw's first instance
+		std::vector<VkBuffer> objectBuffers{};
+		std::vector<VkDeviceMemory> objectBuffersMemory{};
+		std::vector<glm::mat4*> objectBuffersMapped{};
+		//scene version each object buffer was last synced to
+		std::vector<uint64_t> objectBuffersVersion{};
+		VkShaderStageFlags drawConstantStages{ 0 };
+		SceneGraph scene{};
+		SceneNode modelNode{ INVALID_SCENE_NODE };
+		Simulation simulation{};
+		//scene changes from other threads, applied at the start of every frame's update
+		RenderCommandStream renderCommands{};
+		//CPU copy of the world matrices indexed by node
+		std::vector<glm::mat4> objectWorld{};
+		uint64_t objectWorldVersion{ 0 };
+		//boxes indexed by mesh, the objects of the BVH, it's refit when the matrices change
+		BoundsArrays objectLocalBounds{};
+		BoundsArrays objectWorldBounds{};
+		Bvh sceneBvh{};
+		std::vector<uint32_t> visibleObjects{};
+		//per mesh, 1 when it's in visibleObjects
+		std::vector<uint8_t> meshVisible{};
+		//unjittered, for culling and picking
+		glm::mat4 viewProjection{ 1.0f };
+		bool mouseWasPressed{ false };
+		//the material sets, cached by their contents
+		DescriptorAllocator descriptorAllocator{};
+		//transient sets, reset when the frame's slot comes around again
+		std::array<DescriptorAllocator, MAX_FRAMES_IN_FLIGHT> frameDescriptors{};
+		//one per frame in flight and material, frame major
 		std::vector<VkDescriptorSet> descriptorSets{};
-		VkImage textureImage{};
-		VkDeviceMemory textureImageMemory{};
-		VkImageView textureImageView{};
-		VkSampler textureSampler{};
+		std::vector<Mesh> meshes{};
+		std::vector<Submesh> submeshes{};
+		std::vector<DrawBatch> drawBatches{};
+		std::vector<Material> materials{};
+		std::vector<Texture> textures{};
+		ThreadPool workerPool{};
+		AssetArchive assetArchive{};
+		AsyncFileReader fileReader{};
+		//read while the device is created, empty when the model comes from the archive
+		std::vector<char> modelFile{};
+		//one per frame in flight, the instance counts are written after culling
+		std::vector<VkBuffer> drawCommandBuffers{};
+		std::vector<VkDeviceMemory> drawCommandBuffersMemory{};
+		std::vector<VkDrawIndexedIndirectCommand*> drawCommandsMapped{};
+		SamplerCache samplerCache{};
+		TextureRegistry textureRegistry{};
 		VkPhysicalDeviceProperties deviceProperties{};
 		VkPhysicalDeviceFeatures deviceFeatures{};
+		VkPhysicalDeviceVulkan12Features deviceFeatures12{};
+		VkPhysicalDeviceVulkan13Features deviceFeatures13{};
 		VkImage depthImage{};
 		VkDeviceMemory depthImageMemory{};
 		VkImageView depthImageView{};
+		//multisampled or post-processed color target of the render pass backend
+		VkImage colorImage{};
+		VkDeviceMemory colorImageMemory{};
+		VkImageView colorImageView{};
+		VkDeviceSize attachmentMemoryBytes{ 0 };
+		bool swapChainBlitSupported{ false };
+		AntiAliasingMode requestedAntiAliasing{ AntiAliasingMode::MSAA4x };
+		AntiAliasing antiAliasing{};
+		//previous frame's unjittered clip from object transform, for the TAA reprojection
+		glm::mat4 previousModelViewProjection{ 1.0f };
+		glm::mat4 reprojection{ 1.0f };
+		GpuTimer gpuTimer{};
+		AntiAliasingBenchmark benchmark{};
+		StartupProfiler startupProfiler{};
+		std::string startupReportPath{};
+		bool headless{ false };
+		std::string memoryReportPath{ "memory_report.json" };
+		bool memoryReportAtExit{ false };
+		bool memoryKeyWasPressed{ false };
+		std::chrono::steady_clock::time_point lastMemoryBudgetCheck{};
 	};
 }
\ No newline at end of file
@@ -5,8 +5,14 @@ layout(location = 1) in vec2 fragTexCoord;
 
 layout(binding = 1) uniform sampler2D texSampler;
 
+//material variants are specialized by the pipeline instead of branching at runtime
+layout(constant_id = 0) const bool USE_VERTEX_COLOR = false;
+
 layout(location = 0) out vec4 outColor;
 
 void main(){
 	outColor = texture(texSampler, fragTexCoord);
+	if (USE_VERTEX_COLOR) {
+		outColor.rgb *= fragColor;
+	}
 }
\ No newline at end of file
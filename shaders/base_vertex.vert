@@ -1,11 +1,21 @@
 #version 450
 
+//per-frame data shared by every draw
 layout(binding = 0) uniform UniformBufferObject{
-	mat4 model;
 	mat4 view;
 	mat4 proj;
 }ubo;
 
+//model matrices of every object drawn this frame, the first instance of a draw is its object's index
+layout(std430, binding = 2) readonly buffer ObjectBuffer{
+	mat4 models[];
+}objects;
+
+//per-material data, pushed once for all draws of a material
+layout(push_constant) uniform DrawConstants{
+	uint materialIndex;
+}draw;
+
 layout(location = 0) in vec3 inPosition;
 layout(location = 1) in vec3 inColor;
 layout(location = 2) in vec2 inTexCoord;
@@ -14,7 +24,7 @@ layout(location = 0) out vec3 fragColor;
 layout(location = 1) out vec2 fragTexCoord;
 
 void main(){
-	gl_Position = ubo.proj * ubo.view * ubo.model * vec4(inPosition, 1.0);
+	gl_Position = ubo.proj * ubo.view * objects.models[gl_InstanceIndex] * vec4(inPosition, 1.0);
 	fragColor = inColor;
 	fragTexCoord = inTexCoord;
 }
\ No newline at end of file
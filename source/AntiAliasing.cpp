@@ -0,0 +1,358 @@
+#include <array>
+#include <cctype>
+#include "AntiAliasing.h"
+#include "MemoryTracker.h"
+
+namespace Clan
+{
+	namespace
+	{
+		float halton(uint32_t index, uint32_t base)
+		{
+			float result = 0.0f;
+			float fraction = 1.0f;
+			while (index > 0) {
+				fraction /= base;
+				result += fraction * (index % base);
+				index /= base;
+			}
+			return result;
+		}
+	}
+	//-----------------------------------------------------------------------------------------------
+	const char* antiAliasingModeName(AntiAliasingMode mode)
+	{
+		switch (mode) {
+		case AntiAliasingMode::None: return "none";
+		case AntiAliasingMode::MSAA2x: return "msaa2x";
+		case AntiAliasingMode::MSAA4x: return "msaa4x";
+		case AntiAliasingMode::MSAA8x: return "msaa8x";
+		case AntiAliasingMode::FXAA: return "fxaa";
+		case AntiAliasingMode::TAA: return "taa";
+		default: return "unknown";
+		}
+	}
+	//-----------------------------------------------------------------------------------------------
+	bool parseAntiAliasingMode(const char* name, AntiAliasingMode& mode)
+	{
+		for (uint8_t i = 0; i < static_cast<uint8_t>(AntiAliasingMode::Count); ++i) {
+			const char* candidate = antiAliasingModeName(static_cast<AntiAliasingMode>(i));
+			size_t c = 0;
+			while (candidate[c] != '\0' && std::tolower(static_cast<unsigned char>(name[c])) == candidate[c]) ++c;
+			if (candidate[c] == '\0' && name[c] == '\0') {
+				mode = static_cast<AntiAliasingMode>(i);
+				return true;
+			}
+		}
+		return false;
+	}
+	//-----------------------------------------------------------------------------------------------
+	void AntiAliasing::init(VkDevice device, VkPhysicalDevice physicalDevice, DeletionQueue* pDeletionQueue, Timeline* pTimeline,
+		const std::vector<char>& fxaaCode, const std::vector<char>& taaCode)
+	{
+		m_device = device;
+		m_pDeletionQueue = pDeletionQueue;
+		m_pTimeline = pTimeline;
+		vkGetPhysicalDeviceMemoryProperties(physicalDevice, &m_memoryProperties);
+		VkPhysicalDeviceProperties properties{};
+		vkGetPhysicalDeviceProperties(physicalDevice, &properties);
+		m_supportedSamples = properties.limits.framebufferColorSampleCounts & properties.limits.framebufferDepthSampleCounts;
+
+		//0: scene color, 1: depth, 2: history, 3: output. FXAA only uses the color and the output
+		std::array<VkDescriptorSetLayoutBinding, 4> bindings{};
+		for (uint32_t i = 0; i < bindings.size(); ++i) {
+			bindings[i].binding = i;
+			bindings[i].descriptorCount = 1;
+			bindings[i].descriptorType = i == 3 ? VK_DESCRIPTOR_TYPE_STORAGE_IMAGE : VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+			bindings[i].stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+		}
+		VkDescriptorSetLayoutCreateInfo layoutInfo{};
+		layoutInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+		layoutInfo.bindingCount = static_cast<uint32_t>(bindings.size());
+		layoutInfo.pBindings = bindings.data();
+		VkResult result = vkCreateDescriptorSetLayout(m_device, &layoutInfo, vulkanAllocator(), &m_setLayout);
+		ASSERT(result == VK_SUCCESS);
+
+		VkPushConstantRange pushConstantRange{};
+		pushConstantRange.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+		pushConstantRange.offset = 0;
+		pushConstantRange.size = sizeof(PostProcessConstants);
+		VkPipelineLayoutCreateInfo pipelineLayoutInfo{};
+		pipelineLayoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+		pipelineLayoutInfo.setLayoutCount = 1;
+		pipelineLayoutInfo.pSetLayouts = &m_setLayout;
+		pipelineLayoutInfo.pushConstantRangeCount = 1;
+		pipelineLayoutInfo.pPushConstantRanges = &pushConstantRange;
+		result = vkCreatePipelineLayout(m_device, &pipelineLayoutInfo, vulkanAllocator(), &m_pipelineLayout);
+		ASSERT(result == VK_SUCCESS);
+		m_fxaaPipeline = createComputePipeline(fxaaCode);
+		m_taaPipeline = createComputePipeline(taaCode);
+
+		VkSamplerCreateInfo samplerInfo{};
+		samplerInfo.sType = VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO;
+		samplerInfo.magFilter = VK_FILTER_LINEAR;
+		samplerInfo.minFilter = VK_FILTER_LINEAR;
+		samplerInfo.mipmapMode = VK_SAMPLER_MIPMAP_MODE_NEAREST;
+		samplerInfo.addressModeU = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+		samplerInfo.addressModeV = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+		samplerInfo.addressModeW = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+		samplerInfo.maxLod = 0.0f;
+		result = vkCreateSampler(m_device, &samplerInfo, vulkanAllocator(), &m_linearSampler);
+		ASSERT(result == VK_SUCCESS);
+		samplerInfo.magFilter = VK_FILTER_NEAREST;
+		samplerInfo.minFilter = VK_FILTER_NEAREST;
+		result = vkCreateSampler(m_device, &samplerInfo, vulkanAllocator(), &m_pointSampler);
+		ASSERT(result == VK_SUCCESS);
+	}
+	//-----------------------------------------------------------------------------------------------
+	void AntiAliasing::destroy()
+	{
+		releaseHistory();
+		vkDestroySampler(m_device, m_pointSampler, vulkanAllocator());
+		vkDestroySampler(m_device, m_linearSampler, vulkanAllocator());
+		vkDestroyPipeline(m_device, m_taaPipeline, vulkanAllocator());
+		vkDestroyPipeline(m_device, m_fxaaPipeline, vulkanAllocator());
+		vkDestroyPipelineLayout(m_device, m_pipelineLayout, vulkanAllocator());
+		vkDestroyDescriptorSetLayout(m_device, m_setLayout, vulkanAllocator());
+	}
+	//-----------------------------------------------------------------------------------------------
+	AntiAliasingMode AntiAliasing::setMode(AntiAliasingMode mode, bool backbufferBlitSupported)
+	{
+		if (mode == AntiAliasingMode::FXAA && (m_fxaaPipeline == VK_NULL_HANDLE || !backbufferBlitSupported)) {
+			mode = AntiAliasingMode::None;
+		}
+		if (mode == AntiAliasingMode::TAA && (m_taaPipeline == VK_NULL_HANDLE || !backbufferBlitSupported)) {
+			mode = AntiAliasingMode::None;
+		}
+		m_mode = mode;
+		//step down to the highest sample count the device supports, MSAA2x falls back to None
+		while (m_mode != AntiAliasingMode::None && !isPostProcess() && (m_supportedSamples & samples()) == 0) {
+			m_mode = static_cast<AntiAliasingMode>(static_cast<uint8_t>(m_mode) - 1);
+		}
+		m_historyValid = false;
+		return m_mode;
+	}
+	//-----------------------------------------------------------------------------------------------
+	VkSampleCountFlagBits AntiAliasing::samples() const
+	{
+		switch (m_mode) {
+		case AntiAliasingMode::MSAA2x: return VK_SAMPLE_COUNT_2_BIT;
+		case AntiAliasingMode::MSAA4x: return VK_SAMPLE_COUNT_4_BIT;
+		case AntiAliasingMode::MSAA8x: return VK_SAMPLE_COUNT_8_BIT;
+		default: return VK_SAMPLE_COUNT_1_BIT;
+		}
+	}
+	//-----------------------------------------------------------------------------------------------
+	VkFormat AntiAliasing::sceneFormat(VkFormat backbufferFormat) const
+	{
+		//the post-process passes filter linear HDR color, the blit encodes it to the backbuffer format
+		return isPostProcess() ? POST_PROCESS_FORMAT : backbufferFormat;
+	}
+	//-----------------------------------------------------------------------------------------------
+	glm::vec2 AntiAliasing::jitter(VkExtent2D extent) const
+	{
+		if (m_mode != AntiAliasingMode::TAA) return glm::vec2(0.0f);
+		//Halton(2, 3) covers the pixel evenly over a short cycle
+		uint32_t phase = m_frame % JITTER_PHASES + 1;
+		return glm::vec2((halton(phase, 2) - 0.5f) * 2.0f / extent.width,
+						 (halton(phase, 3) - 0.5f) * 2.0f / extent.height);
+	}
+	//-----------------------------------------------------------------------------------------------
+	void AntiAliasing::addPasses(RenderGraph& graph, DescriptorAllocator& frameDescriptors, VkExtent2D extent,
+		GraphResource sceneColor, GraphResource depth, GraphResource backbuffer, const glm::mat4& reprojection)
+	{
+		if (!isPostProcess()) return;
+		RenderGraph* pGraph = &graph;
+		DescriptorAllocator* pDescriptors = &frameDescriptors;
+		PostProcessConstants constants{};
+		constants.reprojection = reprojection;
+		constants.invExtent = glm::vec2(1.0f / extent.width, 1.0f / extent.height);
+		constants.jitter = jitter(extent);
+		constants.historyWeight = 0.9f;
+		constants.historyValid = m_historyValid ? 1 : 0;
+
+		GraphResource output{};
+		if (m_mode == AntiAliasingMode::FXAA) {
+			output = graph.createImage("fxaaOutput", { POST_PROCESS_FORMAT, extent, VK_SAMPLE_COUNT_1_BIT });
+			graph.addPass("fxaa",
+				[&](RenderGraph::PassBuilder& builder) {
+					builder.read(sceneColor, ImageUsage::SampledCompute);
+					builder.write(output, ImageUsage::StorageWrite);
+				},
+				[this, pGraph, pDescriptors, extent, constants, sceneColor, output](VkCommandBuffer commandBuffer) {
+					VkDescriptorSet set = pDescriptors->get(m_setLayout,
+						descriptors(pGraph->imageView(sceneColor), VK_NULL_HANDLE, VK_NULL_HANDLE, pGraph->imageView(output)));
+					dispatch(commandBuffer, m_fxaaPipeline, set, extent, constants);
+				});
+		}
+		else {
+			if (m_historyExtent.width != extent.width || m_historyExtent.height != extent.height) {
+				createHistory(extent);
+				constants.historyValid = 0;
+			}
+			//ping-pong: last frame's output is this frame's history. Both were last read by compute
+			//(the history) or the blit (the output), the new output discards its contents.
+			const HistoryImage& previous = m_history[(m_frame + 1) % 2];
+			const HistoryImage& current = m_history[m_frame % 2];
+			constexpr VkPipelineStageFlags2 lastReaders = VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT | VK_PIPELINE_STAGE_2_ALL_TRANSFER_BIT;
+			ImageState previousState{ lastReaders, VK_ACCESS_2_NONE,
+				constants.historyValid ? VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL : VK_IMAGE_LAYOUT_UNDEFINED };
+			GraphResource history = graph.importImage("taaHistory", previous.image, previous.view, VK_IMAGE_ASPECT_COLOR_BIT,
+				previousState, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
+			output = graph.importImage("taaOutput", current.image, current.view, VK_IMAGE_ASPECT_COLOR_BIT,
+				{ lastReaders, VK_ACCESS_2_NONE, VK_IMAGE_LAYOUT_UNDEFINED }, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
+			graph.addPass("taa",
+				[&](RenderGraph::PassBuilder& builder) {
+					builder.read(sceneColor, ImageUsage::SampledCompute);
+					builder.read(depth, ImageUsage::SampledCompute);
+					builder.read(history, ImageUsage::SampledCompute);
+					builder.write(output, ImageUsage::StorageWrite);
+				},
+				[this, pGraph, pDescriptors, extent, constants, sceneColor, depth, history, output](VkCommandBuffer commandBuffer) {
+					VkDescriptorSet set = pDescriptors->get(m_setLayout, descriptors(pGraph->imageView(sceneColor),
+						pGraph->imageView(depth), pGraph->imageView(history), pGraph->imageView(output)));
+					dispatch(commandBuffer, m_taaPipeline, set, extent, constants);
+				});
+		}
+		graph.addPass("resolveToBackbuffer",
+			[&](RenderGraph::PassBuilder& builder) {
+				builder.read(output, ImageUsage::TransferSrc);
+				builder.write(backbuffer, ImageUsage::TransferDst);
+			},
+			[pGraph, extent, output, backbuffer](VkCommandBuffer commandBuffer) {
+				VkImageBlit region{};
+				region.srcSubresource = { VK_IMAGE_ASPECT_COLOR_BIT, 0, 0, 1 };
+				region.srcOffsets[1] = { static_cast<int32_t>(extent.width), static_cast<int32_t>(extent.height), 1 };
+				region.dstSubresource = { VK_IMAGE_ASPECT_COLOR_BIT, 0, 0, 1 };
+				region.dstOffsets[1] = region.srcOffsets[1];
+				vkCmdBlitImage(commandBuffer,
+					pGraph->image(output), VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+					pGraph->image(backbuffer), VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+					1, &region, VK_FILTER_NEAREST);
+			});
+	}
+	//-----------------------------------------------------------------------------------------------
+	void AntiAliasing::endFrame()
+	{
+		m_historyValid = m_mode == AntiAliasingMode::TAA;
+		++m_frame;
+	}
+	//-----------------------------------------------------------------------------------------------
+	VkPipeline AntiAliasing::createComputePipeline(const std::vector<char>& code)
+	{
+		if (code.empty()) return VK_NULL_HANDLE;
+		VkShaderModuleCreateInfo moduleInfo{};
+		moduleInfo.sType = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO;
+		moduleInfo.codeSize = code.size();
+		moduleInfo.pCode = reinterpret_cast<const uint32_t*>(code.data());
+		VkShaderModule shaderModule{};
+		VkResult result = vkCreateShaderModule(m_device, &moduleInfo, vulkanAllocator(), &shaderModule);
+		ASSERT(result == VK_SUCCESS);
+		VkComputePipelineCreateInfo pipelineInfo{};
+		pipelineInfo.sType = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO;
+		pipelineInfo.stage.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+		pipelineInfo.stage.stage = VK_SHADER_STAGE_COMPUTE_BIT;
+		pipelineInfo.stage.module = shaderModule;
+		pipelineInfo.stage.pName = "main";
+		pipelineInfo.layout = m_pipelineLayout;
+		VkPipeline pipeline{};
+		result = vkCreateComputePipelines(m_device, VK_NULL_HANDLE, 1, &pipelineInfo, vulkanAllocator(), &pipeline);
+		ASSERT(result == VK_SUCCESS);
+		vkDestroyShaderModule(m_device, shaderModule, vulkanAllocator());
+		return pipeline;
+	}
+	//-----------------------------------------------------------------------------------------------
+	void AntiAliasing::createHistory(VkExtent2D extent)
+	{
+		releaseHistory();
+		m_historyExtent = extent;
+		for (auto& history : m_history) {
+			VkImageCreateInfo imageInfo{};
+			imageInfo.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+			imageInfo.imageType = VK_IMAGE_TYPE_2D;
+			imageInfo.extent = { extent.width, extent.height, 1 };
+			imageInfo.mipLevels = 1;
+			imageInfo.arrayLayers = 1;
+			imageInfo.format = POST_PROCESS_FORMAT;
+			imageInfo.tiling = VK_IMAGE_TILING_OPTIMAL;
+			imageInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+			imageInfo.usage = VK_IMAGE_USAGE_STORAGE_BIT | VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT;
+			imageInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+			imageInfo.samples = VK_SAMPLE_COUNT_1_BIT;
+			VkResult result = vkCreateImage(m_device, &imageInfo, vulkanAllocator(), &history.image);
+			ASSERT(result == VK_SUCCESS);
+			VkMemoryRequirements requirements{};
+			vkGetImageMemoryRequirements(m_device, history.image, &requirements);
+			VkMemoryAllocateInfo allocInfo{};
+			allocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+			allocInfo.allocationSize = requirements.size;
+			allocInfo.memoryTypeIndex = findMemoryType(requirements.memoryTypeBits, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+			result = allocateDeviceMemory(m_device, &allocInfo, &history.memory);
+			ASSERT(result == VK_SUCCESS);
+			vkBindImageMemory(m_device, history.image, history.memory, 0);
+			m_historyBytes += requirements.size;
+			VkImageViewCreateInfo viewInfo{};
+			viewInfo.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
+			viewInfo.image = history.image;
+			viewInfo.viewType = VK_IMAGE_VIEW_TYPE_2D;
+			viewInfo.format = POST_PROCESS_FORMAT;
+			viewInfo.subresourceRange = { VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1 };
+			result = vkCreateImageView(m_device, &viewInfo, vulkanAllocator(), &history.view);
+			ASSERT(result == VK_SUCCESS);
+		}
+		m_historyValid = false;
+	}
+	//-----------------------------------------------------------------------------------------------
+	void AntiAliasing::releaseHistory()
+	{
+		uint64_t lastUse = m_pTimeline->lastSubmitted();
+		for (auto& history : m_history) {
+			m_pDeletionQueue->retire<VK_OBJECT_TYPE_IMAGE_VIEW>(history.view, lastUse);
+			m_pDeletionQueue->retireImage(history.image, history.memory, lastUse);
+			history = {};
+		}
+		m_historyExtent = {};
+		m_historyBytes = 0;
+	}
+	//-----------------------------------------------------------------------------------------------
+	DescriptorWriter AntiAliasing::descriptors(VkImageView color, VkImageView depth, VkImageView history, VkImageView output) const
+	{
+		//FXAA leaves the depth and history bindings out
+		DescriptorWriter writer;
+		writer.image(0, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, color, m_linearSampler, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
+		if (depth != VK_NULL_HANDLE) {
+			writer.image(1, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, depth, m_pointSampler, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
+		}
+		if (history != VK_NULL_HANDLE) {
+			writer.image(2, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, history, m_linearSampler, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
+		}
+		writer.image(3, VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, output, VK_NULL_HANDLE, VK_IMAGE_LAYOUT_GENERAL);
+		return writer;
+	}
+	//-----------------------------------------------------------------------------------------------
+	std::vector<VkDescriptorPoolSize> AntiAliasing::descriptorSizes()
+	{
+		return { { VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 3 }, { VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, 1 } };
+	}
+	//-----------------------------------------------------------------------------------------------
+	void AntiAliasing::dispatch(VkCommandBuffer commandBuffer, VkPipeline pipeline, VkDescriptorSet set,
+		VkExtent2D extent, const PostProcessConstants& constants)
+	{
+		vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, pipeline);
+		vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, m_pipelineLayout, 0, 1, &set, 0, nullptr);
+		vkCmdPushConstants(commandBuffer, m_pipelineLayout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(constants), &constants);
+		//8x8 groups, see the local size of the shaders
+		vkCmdDispatch(commandBuffer, (extent.width + 7) / 8, (extent.height + 7) / 8, 1);
+	}
+	//-----------------------------------------------------------------------------------------------
+	uint32_t AntiAliasing::findMemoryType(uint32_t typeFilter, VkMemoryPropertyFlags properties) const
+	{
+		for (uint32_t i = 0; i < m_memoryProperties.memoryTypeCount; i++) {
+			if ((typeFilter & (1 << i)) && (m_memoryProperties.memoryTypes[i].propertyFlags & properties) == properties) {
+				return i;
+			}
+		}
+		ASSERT(false);
+		return 0;
+	}
+}
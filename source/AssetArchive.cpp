@@ -0,0 +1,263 @@
+#include "AssetArchive.h"
+#include <cstring>
+#include <fstream>
+#include <filesystem>
+#include <iostream>
+#include "Lz4.h"
+
+namespace Clan
+{
+	namespace
+	{
+		constexpr uint32_t ARCHIVE_MAGIC = 0x4b415043; //"CPAK"
+		constexpr uint32_t ARCHIVE_VERSION = 1;
+		constexpr uint64_t ENTRY_ALIGNMENT = 4096;
+
+		struct ArchiveHeader {
+			uint32_t magic;
+			uint32_t version;
+			uint32_t entryCount;
+			//power of two, at most half of the slots are used
+			uint32_t slotCount;
+			uint64_t namesOffset;
+			uint64_t namesSize;
+		};
+
+		inline uint64_t alignEntry(uint64_t offset)
+		{
+			return (offset + ENTRY_ALIGNMENT - 1) & ~(ENTRY_ALIGNMENT - 1);
+		}
+
+		//forward slashes and no leading "./", so both spellings of a path find the same entry
+		std::string normalizePath(const std::string& path)
+		{
+			std::string normalized = path;
+			for (char& c : normalized) {
+				if (c == '\\') c = '/';
+			}
+			while (normalized.compare(0, 2, "./") == 0) {
+				normalized.erase(0, 2);
+			}
+			return normalized;
+		}
+
+		//FNV-1a, 0 marks an empty slot
+		uint64_t hashPath(const std::string& normalized)
+		{
+			uint64_t hash = 14695981039346656037ull;
+			for (char c : normalized) {
+				hash = (hash ^ static_cast<uint8_t>(c)) * 1099511628211ull;
+			}
+			return hash != 0 ? hash : 1;
+		}
+	}
+
+	struct AssetArchive::Entry {
+		uint64_t hash;
+		uint64_t offset;
+		uint64_t storedSize;
+		uint64_t size;
+		uint32_t nameOffset;
+		uint32_t nameLength;
+		AssetCompression compression;
+		uint32_t reserved;
+	};
+	//-----------------------------------------------------------------------------------------------
+	bool AssetArchive::open(const std::string& path)
+	{
+		close();
+		if (!m_file.open(path)) return false;
+		const uint8_t* pData = m_file.data();
+		uint64_t fileSize = m_file.size();
+		ArchiveHeader header{};
+		bool valid = fileSize >= sizeof(header);
+		if (valid) {
+			std::memcpy(&header, pData, sizeof(header));
+			uint64_t slotsEnd = sizeof(header) + static_cast<uint64_t>(header.slotCount) * sizeof(Entry);
+			valid = header.magic == ARCHIVE_MAGIC && header.version == ARCHIVE_VERSION
+				&& header.slotCount != 0 && (header.slotCount & (header.slotCount - 1)) == 0
+				&& header.entryCount < header.slotCount && slotsEnd <= fileSize
+				&& header.namesOffset >= slotsEnd && header.namesSize <= fileSize - header.namesOffset;
+		}
+		if (valid) {
+			m_pSlots = reinterpret_cast<const Entry*>(pData + sizeof(header));
+			//checked once here so lookups can trust the table
+			for (uint32_t i = 0; valid && i < header.slotCount; ++i) {
+				const Entry& entry = m_pSlots[i];
+				if (entry.hash == 0) continue;
+				valid = entry.offset <= fileSize && entry.storedSize <= fileSize - entry.offset
+					&& static_cast<uint64_t>(entry.nameOffset) + entry.nameLength <= header.namesSize
+					&& (entry.compression == AssetCompression::Lz4 || (entry.compression == AssetCompression::None && entry.storedSize == entry.size));
+			}
+		}
+		if (!valid) {
+			std::cerr << "invalid asset archive " << path << std::endl;
+			close();
+			return false;
+		}
+		m_slotCount = header.slotCount;
+		m_entryCount = header.entryCount;
+		m_pNames = reinterpret_cast<const char*>(pData + header.namesOffset);
+		m_file.prefetch();
+		return true;
+	}
+	//-----------------------------------------------------------------------------------------------
+	void AssetArchive::close()
+	{
+		m_file.close();
+		m_pSlots = nullptr;
+		m_slotCount = 0;
+		m_entryCount = 0;
+		m_pNames = nullptr;
+	}
+	//-----------------------------------------------------------------------------------------------
+	bool AssetArchive::contains(const std::string& path) const
+	{
+		return find(path) != nullptr;
+	}
+	//-----------------------------------------------------------------------------------------------
+	AssetSpan AssetArchive::view(const std::string& path) const
+	{
+		const Entry* pEntry = find(path);
+		if (pEntry == nullptr || pEntry->compression != AssetCompression::None) return {};
+		return AssetSpan{ m_file.data() + pEntry->offset, static_cast<size_t>(pEntry->size) };
+	}
+	//-----------------------------------------------------------------------------------------------
+	AssetSpan AssetArchive::load(const std::string& path, std::vector<char>& storage) const
+	{
+		const Entry* pEntry = find(path);
+		if (pEntry == nullptr) return {};
+		const uint8_t* pStored = m_file.data() + pEntry->offset;
+		if (pEntry->compression == AssetCompression::None) {
+			return AssetSpan{ pStored, static_cast<size_t>(pEntry->size) };
+		}
+		storage.resize(static_cast<size_t>(pEntry->size));
+		uint8_t* pOut = reinterpret_cast<uint8_t*>(storage.data());
+		if (!lz4Decompress(pStored, static_cast<size_t>(pEntry->storedSize), pOut, storage.size())) {
+			std::cerr << "corrupt asset archive entry " << path << std::endl;
+			storage.clear();
+			return {};
+		}
+		return AssetSpan{ pOut, storage.size() };
+	}
+	//-----------------------------------------------------------------------------------------------
+	bool AssetArchive::read(const std::string& path, std::vector<char>& out) const
+	{
+		const Entry* pEntry = find(path);
+		if (pEntry == nullptr) return false;
+		if (pEntry->compression != AssetCompression::None) {
+			return load(path, out).data != nullptr;
+		}
+		const char* pStored = reinterpret_cast<const char*>(m_file.data() + pEntry->offset);
+		out.assign(pStored, pStored + pEntry->size);
+		return true;
+	}
+	//-----------------------------------------------------------------------------------------------
+	const AssetArchive::Entry* AssetArchive::find(const std::string& path) const
+	{
+		if (m_pSlots == nullptr) return nullptr;
+		std::string normalized = normalizePath(path);
+		uint64_t hash = hashPath(normalized);
+		uint32_t mask = m_slotCount - 1;
+		//linear probing, the table is never more than half full
+		for (uint32_t slot = static_cast<uint32_t>(hash) & mask;; slot = (slot + 1) & mask) {
+			const Entry& entry = m_pSlots[slot];
+			if (entry.hash == 0) return nullptr;
+			if (entry.hash == hash && entry.nameLength == normalized.size()
+				&& std::memcmp(m_pNames + entry.nameOffset, normalized.data(), normalized.size()) == 0) {
+				return &entry;
+			}
+		}
+	}
+	//-----------------------------------------------------------------------------------------------
+	bool AssetArchiveWriter::add(const std::string& path, bool compress)
+	{
+		std::ifstream file(path, std::ios::ate | std::ios::binary);
+		if (!file.is_open()) return false;
+		Source source{ normalizePath(path), std::vector<char>(static_cast<size_t>(file.tellg())), compress };
+		file.seekg(0);
+		file.read(source.data.data(), source.data.size());
+		if (!file) return false;
+		m_sources.push_back(std::move(source));
+		return true;
+	}
+	//-----------------------------------------------------------------------------------------------
+	uint32_t AssetArchiveWriter::addDirectory(const std::string& directory, bool compress)
+	{
+		std::error_code error;
+		uint32_t added = 0;
+		for (auto it = std::filesystem::recursive_directory_iterator(directory, error); !error && it != std::filesystem::recursive_directory_iterator(); it.increment(error)) {
+			if (it->is_regular_file() && add(it->path().generic_string(), compress)) {
+				++added;
+			}
+		}
+		return added;
+	}
+	//-----------------------------------------------------------------------------------------------
+	bool AssetArchiveWriter::write(const std::string& archivePath) const
+	{
+		using Entry = AssetArchive::Entry;
+		uint32_t slotCount = 2;
+		while (slotCount < m_sources.size() * 2) {
+			slotCount *= 2;
+		}
+		std::vector<Entry> slots(slotCount, Entry{});
+		std::string names;
+		std::vector<std::vector<uint8_t>> stored(m_sources.size());
+		std::vector<Entry> entries(m_sources.size(), Entry{});
+		for (size_t i = 0; i < m_sources.size(); ++i) {
+			const Source& source = m_sources[i];
+			Entry& entry = entries[i];
+			entry.hash = hashPath(source.path);
+			entry.nameOffset = static_cast<uint32_t>(names.size());
+			entry.nameLength = static_cast<uint32_t>(source.path.size());
+			entry.size = source.data.size();
+			entry.storedSize = entry.size;
+			entry.compression = AssetCompression::None;
+			names += source.path;
+			if (source.compress && !source.data.empty()) {
+				std::vector<uint8_t>& compressed = stored[i];
+				compressed.resize(lz4CompressBound(source.data.size()));
+				size_t compressedSize = lz4Compress(reinterpret_cast<const uint8_t*>(source.data.data()), source.data.size(),
+					compressed.data(), compressed.size());
+				if (compressedSize != 0 && compressedSize <= entry.size - entry.size / 8) {
+					compressed.resize(compressedSize);
+					entry.storedSize = compressedSize;
+					entry.compression = AssetCompression::Lz4;
+				}
+				else {
+					compressed.clear();
+				}
+			}
+		}
+		ArchiveHeader header{ ARCHIVE_MAGIC, ARCHIVE_VERSION, static_cast<uint32_t>(m_sources.size()), slotCount, 0, names.size() };
+		header.namesOffset = sizeof(header) + static_cast<uint64_t>(slotCount) * sizeof(Entry);
+		uint64_t offset = alignEntry(header.namesOffset + header.namesSize);
+		for (Entry& entry : entries) {
+			entry.offset = offset;
+			offset = alignEntry(offset + entry.storedSize);
+			uint32_t slot = static_cast<uint32_t>(entry.hash) & (slotCount - 1);
+			while (slots[slot].hash != 0) {
+				slot = (slot + 1) & (slotCount - 1);
+			}
+			slots[slot] = entry;
+		}
+		std::ofstream file(archivePath, std::ios::binary | std::ios::trunc);
+		if (!file.is_open()) return false;
+		file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+		file.write(reinterpret_cast<const char*>(slots.data()), static_cast<std::streamsize>(slots.size() * sizeof(Entry)));
+		file.write(names.data(), static_cast<std::streamsize>(names.size()));
+		const std::vector<char> padding(ENTRY_ALIGNMENT, 0);
+		for (size_t i = 0; i < m_sources.size(); ++i) {
+			const Entry& entry = entries[i];
+			file.write(padding.data(), static_cast<std::streamsize>(entry.offset - static_cast<uint64_t>(file.tellp())));
+			if (entry.compression == AssetCompression::None) {
+				file.write(m_sources[i].data.data(), static_cast<std::streamsize>(entry.size));
+			}
+			else {
+				file.write(reinterpret_cast<const char*>(stored[i].data()), static_cast<std::streamsize>(entry.storedSize));
+			}
+		}
+		return file.good();
+	}
+}
@@ -0,0 +1,330 @@
+#include "AsyncFileReader.h"
+#include <fstream>
+#include <filesystem>
+#if defined(__linux__) && __has_include(<linux/io_uring.h>)
+	#define CLAN_IO_URING 1
+	#include <linux/io_uring.h>
+	#include <sys/mman.h>
+	#include <sys/syscall.h>
+	#include <fcntl.h>
+	#include <unistd.h>
+	#include <cerrno>
+#endif
+
+namespace Clan
+{
+#ifdef CLAN_IO_URING
+	namespace
+	{
+		struct PendingRead {
+			FileReadRequest request;
+			int fd;
+			size_t done;
+		};
+
+		//IORING_OP_READ came with 5.6, older kernels take the ring but fail every read
+		bool supportsRead(int fd)
+		{
+			constexpr uint32_t PROBE_OPS = 256;
+			std::vector<uint64_t> storage((sizeof(io_uring_probe) + PROBE_OPS * sizeof(io_uring_probe_op) + 7) / 8, 0);
+			io_uring_probe* pProbe = reinterpret_cast<io_uring_probe*>(storage.data());
+			if (syscall(__NR_io_uring_register, fd, IORING_REGISTER_PROBE, pProbe, PROBE_OPS) < 0) return false;
+			return IORING_OP_READ < pProbe->ops_len && (pProbe->ops[IORING_OP_READ].flags & IO_URING_OP_SUPPORTED) != 0;
+		}
+	}
+
+	struct AsyncFileReader::Ring {
+		int fd{ -1 };
+		uint8_t* pRings{ nullptr };
+		size_t ringsSize{ 0 };
+		io_uring_sqe* pSqes{ nullptr };
+		size_t sqesSize{ 0 };
+		uint32_t* pSqHead{ nullptr };
+		uint32_t* pSqTail{ nullptr };
+		uint32_t sqMask{ 0 };
+		uint32_t* pSqArray{ nullptr };
+		uint32_t* pCqHead{ nullptr };
+		uint32_t* pCqTail{ nullptr };
+		uint32_t cqMask{ 0 };
+		io_uring_cqe* pCqes{ nullptr };
+		//written to the ring but not yet accepted by the kernel
+		uint32_t unsubmitted{ 0 };
+		//in the kernel
+		uint32_t active{ 0 };
+		//short reads, continued with the next submission
+		std::vector<PendingRead*> continued{};
+
+		static Ring* create(uint32_t entries)
+		{
+			io_uring_params params{};
+			int fd = static_cast<int>(syscall(__NR_io_uring_setup, entries, &params));
+			if (fd < 0) return nullptr;
+			if ((params.features & IORING_FEAT_SINGLE_MMAP) == 0 || !supportsRead(fd)) {
+				close(fd);
+				return nullptr;
+			}
+			size_t sqSize = params.sq_off.array + params.sq_entries * sizeof(uint32_t);
+			size_t cqSize = params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe);
+			size_t ringsSize = sqSize > cqSize ? sqSize : cqSize;
+			void* pRings = mmap(nullptr, ringsSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQ_RING);
+			if (pRings == MAP_FAILED) {
+				close(fd);
+				return nullptr;
+			}
+			size_t sqesSize = params.sq_entries * sizeof(io_uring_sqe);
+			void* pSqes = mmap(nullptr, sqesSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQES);
+			if (pSqes == MAP_FAILED) {
+				munmap(pRings, ringsSize);
+				close(fd);
+				return nullptr;
+			}
+			Ring* pRing = new Ring{};
+			uint8_t* pBytes = static_cast<uint8_t*>(pRings);
+			pRing->fd = fd;
+			pRing->pRings = pBytes;
+			pRing->ringsSize = ringsSize;
+			pRing->pSqes = static_cast<io_uring_sqe*>(pSqes);
+			pRing->sqesSize = sqesSize;
+			pRing->pSqHead = reinterpret_cast<uint32_t*>(pBytes + params.sq_off.head);
+			pRing->pSqTail = reinterpret_cast<uint32_t*>(pBytes + params.sq_off.tail);
+			pRing->sqMask = *reinterpret_cast<uint32_t*>(pBytes + params.sq_off.ring_mask);
+			pRing->pSqArray = reinterpret_cast<uint32_t*>(pBytes + params.sq_off.array);
+			pRing->pCqHead = reinterpret_cast<uint32_t*>(pBytes + params.cq_off.head);
+			pRing->pCqTail = reinterpret_cast<uint32_t*>(pBytes + params.cq_off.tail);
+			pRing->cqMask = *reinterpret_cast<uint32_t*>(pBytes + params.cq_off.ring_mask);
+			pRing->pCqes = reinterpret_cast<io_uring_cqe*>(pBytes + params.cq_off.cqes);
+			return pRing;
+		}
+
+		void release()
+		{
+			munmap(pSqes, sqesSize);
+			munmap(pRings, ringsSize);
+			close(fd);
+		}
+
+		//the kernel reads the tail, so the entry has to be visible before it
+		void push(PendingRead* pRead)
+		{
+			uint32_t tail = *pSqTail;
+			uint32_t index = tail & sqMask;
+			io_uring_sqe& sqe = pSqes[index];
+			sqe = io_uring_sqe{};
+			sqe.opcode = IORING_OP_READ;
+			sqe.fd = pRead->fd;
+			sqe.off = pRead->request.offset + pRead->done;
+			sqe.addr = reinterpret_cast<uint64_t>(static_cast<uint8_t*>(pRead->request.pDst) + pRead->done);
+			size_t remaining = pRead->request.size - pRead->done;
+			//a single read is capped at 2GB anyway
+			sqe.len = static_cast<uint32_t>(remaining < 0x7ffff000u ? remaining : 0x7ffff000u);
+			sqe.user_data = reinterpret_cast<uint64_t>(pRead);
+			pSqArray[index] = index;
+			__atomic_store_n(pSqTail, tail + 1, __ATOMIC_RELEASE);
+			++unsubmitted;
+			++active;
+		}
+
+		int enter(uint32_t minComplete)
+		{
+			uint32_t flags = minComplete > 0 ? IORING_ENTER_GETEVENTS : 0;
+			int submitted = static_cast<int>(syscall(__NR_io_uring_enter, fd, unsubmitted, minComplete, flags, nullptr, 0));
+			if (submitted > 0) unsubmitted -= static_cast<uint32_t>(submitted);
+			return submitted;
+		}
+
+		//only io_uring_enter consumes entries, so the ones it didn't accept can be taken back
+		void takeUnsubmitted(std::vector<PendingRead*>& reads)
+		{
+			uint32_t head = __atomic_load_n(pSqHead, __ATOMIC_ACQUIRE);
+			uint32_t tail = *pSqTail;
+			for (uint32_t i = head; i != tail; ++i) {
+				reads.push_back(reinterpret_cast<PendingRead*>(pSqes[pSqArray[i & sqMask]].user_data));
+			}
+			__atomic_store_n(pSqTail, head, __ATOMIC_RELEASE);
+			active -= tail - head;
+			unsubmitted = 0;
+		}
+	};
+#else
+	struct AsyncFileReader::Ring {};
+#endif
+	//-----------------------------------------------------------------------------------------------
+	void AsyncFileReader::init(ThreadPool* pPool, uint32_t queueDepth)
+	{
+		m_pPool = pPool;
+		m_queueDepth = queueDepth;
+#ifdef CLAN_IO_URING
+		m_pRing = Ring::create(queueDepth);
+#endif
+	}
+	//-----------------------------------------------------------------------------------------------
+	void AsyncFileReader::destroy()
+	{
+		wait();
+#ifdef CLAN_IO_URING
+		if (m_pRing != nullptr) m_pRing->release();
+#endif
+		delete m_pRing;
+		m_pRing = nullptr;
+		m_pPool = nullptr;
+	}
+	//-----------------------------------------------------------------------------------------------
+	void AsyncFileReader::read(FileReadRequest request)
+	{
+		m_queued.push_back(std::move(request));
+	}
+	//-----------------------------------------------------------------------------------------------
+	void AsyncFileReader::submit()
+	{
+		if (m_pRing != nullptr) {
+			submitRing();
+		}
+		else {
+			submitBlocking();
+		}
+	}
+	//-----------------------------------------------------------------------------------------------
+	uint32_t AsyncFileReader::poll()
+	{
+		if (m_pRing != nullptr) {
+			reapRing(false);
+			submitRing();
+		}
+		return runCompletions();
+	}
+	//-----------------------------------------------------------------------------------------------
+	void AsyncFileReader::wait()
+	{
+		while (true) {
+			//the callbacks may queue more reads
+			runCompletions();
+			submit();
+			if (idle()) return;
+			if (m_pRing != nullptr) {
+				reapRing(true);
+			}
+			else {
+				std::unique_lock<std::mutex> lock(m_mutex);
+				m_completionReady.wait(lock, [this]() { return !m_completions.empty(); });
+			}
+		}
+	}
+	//-----------------------------------------------------------------------------------------------
+	uint64_t AsyncFileReader::fileSize(const std::string& path)
+	{
+		std::error_code error;
+		uint64_t size = std::filesystem::file_size(path, error);
+		return error ? 0 : size;
+	}
+	//-----------------------------------------------------------------------------------------------
+	void AsyncFileReader::submitBlocking()
+	{
+		ASSERT(m_pPool != nullptr);
+		while (!m_queued.empty()) {
+			++m_inFlight;
+			m_pPool->submit([this, request = std::move(m_queued.front())]() {
+				size_t bytesRead = 0;
+				bool success = false;
+				std::ifstream file(request.path, std::ios::binary);
+				if (file.is_open() && file.seekg(static_cast<std::streamoff>(request.offset))) {
+					file.read(static_cast<char*>(request.pDst), static_cast<std::streamsize>(request.size));
+					bytesRead = static_cast<size_t>(file.gcount());
+					success = !file.bad();
+				}
+				{
+					std::lock_guard<std::mutex> lock(m_mutex);
+					m_completions.push_back(Completion{ request.onComplete, bytesRead, success });
+				}
+				m_completionReady.notify_one();
+			});
+			m_queued.pop_front();
+		}
+	}
+	//-----------------------------------------------------------------------------------------------
+	void AsyncFileReader::submitRing()
+	{
+#ifdef CLAN_IO_URING
+		Ring& ring = *m_pRing;
+		for (PendingRead* pRead : ring.continued) {
+			ring.push(pRead);
+		}
+		ring.continued.clear();
+		while (!m_queued.empty() && ring.active < m_queueDepth) {
+			FileReadRequest& request = m_queued.front();
+			int fd = open(request.path.c_str(), O_RDONLY | O_CLOEXEC);
+			++m_inFlight;
+			if (fd < 0 || request.size == 0) {
+				if (fd >= 0) close(fd);
+				m_completions.push_back(Completion{ std::move(request.onComplete), 0, fd >= 0 });
+			}
+			else {
+				ring.push(new PendingRead{ std::move(request), fd, 0 });
+			}
+			m_queued.pop_front();
+		}
+		while (ring.unsubmitted > 0) {
+			if (ring.enter(0) < 0 && errno != EINTR && errno != EAGAIN && errno != EBUSY) {
+				//the kernel won't take them, they fail now rather than leave wait() waiting for them
+				std::vector<PendingRead*> failed;
+				ring.takeUnsubmitted(failed);
+				for (PendingRead* pRead : failed) {
+					close(pRead->fd);
+					m_completions.push_back(Completion{ std::move(pRead->request.onComplete), pRead->done, false });
+					delete pRead;
+				}
+				break;
+			}
+			if (ring.unsubmitted > 0) reapRing(true);
+		}
+#endif
+	}
+	//-----------------------------------------------------------------------------------------------
+	void AsyncFileReader::reapRing(bool block)
+	{
+#ifdef CLAN_IO_URING
+		Ring& ring = *m_pRing;
+		if (block && ring.active > 0 && __atomic_load_n(ring.pCqTail, __ATOMIC_ACQUIRE) == *ring.pCqHead) {
+			ring.enter(1);
+		}
+		uint32_t head = *ring.pCqHead;
+		uint32_t tail = __atomic_load_n(ring.pCqTail, __ATOMIC_ACQUIRE);
+		for (; head != tail; ++head) {
+			const io_uring_cqe& cqe = ring.pCqes[head & ring.cqMask];
+			PendingRead* pRead = reinterpret_cast<PendingRead*>(cqe.user_data);
+			--ring.active;
+			if (cqe.res == -EINTR || cqe.res == -EAGAIN) {
+				ring.continued.push_back(pRead);
+				continue;
+			}
+			if (cqe.res > 0) {
+				pRead->done += static_cast<size_t>(cqe.res);
+				if (pRead->done < pRead->request.size) {
+					ring.continued.push_back(pRead);
+					continue;
+				}
+			}
+			//0 is the end of the file
+			close(pRead->fd);
+			m_completions.push_back(Completion{ std::move(pRead->request.onComplete), pRead->done, cqe.res >= 0 });
+			delete pRead;
+		}
+		__atomic_store_n(ring.pCqHead, head, __ATOMIC_RELEASE);
+#else
+		(void)block;
+#endif
+	}
+	//-----------------------------------------------------------------------------------------------
+	uint32_t AsyncFileReader::runCompletions()
+	{
+		std::vector<Completion> completions;
+		{
+			std::lock_guard<std::mutex> lock(m_mutex);
+			completions.swap(m_completions);
+		}
+		m_inFlight -= static_cast<uint32_t>(completions.size());
+		for (Completion& completion : completions) {
+			if (completion.onComplete) completion.onComplete(completion.bytesRead, completion.success);
+		}
+		return static_cast<uint32_t>(completions.size());
+	}
+}
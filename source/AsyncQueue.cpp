@@ -0,0 +1,262 @@
+#include <algorithm>
+#include "AsyncQueue.h"
+#include "MemoryTracker.h"
+
+namespace Clan
+{
+	void AsyncQueue::init(VkDevice device, VkQueue queue, uint32_t queueFamily, FrameScheduler* pGraphics,
+		uint32_t graphicsFamily, VkPipelineStageFlags workStages)
+	{
+		m_device = device;
+		m_family = queueFamily;
+		m_pGraphics = pGraphics;
+		m_graphicsFamily = graphicsFamily;
+		m_workStages = workStages;
+		m_timeline.init(device, queue);
+
+		VkCommandPoolCreateInfo poolInfo{};
+		poolInfo.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+		poolInfo.flags = VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT | VK_COMMAND_POOL_CREATE_TRANSIENT_BIT;
+		poolInfo.queueFamilyIndex = queueFamily;
+		VkResult result = vkCreateCommandPool(m_device, &poolInfo, vulkanAllocator(), &m_commandPool);
+		ASSERT(result == VK_SUCCESS);
+	}
+	//-----------------------------------------------------------------------------------------------
+	void AsyncQueue::destroy()
+	{
+		m_timeline.wait(m_timeline.lastSubmitted());
+		vkDestroyCommandPool(m_device, m_commandPool, vulkanAllocator());
+		m_timeline.destroy();
+		m_inFlight.clear();
+		m_freeCommandBuffers.clear();
+		m_pendingBuffers.clear();
+		m_pendingImages.clear();
+		m_incoming.clear();
+		m_graphicsUse.clear();
+	}
+	//-----------------------------------------------------------------------------------------------
+	uint64_t AsyncQueue::submit(const RecordFunc& record,
+		const std::vector<BufferHandoff>& buffers, const std::vector<ImageHandoff>& images)
+	{
+		uint64_t value = submitWork(record, m_graphicsFamily, buffers, images);
+		m_pendingBuffers.insert(m_pendingBuffers.end(), buffers.begin(), buffers.end());
+		m_pendingImages.insert(m_pendingImages.end(), images.begin(), images.end());
+		m_pendingValue = value;
+		return value;
+	}
+	//-----------------------------------------------------------------------------------------------
+	uint64_t AsyncQueue::submitTo(AsyncQueue& consumer, const RecordFunc& record,
+		const std::vector<BufferHandoff>& buffers, const std::vector<ImageHandoff>& images)
+	{
+		uint64_t value = submitWork(record, consumer.m_family, buffers, images);
+		consumer.m_incoming.push_back({ m_family, m_timeline.handle(), value, buffers, images });
+		return value;
+	}
+	//-----------------------------------------------------------------------------------------------
+	uint64_t AsyncQueue::submitWork(const RecordFunc& record, uint32_t dstFamily,
+		const std::vector<BufferHandoff>& buffers, const std::vector<ImageHandoff>& images)
+	{
+		VkCommandBuffer commandBuffer = acquireCommandBuffer();
+		VkCommandBufferBeginInfo beginInfo{};
+		beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+		beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+		VkResult beginResult = vkBeginCommandBuffer(commandBuffer, &beginInfo);
+		ASSERT(beginResult == VK_SUCCESS);
+
+		//acquire what other async queues handed over, after waiting for them like the graphics side does
+		std::vector<SemaphoreWait> waits{};
+		std::vector<VkBufferMemoryBarrier> bufferBarriers{};
+		std::vector<VkImageMemoryBarrier> imageBarriers{};
+		VkPipelineStageFlags acquireStages = 0;
+		for (const auto& incoming : m_incoming) {
+			VkPipelineStageFlags stages = 0;
+			for (const auto& handoff : incoming.buffers) {
+				stages |= handoff.dstStage;
+				if (incoming.family == m_family) continue;
+				VkBufferMemoryBarrier barrier{};
+				barrier.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER;
+				barrier.srcAccessMask = 0;
+				barrier.dstAccessMask = handoff.dstAccess;
+				barrier.srcQueueFamilyIndex = incoming.family;
+				barrier.dstQueueFamilyIndex = m_family;
+				barrier.buffer = handoff.buffer;
+				barrier.offset = handoff.offset;
+				barrier.size = handoff.size;
+				bufferBarriers.push_back(barrier);
+			}
+			for (const auto& handoff : incoming.images) {
+				stages |= handoff.dstStage;
+				if (incoming.family == m_family) continue;
+				VkImageMemoryBarrier barrier{};
+				barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+				barrier.srcAccessMask = 0;
+				barrier.dstAccessMask = handoff.dstAccess;
+				barrier.oldLayout = handoff.layout;
+				barrier.newLayout = handoff.layout;
+				barrier.srcQueueFamilyIndex = incoming.family;
+				barrier.dstQueueFamilyIndex = m_family;
+				barrier.image = handoff.image;
+				barrier.subresourceRange = handoff.range;
+				imageBarriers.push_back(barrier);
+			}
+			acquireStages |= stages;
+			waits.push_back({ incoming.semaphore, incoming.value, stages });
+		}
+		m_incoming.clear();
+		if (!bufferBarriers.empty() || !imageBarriers.empty()) {
+			vkCmdPipelineBarrier(commandBuffer,
+				acquireStages, acquireStages,
+				0,
+				0, nullptr,
+				static_cast<uint32_t>(bufferBarriers.size()), bufferBarriers.data(),
+				static_cast<uint32_t>(imageBarriers.size()), imageBarriers.data());
+		}
+
+		record(commandBuffer);
+
+		//release the written resources to the consuming family, the consumer records the matching acquire.
+		//The previous contents are overwritten, so no release from graphics to us is needed.
+		bufferBarriers.clear();
+		imageBarriers.clear();
+		uint64_t graphicsWait = 0;
+		for (const auto& handoff : buffers) {
+			graphicsWait = std::max(graphicsWait, lastGraphicsUse((uint64_t)handoff.buffer));
+			if (dstFamily == m_family) continue;
+			VkBufferMemoryBarrier barrier{};
+			barrier.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER;
+			barrier.srcAccessMask = VK_ACCESS_MEMORY_WRITE_BIT;
+			barrier.dstAccessMask = 0;
+			barrier.srcQueueFamilyIndex = m_family;
+			barrier.dstQueueFamilyIndex = dstFamily;
+			barrier.buffer = handoff.buffer;
+			barrier.offset = handoff.offset;
+			barrier.size = handoff.size;
+			bufferBarriers.push_back(barrier);
+		}
+		for (const auto& handoff : images) {
+			graphicsWait = std::max(graphicsWait, lastGraphicsUse((uint64_t)handoff.image));
+			if (dstFamily == m_family) continue;
+			VkImageMemoryBarrier barrier{};
+			barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+			barrier.srcAccessMask = VK_ACCESS_MEMORY_WRITE_BIT;
+			barrier.dstAccessMask = 0;
+			barrier.oldLayout = handoff.layout;
+			barrier.newLayout = handoff.layout;
+			barrier.srcQueueFamilyIndex = m_family;
+			barrier.dstQueueFamilyIndex = dstFamily;
+			barrier.image = handoff.image;
+			barrier.subresourceRange = handoff.range;
+			imageBarriers.push_back(barrier);
+		}
+		if (!bufferBarriers.empty() || !imageBarriers.empty()) {
+			vkCmdPipelineBarrier(commandBuffer,
+				m_workStages, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT,
+				0,
+				0, nullptr,
+				static_cast<uint32_t>(bufferBarriers.size()), bufferBarriers.data(),
+				static_cast<uint32_t>(imageBarriers.size()), imageBarriers.data());
+		}
+		VkResult endResult = vkEndCommandBuffer(commandBuffer);
+		ASSERT(endResult == VK_SUCCESS);
+
+		//don't overwrite what a graphics frame still reads
+		if (graphicsWait > 0) {
+			waits.push_back({ m_pGraphics->timeline().handle(), graphicsWait, m_workStages });
+		}
+		uint64_t value = m_timeline.submit(&commandBuffer, 1, waits);
+		m_inFlight.push_back({ commandBuffer, value });
+		return value;
+	}
+	//-----------------------------------------------------------------------------------------------
+	void AsyncQueue::acquireOnGraphics(VkCommandBuffer graphicsCommandBuffer)
+	{
+		if (m_pendingBuffers.empty() && m_pendingImages.empty()) return;
+		//the frame being recorded is the next one the graphics timeline will signal
+		uint64_t frameValue = m_pGraphics->timeline().lastSubmitted() + 1;
+		VkPipelineStageFlags dstStages = 0;
+		std::vector<VkBufferMemoryBarrier> bufferBarriers{};
+		std::vector<VkImageMemoryBarrier> imageBarriers{};
+		for (const auto& handoff : m_pendingBuffers) {
+			dstStages |= handoff.dstStage;
+			m_graphicsUse[(uint64_t)handoff.buffer] = frameValue;
+			if (!isDedicated()) continue;
+			VkBufferMemoryBarrier barrier{};
+			barrier.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER;
+			barrier.srcAccessMask = 0;
+			barrier.dstAccessMask = handoff.dstAccess;
+			barrier.srcQueueFamilyIndex = m_family;
+			barrier.dstQueueFamilyIndex = m_graphicsFamily;
+			barrier.buffer = handoff.buffer;
+			barrier.offset = handoff.offset;
+			barrier.size = handoff.size;
+			bufferBarriers.push_back(barrier);
+		}
+		for (const auto& handoff : m_pendingImages) {
+			dstStages |= handoff.dstStage;
+			m_graphicsUse[(uint64_t)handoff.image] = frameValue;
+			if (!isDedicated()) continue;
+			VkImageMemoryBarrier barrier{};
+			barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+			barrier.srcAccessMask = 0;
+			barrier.dstAccessMask = handoff.dstAccess;
+			barrier.oldLayout = handoff.layout;
+			barrier.newLayout = handoff.layout;
+			barrier.srcQueueFamilyIndex = m_family;
+			barrier.dstQueueFamilyIndex = m_graphicsFamily;
+			barrier.image = handoff.image;
+			barrier.subresourceRange = handoff.range;
+			imageBarriers.push_back(barrier);
+		}
+		//the source scope is the stages the semaphore wait below blocks, so the acquire (and any
+		//layout transition in it) is ordered after the wait
+		if (!bufferBarriers.empty() || !imageBarriers.empty()) {
+			vkCmdPipelineBarrier(graphicsCommandBuffer,
+				dstStages, dstStages,
+				0,
+				0, nullptr,
+				static_cast<uint32_t>(bufferBarriers.size()), bufferBarriers.data(),
+				static_cast<uint32_t>(imageBarriers.size()), imageBarriers.data());
+		}
+		//the semaphore wait also makes the async writes visible to the consuming stages
+		m_pGraphics->addWait(m_timeline.handle(), m_pendingValue, dstStages);
+		m_pendingBuffers.clear();
+		m_pendingImages.clear();
+	}
+	//-----------------------------------------------------------------------------------------------
+	VkCommandBuffer AsyncQueue::acquireCommandBuffer()
+	{
+		//recycle the command buffers of completed submissions
+		uint64_t completed = m_timeline.completedValue();
+		auto done = std::partition(m_inFlight.begin(), m_inFlight.end(),
+			[completed](const InFlightCommandBuffer& entry) { return entry.value > completed; });
+		for (auto it = done; it != m_inFlight.end(); ++it) {
+			vkResetCommandBuffer(it->commandBuffer, 0);
+			m_freeCommandBuffers.push_back(it->commandBuffer);
+		}
+		m_inFlight.erase(done, m_inFlight.end());
+		//forget graphics uses that are already finished
+		uint64_t graphicsCompleted = m_pGraphics->completedValue();
+		std::erase_if(m_graphicsUse, [graphicsCompleted](const auto& entry) { return entry.second <= graphicsCompleted; });
+
+		if (!m_freeCommandBuffers.empty()) {
+			VkCommandBuffer commandBuffer = m_freeCommandBuffers.back();
+			m_freeCommandBuffers.pop_back();
+			return commandBuffer;
+		}
+		VkCommandBufferAllocateInfo allocInfo{};
+		allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+		allocInfo.commandPool = m_commandPool;
+		allocInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+		allocInfo.commandBufferCount = 1;
+		VkCommandBuffer commandBuffer{};
+		VkResult result = vkAllocateCommandBuffers(m_device, &allocInfo, &commandBuffer);
+		ASSERT(result == VK_SUCCESS);
+		return commandBuffer;
+	}
+	//-----------------------------------------------------------------------------------------------
+	uint64_t AsyncQueue::lastGraphicsUse(uint64_t handle) const
+	{
+		auto it = m_graphicsUse.find(handle);
+		return it == m_graphicsUse.end() ? 0 : it->second;
+	}
+}
@@ -0,0 +1,418 @@
+#include <algorithm>
+#include <numeric>
+#include <future>
+#include <limits>
+#include <cmath>
+#include "Bvh.h"
+
+#if defined(_M_X64) || defined(_M_IX86) || defined(__x86_64__) || defined(__i386__)
+	#define CLAN_X86
+	#include <xmmintrin.h>
+#endif
+
+namespace Clan
+{
+	namespace
+	{
+		constexpr uint32_t MAX_LEAF_OBJECTS = 4;
+		constexpr uint32_t SAH_BINS = 16;
+		constexpr uint32_t INVALID_CHILD = ~0u;
+		constexpr float FLOAT_MAX = std::numeric_limits<float>::max();
+
+		float halfArea(const glm::vec3& min, const glm::vec3& max)
+		{
+			glm::vec3 d = glm::max(max - min, glm::vec3(0.0f));
+			return d.x * d.y + d.y * d.z + d.z * d.x;
+		}
+		//-------------------------------------------------------------------------------------------
+		bool intersectsFrustum(const Frustum& frustum, const glm::vec3& min, const glm::vec3& max)
+		{
+			glm::vec3 center = (min + max) * 0.5f;
+			glm::vec3 extent = (max - min) * 0.5f;
+			for (const glm::vec4& plane : frustum.planes) {
+				if (glm::dot(glm::vec3(plane), center) + plane.w + glm::dot(glm::abs(glm::vec3(plane)), extent) < 0.0f) {
+					return false;
+				}
+			}
+			return true;
+		}
+		//-------------------------------------------------------------------------------------------
+		bool intersectsRay(const glm::vec3& origin, const glm::vec3& inverseDirection, float maxDistance,
+			const glm::vec3& min, const glm::vec3& max, float& distance)
+		{
+			glm::vec3 t1 = (min - origin) * inverseDirection;
+			glm::vec3 t2 = (max - origin) * inverseDirection;
+			glm::vec3 tNear = glm::min(t1, t2);
+			glm::vec3 tFar = glm::max(t1, t2);
+			float enter = std::max(std::max(tNear.x, tNear.y), std::max(tNear.z, 0.0f));
+			float exit = std::min(std::min(tFar.x, tFar.y), std::min(tFar.z, maxDistance));
+			distance = enter;
+			return enter <= exit;
+		}
+		//-------------------------------------------------------------------------------------------
+		//Bit i is set when box i intersects the frustum, 'insideMask' gets the boxes fully inside
+		uint32_t testFrustum(const BvhNode& node, const Frustum& frustum, uint32_t& insideMask)
+		{
+#ifdef CLAN_X86
+			const __m128 half = _mm_set1_ps(0.5f);
+			const __m128 zero = _mm_setzero_ps();
+			__m128 minX = _mm_loadu_ps(node.minX), minY = _mm_loadu_ps(node.minY), minZ = _mm_loadu_ps(node.minZ);
+			__m128 maxX = _mm_loadu_ps(node.maxX), maxY = _mm_loadu_ps(node.maxY), maxZ = _mm_loadu_ps(node.maxZ);
+			__m128 cx = _mm_mul_ps(_mm_add_ps(minX, maxX), half);
+			__m128 cy = _mm_mul_ps(_mm_add_ps(minY, maxY), half);
+			__m128 cz = _mm_mul_ps(_mm_add_ps(minZ, maxZ), half);
+			__m128 ex = _mm_mul_ps(_mm_sub_ps(maxX, minX), half);
+			__m128 ey = _mm_mul_ps(_mm_sub_ps(maxY, minY), half);
+			__m128 ez = _mm_mul_ps(_mm_sub_ps(maxZ, minZ), half);
+			__m128 intersect = _mm_cmpeq_ps(zero, zero);
+			__m128 inside = intersect;
+			for (const glm::vec4& plane : frustum.planes) {
+				__m128 distance = _mm_add_ps(_mm_add_ps(_mm_mul_ps(_mm_set1_ps(plane.x), cx), _mm_mul_ps(_mm_set1_ps(plane.y), cy)),
+					_mm_add_ps(_mm_mul_ps(_mm_set1_ps(plane.z), cz), _mm_set1_ps(plane.w)));
+				__m128 radius = _mm_add_ps(_mm_add_ps(_mm_mul_ps(_mm_set1_ps(std::abs(plane.x)), ex), _mm_mul_ps(_mm_set1_ps(std::abs(plane.y)), ey)),
+					_mm_mul_ps(_mm_set1_ps(std::abs(plane.z)), ez));
+				intersect = _mm_and_ps(intersect, _mm_cmpge_ps(_mm_add_ps(distance, radius), zero));
+				inside = _mm_and_ps(inside, _mm_cmpge_ps(_mm_sub_ps(distance, radius), zero));
+			}
+			insideMask = static_cast<uint32_t>(_mm_movemask_ps(inside));
+			return static_cast<uint32_t>(_mm_movemask_ps(intersect));
+#else
+			uint32_t mask = 0;
+			insideMask = 0;
+			for (uint32_t i = 0; i < 4; ++i) {
+				glm::vec3 center(node.minX[i] + node.maxX[i], node.minY[i] + node.maxY[i], node.minZ[i] + node.maxZ[i]);
+				glm::vec3 extent(node.maxX[i] - node.minX[i], node.maxY[i] - node.minY[i], node.maxZ[i] - node.minZ[i]);
+				center *= 0.5f;
+				extent *= 0.5f;
+				bool intersect = true, inside = true;
+				for (const glm::vec4& plane : frustum.planes) {
+					float distance = glm::dot(glm::vec3(plane), center) + plane.w;
+					float radius = glm::dot(glm::abs(glm::vec3(plane)), extent);
+					intersect = intersect && distance + radius >= 0.0f;
+					inside = inside && distance - radius >= 0.0f;
+				}
+				mask |= intersect ? 1u << i : 0u;
+				insideMask |= inside ? 1u << i : 0u;
+			}
+			return mask;
+#endif
+		}
+		//-------------------------------------------------------------------------------------------
+		//Bit i is set when the ray enters box i before 'maxDistance', at distance[i]
+		uint32_t testRay(const BvhNode& node, const glm::vec3& origin, const glm::vec3& inverseDirection, float maxDistance, float distance[4])
+		{
+#ifdef CLAN_X86
+			__m128 ox = _mm_set1_ps(origin.x), oy = _mm_set1_ps(origin.y), oz = _mm_set1_ps(origin.z);
+			__m128 ix = _mm_set1_ps(inverseDirection.x), iy = _mm_set1_ps(inverseDirection.y), iz = _mm_set1_ps(inverseDirection.z);
+			__m128 x1 = _mm_mul_ps(_mm_sub_ps(_mm_loadu_ps(node.minX), ox), ix);
+			__m128 x2 = _mm_mul_ps(_mm_sub_ps(_mm_loadu_ps(node.maxX), ox), ix);
+			__m128 y1 = _mm_mul_ps(_mm_sub_ps(_mm_loadu_ps(node.minY), oy), iy);
+			__m128 y2 = _mm_mul_ps(_mm_sub_ps(_mm_loadu_ps(node.maxY), oy), iy);
+			__m128 z1 = _mm_mul_ps(_mm_sub_ps(_mm_loadu_ps(node.minZ), oz), iz);
+			__m128 z2 = _mm_mul_ps(_mm_sub_ps(_mm_loadu_ps(node.maxZ), oz), iz);
+			__m128 enter = _mm_max_ps(_mm_max_ps(_mm_min_ps(x1, x2), _mm_min_ps(y1, y2)), _mm_max_ps(_mm_min_ps(z1, z2), _mm_setzero_ps()));
+			__m128 exit = _mm_min_ps(_mm_min_ps(_mm_max_ps(x1, x2), _mm_max_ps(y1, y2)), _mm_min_ps(_mm_max_ps(z1, z2), _mm_set1_ps(maxDistance)));
+			_mm_storeu_ps(distance, enter);
+			return static_cast<uint32_t>(_mm_movemask_ps(_mm_cmple_ps(enter, exit)));
+#else
+			uint32_t mask = 0;
+			for (uint32_t i = 0; i < 4; ++i) {
+				glm::vec3 min(node.minX[i], node.minY[i], node.minZ[i]);
+				glm::vec3 max(node.maxX[i], node.maxY[i], node.maxZ[i]);
+				mask |= intersectsRay(origin, inverseDirection, maxDistance, min, max, distance[i]) ? 1u << i : 0u;
+			}
+			return mask;
+#endif
+		}
+	}
+	//-----------------------------------------------------------------------------------------------
+	void Bvh::build(const BoundsArrays& bounds, uint32_t parallelThreshold)
+	{
+		uint32_t count = static_cast<uint32_t>(bounds.size());
+		m_objects.resize(count);
+		std::iota(m_objects.begin(), m_objects.end(), 0u);
+		m_objectMin.resize(count);
+		m_objectMax.resize(count);
+		//the old nodes don't match the new objects, only the object boxes are needed before the build
+		m_nodes.clear();
+		refit(bounds);
+		if (count == 0) return;
+		//every inner node has at least two children, so there are fewer nodes than objects
+		m_nodes.resize(count);
+		m_nodeCount = 0;
+		buildNode(0, count, std::max(parallelThreshold, MAX_LEAF_OBJECTS + 1));
+		m_nodes.resize(m_nodeCount);
+	}
+	//-----------------------------------------------------------------------------------------------
+	void Bvh::refit(const BoundsArrays& bounds)
+	{
+		ASSERT(bounds.size() == m_objectMin.size());
+		for (size_t i = 0; i < m_objectMin.size(); ++i) {
+			glm::vec3 center(bounds.centerX[i], bounds.centerY[i], bounds.centerZ[i]);
+			glm::vec3 extent(bounds.extentX[i], bounds.extentY[i], bounds.extentZ[i]);
+			m_objectMin[i] = center - extent;
+			m_objectMax[i] = center + extent;
+		}
+		//children are always allocated after their parent, walking backwards visits them first
+		for (size_t n = m_nodes.size(); n-- > 0;) {
+			BvhNode& node = m_nodes[n];
+			for (uint32_t slot = 0; slot < 4; ++slot) {
+				if (node.child[slot] == INVALID_CHILD) continue;
+				glm::vec3 min(FLOAT_MAX), max(-FLOAT_MAX);
+				if (node.count[slot] > 0) {
+					for (uint32_t i = node.child[slot]; i < node.child[slot] + node.count[slot]; ++i) {
+						min = glm::min(min, m_objectMin[m_objects[i]]);
+						max = glm::max(max, m_objectMax[m_objects[i]]);
+					}
+				}
+				else {
+					const BvhNode& child = m_nodes[node.child[slot]];
+					for (uint32_t c = 0; c < 4; ++c) {
+						if (child.child[c] == INVALID_CHILD) continue;
+						min = glm::min(min, glm::vec3(child.minX[c], child.minY[c], child.minZ[c]));
+						max = glm::max(max, glm::vec3(child.maxX[c], child.maxY[c], child.maxZ[c]));
+					}
+				}
+				node.minX[slot] = min.x; node.minY[slot] = min.y; node.minZ[slot] = min.z;
+				node.maxX[slot] = max.x; node.maxY[slot] = max.y; node.maxZ[slot] = max.z;
+			}
+		}
+	}
+	//-----------------------------------------------------------------------------------------------
+	void Bvh::clear()
+	{
+		m_nodes.clear();
+		m_objects.clear();
+		m_objectMin.clear();
+		m_objectMax.clear();
+	}
+	//-----------------------------------------------------------------------------------------------
+	size_t Bvh::cullFrustum(const Frustum& frustum, std::vector<uint32_t>& visible) const
+	{
+		size_t first = visible.size();
+		if (m_nodes.empty()) return 0;
+		uint32_t stack[256];
+		uint32_t stackSize = 0;
+		stack[stackSize++] = 0;
+		while (stackSize > 0) {
+			const BvhNode& node = m_nodes[stack[--stackSize]];
+			uint32_t insideMask = 0;
+			uint32_t mask = testFrustum(node, frustum, insideMask);
+			for (uint32_t slot = 0; slot < 4; ++slot) {
+				if (!(mask & (1u << slot)) || node.child[slot] == INVALID_CHILD) continue;
+				bool inside = (insideMask & (1u << slot)) != 0;
+				if (node.count[slot] > 0) {
+					for (uint32_t i = node.child[slot]; i < node.child[slot] + node.count[slot]; ++i) {
+						uint32_t object = m_objects[i];
+						if (inside || intersectsFrustum(frustum, m_objectMin[object], m_objectMax[object])) {
+							visible.push_back(object);
+						}
+					}
+				}
+				else if (inside) {
+					appendSubtree(node.child[slot], visible);
+				}
+				else {
+					ASSERT(stackSize < 256);
+					stack[stackSize++] = node.child[slot];
+				}
+			}
+		}
+		return visible.size() - first;
+	}
+	//-----------------------------------------------------------------------------------------------
+	bool Bvh::raycast(const Ray& ray, float maxDistance, RayHit& hit) const
+	{
+		if (m_nodes.empty()) return false;
+		//keep the slabs finite for axis aligned rays
+		glm::vec3 direction = ray.direction;
+		for (int axis = 0; axis < 3; ++axis) {
+			if (std::abs(direction[axis]) < 1e-20f) direction[axis] = std::copysign(1e-20f, direction[axis]);
+		}
+		glm::vec3 inverseDirection = 1.0f / direction;
+		float closest = maxDistance;
+		hit.object = ~0u;
+		struct Entry {
+			uint32_t node;
+			float distance;
+		};
+		Entry stack[256];
+		uint32_t stackSize = 0;
+		stack[stackSize++] = { 0, 0.0f };
+		while (stackSize > 0) {
+			Entry entry = stack[--stackSize];
+			if (entry.distance > closest) continue;
+			const BvhNode& node = m_nodes[entry.node];
+			float distance[4];
+			uint32_t mask = testRay(node, ray.origin, inverseDirection, closest, distance);
+			Entry children[4];
+			uint32_t childCount = 0;
+			for (uint32_t slot = 0; slot < 4; ++slot) {
+				if (!(mask & (1u << slot)) || node.child[slot] == INVALID_CHILD) continue;
+				if (node.count[slot] > 0) {
+					for (uint32_t i = node.child[slot]; i < node.child[slot] + node.count[slot]; ++i) {
+						uint32_t object = m_objects[i];
+						float objectDistance;
+						if (intersectsRay(ray.origin, inverseDirection, closest, m_objectMin[object], m_objectMax[object], objectDistance)) {
+							closest = objectDistance;
+							hit.object = object;
+						}
+					}
+				}
+				else {
+					children[childCount++] = { node.child[slot], distance[slot] };
+				}
+			}
+			//the nearest child is popped first, it's likely to shorten the ray for the others
+			for (uint32_t c = 1; c < childCount; ++c) {
+				for (uint32_t k = c; k > 0 && children[k - 1].distance < children[k].distance; --k) {
+					std::swap(children[k - 1], children[k]);
+				}
+			}
+			for (uint32_t c = 0; c < childCount; ++c) {
+				ASSERT(stackSize < 256);
+				stack[stackSize++] = children[c];
+			}
+		}
+		hit.distance = closest;
+		return hit.object != ~0u;
+	}
+	//-----------------------------------------------------------------------------------------------
+	uint32_t Bvh::buildNode(uint32_t begin, uint32_t end, uint32_t parallelThreshold)
+	{
+		uint32_t nodeIndex = m_nodeCount.fetch_add(1);
+		//split the largest range until there is one per child
+		Range ranges[4] = { { begin, end } };
+		uint32_t rangeCount = 1;
+		while (rangeCount < 4) {
+			uint32_t largest = 0;
+			for (uint32_t r = 1; r < rangeCount; ++r) {
+				if (ranges[r].end - ranges[r].begin > ranges[largest].end - ranges[largest].begin) largest = r;
+			}
+			Range range = ranges[largest];
+			if (range.end - range.begin <= MAX_LEAF_OBJECTS) break;
+			uint32_t middle = split(range.begin, range.end);
+			ranges[largest] = { range.begin, middle };
+			ranges[rangeCount++] = { middle, range.end };
+		}
+		BvhNode node{};
+		std::future<uint32_t> children[4];
+		for (uint32_t slot = 0; slot < 4; ++slot) {
+			node.child[slot] = INVALID_CHILD;
+			node.count[slot] = 0;
+			node.minX[slot] = node.minY[slot] = node.minZ[slot] = FLOAT_MAX;
+			node.maxX[slot] = node.maxY[slot] = node.maxZ[slot] = -FLOAT_MAX;
+			if (slot >= rangeCount) continue;
+			Range range = ranges[slot];
+			glm::vec3 min(FLOAT_MAX), max(-FLOAT_MAX);
+			for (uint32_t i = range.begin; i < range.end; ++i) {
+				min = glm::min(min, m_objectMin[m_objects[i]]);
+				max = glm::max(max, m_objectMax[m_objects[i]]);
+			}
+			node.minX[slot] = min.x; node.minY[slot] = min.y; node.minZ[slot] = min.z;
+			node.maxX[slot] = max.x; node.maxY[slot] = max.y; node.maxZ[slot] = max.z;
+			uint32_t count = range.end - range.begin;
+			if (count <= MAX_LEAF_OBJECTS) {
+				node.child[slot] = range.begin;
+				node.count[slot] = count;
+			}
+			else if (count > parallelThreshold) {
+				//the ranges are disjoint and the node storage never moves, so subtrees don't share data
+				children[slot] = std::async(std::launch::async, &Bvh::buildNode, this, range.begin, range.end, parallelThreshold);
+			}
+			else {
+				node.child[slot] = buildNode(range.begin, range.end, parallelThreshold);
+			}
+		}
+		for (uint32_t slot = 0; slot < rangeCount; ++slot) {
+			if (children[slot].valid()) node.child[slot] = children[slot].get();
+		}
+		m_nodes[nodeIndex] = node;
+		return nodeIndex;
+	}
+	//-----------------------------------------------------------------------------------------------
+	uint32_t Bvh::split(uint32_t begin, uint32_t end)
+	{
+		glm::vec3 centroidMin(FLOAT_MAX), centroidMax(-FLOAT_MAX);
+		for (uint32_t i = begin; i < end; ++i) {
+			glm::vec3 centroid = m_objectMin[m_objects[i]] + m_objectMax[m_objects[i]];
+			centroidMin = glm::min(centroidMin, centroid);
+			centroidMax = glm::max(centroidMax, centroid);
+		}
+		struct Bin {
+			uint32_t count{ 0 };
+			glm::vec3 min{ FLOAT_MAX };
+			glm::vec3 max{ -FLOAT_MAX };
+		};
+		float bestCost = FLOAT_MAX;
+		int bestAxis = -1;
+		uint32_t bestBin = 0;
+		for (int axis = 0; axis < 3; ++axis) {
+			float extent = centroidMax[axis] - centroidMin[axis];
+			if (extent <= 0.0f) continue;
+			float scale = SAH_BINS * 0.99999f / extent;
+			Bin bins[SAH_BINS];
+			for (uint32_t i = begin; i < end; ++i) {
+				uint32_t object = m_objects[i];
+				float centroid = m_objectMin[object][axis] + m_objectMax[object][axis];
+				uint32_t b = std::min(SAH_BINS - 1, static_cast<uint32_t>((centroid - centroidMin[axis]) * scale));
+				bins[b].count++;
+				bins[b].min = glm::min(bins[b].min, m_objectMin[object]);
+				bins[b].max = glm::max(bins[b].max, m_objectMax[object]);
+			}
+			//sweep from the right once, then evaluate every plane sweeping from the left
+			float rightArea[SAH_BINS];
+			uint32_t rightCount[SAH_BINS];
+			Bin accumulated;
+			for (uint32_t b = SAH_BINS - 1; b > 0; --b) {
+				accumulated.count += bins[b].count;
+				accumulated.min = glm::min(accumulated.min, bins[b].min);
+				accumulated.max = glm::max(accumulated.max, bins[b].max);
+				rightArea[b] = halfArea(accumulated.min, accumulated.max);
+				rightCount[b] = accumulated.count;
+			}
+			accumulated = Bin{};
+			for (uint32_t b = 0; b + 1 < SAH_BINS; ++b) {
+				accumulated.count += bins[b].count;
+				accumulated.min = glm::min(accumulated.min, bins[b].min);
+				accumulated.max = glm::max(accumulated.max, bins[b].max);
+				if (accumulated.count == 0 || rightCount[b + 1] == 0) continue;
+				float cost = accumulated.count * halfArea(accumulated.min, accumulated.max) + rightCount[b + 1] * rightArea[b + 1];
+				if (cost < bestCost) {
+					bestCost = cost;
+					bestAxis = axis;
+					bestBin = b;
+				}
+			}
+		}
+		uint32_t middle = (begin + end) / 2;
+		if (bestAxis >= 0) {
+			float scale = SAH_BINS * 0.99999f / (centroidMax[bestAxis] - centroidMin[bestAxis]);
+			float minimum = centroidMin[bestAxis];
+			auto it = std::partition(m_objects.begin() + begin, m_objects.begin() + end, [&](uint32_t object) {
+				float centroid = m_objectMin[object][bestAxis] + m_objectMax[object][bestAxis];
+				return std::min(SAH_BINS - 1, static_cast<uint32_t>((centroid - minimum) * scale)) <= bestBin;
+			});
+			middle = static_cast<uint32_t>(it - m_objects.begin());
+		}
+		//all centroids in one place, any split is as good as another
+		if (middle == begin || middle == end) middle = (begin + end) / 2;
+		return middle;
+	}
+	//-----------------------------------------------------------------------------------------------
+	void Bvh::appendSubtree(uint32_t nodeIndex, std::vector<uint32_t>& visible) const
+	{
+		const BvhNode& node = m_nodes[nodeIndex];
+		for (uint32_t slot = 0; slot < 4; ++slot) {
+			if (node.child[slot] == INVALID_CHILD) continue;
+			if (node.count[slot] > 0) {
+				for (uint32_t i = node.child[slot]; i < node.child[slot] + node.count[slot]; ++i) {
+					visible.push_back(m_objects[i]);
+				}
+			}
+			else {
+				appendSubtree(node.child[slot], visible);
+			}
+		}
+	}
+}
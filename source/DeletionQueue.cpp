@@ -0,0 +1,123 @@
+#include <algorithm>
+#include "DeletionQueue.h"
+#include "MemoryTracker.h"
+
+namespace Clan
+{
+	void DeletionQueue::init(VkDevice device)
+	{
+		m_device = device;
+		m_entries.clear();
+		m_pendingBytes = 0;
+		m_minPendingValue = UINT64_MAX;
+	}
+	//-----------------------------------------------------------------------------------------------
+	void DeletionQueue::retireBuffer(VkBuffer buffer, VkDeviceMemory memory, uint64_t lastUseValue)
+	{
+		VkMemoryRequirements memRequirements{};
+		vkGetBufferMemoryRequirements(m_device, buffer, &memRequirements);
+		retire<VK_OBJECT_TYPE_BUFFER>(buffer, lastUseValue);
+		retire<VK_OBJECT_TYPE_DEVICE_MEMORY>(memory, lastUseValue, memRequirements.size);
+	}
+	//-----------------------------------------------------------------------------------------------
+	void DeletionQueue::retireImage(VkImage image, VkDeviceMemory memory, uint64_t lastUseValue)
+	{
+		VkMemoryRequirements memRequirements{};
+		vkGetImageMemoryRequirements(m_device, image, &memRequirements);
+		retire<VK_OBJECT_TYPE_IMAGE>(image, lastUseValue);
+		retire<VK_OBJECT_TYPE_DEVICE_MEMORY>(memory, lastUseValue, memRequirements.size);
+	}
+	//-----------------------------------------------------------------------------------------------
+	uint32_t DeletionQueue::flush(uint64_t completedValue)
+	{
+		if (completedValue < m_minPendingValue) return 0;
+		//entries keep their push order, so views are destroyed before their images
+		uint32_t freed = 0;
+		uint64_t minPending = UINT64_MAX;
+		auto remaining = std::stable_partition(m_entries.begin(), m_entries.end(),
+			[completedValue](const Entry& entry) { return entry.value <= completedValue; });
+		for (auto it = m_entries.begin(); it != remaining; ++it, ++freed) {
+			destroy(*it);
+		}
+		for (auto it = remaining; it != m_entries.end(); ++it) {
+			minPending = std::min(minPending, it->value);
+		}
+		m_entries.erase(m_entries.begin(), remaining);
+		m_minPendingValue = minPending;
+		return freed;
+	}
+	//-----------------------------------------------------------------------------------------------
+	void DeletionQueue::flushAll()
+	{
+		flush(UINT64_MAX);
+		ASSERT(m_entries.empty() && m_pendingBytes == 0);
+	}
+	//-----------------------------------------------------------------------------------------------
+	void DeletionQueue::push(VkObjectType type, uint64_t handle, uint64_t lastUseValue, VkDeviceSize bytes)
+	{
+		m_entries.push_back({ lastUseValue, handle, bytes, type });
+		m_pendingBytes += bytes;
+		m_minPendingValue = std::min(m_minPendingValue, lastUseValue);
+	}
+	//-----------------------------------------------------------------------------------------------
+	void DeletionQueue::destroy(const Entry& entry)
+	{
+		switch (entry.type) {
+		case VK_OBJECT_TYPE_BUFFER:
+			vkDestroyBuffer(m_device, (VkBuffer)entry.handle, vulkanAllocator());
+			break;
+		case VK_OBJECT_TYPE_IMAGE:
+			vkDestroyImage(m_device, (VkImage)entry.handle, vulkanAllocator());
+			break;
+		case VK_OBJECT_TYPE_IMAGE_VIEW:
+			vkDestroyImageView(m_device, (VkImageView)entry.handle, vulkanAllocator());
+			break;
+		case VK_OBJECT_TYPE_DEVICE_MEMORY:
+			freeDeviceMemory(m_device, (VkDeviceMemory)entry.handle);
+			break;
+		case VK_OBJECT_TYPE_SAMPLER:
+			vkDestroySampler(m_device, (VkSampler)entry.handle, vulkanAllocator());
+			break;
+		case VK_OBJECT_TYPE_PIPELINE:
+			vkDestroyPipeline(m_device, (VkPipeline)entry.handle, vulkanAllocator());
+			break;
+		case VK_OBJECT_TYPE_PIPELINE_LAYOUT:
+			vkDestroyPipelineLayout(m_device, (VkPipelineLayout)entry.handle, vulkanAllocator());
+			break;
+		case VK_OBJECT_TYPE_RENDER_PASS:
+			vkDestroyRenderPass(m_device, (VkRenderPass)entry.handle, vulkanAllocator());
+			break;
+		case VK_OBJECT_TYPE_FRAMEBUFFER:
+			vkDestroyFramebuffer(m_device, (VkFramebuffer)entry.handle, vulkanAllocator());
+			break;
+		case VK_OBJECT_TYPE_SHADER_MODULE:
+			vkDestroyShaderModule(m_device, (VkShaderModule)entry.handle, vulkanAllocator());
+			break;
+		case VK_OBJECT_TYPE_DESCRIPTOR_POOL:
+			vkDestroyDescriptorPool(m_device, (VkDescriptorPool)entry.handle, vulkanAllocator());
+			break;
+		case VK_OBJECT_TYPE_DESCRIPTOR_SET_LAYOUT:
+			vkDestroyDescriptorSetLayout(m_device, (VkDescriptorSetLayout)entry.handle, vulkanAllocator());
+			break;
+		case VK_OBJECT_TYPE_COMMAND_POOL:
+			vkDestroyCommandPool(m_device, (VkCommandPool)entry.handle, vulkanAllocator());
+			break;
+		case VK_OBJECT_TYPE_SEMAPHORE:
+			vkDestroySemaphore(m_device, (VkSemaphore)entry.handle, vulkanAllocator());
+			break;
+		case VK_OBJECT_TYPE_FENCE:
+			vkDestroyFence(m_device, (VkFence)entry.handle, vulkanAllocator());
+			break;
+		case VK_OBJECT_TYPE_QUERY_POOL:
+			vkDestroyQueryPool(m_device, (VkQueryPool)entry.handle, vulkanAllocator());
+			break;
+		case VK_OBJECT_TYPE_SWAPCHAIN_KHR:
+			vkDestroySwapchainKHR(m_device, (VkSwapchainKHR)entry.handle, vulkanAllocator());
+			break;
+		default:
+			ASSERT(false);
+			break;
+		}
+		m_pendingBytes -= entry.bytes;
+	}
+}
@@ -0,0 +1,191 @@
+#include "DescriptorAllocator.h"
+#include "MemoryTracker.h"
+#include <algorithm>
+#include <cmath>
+
+namespace Clan
+{
+	namespace
+	{
+		void appendHandle(std::vector<uint32_t>& key, uint64_t handle)
+		{
+			key.push_back(static_cast<uint32_t>(handle));
+			key.push_back(static_cast<uint32_t>(handle >> 32));
+		}
+	}
+	//-----------------------------------------------------------------------------------------------
+	DescriptorWriter& DescriptorWriter::buffer(uint32_t binding, VkDescriptorType type, VkBuffer buffer, VkDeviceSize offset, VkDeviceSize range)
+	{
+		Write write{};
+		write.binding = binding;
+		write.type = type;
+		write.bufferInfo = { buffer, offset, range };
+		m_writes.push_back(write);
+		m_key.push_back(binding);
+		m_key.push_back(static_cast<uint32_t>(type));
+		appendHandle(m_key, (uint64_t)buffer);
+		appendHandle(m_key, offset);
+		appendHandle(m_key, range);
+		return *this;
+	}
+	//-----------------------------------------------------------------------------------------------
+	DescriptorWriter& DescriptorWriter::image(uint32_t binding, VkDescriptorType type, VkImageView view, VkSampler sampler, VkImageLayout layout)
+	{
+		Write write{};
+		write.binding = binding;
+		write.type = type;
+		write.imageInfo = { sampler, view, layout };
+		write.isImage = true;
+		m_writes.push_back(write);
+		m_key.push_back(binding);
+		m_key.push_back(static_cast<uint32_t>(type));
+		appendHandle(m_key, (uint64_t)view);
+		appendHandle(m_key, (uint64_t)sampler);
+		m_key.push_back(static_cast<uint32_t>(layout));
+		return *this;
+	}
+	//-----------------------------------------------------------------------------------------------
+	void DescriptorWriter::update(VkDevice device, VkDescriptorSet set) const
+	{
+		std::vector<VkWriteDescriptorSet> writes(m_writes.size());
+		for (size_t i = 0; i < m_writes.size(); ++i) {
+			const Write& source = m_writes[i];
+			VkWriteDescriptorSet& write = writes[i];
+			write.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+			write.dstSet = set;
+			write.dstBinding = source.binding;
+			write.dstArrayElement = 0;
+			write.descriptorCount = 1;
+			write.descriptorType = source.type;
+			write.pBufferInfo = source.isImage ? nullptr : &source.bufferInfo;
+			write.pImageInfo = source.isImage ? &source.imageInfo : nullptr;
+		}
+		vkUpdateDescriptorSets(device, static_cast<uint32_t>(writes.size()), writes.data(), 0, nullptr);
+	}
+	//-----------------------------------------------------------------------------------------------
+	size_t DescriptorAllocator::KeyHash::operator()(const Key& key) const
+	{
+		//FNV-1a over the words
+		uint64_t hash = 14695981039346656037ull;
+		for (uint32_t word : key) {
+			hash = (hash ^ word) * 1099511628211ull;
+		}
+		return static_cast<size_t>(hash);
+	}
+	//-----------------------------------------------------------------------------------------------
+	void DescriptorAllocator::init(VkDevice device, uint32_t setsPerPool, const std::vector<VkDescriptorPoolSize>& sizesPerSet)
+	{
+		m_device = device;
+		m_setsPerPool = std::clamp(setsPerPool, 1u, MAX_SETS_PER_POOL);
+		m_initialRatios.clear();
+		for (const VkDescriptorPoolSize& size : sizesPerSet) {
+			m_initialRatios[size.type] += static_cast<float>(size.descriptorCount);
+		}
+		m_writtenDescriptors.clear();
+		m_writtenSets = 0;
+	}
+	//-----------------------------------------------------------------------------------------------
+	void DescriptorAllocator::destroy()
+	{
+		for (VkDescriptorPool pool : m_usedPools) {
+			vkDestroyDescriptorPool(m_device, pool, vulkanAllocator());
+		}
+		for (VkDescriptorPool pool : m_freePools) {
+			vkDestroyDescriptorPool(m_device, pool, vulkanAllocator());
+		}
+		m_usedPools.clear();
+		m_freePools.clear();
+		m_currentPool = VK_NULL_HANDLE;
+		m_cache.clear();
+	}
+	//-----------------------------------------------------------------------------------------------
+	VkDescriptorSet DescriptorAllocator::allocate(VkDescriptorSetLayout layout)
+	{
+		VkDescriptorSetAllocateInfo allocInfo{};
+		allocInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+		allocInfo.descriptorSetCount = 1;
+		allocInfo.pSetLayouts = &layout;
+		VkDescriptorSet set = VK_NULL_HANDLE;
+		//a pool that was never used has to fit one set, otherwise the ratios miss a type of the layout
+		bool freshPool = false;
+		while (true) {
+			if (m_currentPool == VK_NULL_HANDLE) {
+				freshPool = m_freePools.empty();
+				m_currentPool = nextPool();
+			}
+			allocInfo.descriptorPool = m_currentPool;
+			VkResult result = vkAllocateDescriptorSets(m_device, &allocInfo, &set);
+			if (result == VK_SUCCESS) return set;
+			bool poolFull = result == VK_ERROR_OUT_OF_POOL_MEMORY || result == VK_ERROR_FRAGMENTED_POOL;
+			ASSERT(poolFull && !freshPool);
+			if (!poolFull || freshPool) return VK_NULL_HANDLE;
+			m_currentPool = VK_NULL_HANDLE;
+		}
+	}
+	//-----------------------------------------------------------------------------------------------
+	VkDescriptorSet DescriptorAllocator::get(VkDescriptorSetLayout layout, const DescriptorWriter& writer)
+	{
+		Key key = writer.key();
+		appendHandle(key, (uint64_t)layout);
+		auto it = m_cache.find(key);
+		if (it != m_cache.end()) return it->second;
+		for (size_t i = 0; i < writer.size(); ++i) {
+			++m_writtenDescriptors[writer.type(i)];
+		}
+		++m_writtenSets;
+		VkDescriptorSet set = allocate(layout);
+		writer.update(m_device, set);
+		m_cache.emplace(std::move(key), set);
+		return set;
+	}
+	//-----------------------------------------------------------------------------------------------
+	void DescriptorAllocator::reset()
+	{
+		for (VkDescriptorPool pool : m_usedPools) {
+			vkResetDescriptorPool(m_device, pool, 0);
+			m_freePools.push_back(pool);
+		}
+		m_usedPools.clear();
+		m_currentPool = VK_NULL_HANDLE;
+		m_cache.clear();
+	}
+	//-----------------------------------------------------------------------------------------------
+	VkDescriptorPool DescriptorAllocator::nextPool()
+	{
+		VkDescriptorPool pool = VK_NULL_HANDLE;
+		if (!m_freePools.empty()) {
+			pool = m_freePools.back();
+			m_freePools.pop_back();
+		}
+		else {
+			pool = createPool(m_setsPerPool);
+			m_setsPerPool = std::min(m_setsPerPool * 2, MAX_SETS_PER_POOL);
+		}
+		m_usedPools.push_back(pool);
+		return pool;
+	}
+	//-----------------------------------------------------------------------------------------------
+	VkDescriptorPool DescriptorAllocator::createPool(uint32_t setCount)
+	{
+		//per type, the larger of the given ratio and the one written so far
+		std::unordered_map<VkDescriptorType, float> ratios = m_initialRatios;
+		for (const auto& [type, count] : m_writtenDescriptors) {
+			float written = static_cast<float>(count) / static_cast<float>(m_writtenSets);
+			ratios[type] = std::max(ratios[type], written);
+		}
+		std::vector<VkDescriptorPoolSize> poolSizes;
+		poolSizes.reserve(ratios.size());
+		for (const auto& [type, ratio] : ratios) {
+			poolSizes.push_back({ type, std::max(1u, static_cast<uint32_t>(std::ceil(ratio * setCount))) });
+		}
+		VkDescriptorPoolCreateInfo poolInfo{};
+		poolInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+		poolInfo.poolSizeCount = static_cast<uint32_t>(poolSizes.size());
+		poolInfo.pPoolSizes = poolSizes.data();
+		poolInfo.maxSets = setCount;
+		VkDescriptorPool pool = VK_NULL_HANDLE;
+		VkResult result = vkCreateDescriptorPool(m_device, &poolInfo, vulkanAllocator(), &pool);
+		ASSERT(result == VK_SUCCESS);
+		return pool;
+	}
+}
@@ -0,0 +1,121 @@
+#include <algorithm>
+#include "FrameScheduler.h"
+#include "MemoryTracker.h"
+
+namespace Clan
+{
+	void Timeline::init(VkDevice device, VkQueue queue)
+	{
+		m_device = device;
+		m_queue = queue;
+		VkSemaphoreTypeCreateInfo typeInfo{};
+		typeInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_TYPE_CREATE_INFO;
+		typeInfo.semaphoreType = VK_SEMAPHORE_TYPE_TIMELINE;
+		typeInfo.initialValue = 0;
+		VkSemaphoreCreateInfo semaphoreInfo{};
+		semaphoreInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
+		semaphoreInfo.pNext = &typeInfo;
+		VkResult result = vkCreateSemaphore(m_device, &semaphoreInfo, vulkanAllocator(), &m_semaphore);
+		ASSERT(result == VK_SUCCESS);
+		m_lastSubmitted = m_lastCompleted = 0;
+	}
+	//-----------------------------------------------------------------------------------------------
+	void Timeline::destroy()
+	{
+		vkDestroySemaphore(m_device, m_semaphore, vulkanAllocator());
+		m_semaphore = VK_NULL_HANDLE;
+	}
+	//-----------------------------------------------------------------------------------------------
+	uint64_t Timeline::submit(const VkCommandBuffer* pCommandBuffers, uint32_t count,
+		const std::vector<SemaphoreWait>& waits, const std::vector<VkSemaphore>& binarySignals)
+	{
+		uint64_t signalValue = m_lastSubmitted + 1;
+		std::vector<VkSemaphore> waitSemaphores(waits.size());
+		std::vector<uint64_t> waitValues(waits.size());
+		std::vector<VkPipelineStageFlags> waitStages(waits.size());
+		for (size_t i = 0; i < waits.size(); ++i) {
+			waitSemaphores[i] = waits[i].semaphore;
+			waitValues[i] = waits[i].value;
+			waitStages[i] = waits[i].stage;
+		}
+		//the timeline is always the first signal, binary semaphores ignore their value
+		std::vector<VkSemaphore> signalSemaphores{ m_semaphore };
+		signalSemaphores.insert(signalSemaphores.end(), binarySignals.begin(), binarySignals.end());
+		std::vector<uint64_t> signalValues(signalSemaphores.size(), 0);
+		signalValues[0] = signalValue;
+
+		VkTimelineSemaphoreSubmitInfo timelineInfo{};
+		timelineInfo.sType = VK_STRUCTURE_TYPE_TIMELINE_SEMAPHORE_SUBMIT_INFO;
+		timelineInfo.waitSemaphoreValueCount = static_cast<uint32_t>(waitValues.size());
+		timelineInfo.pWaitSemaphoreValues = waitValues.data();
+		timelineInfo.signalSemaphoreValueCount = static_cast<uint32_t>(signalValues.size());
+		timelineInfo.pSignalSemaphoreValues = signalValues.data();
+		VkSubmitInfo submitInfo{};
+		submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+		submitInfo.pNext = &timelineInfo;
+		submitInfo.waitSemaphoreCount = static_cast<uint32_t>(waitSemaphores.size());
+		submitInfo.pWaitSemaphores = waitSemaphores.data();
+		submitInfo.pWaitDstStageMask = waitStages.data();
+		submitInfo.commandBufferCount = count;
+		submitInfo.pCommandBuffers = pCommandBuffers;
+		submitInfo.signalSemaphoreCount = static_cast<uint32_t>(signalSemaphores.size());
+		submitInfo.pSignalSemaphores = signalSemaphores.data();
+		VkResult result = vkQueueSubmit(m_queue, 1, &submitInfo, VK_NULL_HANDLE);
+		ASSERT(result == VK_SUCCESS);
+		m_lastSubmitted = signalValue;
+		return signalValue;
+	}
+	//-----------------------------------------------------------------------------------------------
+	uint64_t Timeline::completedValue()
+	{
+		uint64_t value = 0;
+		VkResult result = vkGetSemaphoreCounterValue(m_device, m_semaphore, &value);
+		ASSERT(result == VK_SUCCESS);
+		m_lastCompleted = std::max(m_lastCompleted, value);
+		return m_lastCompleted;
+	}
+	//-----------------------------------------------------------------------------------------------
+	void Timeline::wait(uint64_t value)
+	{
+		if (value <= m_lastCompleted) return;
+		VkSemaphoreWaitInfo waitInfo{};
+		waitInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_WAIT_INFO;
+		waitInfo.semaphoreCount = 1;
+		waitInfo.pSemaphores = &m_semaphore;
+		waitInfo.pValues = &value;
+		VkResult result = vkWaitSemaphores(m_device, &waitInfo, UINT64_MAX);
+		ASSERT(result == VK_SUCCESS);
+		m_lastCompleted = std::max(m_lastCompleted, value);
+	}
+	//-----------------------------------------------------------------------------------------------
+	void FrameScheduler::init(VkDevice device, VkQueue graphicsQueue, uint32_t framesInFlight)
+	{
+		m_timeline.init(device, graphicsQueue);
+		m_frameValues.assign(framesInFlight, 0);
+		m_frameIndex = 0;
+	}
+	//-----------------------------------------------------------------------------------------------
+	void FrameScheduler::destroy()
+	{
+		m_timeline.destroy();
+		m_frameValues.clear();
+	}
+	//-----------------------------------------------------------------------------------------------
+	void FrameScheduler::beginFrame(uint32_t frameIndex)
+	{
+		ASSERT(frameIndex < m_frameValues.size());
+		m_frameIndex = frameIndex;
+		m_timeline.wait(m_frameValues[frameIndex]);
+		m_pendingWaits.clear();
+		m_pendingSignals.clear();
+	}
+	//-----------------------------------------------------------------------------------------------
+	uint64_t FrameScheduler::submit(const VkCommandBuffer* pCommandBuffers, uint32_t count)
+	{
+		uint64_t value = m_timeline.submit(pCommandBuffers, count, m_pendingWaits, m_pendingSignals);
+		m_frameValues[m_frameIndex] = value;
+		m_pendingWaits.clear();
+		m_pendingSignals.clear();
+		return value;
+	}
+}
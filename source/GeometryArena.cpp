@@ -0,0 +1,110 @@
+#include "GeometryArena.h"
+
+namespace Clan
+{
+	namespace
+	{
+		inline VkDeviceSize alignUp(VkDeviceSize offset, VkDeviceSize alignment)
+		{
+			return (offset + alignment - 1) / alignment * alignment;
+		}
+	}
+	//-----------------------------------------------------------------------------------------------
+	void GeometryArena::init(VkDevice device, VkPhysicalDevice physicalDevice, VkDeviceSize capacity, uint32_t vertexStride)
+	{
+		m_device = device;
+		m_capacity = capacity;
+		m_vertexStride = vertexStride;
+		m_usedBytes = 0;
+		m_uploadedBytes = 0;
+		m_savedIndexBytes = 0;
+		m_pending.clear();
+		VkBufferCreateInfo bufferInfo{};
+		bufferInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+		bufferInfo.size = capacity;
+		bufferInfo.usage = VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_INDEX_BUFFER_BIT;
+		bufferInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+		VkResult result = vkCreateBuffer(device, &bufferInfo, vulkanAllocator(), &m_buffer);
+		ASSERT(result == VK_SUCCESS);
+		VkMemoryRequirements requirements{};
+		vkGetBufferMemoryRequirements(device, m_buffer, &requirements);
+		VkPhysicalDeviceMemoryProperties memoryProperties{};
+		vkGetPhysicalDeviceMemoryProperties(physicalDevice, &memoryProperties);
+		uint32_t memoryType = UINT32_MAX;
+		for (uint32_t i = 0; i < memoryProperties.memoryTypeCount && memoryType == UINT32_MAX; ++i) {
+			if ((requirements.memoryTypeBits & (1 << i)) &&
+				(memoryProperties.memoryTypes[i].propertyFlags & VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT)) {
+				memoryType = i;
+			}
+		}
+		ASSERT(memoryType != UINT32_MAX);
+		VkMemoryAllocateInfo allocInfo{};
+		allocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+		allocInfo.allocationSize = requirements.size;
+		allocInfo.memoryTypeIndex = memoryType;
+		result = allocateDeviceMemory(device, &allocInfo, &m_memory);
+		ASSERT(result == VK_SUCCESS);
+		vkBindBufferMemory(device, m_buffer, m_memory, 0);
+	}
+	//-----------------------------------------------------------------------------------------------
+	void GeometryArena::destroy()
+	{
+		vkDestroyBuffer(m_device, m_buffer, vulkanAllocator());
+		freeDeviceMemory(m_device, m_memory);
+		m_buffer = VK_NULL_HANDLE;
+		m_memory = VK_NULL_HANDLE;
+		m_pending = {};
+		m_usedBytes = m_uploadedBytes = m_capacity = 0;
+	}
+	//-----------------------------------------------------------------------------------------------
+	VkIndexType GeometryArena::indexTypeFor(uint32_t vertexCount)
+	{
+		return vertexCount <= 65536 ? VK_INDEX_TYPE_UINT16 : VK_INDEX_TYPE_UINT32;
+	}
+	//-----------------------------------------------------------------------------------------------
+	bool GeometryArena::reserve(uint32_t vertexCount, uint32_t indexCount, GeometryMesh& mesh, uint8_t*& pVertexDst, uint8_t*& pIndexDst)
+	{
+		VkIndexType indexType = indexTypeFor(vertexCount);
+		VkDeviceSize indexSize = indexType == VK_INDEX_TYPE_UINT16 ? 2 : 4;
+		VkDeviceSize vertexOffset = alignUp(m_usedBytes, m_vertexStride);
+		VkDeviceSize indexOffset = alignUp(vertexOffset + static_cast<VkDeviceSize>(vertexCount) * m_vertexStride, indexSize);
+		VkDeviceSize end = indexOffset + indexCount * indexSize;
+		//vertexOffset is signed, firstIndex counts indices
+		if (end > m_capacity || vertexOffset / m_vertexStride > INT32_MAX || indexOffset / indexSize > UINT32_MAX) return false;
+		mesh.vertexOffset = static_cast<int32_t>(vertexOffset / m_vertexStride);
+		mesh.firstIndex = static_cast<uint32_t>(indexOffset / indexSize);
+		mesh.vertexCount = vertexCount;
+		mesh.indexCount = indexCount;
+		mesh.indexType = indexType;
+		m_pending.resize(static_cast<size_t>(end - m_uploadedBytes));
+		pVertexDst = m_pending.data() + (vertexOffset - m_uploadedBytes);
+		pIndexDst = m_pending.data() + (indexOffset - m_uploadedBytes);
+		m_usedBytes = end;
+		m_savedIndexBytes += indexCount * (4 - indexSize);
+		return true;
+	}
+	//-----------------------------------------------------------------------------------------------
+	void GeometryArena::recordUpload(VkCommandBuffer commandBuffer, VkBuffer stagingBuffer, void* pStaging)
+	{
+		if (m_pending.empty()) return;
+		std::memcpy(pStaging, m_pending.data(), m_pending.size());
+		VkBufferCopy region{};
+		region.srcOffset = 0;
+		region.dstOffset = m_uploadedBytes;
+		region.size = m_pending.size();
+		vkCmdCopyBuffer(commandBuffer, stagingBuffer, m_buffer, 1, &region);
+		m_uploadedBytes = m_usedBytes;
+		m_pending = {};
+	}
+	//-----------------------------------------------------------------------------------------------
+	void GeometryArena::bindVertices(VkCommandBuffer commandBuffer) const
+	{
+		VkDeviceSize offset = 0;
+		vkCmdBindVertexBuffers(commandBuffer, 0, 1, &m_buffer, &offset);
+	}
+	//-----------------------------------------------------------------------------------------------
+	void GeometryArena::bindIndices(VkCommandBuffer commandBuffer, VkIndexType indexType) const
+	{
+		vkCmdBindIndexBuffer(commandBuffer, m_buffer, 0, indexType);
+	}
+}
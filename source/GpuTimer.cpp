@@ -0,0 +1,62 @@
+#include "GpuTimer.h"
+#include "MemoryTracker.h"
+
+namespace Clan
+{
+	void GpuTimer::init(VkDevice device, VkPhysicalDevice physicalDevice, uint32_t queueFamily, uint32_t framesInFlight)
+	{
+		m_device = device;
+		m_recorded.assign(framesInFlight, false);
+		VkPhysicalDeviceProperties properties{};
+		vkGetPhysicalDeviceProperties(physicalDevice, &properties);
+		uint32_t familyCount = 0;
+		vkGetPhysicalDeviceQueueFamilyProperties(physicalDevice, &familyCount, nullptr);
+		std::vector<VkQueueFamilyProperties> families(familyCount);
+		vkGetPhysicalDeviceQueueFamilyProperties(physicalDevice, &familyCount, families.data());
+		uint32_t validBits = families[queueFamily].timestampValidBits;
+		if (validBits == 0 || properties.limits.timestampPeriod == 0.0f) return;
+		m_nanosecondsPerTick = properties.limits.timestampPeriod;
+		m_validMask = validBits >= 64 ? ~0ull : (1ull << validBits) - 1;
+
+		VkQueryPoolCreateInfo poolInfo{};
+		poolInfo.sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO;
+		poolInfo.queryType = VK_QUERY_TYPE_TIMESTAMP;
+		poolInfo.queryCount = framesInFlight * 2;
+		VkResult result = vkCreateQueryPool(m_device, &poolInfo, vulkanAllocator(), &m_queryPool);
+		ASSERT(result == VK_SUCCESS);
+	}
+	//-----------------------------------------------------------------------------------------------
+	void GpuTimer::destroy()
+	{
+		vkDestroyQueryPool(m_device, m_queryPool, vulkanAllocator());
+		m_queryPool = VK_NULL_HANDLE;
+		m_recorded.clear();
+	}
+	//-----------------------------------------------------------------------------------------------
+	void GpuTimer::begin(VkCommandBuffer commandBuffer, uint32_t frameIndex)
+	{
+		if (!isSupported()) return;
+		vkCmdResetQueryPool(commandBuffer, m_queryPool, frameIndex * 2, 2);
+		vkCmdWriteTimestamp2(commandBuffer, VK_PIPELINE_STAGE_2_TOP_OF_PIPE_BIT, m_queryPool, frameIndex * 2);
+	}
+	//-----------------------------------------------------------------------------------------------
+	void GpuTimer::end(VkCommandBuffer commandBuffer, uint32_t frameIndex)
+	{
+		if (!isSupported()) return;
+		vkCmdWriteTimestamp2(commandBuffer, VK_PIPELINE_STAGE_2_BOTTOM_OF_PIPE_BIT, m_queryPool, frameIndex * 2 + 1);
+		m_recorded[frameIndex] = true;
+	}
+	//-----------------------------------------------------------------------------------------------
+	bool GpuTimer::collect(uint32_t frameIndex, double& milliseconds)
+	{
+		if (!isSupported() || !m_recorded[frameIndex]) return false;
+		uint64_t timestamps[2]{};
+		VkResult result = vkGetQueryPoolResults(m_device, m_queryPool, frameIndex * 2, 2, sizeof(timestamps), timestamps,
+			sizeof(uint64_t), VK_QUERY_RESULT_64_BIT);
+		if (result != VK_SUCCESS) return false;
+		uint64_t ticks = (timestamps[1] - timestamps[0]) & m_validMask;
+		milliseconds = ticks * m_nanosecondsPerTick * 1e-6;
+		m_recorded[frameIndex] = false;
+		return true;
+	}
+}
@@ -0,0 +1,116 @@
+#include "LayoutCache.h"
+#include "MemoryTracker.h"
+#include <algorithm>
+
+namespace Clan
+{
+	namespace
+	{
+		void appendHandle(std::vector<uint32_t>& key, uint64_t handle)
+		{
+			key.push_back(static_cast<uint32_t>(handle));
+			key.push_back(static_cast<uint32_t>(handle >> 32));
+		}
+	}
+
+	size_t LayoutCache::KeyHash::operator()(const Key& key) const
+	{
+		//FNV-1a over the words
+		uint64_t hash = 14695981039346656037ull;
+		for (uint32_t word : key) {
+			hash = (hash ^ word) * 1099511628211ull;
+		}
+		return static_cast<size_t>(hash);
+	}
+	//-----------------------------------------------------------------------------------------------
+	void LayoutCache::init(VkDevice device)
+	{
+		m_device = device;
+	}
+	//-----------------------------------------------------------------------------------------------
+	void LayoutCache::destroy()
+	{
+		for (auto& [key, layout] : m_pipelineLayouts) {
+			vkDestroyPipelineLayout(m_device, layout, vulkanAllocator());
+		}
+		for (auto& [key, layout] : m_setLayouts) {
+			vkDestroyDescriptorSetLayout(m_device, layout, vulkanAllocator());
+		}
+		m_pipelineLayouts.clear();
+		m_setLayouts.clear();
+	}
+	//-----------------------------------------------------------------------------------------------
+	VkDescriptorSetLayout LayoutCache::descriptorSetLayout(const std::vector<VkDescriptorSetLayoutBinding>& bindings)
+	{
+		//the binding order doesn't change the layout
+		std::vector<VkDescriptorSetLayoutBinding> sorted = bindings;
+		std::sort(sorted.begin(), sorted.end(), [](const VkDescriptorSetLayoutBinding& a, const VkDescriptorSetLayoutBinding& b) {
+			return a.binding < b.binding;
+		});
+		Key key;
+		key.reserve(sorted.size() * 4);
+		for (const VkDescriptorSetLayoutBinding& binding : sorted) {
+			ASSERT(binding.pImmutableSamplers == nullptr);
+			key.push_back(binding.binding);
+			key.push_back(static_cast<uint32_t>(binding.descriptorType));
+			key.push_back(binding.descriptorCount);
+			key.push_back(binding.stageFlags);
+		}
+		auto it = m_setLayouts.find(key);
+		if (it != m_setLayouts.end()) return it->second;
+
+		VkDescriptorSetLayoutCreateInfo layoutInfo{};
+		layoutInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+		layoutInfo.bindingCount = static_cast<uint32_t>(sorted.size());
+		layoutInfo.pBindings = sorted.data();
+		VkDescriptorSetLayout layout = VK_NULL_HANDLE;
+		VkResult result = vkCreateDescriptorSetLayout(m_device, &layoutInfo, vulkanAllocator(), &layout);
+		ASSERT(result == VK_SUCCESS);
+		m_setLayouts.emplace(std::move(key), layout);
+		return layout;
+	}
+	//-----------------------------------------------------------------------------------------------
+	VkPipelineLayout LayoutCache::pipelineLayout(const std::vector<VkDescriptorSetLayout>& setLayouts,
+		const std::vector<VkPushConstantRange>& pushConstantRanges)
+	{
+		Key key;
+		key.reserve(1 + setLayouts.size() * 2 + pushConstantRanges.size() * 3);
+		key.push_back(static_cast<uint32_t>(setLayouts.size()));
+		for (VkDescriptorSetLayout setLayout : setLayouts) {
+			appendHandle(key, (uint64_t)setLayout);
+		}
+		for (const VkPushConstantRange& range : pushConstantRanges) {
+			key.push_back(range.stageFlags);
+			key.push_back(range.offset);
+			key.push_back(range.size);
+		}
+		auto it = m_pipelineLayouts.find(key);
+		if (it != m_pipelineLayouts.end()) return it->second;
+
+		VkPipelineLayoutCreateInfo pipelineLayoutInfo{};
+		pipelineLayoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+		pipelineLayoutInfo.setLayoutCount = static_cast<uint32_t>(setLayouts.size());
+		pipelineLayoutInfo.pSetLayouts = setLayouts.data();
+		pipelineLayoutInfo.pushConstantRangeCount = static_cast<uint32_t>(pushConstantRanges.size());
+		pipelineLayoutInfo.pPushConstantRanges = pushConstantRanges.data();
+		VkPipelineLayout layout = VK_NULL_HANDLE;
+		VkResult result = vkCreatePipelineLayout(m_device, &pipelineLayoutInfo, vulkanAllocator(), &layout);
+		ASSERT(result == VK_SUCCESS);
+		m_pipelineLayouts.emplace(std::move(key), layout);
+		return layout;
+	}
+	//-----------------------------------------------------------------------------------------------
+	VkPipelineLayout LayoutCache::pipelineLayout(const ShaderReflection& reflection, std::vector<VkDescriptorSetLayout>* pSetLayouts)
+	{
+		//unused sets below the highest one get an empty layout
+		std::vector<VkDescriptorSetLayout> setLayouts(reflection.setCount());
+		for (uint32_t set = 0; set < setLayouts.size(); ++set) {
+			setLayouts[set] = descriptorSetLayout(reflection.setLayoutBindings(set));
+		}
+		VkPipelineLayout layout = pipelineLayout(setLayouts, reflection.pushConstantRanges());
+		if (pSetLayouts) {
+			*pSetLayouts = std::move(setLayouts);
+		}
+		return layout;
+	}
+}
@@ -0,0 +1,183 @@
+#include "LockFreeQueue.h"
+#include <chrono>
+#include <deque>
+#include <iomanip>
+#include <iostream>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace Clan
+{
+	namespace
+	{
+		//Items of the MPSC benchmark, one per push
+		struct BenchmarkNode : MpscNode {
+			uint64_t value{ 0 };
+		};
+
+		struct BenchmarkResult {
+			double itemsPerSecond{ 0.0 };
+			bool correct{ false };
+		};
+
+		//'push(producer, value)' and 'pop(value)' return false when full or empty, the threads
+		//retry after a yield. Every value is pushed once, their sum proves none got lost.
+		template<typename Push, typename Pop>
+		BenchmarkResult runQueueBenchmark(uint32_t producers, uint32_t consumers, uint32_t itemsPerProducer, Push push, Pop pop)
+		{
+			uint64_t total = static_cast<uint64_t>(producers) * itemsPerProducer;
+			std::atomic<bool> start{ false };
+			std::atomic<uint64_t> popped{ 0 };
+			std::atomic<uint64_t> sum{ 0 };
+			std::vector<std::thread> threads;
+			for (uint32_t p = 0; p < producers; ++p) {
+				threads.emplace_back([&, p]() {
+					while (!start.load(std::memory_order_acquire)) std::this_thread::yield();
+					for (uint32_t i = 0; i < itemsPerProducer; ++i) {
+						uint64_t value = static_cast<uint64_t>(p) * itemsPerProducer + i + 1;
+						while (!push(p, value)) std::this_thread::yield();
+					}
+				});
+			}
+			for (uint32_t c = 0; c < consumers; ++c) {
+				threads.emplace_back([&]() {
+					while (!start.load(std::memory_order_acquire)) std::this_thread::yield();
+					uint64_t localSum = 0;
+					uint64_t value = 0;
+					while (popped.load(std::memory_order_relaxed) < total) {
+						if (pop(value)) {
+							localSum += value;
+							popped.fetch_add(1, std::memory_order_relaxed);
+						}
+						else {
+							std::this_thread::yield();
+						}
+					}
+					sum.fetch_add(localSum, std::memory_order_relaxed);
+				});
+			}
+			auto begin = std::chrono::steady_clock::now();
+			start.store(true, std::memory_order_release);
+			for (std::thread& thread : threads) {
+				thread.join();
+			}
+			double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - begin).count();
+			BenchmarkResult result{};
+			result.itemsPerSecond = total / seconds;
+			result.correct = sum.load() == total * (total + 1) / 2;
+			return result;
+		}
+
+		void printResult(const char* name, uint32_t producers, uint32_t consumers, const BenchmarkResult& result)
+		{
+			std::cout << std::setw(10) << name << std::setw(11) << producers << std::setw(11) << consumers
+				<< std::setw(12) << std::fixed << std::setprecision(2) << result.itemsPerSecond / 1e6
+				<< (result.correct ? "" : "  LOST ITEMS") << std::endl;
+		}
+	}
+
+	void IntrusiveMpscQueue::init()
+	{
+		m_stub.next.store(nullptr, std::memory_order_relaxed);
+		m_head.store(&m_stub, std::memory_order_relaxed);
+		m_tail = &m_stub;
+	}
+	//-----------------------------------------------------------------------------------------------
+	void IntrusiveMpscQueue::push(MpscNode* pNode)
+	{
+		pNode->next.store(nullptr, std::memory_order_relaxed);
+		//the queue is linked again as soon as the previous head points at the node
+		MpscNode* pPrevious = m_head.exchange(pNode, std::memory_order_acq_rel);
+		pPrevious->next.store(pNode, std::memory_order_release);
+	}
+	//-----------------------------------------------------------------------------------------------
+	MpscNode* IntrusiveMpscQueue::pop()
+	{
+		MpscNode* pTail = m_tail;
+		MpscNode* pNext = pTail->next.load(std::memory_order_acquire);
+		if (pTail == &m_stub) {
+			if (pNext == nullptr) return nullptr;
+			m_tail = pNext;
+			pTail = pNext;
+			pNext = pNext->next.load(std::memory_order_acquire);
+		}
+		if (pNext != nullptr) {
+			m_tail = pNext;
+			return pTail;
+		}
+		//the last node can only be taken once the stub is behind it
+		if (pTail != m_head.load(std::memory_order_acquire)) return nullptr;
+		push(&m_stub);
+		pNext = pTail->next.load(std::memory_order_acquire);
+		if (pNext == nullptr) return nullptr;
+		m_tail = pNext;
+		return pTail;
+	}
+	//-----------------------------------------------------------------------------------------------
+	void benchmarkQueues(uint32_t itemsPerProducer)
+	{
+		constexpr uint32_t CAPACITY = 1024;
+		const std::pair<uint32_t, uint32_t> threadCounts[] = { { 1, 1 }, { 2, 2 }, { 4, 4 } };
+		std::cout << "queues, " << itemsPerProducer << " items per producer, " << std::thread::hardware_concurrency()
+			<< " hardware threads, million items per second" << std::endl;
+		std::cout << std::setw(10) << "queue" << std::setw(11) << "producers" << std::setw(11) << "consumers"
+			<< std::setw(12) << "Mitems/s" << std::endl;
+		{
+			SpscRing<uint64_t> ring;
+			ring.init(CAPACITY);
+			BenchmarkResult result = runQueueBenchmark(1, 1, itemsPerProducer,
+				[&](uint32_t, uint64_t value) { return ring.tryPush(value); },
+				[&](uint64_t& value) { return ring.tryPop(value); });
+			printResult("spsc", 1, 1, result);
+			ring.destroy();
+		}
+		for (const auto& [producers, consumers] : threadCounts) {
+			MpmcQueue<uint64_t> queue;
+			queue.init(CAPACITY);
+			BenchmarkResult result = runQueueBenchmark(producers, consumers, itemsPerProducer,
+				[&](uint32_t, uint64_t value) { return queue.tryPush(value); },
+				[&](uint64_t& value) { return queue.tryPop(value); });
+			printResult("mpmc", producers, consumers, result);
+			queue.destroy();
+		}
+		for (const auto& [producers, consumers] : threadCounts) {
+			//the intrusive queue is unbounded, every item has its own node
+			std::vector<BenchmarkNode> nodes(static_cast<size_t>(producers) * itemsPerProducer);
+			IntrusiveMpscQueue queue;
+			queue.init();
+			BenchmarkResult result = runQueueBenchmark(producers, 1, itemsPerProducer,
+				[&](uint32_t, uint64_t value) {
+					BenchmarkNode& node = nodes[value - 1];
+					node.value = value;
+					queue.push(&node);
+					return true;
+				},
+				[&](uint64_t& value) {
+					MpscNode* pNode = queue.pop();
+					if (pNode == nullptr) return false;
+					value = static_cast<BenchmarkNode*>(pNode)->value;
+					return true;
+				});
+			printResult("mpsc", producers, 1, result);
+		}
+		for (const auto& [producers, consumers] : threadCounts) {
+			std::mutex mutex;
+			std::deque<uint64_t> queue;
+			BenchmarkResult result = runQueueBenchmark(producers, consumers, itemsPerProducer,
+				[&](uint32_t, uint64_t value) {
+					std::lock_guard<std::mutex> lock(mutex);
+					queue.push_back(value);
+					return true;
+				},
+				[&](uint64_t& value) {
+					std::lock_guard<std::mutex> lock(mutex);
+					if (queue.empty()) return false;
+					value = queue.front();
+					queue.pop_front();
+					return true;
+				});
+			printResult("mutex", producers, consumers, result);
+		}
+	}
+}
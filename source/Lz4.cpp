@@ -0,0 +1,139 @@
+#include "Lz4.h"
+#include <cstring>
+#include <vector>
+
+namespace Clan
+{
+	namespace
+	{
+		constexpr size_t MIN_MATCH = 4;
+		//the format ends every block with literals, the last match starts 12 bytes before the end
+		constexpr size_t LAST_LITERALS = 5;
+		constexpr size_t MATCH_LIMIT = 12;
+		constexpr size_t MAX_OFFSET = 65535;
+		constexpr uint32_t HASH_BITS = 16;
+
+		inline uint32_t read32(const uint8_t* p)
+		{
+			uint32_t value;
+			std::memcpy(&value, p, sizeof(value));
+			return value;
+		}
+
+		inline uint32_t hashSequence(uint32_t sequence)
+		{
+			return (sequence * 2654435761u) >> (32 - HASH_BITS);
+		}
+
+		inline void writeLength(uint8_t*& pOut, size_t length)
+		{
+			for (; length >= 255; length -= 255) {
+				*pOut++ = 255;
+			}
+			*pOut++ = static_cast<uint8_t>(length);
+		}
+
+		//'matchLength' is without the implicit MIN_MATCH, the last sequence has no match
+		bool writeSequence(uint8_t*& pOut, const uint8_t* pEnd, const uint8_t* pLiterals, size_t literalLength,
+			size_t offset, size_t matchLength, bool last)
+		{
+			size_t worstCase = 1 + literalLength / 255 + 1 + literalLength + 2 + matchLength / 255 + 1;
+			if (static_cast<size_t>(pEnd - pOut) < worstCase) return false;
+			uint8_t* pToken = pOut++;
+			*pToken = static_cast<uint8_t>((literalLength < 15 ? literalLength : 15) << 4);
+			if (literalLength >= 15) writeLength(pOut, literalLength - 15);
+			std::memcpy(pOut, pLiterals, literalLength);
+			pOut += literalLength;
+			if (last) return true;
+			*pOut++ = static_cast<uint8_t>(offset);
+			*pOut++ = static_cast<uint8_t>(offset >> 8);
+			*pToken |= static_cast<uint8_t>(matchLength < 15 ? matchLength : 15);
+			if (matchLength >= 15) writeLength(pOut, matchLength - 15);
+			return true;
+		}
+
+		inline bool readLength(const uint8_t* pSrc, size_t srcSize, size_t& in, size_t& length)
+		{
+			uint8_t byte;
+			do {
+				if (in >= srcSize) return false;
+				byte = pSrc[in++];
+				length += byte;
+			} while (byte == 255);
+			return true;
+		}
+	}
+	//-----------------------------------------------------------------------------------------------
+	size_t lz4CompressBound(size_t size)
+	{
+		return size + size / 255 + 16;
+	}
+	//-----------------------------------------------------------------------------------------------
+	size_t lz4Compress(const uint8_t* pSrc, size_t srcSize, uint8_t* pDst, size_t dstCapacity)
+	{
+		uint8_t* pOut = pDst;
+		const uint8_t* pEnd = pDst + dstCapacity;
+		size_t anchor = 0;
+		if (srcSize > MATCH_LIMIT) {
+			//last position each hashed sequence was seen at
+			std::vector<uint32_t> table(size_t(1) << HASH_BITS, 0);
+			size_t matchEndLimit = srcSize - LAST_LITERALS;
+			size_t in = 0;
+			while (in <= srcSize - MATCH_LIMIT) {
+				uint32_t sequence = read32(pSrc + in);
+				uint32_t& slot = table[hashSequence(sequence)];
+				size_t candidate = slot;
+				slot = static_cast<uint32_t>(in);
+				if (candidate >= in || in - candidate > MAX_OFFSET || read32(pSrc + candidate) != sequence) {
+					++in;
+					continue;
+				}
+				size_t matchEnd = in + MIN_MATCH;
+				while (matchEnd < matchEndLimit && pSrc[matchEnd] == pSrc[candidate + matchEnd - in]) {
+					++matchEnd;
+				}
+				if (!writeSequence(pOut, pEnd, pSrc + anchor, in - anchor, in - candidate, matchEnd - in - MIN_MATCH, false)) return 0;
+				in = anchor = matchEnd;
+			}
+		}
+		if (!writeSequence(pOut, pEnd, pSrc + anchor, srcSize - anchor, 0, 0, true)) return 0;
+		return static_cast<size_t>(pOut - pDst);
+	}
+	//-----------------------------------------------------------------------------------------------
+	bool lz4Decompress(const uint8_t* pSrc, size_t srcSize, uint8_t* pDst, size_t dstSize)
+	{
+		size_t in = 0;
+		size_t out = 0;
+		while (in < srcSize) {
+			uint8_t token = pSrc[in++];
+			size_t literalLength = token >> 4;
+			if (literalLength == 15 && !readLength(pSrc, srcSize, in, literalLength)) return false;
+			if (literalLength > srcSize - in || literalLength > dstSize - out) return false;
+			std::memcpy(pDst + out, pSrc + in, literalLength);
+			in += literalLength;
+			out += literalLength;
+			//the last sequence has no match
+			if (in == srcSize) break;
+			if (srcSize - in < 2) return false;
+			size_t offset = pSrc[in] | (static_cast<size_t>(pSrc[in + 1]) << 8);
+			in += 2;
+			if (offset == 0 || offset > out) return false;
+			size_t matchLength = token & 15;
+			if (matchLength == 15 && !readLength(pSrc, srcSize, in, matchLength)) return false;
+			matchLength += MIN_MATCH;
+			if (matchLength > dstSize - out) return false;
+			uint8_t* pMatch = pDst + out - offset;
+			if (offset >= matchLength) {
+				std::memcpy(pDst + out, pMatch, matchLength);
+			}
+			else {
+				//overlapping matches repeat the last 'offset' bytes
+				for (size_t i = 0; i < matchLength; ++i) {
+					pDst[out + i] = pMatch[i];
+				}
+			}
+			out += matchLength;
+		}
+		return out == dstSize;
+	}
+}
@@ -0,0 +1,96 @@
+#include "MappedFile.h"
+#ifdef _WIN32
+	#define WIN32_LEAN_AND_MEAN
+	#define NOMINMAX
+	#include <windows.h>
+#else
+	#include <sys/mman.h>
+	#include <sys/stat.h>
+	#include <fcntl.h>
+	#include <unistd.h>
+#endif
+
+namespace Clan
+{
+#ifdef _WIN32
+	bool MappedFile::open(const std::string& path)
+	{
+		close();
+		HANDLE file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+		if (file == INVALID_HANDLE_VALUE) return false;
+		LARGE_INTEGER size{};
+		if (!GetFileSizeEx(file, &size) || size.QuadPart == 0) {
+			CloseHandle(file);
+			return false;
+		}
+		HANDLE mapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+		if (mapping == nullptr) {
+			CloseHandle(file);
+			return false;
+		}
+		void* view = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+		if (view == nullptr) {
+			CloseHandle(mapping);
+			CloseHandle(file);
+			return false;
+		}
+		m_file = file;
+		m_mapping = mapping;
+		m_pData = static_cast<const uint8_t*>(view);
+		m_size = static_cast<size_t>(size.QuadPart);
+		return true;
+	}
+	//-----------------------------------------------------------------------------------------------
+	void MappedFile::close()
+	{
+		if (m_pData) UnmapViewOfFile(m_pData);
+		if (m_mapping) CloseHandle(m_mapping);
+		if (m_file) CloseHandle(m_file);
+		m_pData = nullptr;
+		m_mapping = nullptr;
+		m_file = nullptr;
+		m_size = 0;
+	}
+	//-----------------------------------------------------------------------------------------------
+	void MappedFile::prefetch() const
+	{
+		if (m_pData == nullptr) return;
+		WIN32_MEMORY_RANGE_ENTRY range{ const_cast<uint8_t*>(m_pData), m_size };
+		PrefetchVirtualMemory(GetCurrentProcess(), 1, &range, 0);
+	}
+#else
+	bool MappedFile::open(const std::string& path)
+	{
+		close();
+		int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+		if (fd < 0) return false;
+		struct stat status {};
+		if (fstat(fd, &status) != 0 || status.st_size == 0) {
+			::close(fd);
+			return false;
+		}
+		void* view = mmap(nullptr, static_cast<size_t>(status.st_size), PROT_READ, MAP_PRIVATE, fd, 0);
+		//the mapping keeps the file alive
+		::close(fd);
+		if (view == MAP_FAILED) return false;
+		//decoders read front to back
+		madvise(view, static_cast<size_t>(status.st_size), MADV_SEQUENTIAL);
+		m_pData = static_cast<const uint8_t*>(view);
+		m_size = static_cast<size_t>(status.st_size);
+		return true;
+	}
+	//-----------------------------------------------------------------------------------------------
+	void MappedFile::close()
+	{
+		if (m_pData) munmap(const_cast<uint8_t*>(m_pData), m_size);
+		m_pData = nullptr;
+		m_size = 0;
+	}
+	//-----------------------------------------------------------------------------------------------
+	void MappedFile::prefetch() const
+	{
+		if (m_pData == nullptr) return;
+		madvise(const_cast<uint8_t*>(m_pData), m_size, MADV_WILLNEED);
+	}
+#endif
+}
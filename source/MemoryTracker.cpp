@@ -0,0 +1,405 @@
+#include "MemoryTracker.h"
+#include <atomic>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iterator>
+#include <iostream>
+#include <mutex>
+#include <sstream>
+#include <unordered_map>
+
+namespace Clan
+{
+	namespace
+	{
+		constexpr uint32_t MAX_CALLSITES = 1024;
+		//0 and 1 are fixed, the others are registered by memoryCallsite()
+		constexpr uint16_t OPERATOR_NEW_CALLSITE = 0;
+		constexpr uint16_t OVERFLOW_CALLSITE = 1;
+
+		struct Counter {
+			std::atomic<int64_t> current{ 0 };
+			std::atomic<int64_t> peak{ 0 };
+			std::atomic<uint64_t> allocations{ 0 };
+
+			void add(int64_t bytes)
+			{
+				int64_t now = current.fetch_add(bytes, std::memory_order_relaxed) + bytes;
+				int64_t peakBytes = peak.load(std::memory_order_relaxed);
+				while (now > peakBytes && !peak.compare_exchange_weak(peakBytes, now, std::memory_order_relaxed)) {}
+				allocations.fetch_add(1, std::memory_order_relaxed);
+			}
+
+			void remove(int64_t bytes)
+			{
+				current.fetch_sub(bytes, std::memory_order_relaxed);
+			}
+
+			MemoryStats stats() const
+			{
+				return MemoryStats{ current.load(std::memory_order_relaxed), peak.load(std::memory_order_relaxed),
+					allocations.load(std::memory_order_relaxed) };
+			}
+		};
+
+		//in front of every tracked block, keeps the blocks 16 byte aligned
+		struct alignas(16) BlockHeader {
+			uint64_t size;
+			uint32_t offset;
+			uint16_t callsite;
+			MemoryTag tag;
+		};
+		static_assert(sizeof(BlockHeader) == 16);
+
+		struct DeviceAllocation {
+			uint32_t heap;
+			VkDeviceSize size;
+		};
+
+		//nothing in here allocates, global operator new can use it at any time, even before main
+		struct Tracker {
+			Counter tags[static_cast<size_t>(MemoryTag::Count)]{};
+			const char* callsiteNames[MAX_CALLSITES]{ "operator new", "other" };
+			Counter callsites[MAX_CALLSITES]{};
+			std::atomic<uint32_t> callsiteCount{ 2 };
+			std::mutex callsiteMutex{};
+			VkPhysicalDevice physicalDevice{};
+			VkPhysicalDeviceMemoryProperties memoryProperties{};
+			bool budgetSupported{ false };
+			Counter heaps[VK_MAX_MEMORY_HEAPS]{};
+			bool overBudget[VK_MAX_MEMORY_HEAPS]{};
+		};
+
+		Tracker& tracker()
+		{
+			static Tracker instance;
+			return instance;
+		}
+
+		//handle -> heap and size, only touched on device allocations
+		std::unordered_map<VkDeviceMemory, DeviceAllocation>& deviceAllocations(std::unique_lock<std::mutex>& lock)
+		{
+			static std::mutex mutex;
+			static std::unordered_map<VkDeviceMemory, DeviceAllocation> allocations;
+			lock = std::unique_lock<std::mutex>(mutex);
+			return allocations;
+		}
+
+		inline BlockHeader* headerOf(void* pointer)
+		{
+			return reinterpret_cast<BlockHeader*>(pointer) - 1;
+		}
+
+		uint16_t driverCallsite(VkSystemAllocationScope scope)
+		{
+			static const uint16_t callsites[] = {
+				memoryCallsite("vulkan command"),
+				memoryCallsite("vulkan object"),
+				memoryCallsite("vulkan cache"),
+				memoryCallsite("vulkan device"),
+				memoryCallsite("vulkan instance"),
+			};
+			return static_cast<uint32_t>(scope) < std::size(callsites) ? callsites[scope] : OVERFLOW_CALLSITE;
+		}
+
+		void* VKAPI_PTR driverAllocation(void*, size_t size, size_t alignment, VkSystemAllocationScope scope)
+		{
+			return trackedAlloc(size, alignment, MemoryTag::Driver, driverCallsite(scope));
+		}
+
+		void* VKAPI_PTR driverReallocation(void*, void* pOriginal, size_t size, size_t alignment, VkSystemAllocationScope scope)
+		{
+			if (pOriginal == nullptr) return trackedAlloc(size, alignment, MemoryTag::Driver, driverCallsite(scope));
+			if (size == 0) {
+				trackedFree(pOriginal);
+				return nullptr;
+			}
+			void* pointer = trackedAlloc(size, alignment, MemoryTag::Driver, driverCallsite(scope));
+			if (pointer == nullptr) return nullptr;
+			size_t originalSize = static_cast<size_t>(headerOf(pOriginal)->size);
+			std::memcpy(pointer, pOriginal, originalSize < size ? originalSize : size);
+			trackedFree(pOriginal);
+			return pointer;
+		}
+
+		void VKAPI_PTR driverFree(void*, void* pMemory)
+		{
+			trackedFree(pMemory);
+		}
+
+		void VKAPI_PTR driverInternalAllocation(void*, size_t size, VkInternalAllocationType, VkSystemAllocationScope)
+		{
+			tracker().tags[static_cast<size_t>(MemoryTag::DriverInternal)].add(static_cast<int64_t>(size));
+		}
+
+		void VKAPI_PTR driverInternalFree(void*, size_t size, VkInternalAllocationType, VkSystemAllocationScope)
+		{
+			tracker().tags[static_cast<size_t>(MemoryTag::DriverInternal)].remove(static_cast<int64_t>(size));
+		}
+
+		void writeStats(std::ostream& json, const MemoryStats& stats)
+		{
+			json << "\"currentBytes\": " << stats.currentBytes << ", \"peakBytes\": " << stats.peakBytes
+				<< ", \"allocations\": " << stats.allocationCount;
+		}
+
+		//callsites are file paths, with backslashes on Windows
+		std::string escapeJson(const char* text)
+		{
+			std::string escaped;
+			for (; *text != '\0'; ++text) {
+				if (*text == '\\' || *text == '"') escaped += '\\';
+				escaped += *text;
+			}
+			return escaped;
+		}
+	}
+	//-----------------------------------------------------------------------------------------------
+	const char* memoryTagName(MemoryTag tag)
+	{
+		switch (tag) {
+		case MemoryTag::Untagged: return "untagged";
+		case MemoryTag::Geometry: return "geometry";
+		case MemoryTag::StackAllocator: return "stack allocator";
+		case MemoryTag::Driver: return "driver";
+		case MemoryTag::DriverInternal: return "driver internal";
+		default: return "unknown";
+		}
+	}
+	//-----------------------------------------------------------------------------------------------
+	void* trackedAlloc(size_t size, size_t alignment, MemoryTag tag, uint16_t callsite)
+	{
+		if (alignment < alignof(BlockHeader)) alignment = alignof(BlockHeader);
+		uint8_t* pRaw = static_cast<uint8_t*>(std::malloc(size + sizeof(BlockHeader) + alignment));
+		if (pRaw == nullptr) return nullptr;
+		uintptr_t address = reinterpret_cast<uintptr_t>(pRaw + sizeof(BlockHeader));
+		uint8_t* pBlock = reinterpret_cast<uint8_t*>((address + alignment - 1) & ~(static_cast<uintptr_t>(alignment) - 1));
+		BlockHeader* pHeader = headerOf(pBlock);
+		pHeader->size = size;
+		pHeader->offset = static_cast<uint32_t>(pBlock - pRaw);
+		pHeader->callsite = callsite;
+		pHeader->tag = tag;
+		Tracker& state = tracker();
+		state.tags[static_cast<size_t>(tag)].add(static_cast<int64_t>(size));
+		state.callsites[callsite].add(static_cast<int64_t>(size));
+		return pBlock;
+	}
+	//-----------------------------------------------------------------------------------------------
+	void trackedFree(void* pointer)
+	{
+		if (pointer == nullptr) return;
+		BlockHeader* pHeader = headerOf(pointer);
+		Tracker& state = tracker();
+		state.tags[static_cast<size_t>(pHeader->tag)].remove(static_cast<int64_t>(pHeader->size));
+		state.callsites[pHeader->callsite].remove(static_cast<int64_t>(pHeader->size));
+		std::free(static_cast<uint8_t*>(pointer) - pHeader->offset);
+	}
+	//-----------------------------------------------------------------------------------------------
+	uint16_t memoryCallsite(const char* name)
+	{
+		Tracker& state = tracker();
+		std::lock_guard<std::mutex> lock(state.callsiteMutex);
+		uint32_t count = state.callsiteCount.load(std::memory_order_relaxed);
+		for (uint32_t i = 0; i < count; ++i) {
+			if (std::strcmp(state.callsiteNames[i], name) == 0) return static_cast<uint16_t>(i);
+		}
+		if (count == MAX_CALLSITES) return OVERFLOW_CALLSITE;
+		state.callsiteNames[count] = name;
+		state.callsiteCount.store(count + 1, std::memory_order_release);
+		return static_cast<uint16_t>(count);
+	}
+	//-----------------------------------------------------------------------------------------------
+	MemoryStats hostMemoryStats(MemoryTag tag)
+	{
+		return tracker().tags[static_cast<size_t>(tag)].stats();
+	}
+	//-----------------------------------------------------------------------------------------------
+	const VkAllocationCallbacks* vulkanAllocator()
+	{
+		static const VkAllocationCallbacks callbacks{
+			nullptr,
+			driverAllocation,
+			driverReallocation,
+			driverFree,
+			driverInternalAllocation,
+			driverInternalFree,
+		};
+		return &callbacks;
+	}
+	//-----------------------------------------------------------------------------------------------
+	void initDeviceMemoryTracking(VkPhysicalDevice physicalDevice, bool budgetSupported)
+	{
+		Tracker& state = tracker();
+		state.physicalDevice = physicalDevice;
+		state.budgetSupported = budgetSupported;
+		vkGetPhysicalDeviceMemoryProperties(physicalDevice, &state.memoryProperties);
+	}
+	//-----------------------------------------------------------------------------------------------
+	VkResult allocateDeviceMemory(VkDevice device, const VkMemoryAllocateInfo* pAllocateInfo, VkDeviceMemory* pMemory)
+	{
+		VkResult result = vkAllocateMemory(device, pAllocateInfo, vulkanAllocator(), pMemory);
+		if (result != VK_SUCCESS) return result;
+		Tracker& state = tracker();
+		uint32_t heap = state.memoryProperties.memoryTypes[pAllocateInfo->memoryTypeIndex].heapIndex;
+		state.heaps[heap].add(static_cast<int64_t>(pAllocateInfo->allocationSize));
+		std::unique_lock<std::mutex> lock;
+		deviceAllocations(lock)[*pMemory] = DeviceAllocation{ heap, pAllocateInfo->allocationSize };
+		return result;
+	}
+	//-----------------------------------------------------------------------------------------------
+	void freeDeviceMemory(VkDevice device, VkDeviceMemory memory)
+	{
+		if (memory == VK_NULL_HANDLE) return;
+		{
+			std::unique_lock<std::mutex> lock;
+			auto& allocations = deviceAllocations(lock);
+			auto it = allocations.find(memory);
+			if (it != allocations.end()) {
+				tracker().heaps[it->second.heap].remove(static_cast<int64_t>(it->second.size));
+				allocations.erase(it);
+			}
+		}
+		vkFreeMemory(device, memory, vulkanAllocator());
+	}
+	//-----------------------------------------------------------------------------------------------
+	MemoryStats deviceMemoryStats(uint32_t heapIndex)
+	{
+		return tracker().heaps[heapIndex].stats();
+	}
+	//-----------------------------------------------------------------------------------------------
+	bool checkMemoryBudget()
+	{
+		Tracker& state = tracker();
+		if (state.physicalDevice == VK_NULL_HANDLE) return true;
+		VkPhysicalDeviceMemoryBudgetPropertiesEXT budget{};
+		budget.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_MEMORY_BUDGET_PROPERTIES_EXT;
+		VkPhysicalDeviceMemoryProperties2 properties{};
+		properties.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_MEMORY_PROPERTIES_2;
+		if (state.budgetSupported) {
+			properties.pNext = &budget;
+			vkGetPhysicalDeviceMemoryProperties2(state.physicalDevice, &properties);
+		}
+		bool withinBudget = true;
+		for (uint32_t i = 0; i < state.memoryProperties.memoryHeapCount; ++i) {
+			//the driver's usage includes other processes and its own allocations, ours alone count without it
+			VkDeviceSize usage = state.budgetSupported ? budget.heapUsage[i] : static_cast<VkDeviceSize>(state.heaps[i].stats().currentBytes);
+			VkDeviceSize limit = state.budgetSupported ? budget.heapBudget[i] : state.memoryProperties.memoryHeaps[i].size;
+			bool over = usage > limit;
+			if (over && !state.overBudget[i]) {
+				std::cerr << "memory heap " << i << " is over budget: " << usage / (1024 * 1024) << " of "
+					<< limit / (1024 * 1024) << " MB used" << std::endl;
+			}
+			state.overBudget[i] = over;
+			withinBudget = withinBudget && !over;
+		}
+		return withinBudget;
+	}
+	//-----------------------------------------------------------------------------------------------
+	std::string memoryReportJson()
+	{
+		Tracker& state = tracker();
+		std::ostringstream json;
+		json << "{\"host\": {\"tags\": [";
+		for (size_t i = 0; i < static_cast<size_t>(MemoryTag::Count); ++i) {
+			json << (i > 0 ? ", " : "") << "{\"name\": \"" << memoryTagName(static_cast<MemoryTag>(i)) << "\", ";
+			writeStats(json, state.tags[i].stats());
+			json << "}";
+		}
+		json << "], \"callsites\": [";
+		uint32_t callsiteCount = state.callsiteCount.load(std::memory_order_acquire);
+		for (uint32_t i = 0; i < callsiteCount; ++i) {
+			json << (i > 0 ? ", " : "") << "{\"name\": \"" << escapeJson(state.callsiteNames[i]) << "\", ";
+			writeStats(json, state.callsites[i].stats());
+			json << "}";
+		}
+		json << "]}, \"device\": {\"budgetExtension\": " << (state.budgetSupported ? "true" : "false") << ", \"heaps\": [";
+		VkPhysicalDeviceMemoryBudgetPropertiesEXT budget{};
+		budget.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_MEMORY_BUDGET_PROPERTIES_EXT;
+		if (state.budgetSupported) {
+			VkPhysicalDeviceMemoryProperties2 properties{};
+			properties.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_MEMORY_PROPERTIES_2;
+			properties.pNext = &budget;
+			vkGetPhysicalDeviceMemoryProperties2(state.physicalDevice, &properties);
+		}
+		for (uint32_t i = 0; i < state.memoryProperties.memoryHeapCount; ++i) {
+			const VkMemoryHeap& heap = state.memoryProperties.memoryHeaps[i];
+			json << (i > 0 ? ", " : "") << "{\"index\": " << i << ", \"sizeBytes\": " << heap.size
+				<< ", \"deviceLocal\": " << ((heap.flags & VK_MEMORY_HEAP_DEVICE_LOCAL_BIT) ? "true" : "false") << ", ";
+			writeStats(json, state.heaps[i].stats());
+			if (state.budgetSupported) {
+				json << ", \"budgetBytes\": " << budget.heapBudget[i] << ", \"usageBytes\": " << budget.heapUsage[i];
+			}
+			json << "}";
+		}
+		json << "]}}";
+		return json.str();
+	}
+	//-----------------------------------------------------------------------------------------------
+	bool writeMemoryReport(const std::string& path)
+	{
+		std::ofstream file(path, std::ios::trunc);
+		file << memoryReportJson() << std::endl;
+		return file.good();
+	}
+}
+//-----------------------------------------------------------------------------------------------
+#ifdef CLAN_TRACK_MEMORY
+//Every other heap allocation of the process, counted as untagged. The blocks are tracked blocks,
+//so memory from new must not be handed to free() or the other way round. Only in builds with
+//CLAN_TRACK_MEMORY, every new and delete of every thread updates the shared counters.
+void* operator new(size_t size)
+{
+	void* pointer = Clan::trackedAlloc(size, __STDCPP_DEFAULT_NEW_ALIGNMENT__, Clan::MemoryTag::Untagged, 0);
+	if (pointer == nullptr) throw std::bad_alloc();
+	return pointer;
+}
+
+void* operator new[](size_t size)
+{
+	return operator new(size);
+}
+
+void* operator new(size_t size, std::align_val_t alignment)
+{
+	void* pointer = Clan::trackedAlloc(size, static_cast<size_t>(alignment), Clan::MemoryTag::Untagged, 0);
+	if (pointer == nullptr) throw std::bad_alloc();
+	return pointer;
+}
+
+void* operator new[](size_t size, std::align_val_t alignment)
+{
+	return operator new(size, alignment);
+}
+
+void* operator new(size_t size, const std::nothrow_t&) noexcept
+{
+	return Clan::trackedAlloc(size, __STDCPP_DEFAULT_NEW_ALIGNMENT__, Clan::MemoryTag::Untagged, 0);
+}
+
+void* operator new[](size_t size, const std::nothrow_t&) noexcept
+{
+	return Clan::trackedAlloc(size, __STDCPP_DEFAULT_NEW_ALIGNMENT__, Clan::MemoryTag::Untagged, 0);
+}
+
+void* operator new(size_t size, std::align_val_t alignment, const std::nothrow_t&) noexcept
+{
+	return Clan::trackedAlloc(size, static_cast<size_t>(alignment), Clan::MemoryTag::Untagged, 0);
+}
+
+void* operator new[](size_t size, std::align_val_t alignment, const std::nothrow_t&) noexcept
+{
+	return Clan::trackedAlloc(size, static_cast<size_t>(alignment), Clan::MemoryTag::Untagged, 0);
+}
+
+void operator delete(void* pointer) noexcept { Clan::trackedFree(pointer); }
+void operator delete[](void* pointer) noexcept { Clan::trackedFree(pointer); }
+void operator delete(void* pointer, size_t) noexcept { Clan::trackedFree(pointer); }
+void operator delete[](void* pointer, size_t) noexcept { Clan::trackedFree(pointer); }
+void operator delete(void* pointer, std::align_val_t) noexcept { Clan::trackedFree(pointer); }
+void operator delete[](void* pointer, std::align_val_t) noexcept { Clan::trackedFree(pointer); }
+void operator delete(void* pointer, size_t, std::align_val_t) noexcept { Clan::trackedFree(pointer); }
+void operator delete[](void* pointer, size_t, std::align_val_t) noexcept { Clan::trackedFree(pointer); }
+void operator delete(void* pointer, const std::nothrow_t&) noexcept { Clan::trackedFree(pointer); }
+void operator delete[](void* pointer, const std::nothrow_t&) noexcept { Clan::trackedFree(pointer); }
+#endif
@@ -0,0 +1,160 @@
+#include <algorithm>
+#include <array>
+#include <bit>
+#include "MipGenerator.h"
+#include "MemoryTracker.h"
+
+namespace Clan
+{
+	void MipGenerator::init(VkDevice device, const std::vector<char>& code)
+	{
+		m_device = device;
+		if (code.empty()) return;
+
+		//0: the level above, 1: the level being written
+		std::array<VkDescriptorSetLayoutBinding, 2> bindings{};
+		for (uint32_t i = 0; i < bindings.size(); ++i) {
+			bindings[i].binding = i;
+			bindings[i].descriptorCount = 1;
+			bindings[i].descriptorType = i == 1 ? VK_DESCRIPTOR_TYPE_STORAGE_IMAGE : VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+			bindings[i].stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+		}
+		VkDescriptorSetLayoutCreateInfo layoutInfo{};
+		layoutInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+		layoutInfo.bindingCount = static_cast<uint32_t>(bindings.size());
+		layoutInfo.pBindings = bindings.data();
+		VkResult result = vkCreateDescriptorSetLayout(m_device, &layoutInfo, vulkanAllocator(), &m_setLayout);
+		ASSERT(result == VK_SUCCESS);
+		VkPipelineLayoutCreateInfo pipelineLayoutInfo{};
+		pipelineLayoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+		pipelineLayoutInfo.setLayoutCount = 1;
+		pipelineLayoutInfo.pSetLayouts = &m_setLayout;
+		result = vkCreatePipelineLayout(m_device, &pipelineLayoutInfo, vulkanAllocator(), &m_pipelineLayout);
+		ASSERT(result == VK_SUCCESS);
+
+		VkShaderModuleCreateInfo moduleInfo{};
+		moduleInfo.sType = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO;
+		moduleInfo.codeSize = code.size();
+		moduleInfo.pCode = reinterpret_cast<const uint32_t*>(code.data());
+		VkShaderModule shaderModule{};
+		result = vkCreateShaderModule(m_device, &moduleInfo, vulkanAllocator(), &shaderModule);
+		ASSERT(result == VK_SUCCESS);
+		VkComputePipelineCreateInfo pipelineInfo{};
+		pipelineInfo.sType = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO;
+		pipelineInfo.stage.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+		pipelineInfo.stage.stage = VK_SHADER_STAGE_COMPUTE_BIT;
+		pipelineInfo.stage.module = shaderModule;
+		pipelineInfo.stage.pName = "main";
+		pipelineInfo.layout = m_pipelineLayout;
+		result = vkCreateComputePipelines(m_device, VK_NULL_HANDLE, 1, &pipelineInfo, vulkanAllocator(), &m_pipeline);
+		ASSERT(result == VK_SUCCESS);
+		vkDestroyShaderModule(m_device, shaderModule, vulkanAllocator());
+
+		//the shader samples the middle of every 2x2 block of the level above
+		VkSamplerCreateInfo samplerInfo{};
+		samplerInfo.sType = VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO;
+		samplerInfo.magFilter = VK_FILTER_LINEAR;
+		samplerInfo.minFilter = VK_FILTER_LINEAR;
+		samplerInfo.mipmapMode = VK_SAMPLER_MIPMAP_MODE_NEAREST;
+		samplerInfo.addressModeU = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+		samplerInfo.addressModeV = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+		samplerInfo.addressModeW = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+		samplerInfo.maxLod = 0.0f;
+		result = vkCreateSampler(m_device, &samplerInfo, vulkanAllocator(), &m_sampler);
+		ASSERT(result == VK_SUCCESS);
+		m_descriptors.init(m_device, 16, { { VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 1 }, { VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, 1 } });
+	}
+	//-----------------------------------------------------------------------------------------------
+	void MipGenerator::destroy()
+	{
+		if (!isAvailable()) return;
+		reset();
+		m_descriptors.destroy();
+		vkDestroySampler(m_device, m_sampler, vulkanAllocator());
+		vkDestroyPipeline(m_device, m_pipeline, vulkanAllocator());
+		vkDestroyPipelineLayout(m_device, m_pipelineLayout, vulkanAllocator());
+		vkDestroyDescriptorSetLayout(m_device, m_setLayout, vulkanAllocator());
+		m_pipeline = VK_NULL_HANDLE;
+	}
+	//-----------------------------------------------------------------------------------------------
+	void MipGenerator::record(VkCommandBuffer commandBuffer, VkImage image, uint32_t width, uint32_t height, uint32_t mipLevels)
+	{
+		ASSERT(isAvailable());
+		if (mipLevels <= 1) return;
+		//the levels below 0 have no contents yet
+		VkImageMemoryBarrier2 barrier{};
+		barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER_2;
+		barrier.srcStageMask = VK_PIPELINE_STAGE_2_NONE;
+		barrier.srcAccessMask = 0;
+		barrier.dstStageMask = VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT;
+		barrier.dstAccessMask = VK_ACCESS_2_SHADER_STORAGE_WRITE_BIT;
+		barrier.oldLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+		barrier.newLayout = VK_IMAGE_LAYOUT_GENERAL;
+		barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+		barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+		barrier.image = image;
+		barrier.subresourceRange = { VK_IMAGE_ASPECT_COLOR_BIT, 1, mipLevels - 1, 0, 1 };
+		VkDependencyInfo dependencyInfo{};
+		dependencyInfo.sType = VK_STRUCTURE_TYPE_DEPENDENCY_INFO;
+		dependencyInfo.imageMemoryBarrierCount = 1;
+		dependencyInfo.pImageMemoryBarriers = &barrier;
+		vkCmdPipelineBarrier2(commandBuffer, &dependencyInfo);
+
+		vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, m_pipeline);
+		for (uint32_t level = 1; level < mipLevels; ++level) {
+			uint32_t levelWidth = std::max(width >> level, 1u);
+			uint32_t levelHeight = std::max(height >> level, 1u);
+			DescriptorWriter writer;
+			writer.image(0, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, createView(image, SAMPLED_FORMAT, VK_IMAGE_USAGE_SAMPLED_BIT, level - 1),
+				m_sampler, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
+			writer.image(1, VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, createView(image, STORAGE_FORMAT, VK_IMAGE_USAGE_STORAGE_BIT, level),
+				VK_NULL_HANDLE, VK_IMAGE_LAYOUT_GENERAL);
+			VkDescriptorSet set = m_descriptors.get(m_setLayout, writer);
+			vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, m_pipelineLayout, 0, 1, &set, 0, nullptr);
+			vkCmdDispatch(commandBuffer, (levelWidth + GROUP_SIZE - 1) / GROUP_SIZE, (levelHeight + GROUP_SIZE - 1) / GROUP_SIZE, 1);
+			//the next level samples this one, the last barrier chains into the release of the async queue
+			barrier.srcStageMask = VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT;
+			barrier.srcAccessMask = VK_ACCESS_2_SHADER_STORAGE_WRITE_BIT;
+			barrier.dstStageMask = VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT;
+			barrier.dstAccessMask = VK_ACCESS_2_SHADER_SAMPLED_READ_BIT;
+			barrier.oldLayout = VK_IMAGE_LAYOUT_GENERAL;
+			barrier.newLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+			barrier.subresourceRange = { VK_IMAGE_ASPECT_COLOR_BIT, level, 1, 0, 1 };
+			vkCmdPipelineBarrier2(commandBuffer, &dependencyInfo);
+		}
+	}
+	//-----------------------------------------------------------------------------------------------
+	void MipGenerator::reset()
+	{
+		for (VkImageView view : m_views) {
+			vkDestroyImageView(m_device, view, vulkanAllocator());
+		}
+		m_views.clear();
+		m_descriptors.reset();
+	}
+	//-----------------------------------------------------------------------------------------------
+	uint32_t MipGenerator::mipLevels(uint32_t width, uint32_t height)
+	{
+		return static_cast<uint32_t>(std::bit_width(std::max(width, height)));
+	}
+	//-----------------------------------------------------------------------------------------------
+	VkImageView MipGenerator::createView(VkImage image, VkFormat format, VkImageUsageFlags usage, uint32_t level)
+	{
+		//the image's usage has both, each format only supports its own
+		VkImageViewUsageCreateInfo usageInfo{};
+		usageInfo.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_USAGE_CREATE_INFO;
+		usageInfo.usage = usage;
+		VkImageViewCreateInfo viewInfo{};
+		viewInfo.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
+		viewInfo.pNext = &usageInfo;
+		viewInfo.image = image;
+		viewInfo.viewType = VK_IMAGE_VIEW_TYPE_2D;
+		viewInfo.format = format;
+		viewInfo.subresourceRange = { VK_IMAGE_ASPECT_COLOR_BIT, level, 1, 0, 1 };
+		VkImageView view{};
+		VkResult result = vkCreateImageView(m_device, &viewInfo, vulkanAllocator(), &view);
+		ASSERT(result == VK_SUCCESS);
+		m_views.push_back(view);
+		return view;
+	}
+}
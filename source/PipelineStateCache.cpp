@@ -0,0 +1,390 @@
+#include "PipelineStateCache.h"
+#include "MemoryTracker.h"
+#include <algorithm>
+#include <fstream>
+#include <sstream>
+#include <cstring>
+#include "ShaderReflection.h"
+
+namespace Clan
+{
+	namespace
+	{
+		void hashBytes(uint64_t& hash, const void* pData, size_t size)
+		{
+			//FNV-1a
+			const uint8_t* pBytes = static_cast<const uint8_t*>(pData);
+			for (size_t i = 0; i < size; ++i) {
+				hash = (hash ^ pBytes[i]) * 1099511628211ull;
+			}
+		}
+
+		template<typename T>
+		void hashValue(uint64_t& hash, const T& value)
+		{
+			hashBytes(hash, &value, sizeof(value));
+		}
+	}
+
+	uint64_t PipelineKey::hash() const
+	{
+		uint64_t hash = 14695981039346656037ull;
+		hashBytes(hash, vertexShader.data(), vertexShader.size() + 1);
+		hashBytes(hash, fragmentShader.data(), fragmentShader.size() + 1);
+		hashValue(hash, vertexStride);
+		hashValue(hash, topology);
+		hashValue(hash, polygonMode);
+		hashValue(hash, cullMode);
+		hashValue(hash, frontFace);
+		hashValue(hash, depthTest);
+		hashValue(hash, depthWrite);
+		hashValue(hash, depthCompare);
+		hashValue(hash, blendMode);
+		hashValue(hash, colorFormat);
+		hashValue(hash, depthFormat);
+		hashValue(hash, samples);
+		for (const SpecializationConstant& constant : constants) {
+			hashValue(hash, constant.id);
+			hashValue(hash, constant.value);
+		}
+		return hash;
+	}
+	//-----------------------------------------------------------------------------------------------
+	std::string PipelineKey::serialize() const
+	{
+		std::ostringstream line;
+		line << vertexShader << ' ' << fragmentShader << ' ' << vertexStride << ' ' << topology << ' ' << polygonMode
+			<< ' ' << cullMode << ' ' << frontFace << ' ' << depthTest << ' ' << depthWrite << ' ' << depthCompare
+			<< ' ' << static_cast<uint32_t>(blendMode) << ' ' << colorFormat << ' ' << depthFormat << ' ' << samples
+			<< ' ' << constants.size();
+		for (const SpecializationConstant& constant : constants) {
+			line << ' ' << constant.id << ' ' << constant.value;
+		}
+		return line.str();
+	}
+	//-----------------------------------------------------------------------------------------------
+	bool PipelineKey::deserialize(const std::string& line)
+	{
+		std::istringstream input(line);
+		uint32_t values[12]{};
+		size_t constantCount = 0;
+		input >> vertexShader >> fragmentShader;
+		for (uint32_t& value : values) {
+			input >> value;
+		}
+		input >> constantCount;
+		if (!input) return false;
+		vertexStride = values[0];
+		topology = static_cast<VkPrimitiveTopology>(values[1]);
+		polygonMode = static_cast<VkPolygonMode>(values[2]);
+		cullMode = values[3];
+		frontFace = static_cast<VkFrontFace>(values[4]);
+		depthTest = values[5] != 0;
+		depthWrite = values[6] != 0;
+		depthCompare = static_cast<VkCompareOp>(values[7]);
+		blendMode = static_cast<BlendMode>(values[8]);
+		colorFormat = static_cast<VkFormat>(values[9]);
+		depthFormat = static_cast<VkFormat>(values[10]);
+		samples = static_cast<VkSampleCountFlagBits>(values[11]);
+		constants.resize(constantCount);
+		for (SpecializationConstant& constant : constants) {
+			input >> constant.id >> constant.value;
+		}
+		return static_cast<bool>(input);
+	}
+	//-----------------------------------------------------------------------------------------------
+	void PipelineStateCache::init(VkDevice device, VkPhysicalDevice physicalDevice, LayoutCache* pLayoutCache,
+		const std::string& shaderDirectory, const std::string& cacheFile, const AssetArchive* pArchive)
+	{
+		m_device = device;
+		m_pLayoutCache = pLayoutCache;
+		m_shaderDirectory = shaderDirectory;
+		m_pArchive = pArchive;
+		m_cacheFile = cacheFile;
+		vkGetPhysicalDeviceProperties(physicalDevice, &m_properties);
+
+		//the driver validates the data as well, the header check just avoids handing it another GPU's cache
+		std::vector<char> data;
+		std::ifstream file(cacheFile, std::ios::ate | std::ios::binary);
+		if (file.is_open()) {
+			data.resize(static_cast<size_t>(file.tellg()));
+			file.seekg(0);
+			file.read(data.data(), data.size());
+		}
+		VkPipelineCacheHeaderVersionOne header{};
+		if (data.size() >= sizeof(header)) {
+			memcpy(&header, data.data(), sizeof(header));
+		}
+		bool compatible = header.headerVersion == VK_PIPELINE_CACHE_HEADER_VERSION_ONE
+			&& header.vendorID == m_properties.vendorID && header.deviceID == m_properties.deviceID
+			&& memcmp(header.pipelineCacheUUID, m_properties.pipelineCacheUUID, VK_UUID_SIZE) == 0;
+
+		VkPipelineCacheCreateInfo cacheInfo{};
+		cacheInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_CACHE_CREATE_INFO;
+		cacheInfo.initialDataSize = compatible ? data.size() : 0;
+		cacheInfo.pInitialData = compatible ? data.data() : nullptr;
+		VkResult result = vkCreatePipelineCache(m_device, &cacheInfo, vulkanAllocator(), &m_pipelineCache);
+		ASSERT(result == VK_SUCCESS);
+	}
+	//-----------------------------------------------------------------------------------------------
+	void PipelineStateCache::destroy()
+	{
+		savePipelineCache();
+		for (auto& [key, pipeline] : m_variants) {
+			vkDestroyPipeline(m_device, pipeline, vulkanAllocator());
+		}
+		m_variants.clear();
+		m_shaderCode.clear();
+		m_looseShaders.clear();
+		vkDestroyPipelineCache(m_device, m_pipelineCache, vulkanAllocator());
+		m_pipelineCache = VK_NULL_HANDLE;
+	}
+	//-----------------------------------------------------------------------------------------------
+	VkPipeline PipelineStateCache::get(const PipelineKey& key, VkRenderPass renderPass)
+	{
+		auto it = m_variants.find(key);
+		if (it != m_variants.end()) return it->second;
+		++m_misses;
+		VkPipeline pipeline = build(key, renderPass, layout(key), shaderCode(key.vertexShader), shaderCode(key.fragmentShader));
+		if (pipeline != VK_NULL_HANDLE) {
+			m_variants.emplace(key, pipeline);
+		}
+		return pipeline;
+	}
+	//-----------------------------------------------------------------------------------------------
+	VkPipelineLayout PipelineStateCache::layout(const PipelineKey& key)
+	{
+		ShaderReflection reflection{};
+		ShaderReflection fragmentReflection{};
+		bool parsed = reflection.parse(shaderCode(key.vertexShader)) && fragmentReflection.parse(shaderCode(key.fragmentShader));
+		ASSERT(parsed);
+		reflection.merge(fragmentReflection);
+		return m_pLayoutCache->pipelineLayout(reflection);
+	}
+	//-----------------------------------------------------------------------------------------------
+	VkPipeline PipelineStateCache::build(const PipelineKey& key, VkRenderPass renderPass, VkPipelineLayout layout,
+		const std::vector<char>& vertexCode, const std::vector<char>& fragmentCode) const
+	{
+		//vertex inputs are reflected first, a shader that doesn't match the vertex is rejected before anything is created
+		ShaderReflection vertexReflection{};
+		if (!vertexReflection.parse(vertexCode) || !ShaderReflection{}.parse(fragmentCode)) return VK_NULL_HANDLE;
+		VkVertexInputBindingDescription bindingDescription = vertexReflection.vertexBinding();
+		std::vector<VkVertexInputAttributeDescription> attributeDescriptions = vertexReflection.vertexAttributes();
+		if (bindingDescription.stride != key.vertexStride) return VK_NULL_HANDLE;
+
+		//specialization constants are all 32 bit
+		std::vector<VkSpecializationMapEntry> mapEntries(key.constants.size());
+		std::vector<uint32_t> constantData(key.constants.size());
+		for (size_t i = 0; i < key.constants.size(); ++i) {
+			mapEntries[i].constantID = key.constants[i].id;
+			mapEntries[i].offset = static_cast<uint32_t>(i * sizeof(uint32_t));
+			mapEntries[i].size = sizeof(uint32_t);
+			constantData[i] = key.constants[i].value;
+		}
+		VkSpecializationInfo specialization{};
+		specialization.mapEntryCount = static_cast<uint32_t>(mapEntries.size());
+		specialization.pMapEntries = mapEntries.data();
+		specialization.dataSize = constantData.size() * sizeof(uint32_t);
+		specialization.pData = constantData.data();
+
+		VkShaderModule vertexModule = createShaderModule(vertexCode);
+		VkShaderModule fragmentModule = createShaderModule(fragmentCode);
+		VkPipelineShaderStageCreateInfo shaderStages[2]{};
+		shaderStages[0].sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+		shaderStages[0].stage = VK_SHADER_STAGE_VERTEX_BIT;
+		shaderStages[0].module = vertexModule;
+		shaderStages[0].pName = "main";
+		shaderStages[0].pSpecializationInfo = key.constants.empty() ? nullptr : &specialization;
+		shaderStages[1] = shaderStages[0];
+		shaderStages[1].stage = VK_SHADER_STAGE_FRAGMENT_BIT;
+		shaderStages[1].module = fragmentModule;
+
+		VkPipelineVertexInputStateCreateInfo vertexInput{};
+		vertexInput.sType = VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO;
+		vertexInput.vertexBindingDescriptionCount = 1;
+		vertexInput.pVertexBindingDescriptions = &bindingDescription;
+		vertexInput.vertexAttributeDescriptionCount = static_cast<uint32_t>(attributeDescriptions.size());
+		vertexInput.pVertexAttributeDescriptions = attributeDescriptions.data();
+		VkPipelineInputAssemblyStateCreateInfo inputAssembly{};
+		inputAssembly.sType = VK_STRUCTURE_TYPE_PIPELINE_INPUT_ASSEMBLY_STATE_CREATE_INFO;
+		inputAssembly.topology = key.topology;
+		inputAssembly.primitiveRestartEnable = VK_FALSE;
+		//viewport and scissor are dynamic, so pipelines survive swapchain resizes
+		VkPipelineViewportStateCreateInfo viewportState{};
+		viewportState.sType = VK_STRUCTURE_TYPE_PIPELINE_VIEWPORT_STATE_CREATE_INFO;
+		viewportState.viewportCount = 1;
+		viewportState.scissorCount = 1;
+		VkPipelineRasterizationStateCreateInfo rasterizer{};
+		rasterizer.sType = VK_STRUCTURE_TYPE_PIPELINE_RASTERIZATION_STATE_CREATE_INFO;
+		rasterizer.depthClampEnable = VK_FALSE;
+		rasterizer.rasterizerDiscardEnable = VK_FALSE;
+		rasterizer.polygonMode = key.polygonMode;
+		rasterizer.cullMode = key.cullMode;
+		rasterizer.frontFace = key.frontFace;
+		rasterizer.depthBiasEnable = VK_FALSE;
+		rasterizer.lineWidth = 1.0f;
+		VkPipelineDepthStencilStateCreateInfo depthStencil{};
+		depthStencil.sType = VK_STRUCTURE_TYPE_PIPELINE_DEPTH_STENCIL_STATE_CREATE_INFO;
+		depthStencil.depthTestEnable = key.depthTest ? VK_TRUE : VK_FALSE;
+		depthStencil.depthWriteEnable = key.depthWrite ? VK_TRUE : VK_FALSE;
+		depthStencil.depthCompareOp = key.depthCompare;
+		depthStencil.depthBoundsTestEnable = VK_FALSE;
+		depthStencil.minDepthBounds = 0.0f;
+		depthStencil.maxDepthBounds = 1.0f;
+		depthStencil.stencilTestEnable = VK_FALSE;
+		VkPipelineMultisampleStateCreateInfo multisampling{};
+		multisampling.sType = VK_STRUCTURE_TYPE_PIPELINE_MULTISAMPLE_STATE_CREATE_INFO;
+		multisampling.rasterizationSamples = key.samples;
+		multisampling.sampleShadingEnable = VK_FALSE;
+		multisampling.minSampleShading = 1.0f;
+		VkPipelineColorBlendAttachmentState colorBlendAttachment{};
+		colorBlendAttachment.blendEnable = key.blendMode == BlendMode::Opaque ? VK_FALSE : VK_TRUE;
+		colorBlendAttachment.srcColorBlendFactor = key.blendMode == BlendMode::Alpha ? VK_BLEND_FACTOR_SRC_ALPHA : VK_BLEND_FACTOR_ONE;
+		colorBlendAttachment.dstColorBlendFactor = key.blendMode == BlendMode::Alpha ? VK_BLEND_FACTOR_ONE_MINUS_SRC_ALPHA : VK_BLEND_FACTOR_ONE;
+		colorBlendAttachment.colorBlendOp = VK_BLEND_OP_ADD;
+		colorBlendAttachment.srcAlphaBlendFactor = VK_BLEND_FACTOR_ONE;
+		colorBlendAttachment.dstAlphaBlendFactor = VK_BLEND_FACTOR_ZERO;
+		colorBlendAttachment.alphaBlendOp = VK_BLEND_OP_ADD;
+		colorBlendAttachment.colorWriteMask = VK_COLOR_COMPONENT_R_BIT | VK_COLOR_COMPONENT_G_BIT | VK_COLOR_COMPONENT_B_BIT | VK_COLOR_COMPONENT_A_BIT;
+		VkPipelineColorBlendStateCreateInfo colorBlending{};
+		colorBlending.sType = VK_STRUCTURE_TYPE_PIPELINE_COLOR_BLEND_STATE_CREATE_INFO;
+		colorBlending.logicOpEnable = VK_FALSE;
+		colorBlending.attachmentCount = 1;
+		colorBlending.pAttachments = &colorBlendAttachment;
+		VkDynamicState dynamicStates[] = {
+			VK_DYNAMIC_STATE_VIEWPORT,
+			VK_DYNAMIC_STATE_SCISSOR,
+		};
+		VkPipelineDynamicStateCreateInfo dynamicState{};
+		dynamicState.sType = VK_STRUCTURE_TYPE_PIPELINE_DYNAMIC_STATE_CREATE_INFO;
+		dynamicState.dynamicStateCount = 2;
+		dynamicState.pDynamicStates = dynamicStates;
+
+		VkGraphicsPipelineCreateInfo pipelineInfo{};
+		pipelineInfo.sType = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO;
+		pipelineInfo.stageCount = 2;
+		pipelineInfo.pStages = shaderStages;
+		pipelineInfo.pVertexInputState = &vertexInput;
+		pipelineInfo.pInputAssemblyState = &inputAssembly;
+		pipelineInfo.pViewportState = &viewportState;
+		pipelineInfo.pRasterizationState = &rasterizer;
+		pipelineInfo.pMultisampleState = &multisampling;
+		pipelineInfo.pDepthStencilState = &depthStencil;
+		pipelineInfo.pColorBlendState = &colorBlending;
+		pipelineInfo.pDynamicState = &dynamicState;
+		pipelineInfo.layout = layout;
+		//dynamic rendering: the attachment formats replace the render pass
+		VkPipelineRenderingCreateInfo renderingInfo{};
+		renderingInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_RENDERING_CREATE_INFO;
+		renderingInfo.colorAttachmentCount = 1;
+		renderingInfo.pColorAttachmentFormats = &key.colorFormat;
+		renderingInfo.depthAttachmentFormat = key.depthFormat;
+		if (renderPass == VK_NULL_HANDLE) {
+			pipelineInfo.pNext = &renderingInfo;
+		}
+		pipelineInfo.renderPass = renderPass;
+		pipelineInfo.subpass = 0;
+		pipelineInfo.basePipelineHandle = VK_NULL_HANDLE;
+		pipelineInfo.basePipelineIndex = -1;
+		VkPipeline pipeline = VK_NULL_HANDLE;
+		VkResult result = vkCreateGraphicsPipelines(m_device, m_pipelineCache, 1, &pipelineInfo, vulkanAllocator(), &pipeline);
+
+		vkDestroyShaderModule(m_device, vertexModule, vulkanAllocator());
+		vkDestroyShaderModule(m_device, fragmentModule, vulkanAllocator());
+		return result == VK_SUCCESS ? pipeline : VK_NULL_HANDLE;
+	}
+	//-----------------------------------------------------------------------------------------------
+	VkPipeline PipelineStateCache::insert(const PipelineKey& key, VkPipeline pipeline)
+	{
+		VkPipeline& variant = m_variants[key];
+		VkPipeline replaced = variant;
+		variant = pipeline;
+		return replaced;
+	}
+	//-----------------------------------------------------------------------------------------------
+	std::vector<VkPipeline> PipelineStateCache::invalidateShader(const std::string& shader)
+	{
+		m_shaderCode.erase(shader);
+		m_looseShaders.insert(shader);
+		std::vector<VkPipeline> removed;
+		for (auto it = m_variants.begin(); it != m_variants.end();) {
+			if (it->first.vertexShader == shader || it->first.fragmentShader == shader) {
+				removed.push_back(it->second);
+				it = m_variants.erase(it);
+			}
+			else {
+				++it;
+			}
+		}
+		return removed;
+	}
+	//-----------------------------------------------------------------------------------------------
+	bool PipelineStateCache::saveKeys(const std::string& path) const
+	{
+		std::ofstream file(path, std::ios::trunc);
+		if (!file.is_open()) return false;
+		for (const auto& [key, pipeline] : m_variants) {
+			file << key.serialize() << '\n';
+		}
+		return static_cast<bool>(file);
+	}
+	//-----------------------------------------------------------------------------------------------
+	uint32_t PipelineStateCache::precompile(const std::string& path, VkRenderPass renderPass, VkFormat colorFormat, VkSampleCountFlagBits samples)
+	{
+		std::ifstream file(path);
+		uint32_t built = 0;
+		std::string line;
+		while (std::getline(file, line)) {
+			PipelineKey key{};
+			if (!key.deserialize(line) || m_variants.count(key)) continue;
+			//a render pass is only compatible with pipelines of its own attachment formats
+			if (renderPass != VK_NULL_HANDLE && (key.colorFormat != colorFormat || key.samples != samples)) continue;
+			//shaders that were renamed or removed since the list was recorded are skipped
+			if (shaderCode(key.vertexShader).empty() || shaderCode(key.fragmentShader).empty()) continue;
+			if (get(key, renderPass) != VK_NULL_HANDLE) {
+				++built;
+			}
+		}
+		return built;
+	}
+	//-----------------------------------------------------------------------------------------------
+	const std::vector<char>& PipelineStateCache::shaderCode(const std::string& shader)
+	{
+		auto it = m_shaderCode.find(shader);
+		if (it != m_shaderCode.end()) return it->second;
+		std::vector<char> code;
+		std::string path = m_shaderDirectory + "/" + shader;
+		if (m_pArchive != nullptr && m_looseShaders.count(shader) == 0 && m_pArchive->read(path, code)) {
+			return m_shaderCode.emplace(shader, std::move(code)).first->second;
+		}
+		std::ifstream file(path, std::ios::ate | std::ios::binary);
+		if (file.is_open()) {
+			code.resize(static_cast<size_t>(file.tellg()));
+			file.seekg(0);
+			file.read(code.data(), code.size());
+		}
+		return m_shaderCode.emplace(shader, std::move(code)).first->second;
+	}
+	//-----------------------------------------------------------------------------------------------
+	void PipelineStateCache::savePipelineCache()
+	{
+		size_t size = 0;
+		if (vkGetPipelineCacheData(m_device, m_pipelineCache, &size, nullptr) != VK_SUCCESS || size == 0) return;
+		std::vector<char> data(size);
+		if (vkGetPipelineCacheData(m_device, m_pipelineCache, &size, data.data()) != VK_SUCCESS) return;
+		std::ofstream file(m_cacheFile, std::ios::binary | std::ios::trunc);
+		file.write(data.data(), static_cast<std::streamsize>(size));
+	}
+	//-----------------------------------------------------------------------------------------------
+	VkShaderModule PipelineStateCache::createShaderModule(const std::vector<char>& code) const
+	{
+		VkShaderModuleCreateInfo createInfo{};
+		createInfo.sType = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO;
+		createInfo.codeSize = code.size();
+		createInfo.pCode = reinterpret_cast<const uint32_t*>(code.data());
+		VkShaderModule shaderModule = VK_NULL_HANDLE;
+		VkResult result = vkCreateShaderModule(m_device, &createInfo, vulkanAllocator(), &shaderModule);
+		ASSERT(result == VK_SUCCESS);
+		return shaderModule;
+	}
+}
@@ -0,0 +1,129 @@
+#include "RenderCommandStream.h"
+#include <chrono>
+#include <iomanip>
+#include <iostream>
+#include <thread>
+#include <vector>
+
+namespace Clan
+{
+	void RenderCommandStream::init(uint32_t chunkCount)
+	{
+		ASSERT(chunkCount > 0);
+		m_chunks = std::make_unique<RenderCommandChunk[]>(chunkCount);
+		uint32_t capacity = 1;
+		while (capacity < chunkCount) capacity *= 2;
+		m_freeChunks.init(capacity);
+		for (uint32_t i = 0; i < chunkCount; ++i) {
+			m_freeChunks.tryPush(&m_chunks[i]);
+		}
+		m_submitted.init();
+		m_failedWrites = 0;
+	}
+	//-----------------------------------------------------------------------------------------------
+	void RenderCommandStream::destroy()
+	{
+		m_freeChunks.destroy();
+		m_chunks.reset();
+	}
+	//-----------------------------------------------------------------------------------------------
+	RenderCommandChunk* RenderCommandStream::acquireChunk()
+	{
+		RenderCommandChunk* pChunk = nullptr;
+		m_freeChunks.tryPop(pChunk);
+		return pChunk;
+	}
+	//-----------------------------------------------------------------------------------------------
+	void RenderCommandStream::submit(RenderCommandChunk* pChunk)
+	{
+		m_submitted.push(pChunk);
+	}
+	//-----------------------------------------------------------------------------------------------
+	void RenderCommandWriter::init(RenderCommandStream& stream)
+	{
+		m_pStream = &stream;
+		m_pChunk = nullptr;
+	}
+	//-----------------------------------------------------------------------------------------------
+	void RenderCommandWriter::destroy()
+	{
+		flush();
+		if (m_pChunk != nullptr) {
+			//empty, submitting it only gives it back
+			m_pStream->submit(m_pChunk);
+			m_pChunk = nullptr;
+		}
+	}
+	//-----------------------------------------------------------------------------------------------
+	void RenderCommandWriter::flush()
+	{
+		if (m_pChunk == nullptr || m_pChunk->used == 0) return;
+		m_pStream->submit(m_pChunk);
+		m_pChunk = nullptr;
+	}
+	//-----------------------------------------------------------------------------------------------
+	void benchmarkRenderCommandStream(uint32_t commandsPerWriter)
+	{
+		//a frame's worth of commands per flush, enough chunks that writers rarely run dry
+		constexpr uint32_t COMMANDS_PER_FLUSH = 256;
+		constexpr uint32_t CHUNK_COUNT = 256;
+		std::cout << "render command stream, " << commandsPerWriter << " commands per writer, million commands per second" << std::endl;
+		std::cout << std::setw(10) << "writers" << std::setw(12) << "Mcommands/s" << std::setw(10) << "retries"
+			<< std::setw(10) << "bytes" << std::endl;
+		for (uint32_t writers : { 1u, 2u, 4u }) {
+			RenderCommandStream stream;
+			stream.init(CHUNK_COUNT);
+			std::atomic<bool> start{ false };
+			std::vector<std::thread> threads;
+			for (uint32_t w = 0; w < writers; ++w) {
+				threads.emplace_back([&, w]() {
+					RenderCommandWriter writer;
+					writer.init(stream);
+					while (!start.load(std::memory_order_acquire)) std::this_thread::yield();
+					for (uint32_t i = 0; i < commandsPerWriter; ++i) {
+						SetNodeRotationCommand command{};
+						command.node = w;
+						//the writer's sequence number rides in the payload, the rotation isn't applied
+						command.rotation = glm::quat(1.0f, static_cast<float>(i), 0.0f, 0.0f);
+						//the render thread is the bottleneck, the writer retries rather than losing work
+						while (!writer.write(command)) std::this_thread::yield();
+						if (i % COMMANDS_PER_FLUSH == COMMANDS_PER_FLUSH - 1) writer.flush();
+					}
+					writer.destroy();
+				});
+			}
+			uint64_t consumed = 0;
+			uint64_t total = static_cast<uint64_t>(writers) * commandsPerWriter;
+			//applied like the scene would, one rotation per writer's node
+			std::vector<glm::quat> rotations(writers);
+			//the commands of one writer must arrive in the order it wrote them, none lost or repeated
+			std::vector<uint32_t> nextSequence(writers, 0);
+			uint64_t outOfOrder = 0;
+			auto begin = std::chrono::steady_clock::now();
+			start.store(true, std::memory_order_release);
+			while (consumed < total) {
+				uint32_t count = stream.consume([&](const auto& command) {
+					using Command = std::decay_t<decltype(command)>;
+					if constexpr (std::is_same_v<Command, SetNodeRotationCommand>) {
+						rotations[command.node] = command.rotation;
+						if (command.rotation.x != static_cast<float>(nextSequence[command.node])) ++outOfOrder;
+						++nextSequence[command.node];
+					}
+				});
+				consumed += count;
+				if (count == 0) std::this_thread::yield();
+			}
+			double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - begin).count();
+			for (std::thread& thread : threads) {
+				thread.join();
+			}
+			//the empty chunks the writers gave back on destroy()
+			stream.consume([](const auto&) {});
+			std::cout << std::setw(10) << writers << std::setw(12) << std::fixed << std::setprecision(2) << total / seconds / 1e6
+				<< std::setw(10) << stream.failedWrites()
+				<< std::setw(10) << sizeof(RenderCommandHeader) + ((sizeof(SetNodeRotationCommand) + 3) & ~3u)
+				<< (outOfOrder > 0 ? "  OUT OF ORDER" : "") << std::endl;
+			stream.destroy();
+		}
+	}
+}
@@ -0,0 +1,548 @@
+#include <algorithm>
+#include "RenderGraph.h"
+#include "MemoryTracker.h"
+
+namespace Clan
+{
+	namespace
+	{
+		constexpr VkAccessFlags2 WRITE_ACCESS_MASK =
+			VK_ACCESS_2_SHADER_WRITE_BIT | VK_ACCESS_2_SHADER_STORAGE_WRITE_BIT |
+			VK_ACCESS_2_COLOR_ATTACHMENT_WRITE_BIT | VK_ACCESS_2_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT |
+			VK_ACCESS_2_TRANSFER_WRITE_BIT | VK_ACCESS_2_HOST_WRITE_BIT | VK_ACCESS_2_MEMORY_WRITE_BIT;
+
+		VkImageUsageFlags imageUsageFlags(ImageUsage usage)
+		{
+			switch (usage) {
+			case ImageUsage::ColorAttachment: return VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT;
+			case ImageUsage::DepthAttachment:
+			case ImageUsage::DepthRead: return VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT;
+			case ImageUsage::SampledFragment:
+			case ImageUsage::SampledCompute: return VK_IMAGE_USAGE_SAMPLED_BIT;
+			case ImageUsage::StorageRead:
+			case ImageUsage::StorageWrite: return VK_IMAGE_USAGE_STORAGE_BIT;
+			case ImageUsage::TransferSrc: return VK_IMAGE_USAGE_TRANSFER_SRC_BIT;
+			case ImageUsage::TransferDst: return VK_IMAGE_USAGE_TRANSFER_DST_BIT;
+			default: return 0;
+			}
+		}
+	}
+	//-----------------------------------------------------------------------------------------------
+	ImageState imageStateForUsage(ImageUsage usage)
+	{
+		switch (usage) {
+		case ImageUsage::ColorAttachment:
+			return { VK_PIPELINE_STAGE_2_COLOR_ATTACHMENT_OUTPUT_BIT,
+					 VK_ACCESS_2_COLOR_ATTACHMENT_READ_BIT | VK_ACCESS_2_COLOR_ATTACHMENT_WRITE_BIT,
+					 VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL };
+		case ImageUsage::DepthAttachment:
+			return { VK_PIPELINE_STAGE_2_EARLY_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_2_LATE_FRAGMENT_TESTS_BIT,
+					 VK_ACCESS_2_DEPTH_STENCIL_ATTACHMENT_READ_BIT | VK_ACCESS_2_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT,
+					 VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL };
+		case ImageUsage::DepthRead:
+			return { VK_PIPELINE_STAGE_2_EARLY_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_2_LATE_FRAGMENT_TESTS_BIT,
+					 VK_ACCESS_2_DEPTH_STENCIL_ATTACHMENT_READ_BIT,
+					 VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL };
+		case ImageUsage::SampledFragment:
+			return { VK_PIPELINE_STAGE_2_FRAGMENT_SHADER_BIT, VK_ACCESS_2_SHADER_SAMPLED_READ_BIT,
+					 VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL };
+		case ImageUsage::SampledCompute:
+			return { VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT, VK_ACCESS_2_SHADER_SAMPLED_READ_BIT,
+					 VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL };
+		case ImageUsage::StorageRead:
+			return { VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT, VK_ACCESS_2_SHADER_STORAGE_READ_BIT,
+					 VK_IMAGE_LAYOUT_GENERAL };
+		case ImageUsage::StorageWrite:
+			return { VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT,
+					 VK_ACCESS_2_SHADER_STORAGE_READ_BIT | VK_ACCESS_2_SHADER_STORAGE_WRITE_BIT,
+					 VK_IMAGE_LAYOUT_GENERAL };
+		case ImageUsage::TransferSrc:
+			return { VK_PIPELINE_STAGE_2_ALL_TRANSFER_BIT, VK_ACCESS_2_TRANSFER_READ_BIT,
+					 VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL };
+		case ImageUsage::TransferDst:
+			return { VK_PIPELINE_STAGE_2_ALL_TRANSFER_BIT, VK_ACCESS_2_TRANSFER_WRITE_BIT,
+					 VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL };
+		case ImageUsage::Present:
+			return { VK_PIPELINE_STAGE_2_NONE, VK_ACCESS_2_NONE, VK_IMAGE_LAYOUT_PRESENT_SRC_KHR };
+		}
+		ASSERT(false);
+		return {};
+	}
+	//-----------------------------------------------------------------------------------------------
+	ImageState imageStateForLayout(VkImageLayout layout)
+	{
+		switch (layout) {
+		case VK_IMAGE_LAYOUT_UNDEFINED:
+		case VK_IMAGE_LAYOUT_PREINITIALIZED:
+			return { VK_PIPELINE_STAGE_2_NONE, VK_ACCESS_2_NONE, layout };
+		case VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL:
+			return imageStateForUsage(ImageUsage::ColorAttachment);
+		case VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL:
+		case VK_IMAGE_LAYOUT_DEPTH_ATTACHMENT_OPTIMAL:
+			return { imageStateForUsage(ImageUsage::DepthAttachment).stage,
+					 imageStateForUsage(ImageUsage::DepthAttachment).access, layout };
+		case VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL:
+			return imageStateForUsage(ImageUsage::DepthRead);
+		case VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL:
+			return { VK_PIPELINE_STAGE_2_FRAGMENT_SHADER_BIT | VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT,
+					 VK_ACCESS_2_SHADER_SAMPLED_READ_BIT, layout };
+		case VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL:
+			return imageStateForUsage(ImageUsage::TransferSrc);
+		case VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL:
+			return imageStateForUsage(ImageUsage::TransferDst);
+		case VK_IMAGE_LAYOUT_PRESENT_SRC_KHR:
+			return imageStateForUsage(ImageUsage::Present);
+		default:
+			return { VK_PIPELINE_STAGE_2_ALL_COMMANDS_BIT,
+					 VK_ACCESS_2_MEMORY_READ_BIT | VK_ACCESS_2_MEMORY_WRITE_BIT, layout };
+		}
+	}
+	//-----------------------------------------------------------------------------------------------
+	bool isWriteUsage(ImageUsage usage)
+	{
+		return (imageStateForUsage(usage).access & WRITE_ACCESS_MASK) != 0;
+	}
+	//-----------------------------------------------------------------------------------------------
+	VkImageAspectFlags aspectForFormat(VkFormat format)
+	{
+		switch (format) {
+		case VK_FORMAT_D16_UNORM:
+		case VK_FORMAT_X8_D24_UNORM_PACK32:
+		case VK_FORMAT_D32_SFLOAT:
+			return VK_IMAGE_ASPECT_DEPTH_BIT;
+		case VK_FORMAT_D16_UNORM_S8_UINT:
+		case VK_FORMAT_D24_UNORM_S8_UINT:
+		case VK_FORMAT_D32_SFLOAT_S8_UINT:
+			return VK_IMAGE_ASPECT_DEPTH_BIT | VK_IMAGE_ASPECT_STENCIL_BIT;
+		case VK_FORMAT_S8_UINT:
+			return VK_IMAGE_ASPECT_STENCIL_BIT;
+		default:
+			return VK_IMAGE_ASPECT_COLOR_BIT;
+		}
+	}
+	//-----------------------------------------------------------------------------------------------
+	void RenderGraph::init(VkDevice device, VkPhysicalDevice physicalDevice, DeletionQueue* pDeletionQueue, Timeline* pTimeline)
+	{
+		m_device = device;
+		m_pDeletionQueue = pDeletionQueue;
+		m_pTimeline = pTimeline;
+		vkGetPhysicalDeviceMemoryProperties(physicalDevice, &m_memoryProperties);
+	}
+	//-----------------------------------------------------------------------------------------------
+	void RenderGraph::destroy()
+	{
+		releaseTransients();
+		reset();
+	}
+	//-----------------------------------------------------------------------------------------------
+	void RenderGraph::reset()
+	{
+		m_passes.clear();
+		m_resources.clear();
+		m_finalBarriers.clear();
+		m_culledPasses = 0;
+	}
+	//-----------------------------------------------------------------------------------------------
+	GraphResource RenderGraph::importImage(const std::string& name, VkImage image, VkImageView view,
+		VkImageAspectFlags aspect, ImageState initial, VkImageLayout finalLayout)
+	{
+		Resource resource{};
+		resource.name = name;
+		resource.image = image;
+		resource.view = view;
+		resource.aspect = aspect;
+		resource.initial = initial;
+		resource.finalLayout = finalLayout;
+		m_resources.push_back(resource);
+		return static_cast<GraphResource>(m_resources.size() - 1);
+	}
+	//-----------------------------------------------------------------------------------------------
+	GraphResource RenderGraph::createImage(const std::string& name, const TransientImageDesc& desc)
+	{
+		Resource resource{};
+		resource.name = name;
+		resource.transient = true;
+		resource.desc = desc;
+		resource.aspect = aspectForFormat(desc.format);
+		m_resources.push_back(resource);
+		return static_cast<GraphResource>(m_resources.size() - 1);
+	}
+	//-----------------------------------------------------------------------------------------------
+	void RenderGraph::addPass(const std::string& name, const SetupFunc& setup, const ExecuteFunc& execute)
+	{
+		Pass pass{};
+		pass.name = name;
+		pass.execute = execute;
+		PassBuilder builder{};
+		builder.m_pPass = &pass;
+		setup(builder);
+		m_passes.push_back(std::move(pass));
+	}
+	//-----------------------------------------------------------------------------------------------
+	void RenderGraph::markOutput(GraphResource resource)
+	{
+		ASSERT(resource < m_resources.size());
+		m_resources[resource].output = true;
+	}
+	//-----------------------------------------------------------------------------------------------
+	void RenderGraph::compile()
+	{
+		cullPasses();
+		computeLifetimes();
+		allocateTransients();
+		buildBarriers();
+	}
+	//-----------------------------------------------------------------------------------------------
+	void RenderGraph::execute(VkCommandBuffer commandBuffer)
+	{
+		for (const auto& pass : m_passes) {
+			if (pass.culled) continue;
+			if (!pass.barriers.empty()) {
+				VkDependencyInfo dependencyInfo{};
+				dependencyInfo.sType = VK_STRUCTURE_TYPE_DEPENDENCY_INFO;
+				dependencyInfo.imageMemoryBarrierCount = static_cast<uint32_t>(pass.barriers.size());
+				dependencyInfo.pImageMemoryBarriers = pass.barriers.data();
+				vkCmdPipelineBarrier2(commandBuffer, &dependencyInfo);
+			}
+			pass.execute(commandBuffer);
+		}
+		if (!m_finalBarriers.empty()) {
+			VkDependencyInfo dependencyInfo{};
+			dependencyInfo.sType = VK_STRUCTURE_TYPE_DEPENDENCY_INFO;
+			dependencyInfo.imageMemoryBarrierCount = static_cast<uint32_t>(m_finalBarriers.size());
+			dependencyInfo.pImageMemoryBarriers = m_finalBarriers.data();
+			vkCmdPipelineBarrier2(commandBuffer, &dependencyInfo);
+		}
+	}
+	//-----------------------------------------------------------------------------------------------
+	VkImage RenderGraph::image(GraphResource resource) const
+	{
+		ASSERT(resource < m_resources.size());
+		return m_resources[resource].image;
+	}
+	//-----------------------------------------------------------------------------------------------
+	VkImageView RenderGraph::imageView(GraphResource resource) const
+	{
+		ASSERT(resource < m_resources.size());
+		return m_resources[resource].view;
+	}
+	//-----------------------------------------------------------------------------------------------
+	VkDeviceSize RenderGraph::transientCommittedBytes() const
+	{
+		VkDeviceSize bytes = 0;
+		for (const auto& slot : m_slots) {
+			VkDeviceSize committed = slot.size;
+			if (slot.lazy) {
+				vkGetDeviceMemoryCommitment(m_device, slot.memory, &committed);
+			}
+			bytes += committed;
+		}
+		return bytes;
+	}
+	//-----------------------------------------------------------------------------------------------
+	void RenderGraph::cullPasses()
+	{
+		//walk backwards from the outputs, a pass survives if a later survivor or an output needs it
+		std::vector<bool> needed(m_resources.size(), false);
+		for (size_t i = 0; i < m_resources.size(); ++i) {
+			needed[i] = m_resources[i].output;
+		}
+		m_culledPasses = 0;
+		for (auto pass = m_passes.rbegin(); pass != m_passes.rend(); ++pass) {
+			bool alive = pass->sideEffect;
+			for (const auto& access : pass->accesses) {
+				if (isWriteUsage(access.usage) && needed[access.resource]) alive = true;
+			}
+			pass->culled = !alive;
+			if (!alive) {
+				++m_culledPasses;
+				continue;
+			}
+			for (const auto& access : pass->accesses) {
+				needed[access.resource] = true;
+			}
+		}
+	}
+	//-----------------------------------------------------------------------------------------------
+	void RenderGraph::computeLifetimes()
+	{
+		for (uint32_t i = 0; i < m_passes.size(); ++i) {
+			if (m_passes[i].culled) continue;
+			for (const auto& access : m_passes[i].accesses) {
+				Resource& resource = m_resources[access.resource];
+				resource.firstPass = std::min(resource.firstPass, i);
+				resource.lastPass = std::max(resource.lastPass, i);
+				resource.usageFlags |= imageUsageFlags(access.usage);
+			}
+		}
+	}
+	//-----------------------------------------------------------------------------------------------
+	std::vector<uint64_t> RenderGraph::transientSignature() const
+	{
+		std::vector<uint64_t> signature{};
+		for (const auto& resource : m_resources) {
+			if (!resource.transient || resource.firstPass == UINT32_MAX) continue;
+			signature.push_back((uint64_t)resource.desc.format << 32 | resource.desc.samples);
+			signature.push_back((uint64_t)resource.desc.extent.width << 32 | resource.desc.extent.height);
+			signature.push_back((uint64_t)resource.usageFlags);
+			signature.push_back((uint64_t)resource.firstPass << 32 | resource.lastPass);
+		}
+		return signature;
+	}
+	//-----------------------------------------------------------------------------------------------
+	void RenderGraph::allocateTransients()
+	{
+		std::vector<uint32_t> transients{};
+		for (uint32_t i = 0; i < m_resources.size(); ++i) {
+			if (m_resources[i].transient && m_resources[i].firstPass != UINT32_MAX) transients.push_back(i);
+		}
+		std::vector<uint64_t> signature = transientSignature();
+		if (signature != m_signature || m_transientImages.size() != transients.size()) {
+			releaseTransients();
+			m_signature = signature;
+			//create the images first, their requirements decide the placement
+			std::vector<VkMemoryRequirements> requirements(transients.size());
+			std::vector<bool> lazy(transients.size(), false);
+			for (size_t t = 0; t < transients.size(); ++t) {
+				const Resource& resource = m_resources[transients[t]];
+				VkImageUsageFlags usage = resource.usageFlags;
+				constexpr VkImageUsageFlags attachmentOnly = VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT |
+					VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT | VK_IMAGE_USAGE_INPUT_ATTACHMENT_BIT;
+				if ((usage & ~attachmentOnly) == 0) {
+					usage |= VK_IMAGE_USAGE_TRANSIENT_ATTACHMENT_BIT;
+					lazy[t] = true;
+				}
+				VkImageCreateInfo imageInfo{};
+				imageInfo.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+				imageInfo.imageType = VK_IMAGE_TYPE_2D;
+				imageInfo.extent = { resource.desc.extent.width, resource.desc.extent.height, 1 };
+				imageInfo.mipLevels = 1;
+				imageInfo.arrayLayers = 1;
+				imageInfo.format = resource.desc.format;
+				imageInfo.tiling = VK_IMAGE_TILING_OPTIMAL;
+				imageInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+				imageInfo.usage = usage;
+				imageInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+				imageInfo.samples = resource.desc.samples;
+				imageInfo.flags = VK_IMAGE_CREATE_ALIAS_BIT;
+				VkImage image{};
+				VkResult result = vkCreateImage(m_device, &imageInfo, vulkanAllocator(), &image);
+				ASSERT(result == VK_SUCCESS);
+				vkGetImageMemoryRequirements(m_device, image, &requirements[t]);
+				m_transientImages.push_back(image);
+			}
+			//greedy placement, biggest first, into a slot whose users' lifetimes don't overlap
+			std::vector<size_t> order(transients.size());
+			for (size_t t = 0; t < order.size(); ++t) order[t] = t;
+			std::sort(order.begin(), order.end(), [&requirements](size_t a, size_t b) {
+				return requirements[a].size > requirements[b].size;
+			});
+			std::vector<bool> slotLazy{};
+			m_transientSlots.assign(transients.size(), UINT32_MAX);
+			for (size_t t : order) {
+				const Resource& resource = m_resources[transients[t]];
+				uint32_t slotIndex = UINT32_MAX;
+				for (uint32_t s = 0; s < m_slots.size() && slotIndex == UINT32_MAX; ++s) {
+					if (slotLazy[s] != lazy[t] || (m_slots[s].memoryTypeBits & requirements[t].memoryTypeBits) == 0) continue;
+					bool overlaps = false;
+					for (uint32_t other : m_slots[s].resources) {
+						const Resource& o = m_resources[other];
+						if (resource.firstPass <= o.lastPass && o.firstPass <= resource.lastPass) overlaps = true;
+					}
+					if (!overlaps) slotIndex = s;
+				}
+				if (slotIndex == UINT32_MAX) {
+					slotIndex = static_cast<uint32_t>(m_slots.size());
+					m_slots.push_back({});
+					slotLazy.push_back(lazy[t]);
+				}
+				MemorySlot& slot = m_slots[slotIndex];
+				slot.size = std::max(slot.size, requirements[t].size);
+				slot.memoryTypeBits &= requirements[t].memoryTypeBits;
+				slot.resources.push_back(transients[t]);
+				m_resources[transients[t]].memorySlot = slotIndex;
+				m_transientSlots[t] = slotIndex;
+			}
+			m_transientBytes = 0;
+			for (uint32_t s = 0; s < m_slots.size(); ++s) {
+				MemorySlot& slot = m_slots[s];
+				uint32_t memoryType = UINT32_MAX;
+				if (slotLazy[s]) {
+					memoryType = findMemoryType(slot.memoryTypeBits, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT | VK_MEMORY_PROPERTY_LAZILY_ALLOCATED_BIT);
+				}
+				if (memoryType == UINT32_MAX) {
+					memoryType = findMemoryType(slot.memoryTypeBits, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+				}
+				ASSERT(memoryType != UINT32_MAX);
+				slot.lazy = (m_memoryProperties.memoryTypes[memoryType].propertyFlags & VK_MEMORY_PROPERTY_LAZILY_ALLOCATED_BIT) != 0;
+				VkMemoryAllocateInfo allocInfo{};
+				allocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+				allocInfo.allocationSize = slot.size;
+				allocInfo.memoryTypeIndex = memoryType;
+				VkResult result = allocateDeviceMemory(m_device, &allocInfo, &slot.memory);
+				ASSERT(result == VK_SUCCESS);
+				m_transientBytes += slot.size;
+			}
+			for (size_t t = 0; t < transients.size(); ++t) {
+				Resource& resource = m_resources[transients[t]];
+				vkBindImageMemory(m_device, m_transientImages[t], m_slots[resource.memorySlot].memory, 0);
+				VkImageViewCreateInfo viewInfo{};
+				viewInfo.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
+				viewInfo.image = m_transientImages[t];
+				viewInfo.viewType = VK_IMAGE_VIEW_TYPE_2D;
+				viewInfo.format = resource.desc.format;
+				viewInfo.subresourceRange = { resource.aspect, 0, 1, 0, 1 };
+				VkImageView view{};
+				VkResult result = vkCreateImageView(m_device, &viewInfo, vulkanAllocator(), &view);
+				ASSERT(result == VK_SUCCESS);
+				m_transientViews.push_back(view);
+			}
+		}
+		//the logical resources are recreated every frame, rebind them to the physical ones
+		for (size_t t = 0; t < transients.size(); ++t) {
+			m_resources[transients[t]].image = m_transientImages[t];
+			m_resources[transients[t]].view = m_transientViews[t];
+			m_resources[transients[t]].memorySlot = m_transientSlots[t];
+		}
+	}
+	//-----------------------------------------------------------------------------------------------
+	void RenderGraph::releaseTransients()
+	{
+		uint64_t lastUse = m_pTimeline->lastSubmitted();
+		for (VkImageView view : m_transientViews) {
+			m_pDeletionQueue->retire<VK_OBJECT_TYPE_IMAGE_VIEW>(view, lastUse);
+		}
+		for (VkImage image : m_transientImages) {
+			m_pDeletionQueue->retire<VK_OBJECT_TYPE_IMAGE>(image, lastUse);
+		}
+		for (const auto& slot : m_slots) {
+			m_pDeletionQueue->retire<VK_OBJECT_TYPE_DEVICE_MEMORY>(slot.memory, lastUse, slot.size);
+		}
+		m_transientViews.clear();
+		m_transientImages.clear();
+		m_slots.clear();
+		m_transientSlots.clear();
+		m_signature.clear();
+		m_transientBytes = 0;
+	}
+	//-----------------------------------------------------------------------------------------------
+	void RenderGraph::buildBarriers()
+	{
+		struct Track {
+			VkImageLayout layout;
+			VkPipelineStageFlags2 writeStage;
+			VkAccessFlags2 writeAccess;
+			VkPipelineStageFlags2 readStages;
+			VkPipelineStageFlags2 visibleStages;
+			bool touched;
+		};
+		std::vector<Track> tracks(m_resources.size());
+		for (size_t i = 0; i < m_resources.size(); ++i) {
+			const ImageState& initial = m_resources[i].initial;
+			Track& track = tracks[i];
+			track = { initial.layout, 0, 0, 0, 0, false };
+			//a stage without accesses (e.g. the swapchain acquire wait) only needs an execution dependency
+			if (initial.access & WRITE_ACCESS_MASK) {
+				track.writeStage = initial.stage;
+				track.writeAccess = initial.access & WRITE_ACCESS_MASK;
+			}
+			else {
+				track.readStages = initial.stage;
+			}
+		}
+		//aliased memory: a transient image must wait for the previous user of its memory slot
+		//(the previous frame's last user included, it ran earlier on the same queue)
+		std::vector<Track> slotTracks(m_slots.size());
+		for (size_t s = 0; s < m_slots.size(); ++s) {
+			slotTracks[s] = { VK_IMAGE_LAYOUT_UNDEFINED, m_slots[s].lastWriteStage, m_slots[s].lastWriteAccess,
+							  m_slots[s].lastReadStages, 0, false };
+		}
+
+		auto makeBarrier = [this](GraphResource r, const Track& track, const ImageState& dst) {
+			VkImageMemoryBarrier2 barrier{};
+			barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER_2;
+			barrier.srcStageMask = track.writeStage | track.readStages;
+			barrier.srcAccessMask = track.writeAccess;
+			barrier.dstStageMask = dst.stage;
+			barrier.dstAccessMask = dst.access;
+			barrier.oldLayout = track.layout;
+			barrier.newLayout = dst.layout;
+			barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+			barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+			barrier.image = m_resources[r].image;
+			barrier.subresourceRange = { m_resources[r].aspect, 0, VK_REMAINING_MIP_LEVELS, 0, VK_REMAINING_ARRAY_LAYERS };
+			return barrier;
+		};
+
+		for (auto& pass : m_passes) {
+			pass.barriers.clear();
+			if (pass.culled) continue;
+			for (const auto& access : pass.accesses) {
+				Resource& resource = m_resources[access.resource];
+				Track& track = tracks[access.resource];
+				if (!track.touched && resource.transient) {
+					const Track& slotTrack = slotTracks[resource.memorySlot];
+					track.writeStage = slotTrack.writeStage;
+					track.writeAccess = slotTrack.writeAccess;
+					track.readStages = slotTrack.readStages;
+					track.layout = VK_IMAGE_LAYOUT_UNDEFINED;
+				}
+				track.touched = true;
+				ImageState dst = imageStateForUsage(access.usage);
+				bool write = isWriteUsage(access.usage);
+				bool layoutChange = track.layout != dst.layout;
+				if (write || layoutChange) {
+					pass.barriers.push_back(makeBarrier(access.resource, track, dst));
+					track.layout = dst.layout;
+					if (write) {
+						track.writeStage = dst.stage;
+						track.writeAccess = dst.access & WRITE_ACCESS_MASK;
+						track.readStages = 0;
+						track.visibleStages = 0;
+					}
+					else {
+						track.readStages = dst.stage;
+						track.visibleStages = dst.stage;
+					}
+				}
+				else if (track.writeAccess != 0 && (dst.stage & ~track.visibleStages) != 0) {
+					//read after write in a stage the write isn't visible to yet
+					VkImageMemoryBarrier2 barrier = makeBarrier(access.resource, track, dst);
+					barrier.srcStageMask = track.writeStage;
+					pass.barriers.push_back(barrier);
+					track.visibleStages |= dst.stage;
+					track.readStages |= dst.stage;
+				}
+				else {
+					//read after read in the same layout, no barrier
+					track.readStages |= dst.stage;
+				}
+				if (resource.transient) {
+					slotTracks[resource.memorySlot] = track;
+				}
+			}
+		}
+		for (size_t s = 0; s < m_slots.size(); ++s) {
+			m_slots[s].lastWriteStage = slotTracks[s].writeStage;
+			m_slots[s].lastWriteAccess = slotTracks[s].writeAccess;
+			m_slots[s].lastReadStages = slotTracks[s].readStages;
+		}
+		m_finalBarriers.clear();
+		for (uint32_t i = 0; i < m_resources.size(); ++i) {
+			const Resource& resource = m_resources[i];
+			const Track& track = tracks[i];
+			if (!track.touched || resource.finalLayout == VK_IMAGE_LAYOUT_UNDEFINED || resource.finalLayout == track.layout) continue;
+			m_finalBarriers.push_back(makeBarrier(i, track, imageStateForLayout(resource.finalLayout)));
+		}
+	}
+	//-----------------------------------------------------------------------------------------------
+	uint32_t RenderGraph::findMemoryType(uint32_t typeFilter, VkMemoryPropertyFlags properties) const
+	{
+		for (uint32_t i = 0; i < m_memoryProperties.memoryTypeCount; i++) {
+			if ((typeFilter & (1 << i)) && (m_memoryProperties.memoryTypes[i].propertyFlags & properties) == properties) {
+				return i;
+			}
+		}
+		return UINT32_MAX;
+	}
+}
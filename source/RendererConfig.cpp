@@ -0,0 +1,82 @@
+#include "RendererConfig.h"
+#include <fstream>
+#include <iostream>
+#include <cctype>
+#include <cstdlib>
+
+namespace Clan
+{
+	namespace
+	{
+		std::string trim(const std::string& text)
+		{
+			size_t begin = 0;
+			size_t end = text.size();
+			while (begin < end && std::isspace(static_cast<unsigned char>(text[begin]))) ++begin;
+			while (end > begin && std::isspace(static_cast<unsigned char>(text[end - 1]))) --end;
+			return text.substr(begin, end - begin);
+		}
+
+		bool parseSize(const std::string& value, uint32_t& size)
+		{
+			char* pEnd = nullptr;
+			unsigned long parsed = std::strtoul(value.c_str(), &pEnd, 10);
+			if (value.empty() || *pEnd != '\0' || parsed == 0 || parsed > 16384) return false;
+			size = static_cast<uint32_t>(parsed);
+			return true;
+		}
+
+		bool parseBool(const std::string& value, bool& enabled)
+		{
+			if (value == "true" || value == "on" || value == "1") {
+				enabled = true;
+				return true;
+			}
+			if (value == "false" || value == "off" || value == "0") {
+				enabled = false;
+				return true;
+			}
+			return false;
+		}
+	}
+	//-----------------------------------------------------------------------------------------------
+	bool RendererConfig::load(const std::string& path)
+	{
+		std::ifstream file(path);
+		if (!file.is_open()) return false;
+		std::string line;
+		for (uint32_t lineNumber = 1; std::getline(file, line); ++lineNumber) {
+			line = trim(line.substr(0, line.find('#')));
+			if (line.empty()) continue;
+			if (!set(line)) {
+				std::cerr << path << ":" << lineNumber << ": bad setting: " << line << std::endl;
+			}
+		}
+		return true;
+	}
+	//-----------------------------------------------------------------------------------------------
+	bool RendererConfig::set(const std::string& key, const std::string& value)
+	{
+		if (key == "windowWidth") return parseSize(value, windowWidth);
+		if (key == "windowHeight") return parseSize(value, windowHeight);
+		if (key == "simulationRate") return parseSize(value, simulationRate);
+		if (key == "validation") return parseBool(value, enableValidation);
+		if (value.empty()) return false;
+		if (key == "model") {
+			modelPath = value;
+			return true;
+		}
+		if (key == "texture") {
+			texturePath = value;
+			return true;
+		}
+		return false;
+	}
+	//-----------------------------------------------------------------------------------------------
+	bool RendererConfig::set(const std::string& assignment)
+	{
+		size_t separator = assignment.find('=');
+		if (separator == std::string::npos) return false;
+		return set(trim(assignment.substr(0, separator)), trim(assignment.substr(separator + 1)));
+	}
+}
@@ -0,0 +1,84 @@
+#include "SamplerCache.h"
+#include "MemoryTracker.h"
+#include <cstring>
+#include <iostream>
+
+namespace Clan
+{
+	namespace
+	{
+		uint32_t floatBits(float value)
+		{
+			uint32_t bits = 0;
+			std::memcpy(&bits, &value, sizeof(bits));
+			return bits;
+		}
+	}
+
+	size_t SamplerCache::KeyHash::operator()(const Key& key) const
+	{
+		//FNV-1a over the words
+		uint64_t hash = 14695981039346656037ull;
+		for (uint32_t word : key) {
+			hash = (hash ^ word) * 1099511628211ull;
+		}
+		return static_cast<size_t>(hash);
+	}
+	//-----------------------------------------------------------------------------------------------
+	void SamplerCache::init(VkDevice device, uint32_t maxSamplers)
+	{
+		m_device = device;
+		m_maxSamplers = maxSamplers;
+	}
+	//-----------------------------------------------------------------------------------------------
+	void SamplerCache::destroy()
+	{
+		for (VkSampler sampler : m_created) {
+			vkDestroySampler(m_device, sampler, vulkanAllocator());
+		}
+		m_created.clear();
+		m_samplers.clear();
+	}
+	//-----------------------------------------------------------------------------------------------
+	VkSampler SamplerCache::get(const VkSamplerCreateInfo& info)
+	{
+		ASSERT(info.pNext == nullptr);
+		//the anisotropy and the border color only matter when they are used
+		bool anisotropy = info.anisotropyEnable == VK_TRUE;
+		bool border = info.addressModeU == VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_BORDER ||
+			info.addressModeV == VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_BORDER ||
+			info.addressModeW == VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_BORDER;
+		Key key = {
+			info.flags,
+			static_cast<uint32_t>(info.magFilter),
+			static_cast<uint32_t>(info.minFilter),
+			static_cast<uint32_t>(info.mipmapMode),
+			static_cast<uint32_t>(info.addressModeU),
+			static_cast<uint32_t>(info.addressModeV),
+			static_cast<uint32_t>(info.addressModeW),
+			floatBits(info.mipLodBias),
+			anisotropy ? floatBits(info.maxAnisotropy) : 0u,
+			info.compareEnable,
+			info.compareEnable ? static_cast<uint32_t>(info.compareOp) : 0u,
+			floatBits(info.minLod),
+			floatBits(info.maxLod),
+			border ? static_cast<uint32_t>(info.borderColor) : 0u,
+			info.unnormalizedCoordinates,
+		};
+		auto it = m_samplers.find(key);
+		if (it != m_samplers.end()) return it->second;
+		if (!m_created.empty() && m_created.size() >= m_maxSamplers) {
+			if (m_samplers.size() == m_created.size()) {
+				std::cerr << "maxSamplerAllocationCount reached, new sampler states share the first sampler" << std::endl;
+			}
+			m_samplers.emplace(std::move(key), m_created.front());
+			return m_created.front();
+		}
+		VkSampler sampler = VK_NULL_HANDLE;
+		VkResult result = vkCreateSampler(m_device, &info, vulkanAllocator(), &sampler);
+		ASSERT(result == VK_SUCCESS);
+		m_created.push_back(sampler);
+		m_samplers.emplace(std::move(key), sampler);
+		return sampler;
+	}
+}
@@ -0,0 +1,201 @@
+#include <algorithm>
+#include <numeric>
+#include "SceneGraph.h"
+
+namespace Clan
+{
+	void SceneGraph::init(uint32_t capacity, SimdLevel level)
+	{
+		m_pKernels = &transformKernels(level);
+		m_handleToIndex.reserve(capacity);
+		m_indexToHandle.reserve(capacity);
+		m_parent.reserve(capacity);
+		m_depth.reserve(capacity);
+		m_dirty.reserve(capacity);
+		m_worldVersion.reserve(capacity);
+		m_world.reserve(capacity);
+		m_parentWorld.reserve(capacity);
+	}
+	//-----------------------------------------------------------------------------------------------
+	void SceneGraph::destroy()
+	{
+		m_handleToIndex.clear();
+		m_indexToHandle.clear();
+		m_parent.clear();
+		m_depth.clear();
+		m_dirty.clear();
+		m_worldVersion.clear();
+		m_local.resize(0);
+		m_world.clear();
+		m_parentWorld.clear();
+		m_depthStart.clear();
+		m_dirtyCount = 0;
+		m_structureChanged = false;
+	}
+	//-----------------------------------------------------------------------------------------------
+	SceneNode SceneGraph::createNode(SceneNode parent)
+	{
+		SceneNode node = static_cast<SceneNode>(m_handleToIndex.size());
+		uint32_t index = static_cast<uint32_t>(m_indexToHandle.size());
+		uint32_t parentIndex = parent == INVALID_SCENE_NODE ? INVALID_SCENE_NODE : m_handleToIndex[parent];
+		m_handleToIndex.push_back(index);
+		m_indexToHandle.push_back(node);
+		m_parent.push_back(parentIndex);
+		m_depth.push_back(parentIndex == INVALID_SCENE_NODE ? 0 : m_depth[parentIndex] + 1);
+		m_dirty.push_back(0);
+		m_worldVersion.push_back(0);
+		m_local.resize(index + 1);
+		m_world.emplace_back(1.0f);
+		m_parentWorld.emplace_back(1.0f);
+		m_structureChanged = true;
+		markDirty(node);
+		return node;
+	}
+	//-----------------------------------------------------------------------------------------------
+	void SceneGraph::setTransform(SceneNode node, const glm::vec3& position, const glm::quat& rotation, const glm::vec3& scale)
+	{
+		m_local.set(m_handleToIndex[node], position, rotation, scale);
+		markDirty(node);
+	}
+	//-----------------------------------------------------------------------------------------------
+	void SceneGraph::setPosition(SceneNode node, const glm::vec3& position)
+	{
+		uint32_t index = m_handleToIndex[node];
+		m_local.positionX[index] = position.x;
+		m_local.positionY[index] = position.y;
+		m_local.positionZ[index] = position.z;
+		markDirty(node);
+	}
+	//-----------------------------------------------------------------------------------------------
+	void SceneGraph::setRotation(SceneNode node, const glm::quat& rotation)
+	{
+		uint32_t index = m_handleToIndex[node];
+		m_local.rotationX[index] = rotation.x;
+		m_local.rotationY[index] = rotation.y;
+		m_local.rotationZ[index] = rotation.z;
+		m_local.rotationW[index] = rotation.w;
+		markDirty(node);
+	}
+	//-----------------------------------------------------------------------------------------------
+	void SceneGraph::setScale(SceneNode node, const glm::vec3& scale)
+	{
+		uint32_t index = m_handleToIndex[node];
+		m_local.scaleX[index] = scale.x;
+		m_local.scaleY[index] = scale.y;
+		m_local.scaleZ[index] = scale.z;
+		markDirty(node);
+	}
+	//-----------------------------------------------------------------------------------------------
+	uint32_t SceneGraph::update()
+	{
+		if (m_structureChanged) {
+			sortByDepth();
+			m_structureChanged = false;
+		}
+		if (m_dirtyCount == 0) return 0;
+		++m_version;
+		uint32_t updated = 0;
+		for (size_t depth = 0; depth + 1 < m_depthStart.size(); ++depth) {
+			uint32_t begin = m_depthStart[depth];
+			uint32_t end = m_depthStart[depth + 1];
+			//the parents were finished at the previous depth, their flag reaches the children here
+			if (depth > 0) {
+				for (uint32_t i = begin; i < end; ++i) {
+					m_dirty[i] |= m_dirty[m_parent[i]];
+				}
+			}
+			//contiguous dirty runs go through the kernels in one batch
+			uint32_t i = begin;
+			while (i < end) {
+				if (!m_dirty[i]) {
+					++i;
+					continue;
+				}
+				uint32_t runEnd = i;
+				while (runEnd < end && m_dirty[runEnd]) ++runEnd;
+				m_pKernels->compose(m_local, i, runEnd, m_world.data());
+				if (depth > 0) {
+					for (uint32_t k = i; k < runEnd; ++k) {
+						m_parentWorld[k] = m_world[m_parent[k]];
+					}
+					m_pKernels->multiply(&m_parentWorld[i], &m_world[i], &m_world[i], runEnd - i);
+				}
+				std::fill(m_worldVersion.begin() + i, m_worldVersion.begin() + runEnd, m_version);
+				updated += runEnd - i;
+				i = runEnd;
+			}
+		}
+		std::fill(m_dirty.begin(), m_dirty.end(), 0);
+		m_dirtyCount = 0;
+		return updated;
+	}
+	//-----------------------------------------------------------------------------------------------
+	uint32_t SceneGraph::copyChanged(glm::mat4* dst, uint64_t& syncedVersion) const
+	{
+		if (syncedVersion == m_version) return 0;
+		uint32_t copied = 0;
+		for (uint32_t i = 0; i < m_worldVersion.size(); ++i) {
+			if (m_worldVersion[i] > syncedVersion) {
+				dst[m_indexToHandle[i]] = m_world[i];
+				++copied;
+			}
+		}
+		syncedVersion = m_version;
+		return copied;
+	}
+	//-----------------------------------------------------------------------------------------------
+	void SceneGraph::markDirty(SceneNode node)
+	{
+		uint8_t& dirty = m_dirty[m_handleToIndex[node]];
+		if (!dirty) {
+			dirty = 1;
+			++m_dirtyCount;
+		}
+	}
+	//-----------------------------------------------------------------------------------------------
+	void SceneGraph::sortByDepth()
+	{
+		uint32_t count = nodeCount();
+		if (!std::is_sorted(m_depth.begin(), m_depth.end())) {
+			//stable, so siblings keep their creation order
+			std::vector<uint32_t> order(count);
+			std::iota(order.begin(), order.end(), 0u);
+			std::stable_sort(order.begin(), order.end(), [this](uint32_t a, uint32_t b) { return m_depth[a] < m_depth[b]; });
+			std::vector<uint32_t> newIndex(count);
+			for (uint32_t i = 0; i < count; ++i) {
+				newIndex[order[i]] = i;
+			}
+			auto permute = [&order, count](auto& array) {
+				std::remove_reference_t<decltype(array)> sorted(count);
+				for (uint32_t i = 0; i < count; ++i) {
+					sorted[i] = array[order[i]];
+				}
+				array = std::move(sorted);
+			};
+			permute(m_indexToHandle);
+			permute(m_parent);
+			permute(m_depth);
+			permute(m_dirty);
+			permute(m_worldVersion);
+			permute(m_world);
+			for (std::vector<float>* array : { &m_local.positionX, &m_local.positionY, &m_local.positionZ,
+				&m_local.rotationX, &m_local.rotationY, &m_local.rotationZ, &m_local.rotationW,
+				&m_local.scaleX, &m_local.scaleY, &m_local.scaleZ }) {
+				permute(*array);
+			}
+			for (uint32_t& parentIndex : m_parent) {
+				if (parentIndex != INVALID_SCENE_NODE) parentIndex = newIndex[parentIndex];
+			}
+			for (uint32_t i = 0; i < count; ++i) {
+				m_handleToIndex[m_indexToHandle[i]] = i;
+			}
+		}
+		m_depthStart.clear();
+		for (uint32_t i = 0; i < count; ++i) {
+			while (m_depthStart.size() <= m_depth[i]) {
+				m_depthStart.push_back(i);
+			}
+		}
+		m_depthStart.push_back(count);
+	}
+}
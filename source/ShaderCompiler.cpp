@@ -0,0 +1,141 @@
+#include "ShaderCompiler.h"
+#include <fstream>
+#include <sstream>
+#ifdef _WIN32
+	#define WIN32_LEAN_AND_MEAN
+	#define NOMINMAX
+	#include <windows.h>
+#else
+	#include <dlfcn.h>
+#endif
+
+namespace Clan
+{
+	namespace
+	{
+		void* openLibrary()
+		{
+#if defined(_WIN32)
+			return LoadLibraryA("shaderc_shared.dll");
+#elif defined(__APPLE__)
+			return dlopen("libshaderc_shared.dylib", RTLD_NOW);
+#else
+			void* library = dlopen("libshaderc_shared.so.1", RTLD_NOW);
+			return library ? library : dlopen("libshaderc_shared.so", RTLD_NOW);
+#endif
+		}
+
+		void closeLibrary(void* library)
+		{
+#ifdef _WIN32
+			FreeLibrary(static_cast<HMODULE>(library));
+#else
+			dlclose(library);
+#endif
+		}
+
+		template<typename T>
+		bool loadSymbol(void* library, const char* name, T& function)
+		{
+#ifdef _WIN32
+			function = reinterpret_cast<T>(GetProcAddress(static_cast<HMODULE>(library), name));
+#else
+			function = reinterpret_cast<T>(dlsym(library, name));
+#endif
+			return function != nullptr;
+		}
+	}
+
+	ShaderStage shaderStageForPath(const std::string& path)
+	{
+		auto endsWith = [&path](const char* extension) {
+			std::string suffix(extension);
+			return path.size() >= suffix.size() && path.compare(path.size() - suffix.size(), suffix.size(), suffix) == 0;
+		};
+		if (endsWith(".vert")) return ShaderStage::Vertex;
+		if (endsWith(".frag")) return ShaderStage::Fragment;
+		if (endsWith(".comp")) return ShaderStage::Compute;
+		return ShaderStage::Unknown;
+	}
+	//-----------------------------------------------------------------------------------------------
+	bool ShaderCompiler::init()
+	{
+		m_library = openLibrary();
+		if (!m_library) return false;
+		bool loaded = loadSymbol(m_library, "shaderc_compiler_initialize", m_compilerInitialize)
+			&& loadSymbol(m_library, "shaderc_compiler_release", m_compilerRelease)
+			&& loadSymbol(m_library, "shaderc_compile_options_initialize", m_optionsInitialize)
+			&& loadSymbol(m_library, "shaderc_compile_options_release", m_optionsRelease)
+			&& loadSymbol(m_library, "shaderc_compile_options_set_target_env", m_optionsSetTargetEnv)
+			&& loadSymbol(m_library, "shaderc_compile_options_set_optimization_level", m_optionsSetOptimizationLevel)
+			&& loadSymbol(m_library, "shaderc_compile_into_spv", m_compileIntoSpv)
+			&& loadSymbol(m_library, "shaderc_result_release", m_resultRelease)
+			&& loadSymbol(m_library, "shaderc_result_get_length", m_resultGetLength)
+			&& loadSymbol(m_library, "shaderc_result_get_bytes", m_resultGetBytes)
+			&& loadSymbol(m_library, "shaderc_result_get_compilation_status", m_resultGetStatus)
+			&& loadSymbol(m_library, "shaderc_result_get_error_message", m_resultGetErrorMessage);
+		if (loaded) {
+			m_compiler = m_compilerInitialize();
+		}
+		if (!m_compiler) {
+			destroy();
+			return false;
+		}
+		return true;
+	}
+	//-----------------------------------------------------------------------------------------------
+	void ShaderCompiler::destroy()
+	{
+		if (m_compiler) {
+			m_compilerRelease(m_compiler);
+			m_compiler = nullptr;
+		}
+		if (m_library) {
+			closeLibrary(m_library);
+			m_library = nullptr;
+		}
+	}
+	//-----------------------------------------------------------------------------------------------
+	bool ShaderCompiler::compile(const std::string& path, std::vector<char>& spirv, std::string& log) const
+	{
+		if (!isAvailable()) {
+			log = "shaderc is not available";
+			return false;
+		}
+		shaderc_shader_kind kind{};
+		switch (shaderStageForPath(path)) {
+		case ShaderStage::Vertex: kind = shaderc_glsl_vertex_shader; break;
+		case ShaderStage::Fragment: kind = shaderc_glsl_fragment_shader; break;
+		case ShaderStage::Compute: kind = shaderc_glsl_compute_shader; break;
+		default:
+			log = path + ": unknown shader stage";
+			return false;
+		}
+		std::ifstream file(path, std::ios::binary);
+		if (!file.is_open()) {
+			log = path + ": can't be opened";
+			return false;
+		}
+		std::stringstream source;
+		source << file.rdbuf();
+		std::string text = source.str();
+
+		//the compiler is thread safe, options are per call
+		shaderc_compile_options_t options = m_optionsInitialize();
+		m_optionsSetTargetEnv(options, shaderc_target_env_vulkan, shaderc_env_version_vulkan_1_3);
+		m_optionsSetOptimizationLevel(options, shaderc_optimization_level_performance);
+		shaderc_compilation_result_t result = m_compileIntoSpv(m_compiler, text.data(), text.size(), kind,
+			path.c_str(), "main", options);
+		bool success = m_resultGetStatus(result) == shaderc_compilation_status_success;
+		if (success) {
+			const char* bytes = m_resultGetBytes(result);
+			spirv.assign(bytes, bytes + m_resultGetLength(result));
+		}
+		else {
+			log = m_resultGetErrorMessage(result);
+		}
+		m_resultRelease(result);
+		m_optionsRelease(options);
+		return success;
+	}
+}
@@ -0,0 +1,242 @@
+#include "ShaderHotReload.h"
+#include "MemoryTracker.h"
+#include <algorithm>
+#include <chrono>
+#include <fstream>
+#ifdef __linux__
+	#include <sys/inotify.h>
+	#include <poll.h>
+	#include <unistd.h>
+#endif
+
+namespace Clan
+{
+#ifdef __linux__
+	bool FileWatcher::init(const std::string& directory)
+	{
+		m_directory = directory;
+		m_fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+		if (m_fd < 0) return false;
+		//editors either rewrite the file or rename a temporary over it
+		if (inotify_add_watch(m_fd, directory.c_str(), IN_CLOSE_WRITE | IN_MOVED_TO) < 0) {
+			destroy();
+			return false;
+		}
+		return true;
+	}
+	//-----------------------------------------------------------------------------------------------
+	void FileWatcher::destroy()
+	{
+		if (m_fd >= 0) {
+			close(m_fd);
+			m_fd = -1;
+		}
+	}
+	//-----------------------------------------------------------------------------------------------
+	std::vector<std::string> FileWatcher::wait(uint32_t timeoutMs)
+	{
+		std::vector<std::string> files;
+		pollfd descriptor{ m_fd, POLLIN, 0 };
+		if (poll(&descriptor, 1, static_cast<int>(timeoutMs)) <= 0) return files;
+		alignas(inotify_event) char buffer[4096];
+		ssize_t length = 0;
+		while ((length = read(m_fd, buffer, sizeof(buffer))) > 0) {
+			for (ssize_t offset = 0; offset < length;) {
+				const inotify_event* pEvent = reinterpret_cast<const inotify_event*>(buffer + offset);
+				if (pEvent->len > 0) {
+					files.emplace_back(pEvent->name);
+				}
+				offset += sizeof(inotify_event) + pEvent->len;
+			}
+		}
+		return files;
+	}
+#else
+	bool FileWatcher::init(const std::string& directory)
+	{
+		m_directory = directory;
+		std::error_code error;
+		for (const auto& entry : std::filesystem::directory_iterator(directory, error)) {
+			if (entry.is_regular_file(error)) {
+				m_writeTimes[entry.path().filename().string()] = entry.last_write_time(error);
+			}
+		}
+		return !error;
+	}
+	//-----------------------------------------------------------------------------------------------
+	void FileWatcher::destroy()
+	{
+		m_writeTimes.clear();
+	}
+	//-----------------------------------------------------------------------------------------------
+	std::vector<std::string> FileWatcher::wait(uint32_t timeoutMs)
+	{
+		std::this_thread::sleep_for(std::chrono::milliseconds(timeoutMs));
+		std::vector<std::string> files;
+		std::error_code error;
+		for (const auto& entry : std::filesystem::directory_iterator(m_directory, error)) {
+			if (!entry.is_regular_file(error)) continue;
+			std::filesystem::file_time_type writeTime = entry.last_write_time(error);
+			if (error) continue;
+			std::string name = entry.path().filename().string();
+			auto it = m_writeTimes.find(name);
+			if (it == m_writeTimes.end() || it->second != writeTime) {
+				m_writeTimes[name] = writeTime;
+				files.push_back(name);
+			}
+		}
+		return files;
+	}
+#endif
+	//-----------------------------------------------------------------------------------------------
+	void ShaderHotReload::init(VkDevice device, const std::string& shaderDirectory)
+	{
+		m_device = device;
+		m_directory = shaderDirectory;
+		if (!m_compiler.init()) {
+			std::cout << "shader hot reload disabled: shaderc shared library not found" << std::endl;
+			return;
+		}
+		if (!m_watcher.init(shaderDirectory)) {
+			std::cout << "shader hot reload disabled: can't watch " << shaderDirectory << std::endl;
+			m_compiler.destroy();
+			return;
+		}
+		m_running = true;
+		m_worker = std::thread(&ShaderHotReload::run, this);
+	}
+	//-----------------------------------------------------------------------------------------------
+	void ShaderHotReload::destroy()
+	{
+		if (m_running) {
+			m_running = false;
+			m_worker.join();
+			m_watcher.destroy();
+			m_compiler.destroy();
+		}
+		dropReloaded(nullptr);
+		m_watched.clear();
+		m_spirv.clear();
+	}
+	//-----------------------------------------------------------------------------------------------
+	void ShaderHotReload::watch(const std::string& name, const std::vector<std::string>& sources, const BuildFunc& build)
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		Watched& watched = m_watched[name];
+		watched.sources = sources;
+		watched.build = build;
+		watched.generation = ++m_generation;
+		dropReloaded(&name);
+	}
+	//-----------------------------------------------------------------------------------------------
+	void ShaderHotReload::suspend()
+	{
+		m_buildMutex.lock();
+		std::lock_guard<std::mutex> lock(m_mutex);
+		dropReloaded(nullptr);
+	}
+	//-----------------------------------------------------------------------------------------------
+	void ShaderHotReload::resume()
+	{
+		m_buildMutex.unlock();
+	}
+	//-----------------------------------------------------------------------------------------------
+	std::vector<ShaderHotReload::ReloadedPipeline> ShaderHotReload::collect()
+	{
+		std::vector<ReloadedPipeline> reloaded;
+		if (!m_running) return reloaded;
+		std::lock_guard<std::mutex> lock(m_mutex);
+		reloaded.swap(m_reloaded);
+		return reloaded;
+	}
+	//-----------------------------------------------------------------------------------------------
+	void ShaderHotReload::run()
+	{
+		while (m_running) {
+			std::vector<std::string> changed = m_watcher.wait(WAIT_MILLISECONDS);
+			if (changed.empty()) continue;
+			std::vector<std::string> more = m_watcher.wait(SETTLE_MILLISECONDS);
+			changed.insert(changed.end(), more.begin(), more.end());
+			//the .spv files written back by rebuild() are reported too
+			changed.erase(std::remove_if(changed.begin(), changed.end(), [](const std::string& file) {
+				return shaderStageForPath(file) == ShaderStage::Unknown;
+			}), changed.end());
+			std::sort(changed.begin(), changed.end());
+			changed.erase(std::unique(changed.begin(), changed.end()), changed.end());
+			if (!changed.empty()) {
+				std::lock_guard<std::mutex> buildLock(m_buildMutex);
+				rebuild(changed);
+			}
+		}
+	}
+	//-----------------------------------------------------------------------------------------------
+	void ShaderHotReload::rebuild(const std::vector<std::string>& changedFiles)
+	{
+		for (const std::string& file : changedFiles) {
+			m_spirv.erase(file);
+		}
+		std::vector<std::pair<std::string, Watched>> affected;
+		{
+			std::lock_guard<std::mutex> lock(m_mutex);
+			for (const auto& [name, watched] : m_watched) {
+				bool uses = std::any_of(watched.sources.begin(), watched.sources.end(), [&changedFiles](const std::string& source) {
+					return std::binary_search(changedFiles.begin(), changedFiles.end(), source);
+				});
+				if (uses) {
+					affected.emplace_back(name, watched);
+				}
+			}
+		}
+
+		for (const auto& [name, watched] : affected) {
+			auto start = std::chrono::steady_clock::now();
+			std::vector<std::vector<char>> stages;
+			for (const std::string& source : watched.sources) {
+				auto it = m_spirv.find(source);
+				if (it == m_spirv.end()) {
+					std::filesystem::path path = m_directory / source;
+					std::vector<char> spirv;
+					std::string log;
+					if (!m_compiler.compile(path.string(), spirv, log)) {
+						//the pipeline in use is kept until the source compiles again
+						std::cerr << log << std::endl;
+						break;
+					}
+					//the next start loads the edited shader too
+					std::ofstream output(path.replace_extension(".spv"), std::ios::binary | std::ios::trunc);
+					output.write(spirv.data(), static_cast<std::streamsize>(spirv.size()));
+					it = m_spirv.emplace(source, std::move(spirv)).first;
+				}
+				stages.push_back(it->second);
+			}
+			if (stages.size() != watched.sources.size()) continue;
+
+			VkPipeline pipeline = watched.build(stages);
+			if (pipeline == VK_NULL_HANDLE) {
+				std::cerr << "shader hot reload: building " << name << " failed" << std::endl;
+				continue;
+			}
+			double milliseconds = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+			std::lock_guard<std::mutex> lock(m_mutex);
+			auto current = m_watched.find(name);
+			if (current == m_watched.end() || current->second.generation != watched.generation) {
+				//redeclared while building, the pipeline was built with stale state
+				vkDestroyPipeline(m_device, pipeline, vulkanAllocator());
+				continue;
+			}
+			std::cout << "reloaded " << name << " in " << milliseconds << " ms" << std::endl;
+			m_reloaded.push_back({ name, pipeline });
+		}
+	}
+	//-----------------------------------------------------------------------------------------------
+	void ShaderHotReload::dropReloaded(const std::string* pName)
+	{
+		//never bound, no need to wait for the GPU
+		auto end = std::remove_if(m_reloaded.begin(), m_reloaded.end(), [this, pName](const ReloadedPipeline& reloaded) {
+			if (pName && reloaded.name != *pName) return false;
+			vkDestroyPipeline(m_device, reloaded.pipeline, vulkanAllocator());
+			return true;
+		});
+		m_reloaded.erase(end, m_reloaded.end());
+	}
+}
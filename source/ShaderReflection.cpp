@@ -0,0 +1,368 @@
+#include "ShaderReflection.h"
+#include <algorithm>
+#include <cstring>
+#include <spirv-headers/spirv.h>
+
+namespace Clan
+{
+	namespace
+	{
+		struct Member {
+			uint32_t offset{ 0 };
+			uint32_t matrixStride{ 0 };
+		};
+
+		//what the module says about one id, only the parts the reflection needs
+		struct IdInfo {
+			uint32_t opcode{ 0 };
+			//words following the result id of type declarations
+			std::vector<uint32_t> operands{};
+			std::string name{};
+			uint32_t set{ 0 };
+			uint32_t binding{ UINT32_MAX };
+			uint32_t location{ UINT32_MAX };
+			uint32_t arrayStride{ 0 };
+			bool builtIn{ false };
+			bool bufferBlock{ false };
+			std::vector<Member> members{};
+			//variables
+			uint32_t typeId{ 0 };
+			uint32_t storageClass{ 0 };
+			//constants
+			uint32_t value{ 0 };
+		};
+
+		std::string readString(const uint32_t* pWords, size_t wordCount)
+		{
+			const char* pChars = reinterpret_cast<const char*>(pWords);
+			return std::string(pChars, strnlen(pChars, wordCount * sizeof(uint32_t)));
+		}
+
+		Member& member(IdInfo& info, uint32_t index)
+		{
+			if (info.members.size() <= index) {
+				info.members.resize(index + 1);
+			}
+			return info.members[index];
+		}
+
+		uint32_t typeSize(const std::vector<IdInfo>& ids, uint32_t typeId)
+		{
+			const IdInfo& type = ids[typeId];
+			switch (type.opcode) {
+			case SpvOpTypeInt:
+			case SpvOpTypeFloat:
+				return type.operands[0] / 8;
+			case SpvOpTypeVector:
+				return type.operands[1] * typeSize(ids, type.operands[0]);
+			case SpvOpTypeMatrix:
+				return type.operands[1] * typeSize(ids, type.operands[0]);
+			case SpvOpTypeArray: {
+				uint32_t stride = type.arrayStride ? type.arrayStride : typeSize(ids, type.operands[0]);
+				return ids[type.operands[1]].value * stride;
+			}
+			case SpvOpTypeStruct: {
+				uint32_t size = 0;
+				for (uint32_t i = 0; i < type.operands.size(); ++i) {
+					Member layout = i < type.members.size() ? type.members[i] : Member{};
+					const IdInfo& memberType = ids[type.operands[i]];
+					uint32_t memberSize = memberType.opcode == SpvOpTypeMatrix && layout.matrixStride
+						? memberType.operands[1] * layout.matrixStride : typeSize(ids, type.operands[i]);
+					size = std::max(size, layout.offset + memberSize);
+				}
+				return size;
+			}
+			default:
+				return 0;
+			}
+		}
+
+		VkDescriptorType descriptorType(const IdInfo& type, uint32_t storageClass)
+		{
+			if (storageClass == SpvStorageClassStorageBuffer) return VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+			if (storageClass == SpvStorageClassUniform) {
+				return type.bufferBlock ? VK_DESCRIPTOR_TYPE_STORAGE_BUFFER : VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
+			}
+			switch (type.opcode) {
+			case SpvOpTypeSampledImage: return VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+			case SpvOpTypeSampler: return VK_DESCRIPTOR_TYPE_SAMPLER;
+			case SpvOpTypeAccelerationStructureKHR: return VK_DESCRIPTOR_TYPE_ACCELERATION_STRUCTURE_KHR;
+			case SpvOpTypeImage: {
+				//sampled type, dim, depth, arrayed, multisampled, sampled, format
+				uint32_t dim = type.operands[1];
+				bool storage = type.operands[5] == 2;
+				if (dim == SpvDimBuffer) return storage ? VK_DESCRIPTOR_TYPE_STORAGE_TEXEL_BUFFER : VK_DESCRIPTOR_TYPE_UNIFORM_TEXEL_BUFFER;
+				if (dim == SpvDimSubpassData) return VK_DESCRIPTOR_TYPE_INPUT_ATTACHMENT;
+				return storage ? VK_DESCRIPTOR_TYPE_STORAGE_IMAGE : VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE;
+			}
+			default:
+				return VK_DESCRIPTOR_TYPE_MAX_ENUM;
+			}
+		}
+
+		VkFormat vertexFormat(const std::vector<IdInfo>& ids, uint32_t typeId)
+		{
+			const IdInfo* pType = &ids[typeId];
+			uint32_t components = 1;
+			if (pType->opcode == SpvOpTypeVector) {
+				components = pType->operands[1];
+				pType = &ids[pType->operands[0]];
+			}
+			if (pType->operands.empty() || pType->operands[0] != 32 || components < 1 || components > 4) {
+				return VK_FORMAT_UNDEFINED;
+			}
+			static constexpr VkFormat floatFormats[] = { VK_FORMAT_R32_SFLOAT, VK_FORMAT_R32G32_SFLOAT, VK_FORMAT_R32G32B32_SFLOAT, VK_FORMAT_R32G32B32A32_SFLOAT };
+			static constexpr VkFormat intFormats[] = { VK_FORMAT_R32_SINT, VK_FORMAT_R32G32_SINT, VK_FORMAT_R32G32B32_SINT, VK_FORMAT_R32G32B32A32_SINT };
+			static constexpr VkFormat uintFormats[] = { VK_FORMAT_R32_UINT, VK_FORMAT_R32G32_UINT, VK_FORMAT_R32G32B32_UINT, VK_FORMAT_R32G32B32A32_UINT };
+			if (pType->opcode == SpvOpTypeFloat) return floatFormats[components - 1];
+			if (pType->opcode == SpvOpTypeInt) return pType->operands[1] ? intFormats[components - 1] : uintFormats[components - 1];
+			return VK_FORMAT_UNDEFINED;
+		}
+
+		VkShaderStageFlags stageForExecutionModel(uint32_t model)
+		{
+			switch (model) {
+			case SpvExecutionModelVertex: return VK_SHADER_STAGE_VERTEX_BIT;
+			case SpvExecutionModelTessellationControl: return VK_SHADER_STAGE_TESSELLATION_CONTROL_BIT;
+			case SpvExecutionModelTessellationEvaluation: return VK_SHADER_STAGE_TESSELLATION_EVALUATION_BIT;
+			case SpvExecutionModelGeometry: return VK_SHADER_STAGE_GEOMETRY_BIT;
+			case SpvExecutionModelFragment: return VK_SHADER_STAGE_FRAGMENT_BIT;
+			case SpvExecutionModelGLCompute: return VK_SHADER_STAGE_COMPUTE_BIT;
+			default: return 0;
+			}
+		}
+	}
+
+	bool ShaderReflection::parse(const std::vector<char>& spirv)
+	{
+		*this = {};
+		constexpr size_t HEADER_WORDS = 5;
+		if (spirv.size() % sizeof(uint32_t) != 0 || spirv.size() < HEADER_WORDS * sizeof(uint32_t)) return false;
+		std::vector<uint32_t> words(spirv.size() / sizeof(uint32_t));
+		memcpy(words.data(), spirv.data(), spirv.size());
+		if (words[0] != SpvMagicNumber) return false;
+
+		std::vector<IdInfo> ids(words[3]);
+		std::vector<uint32_t> variables;
+		for (size_t i = HEADER_WORDS; i < words.size();) {
+			uint32_t opcode = words[i] & SpvOpCodeMask;
+			uint32_t wordCount = words[i] >> SpvWordCountShift;
+			if (wordCount == 0 || i + wordCount > words.size()) return false;
+			const uint32_t* pOperands = &words[i + 1];
+			switch (opcode) {
+			case SpvOpName:
+				ids[pOperands[0]].name = readString(pOperands + 1, wordCount - 2);
+				break;
+			case SpvOpEntryPoint:
+				m_stages |= stageForExecutionModel(pOperands[0]);
+				break;
+			case SpvOpDecorate: {
+				IdInfo& target = ids[pOperands[0]];
+				switch (pOperands[1]) {
+				case SpvDecorationDescriptorSet: target.set = pOperands[2]; break;
+				case SpvDecorationBinding: target.binding = pOperands[2]; break;
+				case SpvDecorationLocation: target.location = pOperands[2]; break;
+				case SpvDecorationArrayStride: target.arrayStride = pOperands[2]; break;
+				case SpvDecorationBuiltIn: target.builtIn = true; break;
+				case SpvDecorationBufferBlock: target.bufferBlock = true; break;
+				}
+				break;
+			}
+			case SpvOpMemberDecorate:
+				if (pOperands[2] == SpvDecorationOffset) member(ids[pOperands[0]], pOperands[1]).offset = pOperands[3];
+				if (pOperands[2] == SpvDecorationMatrixStride) member(ids[pOperands[0]], pOperands[1]).matrixStride = pOperands[3];
+				break;
+			case SpvOpTypeInt:
+			case SpvOpTypeFloat:
+			case SpvOpTypeVector:
+			case SpvOpTypeMatrix:
+			case SpvOpTypeImage:
+			case SpvOpTypeSampler:
+			case SpvOpTypeSampledImage:
+			case SpvOpTypeArray:
+			case SpvOpTypeRuntimeArray:
+			case SpvOpTypeStruct:
+			case SpvOpTypePointer:
+			case SpvOpTypeAccelerationStructureKHR:
+				ids[pOperands[0]].opcode = opcode;
+				ids[pOperands[0]].operands.assign(pOperands + 1, pOperands + wordCount - 1);
+				break;
+			case SpvOpConstant:
+				ids[pOperands[1]].opcode = opcode;
+				ids[pOperands[1]].value = pOperands[2];
+				break;
+			case SpvOpVariable:
+				ids[pOperands[1]].opcode = opcode;
+				ids[pOperands[1]].typeId = pOperands[0];
+				ids[pOperands[1]].storageClass = pOperands[2];
+				variables.push_back(pOperands[1]);
+				break;
+			}
+			i += wordCount;
+		}
+
+		for (uint32_t id : variables) {
+			const IdInfo& variable = ids[id];
+			//pointer operands: storage class, pointee
+			uint32_t typeId = ids[variable.typeId].operands[1];
+			switch (variable.storageClass) {
+			case SpvStorageClassUniformConstant:
+			case SpvStorageClassUniform:
+			case SpvStorageClassStorageBuffer: {
+				ReflectedBinding binding{};
+				binding.set = variable.set;
+				binding.binding = variable.binding;
+				binding.stages = m_stages;
+				binding.name = variable.name;
+				while (ids[typeId].opcode == SpvOpTypeArray || ids[typeId].opcode == SpvOpTypeRuntimeArray) {
+					//runtime arrays need descriptor indexing, they are reflected as one descriptor
+					if (ids[typeId].opcode == SpvOpTypeArray) {
+						binding.count *= ids[ids[typeId].operands[1]].value;
+					}
+					typeId = ids[typeId].operands[0];
+				}
+				if (binding.name.empty()) {
+					binding.name = ids[typeId].name;
+				}
+				binding.type = descriptorType(ids[typeId], variable.storageClass);
+				if (binding.binding != UINT32_MAX && binding.type != VK_DESCRIPTOR_TYPE_MAX_ENUM) {
+					m_bindings.push_back(binding);
+				}
+				break;
+			}
+			case SpvStorageClassPushConstant: {
+				const IdInfo& block = ids[typeId];
+				uint32_t offset = UINT32_MAX;
+				for (const Member& member : block.members) {
+					offset = std::min(offset, member.offset);
+				}
+				m_pushConstantOffset = std::min(m_pushConstantOffset, offset == UINT32_MAX ? 0 : offset);
+				m_pushConstantEnd = std::max(m_pushConstantEnd, typeSize(ids, typeId));
+				break;
+			}
+			case SpvStorageClassInput:
+				if (m_stages == VK_SHADER_STAGE_VERTEX_BIT && !variable.builtIn && variable.location != UINT32_MAX) {
+					ReflectedVertexInput input{};
+					input.location = variable.location;
+					input.format = vertexFormat(ids, typeId);
+					input.size = typeSize(ids, typeId);
+					input.name = variable.name;
+					m_vertexInputs.push_back(input);
+				}
+				break;
+			}
+		}
+		std::sort(m_bindings.begin(), m_bindings.end(), [](const ReflectedBinding& a, const ReflectedBinding& b) {
+			return a.set != b.set ? a.set < b.set : a.binding < b.binding;
+		});
+		std::sort(m_vertexInputs.begin(), m_vertexInputs.end(), [](const ReflectedVertexInput& a, const ReflectedVertexInput& b) {
+			return a.location < b.location;
+		});
+		return true;
+	}
+	//-----------------------------------------------------------------------------------------------
+	void ShaderReflection::merge(const ShaderReflection& other)
+	{
+		m_stages |= other.m_stages;
+		for (const ReflectedBinding& binding : other.m_bindings) {
+			auto it = std::find_if(m_bindings.begin(), m_bindings.end(), [&binding](const ReflectedBinding& existing) {
+				return existing.set == binding.set && existing.binding == binding.binding;
+			});
+			if (it == m_bindings.end()) {
+				m_bindings.push_back(binding);
+				continue;
+			}
+			ASSERT(it->type == binding.type && it->count == binding.count);
+			it->stages |= binding.stages;
+		}
+		std::sort(m_bindings.begin(), m_bindings.end(), [](const ReflectedBinding& a, const ReflectedBinding& b) {
+			return a.set != b.set ? a.set < b.set : a.binding < b.binding;
+		});
+		if (m_vertexInputs.empty()) {
+			m_vertexInputs = other.m_vertexInputs;
+		}
+		m_pushConstantOffset = std::min(m_pushConstantOffset, other.m_pushConstantOffset);
+		m_pushConstantEnd = std::max(m_pushConstantEnd, other.m_pushConstantEnd);
+	}
+	//-----------------------------------------------------------------------------------------------
+	const ReflectedBinding* ShaderReflection::findBinding(const std::string& name) const
+	{
+		for (const ReflectedBinding& binding : m_bindings) {
+			if (binding.name == name) return &binding;
+		}
+		return nullptr;
+	}
+	//-----------------------------------------------------------------------------------------------
+	uint32_t ShaderReflection::setCount() const
+	{
+		return m_bindings.empty() ? 0 : m_bindings.back().set + 1;
+	}
+	//-----------------------------------------------------------------------------------------------
+	std::vector<VkDescriptorSetLayoutBinding> ShaderReflection::setLayoutBindings(uint32_t set) const
+	{
+		std::vector<VkDescriptorSetLayoutBinding> layoutBindings;
+		for (const ReflectedBinding& binding : m_bindings) {
+			if (binding.set != set) continue;
+			VkDescriptorSetLayoutBinding layoutBinding{};
+			layoutBinding.binding = binding.binding;
+			layoutBinding.descriptorType = binding.type;
+			layoutBinding.descriptorCount = binding.count;
+			layoutBinding.stageFlags = binding.stages;
+			layoutBindings.push_back(layoutBinding);
+		}
+		return layoutBindings;
+	}
+	//-----------------------------------------------------------------------------------------------
+	std::vector<VkPushConstantRange> ShaderReflection::pushConstantRanges() const
+	{
+		if (m_pushConstantEnd == 0) return {};
+		VkPushConstantRange range{};
+		range.stageFlags = m_stages;
+		range.offset = m_pushConstantOffset;
+		range.size = m_pushConstantEnd - m_pushConstantOffset;
+		return { range };
+	}
+	//-----------------------------------------------------------------------------------------------
+	std::vector<VkDescriptorPoolSize> ShaderReflection::poolSizes(uint32_t setCopies) const
+	{
+		std::vector<VkDescriptorPoolSize> sizes;
+		for (const ReflectedBinding& binding : m_bindings) {
+			auto it = std::find_if(sizes.begin(), sizes.end(), [&binding](const VkDescriptorPoolSize& size) {
+				return size.type == binding.type;
+			});
+			if (it == sizes.end()) {
+				sizes.push_back({ binding.type, 0 });
+				it = sizes.end() - 1;
+			}
+			it->descriptorCount += binding.count * setCopies;
+		}
+		return sizes;
+	}
+	//-----------------------------------------------------------------------------------------------
+	VkVertexInputBindingDescription ShaderReflection::vertexBinding(uint32_t binding) const
+	{
+		VkVertexInputBindingDescription description{};
+		description.binding = binding;
+		description.inputRate = VK_VERTEX_INPUT_RATE_VERTEX;
+		for (const ReflectedVertexInput& input : m_vertexInputs) {
+			description.stride += input.size;
+		}
+		return description;
+	}
+	//-----------------------------------------------------------------------------------------------
+	std::vector<VkVertexInputAttributeDescription> ShaderReflection::vertexAttributes(uint32_t binding) const
+	{
+		std::vector<VkVertexInputAttributeDescription> attributes;
+		uint32_t offset = 0;
+		for (const ReflectedVertexInput& input : m_vertexInputs) {
+			VkVertexInputAttributeDescription attribute{};
+			attribute.binding = binding;
+			attribute.location = input.location;
+			attribute.format = input.format;
+			attribute.offset = offset;
+			attributes.push_back(attribute);
+			offset += input.size;
+		}
+		return attributes;
+	}
+}
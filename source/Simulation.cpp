@@ -0,0 +1,176 @@
+#include "Simulation.h"
+#include <algorithm>
+#include <iomanip>
+#include <iostream>
+
+namespace Clan
+{
+	namespace
+	{
+		//steps run back to back after a stall before the rest are dropped, otherwise a simulation
+		//slower than real time would fall further behind with every batch
+		constexpr uint32_t MAX_CATCH_UP_STEPS = 8;
+
+		//Value of the triple buffer benchmark, every word holds the sequence number so a torn copy shows
+		struct BenchmarkValue {
+			uint64_t words[16]{};
+		};
+
+		struct SimulationRun {
+			uint64_t ticks{ 0 };
+			uint64_t dropped{ 0 };
+			double longestSampleMicroseconds{ 0.0 };
+		};
+
+		//Samples the simulation from this thread as a render loop would, for 'seconds'
+		SimulationRun runSimulation(uint32_t stepsPerSecond, double seconds, Simulation::StepFunction step)
+		{
+			Simulation simulation;
+			simulation.init(stepsPerSecond, SimulationState{}, std::move(step));
+			SimulationRun run{};
+			auto begin = Simulation::Clock::now();
+			auto end = begin + std::chrono::duration_cast<Simulation::Clock::duration>(std::chrono::duration<double>(seconds));
+			for (auto now = begin; now < end; now = Simulation::Clock::now()) {
+				SimulationState state = simulation.sample(now);
+				double microseconds = std::chrono::duration<double, std::micro>(Simulation::Clock::now() - now).count();
+				run.longestSampleMicroseconds = std::max(run.longestSampleMicroseconds, microseconds);
+				run.ticks = std::max(run.ticks, state.tick);
+				std::this_thread::sleep_for(std::chrono::milliseconds(1));
+			}
+			simulation.destroy();
+			run.dropped = simulation.droppedSteps();
+			return run;
+		}
+	}
+
+	SimulationState interpolate(const SimulationState& from, const SimulationState& to, float alpha)
+	{
+		SimulationState state{};
+		state.tick = alpha < 1.0f ? from.tick : to.tick;
+		state.modelRotation = glm::slerp(from.modelRotation, to.modelRotation, alpha);
+		return state;
+	}
+	//-----------------------------------------------------------------------------------------------
+	void Simulation::init(uint32_t stepsPerSecond, const SimulationState& initial, StepFunction step)
+	{
+		ASSERT(stepsPerSecond > 0 && step);
+		m_step = std::move(step);
+		m_stepDuration = std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double>(1.0 / stepsPerSecond));
+		m_stepSeconds = 1.0f / stepsPerSecond;
+		m_stop = false;
+		m_droppedSteps = 0;
+		Snapshot snapshot{};
+		snapshot.previous = initial;
+		snapshot.current = initial;
+		snapshot.time = Clock::now();
+		m_snapshots.reset(snapshot);
+		m_thread = std::thread(&Simulation::threadLoop, this, initial);
+	}
+	//-----------------------------------------------------------------------------------------------
+	void Simulation::destroy()
+	{
+		if (!m_thread.joinable()) return;
+		{
+			std::lock_guard<std::mutex> lock(m_mutex);
+			m_stop = true;
+		}
+		m_stopRequested.notify_one();
+		m_thread.join();
+	}
+	//-----------------------------------------------------------------------------------------------
+	SimulationState Simulation::sample(Clock::time_point now)
+	{
+		const Snapshot& snapshot = m_snapshots.read();
+		//'previous' was due one step before 'time', so this lags the clock by one step
+		float alpha = std::chrono::duration<float>(now - snapshot.time).count() / m_stepSeconds;
+		return interpolate(snapshot.previous, snapshot.current, std::clamp(alpha, 0.0f, 1.0f));
+	}
+	//-----------------------------------------------------------------------------------------------
+	void Simulation::threadLoop(SimulationState initial)
+	{
+		Snapshot snapshot{};
+		snapshot.current = initial;
+		snapshot.time = Clock::now();
+		Clock::time_point next = snapshot.time + m_stepDuration;
+		while (true) {
+			{
+				std::unique_lock<std::mutex> lock(m_mutex);
+				if (m_stopRequested.wait_until(lock, next, [this]() { return m_stop; })) break;
+			}
+			Clock::time_point now = Clock::now();
+			for (uint32_t steps = 0; next <= now && steps < MAX_CATCH_UP_STEPS; ++steps) {
+				snapshot.previous = snapshot.current;
+				m_step(snapshot.current, m_stepSeconds);
+				++snapshot.current.tick;
+				snapshot.time = next;
+				next += m_stepDuration;
+			}
+			if (next <= now) {
+				uint64_t dropped = static_cast<uint64_t>((now - next) / m_stepDuration) + 1;
+				m_droppedSteps.fetch_add(dropped, std::memory_order_relaxed);
+				next += m_stepDuration * dropped;
+				//the interpolation restarts from the present instead of replaying the stall
+				snapshot.time = next - m_stepDuration;
+			}
+			m_snapshots.back() = snapshot;
+			m_snapshots.publish();
+		}
+	}
+	//-----------------------------------------------------------------------------------------------
+	void benchmarkSimulation(uint32_t publishes)
+	{
+		std::cout << "triple buffer, " << publishes << " publishes against a reader spinning on read()" << std::endl;
+		TripleBuffer<BenchmarkValue> buffer;
+		buffer.reset(BenchmarkValue{});
+		std::atomic<bool> done{ false };
+		uint64_t reads = 0, newValues = 0, torn = 0, older = 0;
+		std::thread reader([&]() {
+			uint64_t last = 0;
+			while (!done.load(std::memory_order_acquire)) {
+				const BenchmarkValue& value = buffer.read();
+				++reads;
+				if (!std::all_of(std::begin(value.words), std::end(value.words), [&](uint64_t word) { return word == value.words[0]; })) ++torn;
+				if (value.words[0] < last) ++older;
+				if (value.words[0] > last) ++newValues;
+				last = value.words[0];
+			}
+		});
+		auto begin = std::chrono::steady_clock::now();
+		for (uint64_t i = 1; i <= publishes; ++i) {
+			std::fill(std::begin(buffer.back().words), std::end(buffer.back().words), i);
+			buffer.publish();
+		}
+		double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - begin).count();
+		done.store(true, std::memory_order_release);
+		reader.join();
+		std::cout << std::fixed << std::setprecision(2) << publishes / seconds / 1e6 << " Mpublishes/s, " << reads << " reads, "
+			<< newValues << " new values" << (torn > 0 ? "  TORN VALUES" : "") << (older > 0 ? "  OLDER VALUES" : "") << std::endl;
+
+		//a step that keeps up must run every step and drop none, one slower than real time drops
+		//steps but never holds up sample()
+		constexpr uint32_t STEPS_PER_SECOND = 100;
+		constexpr double SECONDS = 1.0;
+		std::cout << "simulation, " << STEPS_PER_SECOND << " steps per second for " << SECONDS << " s" << std::endl;
+		std::cout << std::setw(10) << "step" << std::setw(10) << "ticks" << std::setw(10) << "dropped"
+			<< std::setw(14) << "sample max us" << std::endl;
+		struct StepCase {
+			const char* name;
+			bool keepsUp;
+			Simulation::StepFunction step;
+		};
+		const StepCase steps[] = {
+			{ "cheap", true, [](SimulationState&, float) {} },
+			{ "slow", false, [](SimulationState&, float stepSeconds) {
+				std::this_thread::sleep_for(std::chrono::duration<float>(stepSeconds * 2.0f));
+			} },
+		};
+		for (const auto& [name, keepsUp, step] : steps) {
+			SimulationRun run = runSimulation(STEPS_PER_SECOND, SECONDS, step);
+			//the sample lags one step, and the first one is due a step after the start
+			uint64_t expected = static_cast<uint64_t>(STEPS_PER_SECOND * SECONDS);
+			bool wrong = keepsUp ? (run.dropped > 0 || run.ticks + 3 < expected) : run.dropped == 0;
+			std::cout << std::setw(10) << name << std::setw(10) << run.ticks << std::setw(10) << run.dropped
+				<< std::setw(14) << std::setprecision(1) << run.longestSampleMicroseconds << (wrong ? "  WRONG STEP COUNT" : "") << std::endl;
+		}
+	}
+}
@@ -1,17 +1,19 @@
 #include "StackAllocator.h"
+#include "MemoryTracker.h"
 
 namespace Clan
 {
 	StackAllocator::StackAllocator(uint32_t stackSize_bytes)
 	{
-		m_pBottom = new uint8_t[stackSize_bytes];
+		m_pBottom = static_cast<uint8_t*>(TRACKED_ALLOC(stackSize_bytes, 16, MemoryTag::StackAllocator));
+		ASSERT(m_pBottom != nullptr);
 		m_pTop = m_pBottom;
 		m_pCapability = m_pBottom + stackSize_bytes;
 	}
 
 	StackAllocator::~StackAllocator()
 	{
-		delete[] m_pBottom;
+		trackedFree(m_pBottom);
 		m_pBottom = m_pTop = m_pCapability = nullptr;
 	}
 }
\ No newline at end of file
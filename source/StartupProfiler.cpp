@@ -0,0 +1,168 @@
+#include "StartupProfiler.h"
+#include <algorithm>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+#ifndef _WIN32
+	#include <fcntl.h>
+	#include <unistd.h>
+#endif
+
+namespace Clan
+{
+	namespace
+	{
+		constexpr const char* RUN_REPORT_PATH = "startup_run.json";
+
+		void evictFile(const std::filesystem::path& path)
+		{
+#if defined(POSIX_FADV_DONTNEED)
+			int fd = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+			if (fd < 0) return;
+			posix_fadvise(fd, 0, 0, POSIX_FADV_DONTNEED);
+			close(fd);
+#else
+			//no way to drop another file's pages without admin rights, the cold runs only lose the caches
+			(void)path;
+#endif
+		}
+
+		void makeCold(const ColdStartFiles& files)
+		{
+			std::error_code error;
+			for (const std::string& cache : files.caches) {
+				std::filesystem::remove(cache, error);
+			}
+			for (const std::string& asset : files.assets) {
+				if (std::filesystem::is_directory(asset, error)) {
+					for (auto it = std::filesystem::recursive_directory_iterator(asset, error); !error && it != std::filesystem::recursive_directory_iterator(); it.increment(error)) {
+						if (it->is_regular_file()) evictFile(it->path());
+					}
+				}
+				else {
+					evictFile(asset);
+				}
+			}
+		}
+
+		//runs one start and returns its report, empty if it failed
+		std::string runOnce(const std::string& executable)
+		{
+			std::error_code error;
+			std::filesystem::remove(RUN_REPORT_PATH, error);
+			std::string command = "\"" + executable + "\" --headless --startup-report " + RUN_REPORT_PATH;
+#ifdef _WIN32
+			//cmd strips the outer quotes of the whole line
+			command = "\"" + command + "\"";
+#endif
+			if (std::system(command.c_str()) != 0) return {};
+			std::ifstream file(RUN_REPORT_PATH);
+			std::stringstream report;
+			report << file.rdbuf();
+			return report.str();
+		}
+
+		double reportTotal(const std::string& report)
+		{
+			const std::string key = "\"totalMilliseconds\":";
+			size_t position = report.find(key);
+			return position == std::string::npos ? 0.0 : std::strtod(report.c_str() + position + key.size(), nullptr);
+		}
+
+		double median(std::vector<double> values)
+		{
+			if (values.empty()) return 0.0;
+			std::sort(values.begin(), values.end());
+			size_t middle = values.size() / 2;
+			return values.size() % 2 ? values[middle] : (values[middle - 1] + values[middle]) * 0.5;
+		}
+	}
+	//-----------------------------------------------------------------------------------------------
+	void StartupProfiler::start()
+	{
+		m_start = Clock::now();
+		m_steps.clear();
+		m_totalMilliseconds = 0.0;
+		m_inStep = false;
+	}
+	//-----------------------------------------------------------------------------------------------
+	void StartupProfiler::beginStep(const char* name)
+	{
+		endStep();
+		m_steps.push_back(StartupStep{ name });
+		m_stepStart = Clock::now();
+		m_inStep = true;
+	}
+	//-----------------------------------------------------------------------------------------------
+	void StartupProfiler::endStep()
+	{
+		if (!m_inStep) return;
+		Clock::time_point now = Clock::now();
+		m_steps.back().milliseconds = std::chrono::duration<double, std::milli>(now - m_stepStart).count();
+		m_totalMilliseconds = std::chrono::duration<double, std::milli>(now - m_start).count();
+		m_inStep = false;
+	}
+	//-----------------------------------------------------------------------------------------------
+	std::string StartupProfiler::toJson() const
+	{
+		std::ostringstream json;
+		json << std::fixed << std::setprecision(3);
+		json << "{\"totalMilliseconds\": " << m_totalMilliseconds << ", \"steps\": [";
+		for (size_t i = 0; i < m_steps.size(); ++i) {
+			json << (i > 0 ? ", " : "") << "{\"name\": \"" << m_steps[i].name << "\", \"milliseconds\": " << m_steps[i].milliseconds << "}";
+		}
+		json << "]}";
+		return json.str();
+	}
+	//-----------------------------------------------------------------------------------------------
+	bool StartupProfiler::writeJson(const std::string& path) const
+	{
+		std::ofstream file(path, std::ios::trunc);
+		file << toJson() << std::endl;
+		return file.good();
+	}
+	//-----------------------------------------------------------------------------------------------
+	bool benchmarkStartup(const std::string& executable, uint32_t runs, const ColdStartFiles& files, const std::string& reportPath)
+	{
+		std::vector<std::string> coldReports, warmReports;
+		std::vector<double> coldTotals, warmTotals;
+		for (uint32_t i = 0; i < runs; ++i) {
+			makeCold(files);
+			std::string report = runOnce(executable);
+			if (report.empty()) return false;
+			coldTotals.push_back(reportTotal(report));
+			coldReports.push_back(report);
+		}
+		//the last cold run left the caches behind, one more run settles the OS file cache
+		if (runOnce(executable).empty()) return false;
+		for (uint32_t i = 0; i < runs; ++i) {
+			std::string report = runOnce(executable);
+			if (report.empty()) return false;
+			warmTotals.push_back(reportTotal(report));
+			warmReports.push_back(report);
+		}
+		std::error_code error;
+		std::filesystem::remove(RUN_REPORT_PATH, error);
+		auto joinReports = [](const std::vector<std::string>& reports) {
+			std::string joined;
+			for (const std::string& report : reports) {
+				//each report ends with a newline
+				joined += (joined.empty() ? "" : ", ") + report.substr(0, report.find_last_not_of("\r\n") + 1);
+			}
+			return joined;
+		};
+		std::ofstream file(reportPath, std::ios::trunc);
+		file << std::fixed << std::setprecision(3);
+		file << "{\"runs\": " << runs
+			<< ", \"coldMedianMilliseconds\": " << median(coldTotals)
+			<< ", \"warmMedianMilliseconds\": " << median(warmTotals)
+			<< ", \"cold\": [" << joinReports(coldReports) << "]"
+			<< ", \"warm\": [" << joinReports(warmReports) << "]}" << std::endl;
+		std::cout << std::fixed << std::setprecision(1) << "startup over " << runs << " runs: cold " << median(coldTotals)
+			<< " ms, warm " << median(warmTotals) << " ms (median), reports in " << reportPath << std::endl;
+		return file.good();
+	}
+}
@@ -0,0 +1,295 @@
+#include "TextureLoader.h"
+#include <chrono>
+#include <atomic>
+#include <cstring>
+#include <mutex>
+#include <condition_variable>
+#include <cstdlib>
+
+namespace
+{
+	//The staging region the decoder on this thread writes into. stb allocates its result with the
+	//size of the decoded image, that allocation is handed the region instead of the heap, so the
+	//texels are written where they are uploaded from. Scratch buffers of other sizes, and a result
+	//stb converts afterwards, still come from the heap.
+	struct DecodeTarget {
+		void* pData{ nullptr };
+		size_t size{ 0 };
+		size_t capacity{ 0 };
+		bool claimed{ false };
+	};
+
+	thread_local DecodeTarget t_decodeTarget{};
+
+	void* decodeMalloc(size_t size)
+	{
+		DecodeTarget& target = t_decodeTarget;
+		if (target.pData != nullptr && !target.claimed && size >= target.size && size <= target.capacity) {
+			target.claimed = true;
+			return target.pData;
+		}
+		return std::malloc(size);
+	}
+
+	void* decodeRealloc(void* p, size_t oldSize, size_t newSize)
+	{
+		DecodeTarget& target = t_decodeTarget;
+		if (p == nullptr || p != target.pData) {
+			return std::realloc(p, newSize);
+		}
+		//the region can't grow, the contents move to the heap
+		void* pMoved = std::malloc(newSize);
+		if (pMoved != nullptr) {
+			std::memcpy(pMoved, p, oldSize < newSize ? oldSize : newSize);
+			target.claimed = false;
+		}
+		return pMoved;
+	}
+
+	void decodeFree(void* p)
+	{
+		DecodeTarget& target = t_decodeTarget;
+		if (p != nullptr && p == target.pData) {
+			target.claimed = false;
+			return;
+		}
+		std::free(p);
+	}
+}
+
+#define STBI_MALLOC(size) decodeMalloc(size)
+#define STBI_REALLOC_SIZED(p, oldSize, newSize) decodeRealloc(p, oldSize, newSize)
+#define STBI_FREE(p) decodeFree(p)
+#define STB_IMAGE_IMPLEMENTATION
+#include "stb_image.h"
+
+namespace Clan
+{
+	namespace
+	{
+		//copy offsets have to be a multiple of the texel size
+		constexpr VkDeviceSize REGION_ALIGNMENT = 16;
+		//the jpeg decoder allocates a byte more than the texels for its result
+		constexpr VkDeviceSize DECODE_SLACK = 1;
+
+		//8 bytes per step, images are large and the hash only picks the candidates for a compare
+		uint64_t hashContents(const uint8_t* pData, size_t size)
+		{
+			uint64_t hash = 14695981039346656037ull ^ size;
+			size_t i = 0;
+			for (; i + 8 <= size; i += 8) {
+				uint64_t word = 0;
+				std::memcpy(&word, pData + i, sizeof(word));
+				hash = (hash ^ word) * 0x9E3779B97F4A7C15ull;
+				hash ^= hash >> 29;
+			}
+			for (; i < size; ++i) {
+				hash = (hash ^ pData[i]) * 1099511628211ull;
+			}
+			return hash;
+		}
+	}
+	//-----------------------------------------------------------------------------------------------
+	void TextureBatch::open(const std::vector<std::string>& paths, ThreadPool& pool, const AssetArchive* pArchive)
+	{
+		close();
+		m_paths = paths;
+		m_files = std::make_unique<MappedFile[]>(paths.size());
+		m_sources.assign(paths.size(), AssetSpan{});
+		m_storage.assign(paths.size(), std::vector<char>{});
+		m_regions.assign(paths.size(), TextureRegion{});
+		m_valid.assign(paths.size(), 0);
+		m_contentHashes.assign(paths.size(), 0);
+		m_duplicateOf.resize(paths.size());
+		for (size_t i = 0; i < paths.size(); ++i) {
+			m_duplicateOf[i] = i;
+		}
+		for (size_t i = 0; i < paths.size(); ++i) {
+			if (paths[i].empty()) continue;
+			if (pArchive != nullptr && pArchive->contains(paths[i])) {
+				pool.submit([this, i, pArchive]() {
+					m_sources[i] = pArchive->load(m_paths[i], m_storage[i]);
+					readHeader(i);
+				});
+			}
+			else {
+				pool.submit([this, i]() {
+					MappedFile& file = m_files[i];
+					if (file.open(m_paths[i])) {
+						//the kernel reads the rest ahead while the header is parsed and the others open
+						file.prefetch();
+						m_sources[i] = AssetSpan{ file.data(), file.size() };
+					}
+					readHeader(i);
+				});
+			}
+		}
+		pool.wait();
+		findDuplicates();
+		m_stagingSize = 0;
+		for (size_t i = 0; i < m_regions.size(); ++i) {
+			if (m_duplicateOf[i] != i) continue;
+			TextureRegion& region = m_regions[i];
+			region.offset = m_stagingSize;
+			VkDeviceSize size = static_cast<VkDeviceSize>(region.width) * region.height * 4;
+			m_stagingSize += (size + DECODE_SLACK + REGION_ALIGNMENT - 1) & ~(REGION_ALIGNMENT - 1);
+		}
+	}
+	//-----------------------------------------------------------------------------------------------
+	void TextureBatch::close()
+	{
+		for (size_t i = 0; m_files && i < m_regions.size(); ++i) {
+			m_files[i].close();
+		}
+		m_files.reset();
+		m_sources.clear();
+		m_storage.clear();
+		m_paths.clear();
+		m_regions.clear();
+		m_valid.clear();
+		m_contentHashes.clear();
+		m_duplicateOf.clear();
+		m_stagingSize = 0;
+	}
+	//-----------------------------------------------------------------------------------------------
+	TextureLoadStats TextureBatch::decode(ThreadPool& pool, void* pStaging, const std::function<void(size_t index)>& onDecoded)
+	{
+		TextureLoadStats stats{};
+		stats.textureCount = static_cast<uint32_t>(m_regions.size());
+		std::atomic<uint32_t> failedCount{ 0 };
+		std::atomic<uint32_t> copiedCount{ 0 };
+		//indices of the written regions, handed from the workers to this thread
+		std::mutex mutex;
+		std::condition_variable decodedReady;
+		std::vector<size_t> decoded;
+		size_t remaining = 0;
+		auto start = std::chrono::steady_clock::now();
+		for (size_t i = 0; i < m_regions.size(); ++i) {
+			if (m_duplicateOf[i] != i) {
+				++stats.duplicateCount;
+				continue;
+			}
+			const TextureRegion& region = m_regions[i];
+			uint8_t* pDst = static_cast<uint8_t*>(pStaging) + region.offset;
+			size_t size = static_cast<size_t>(region.width) * region.height * 4;
+			stats.decodedBytes += size;
+			if (!m_valid[i]) {
+				std::memset(pDst, 0xFF, size);
+				if (!m_paths[i].empty()) ++failedCount;
+				if (onDecoded) onDecoded(i);
+				continue;
+			}
+			stats.fileBytes += m_sources[i].size;
+			++remaining;
+			pool.submit([this, i, pDst, size, &failedCount, &copiedCount, &mutex, &decodedReady, &decoded]() {
+				const AssetSpan& source = m_sources[i];
+				int width = 0, height = 0, channels = 0;
+				t_decodeTarget = DecodeTarget{ pDst, size, size + DECODE_SLACK };
+				stbi_uc* pixels = stbi_load_from_memory(source.data, static_cast<int>(source.size), &width, &height, &channels, STBI_rgb_alpha);
+				t_decodeTarget = DecodeTarget{};
+				if (pixels == nullptr || static_cast<size_t>(width) * height * 4 != size) {
+					std::memset(pDst, 0xFF, size);
+					++failedCount;
+				}
+				else if (pixels != pDst) {
+					std::memcpy(pDst, pixels, size);
+					++copiedCount;
+				}
+				if (pixels != pDst) {
+					stbi_image_free(pixels);
+				}
+				{
+					std::lock_guard<std::mutex> lock(mutex);
+					decoded.push_back(i);
+				}
+				decodedReady.notify_one();
+			});
+		}
+		std::vector<size_t> ready;
+		while (remaining > 0) {
+			{
+				std::unique_lock<std::mutex> lock(mutex);
+				decodedReady.wait(lock, [&decoded]() { return !decoded.empty(); });
+				ready.swap(decoded);
+			}
+			remaining -= ready.size();
+			for (size_t index : ready) {
+				if (onDecoded) onDecoded(index);
+			}
+			ready.clear();
+		}
+		pool.wait();
+		stats.milliseconds = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+		stats.failedCount = failedCount;
+		stats.copiedCount = copiedCount;
+		return stats;
+	}
+	//-----------------------------------------------------------------------------------------------
+	void TextureBatch::readHeader(size_t index)
+	{
+		const AssetSpan& source = m_sources[index];
+		int width = 0, height = 0, channels = 0;
+		if (source.data != nullptr &&
+			stbi_info_from_memory(source.data, static_cast<int>(source.size), &width, &height, &channels) != 0) {
+			m_regions[index].width = static_cast<uint32_t>(width);
+			m_regions[index].height = static_cast<uint32_t>(height);
+			m_valid[index] = 1;
+			m_contentHashes[index] = hashContents(source.data, source.size);
+		}
+		else {
+			m_files[index].close();
+			m_storage[index].clear();
+			m_sources[index] = AssetSpan{};
+		}
+	}
+	//-----------------------------------------------------------------------------------------------
+	void TextureBatch::findDuplicates()
+	{
+		std::unordered_multimap<uint64_t, size_t> firstByHash;
+		for (size_t i = 0; i < m_regions.size(); ++i) {
+			if (!m_valid[i]) continue;
+			const AssetSpan& source = m_sources[i];
+			auto [begin, end] = firstByHash.equal_range(m_contentHashes[i]);
+			for (auto it = begin; it != end; ++it) {
+				const AssetSpan& first = m_sources[it->second];
+				if (first.size == source.size && std::memcmp(first.data, source.data, source.size) == 0) {
+					m_duplicateOf[i] = it->second;
+					break;
+				}
+			}
+			if (m_duplicateOf[i] == i) {
+				firstByHash.emplace(m_contentHashes[i], i);
+			}
+			else {
+				m_files[i].close();
+				m_storage[i].clear();
+				m_sources[i] = AssetSpan{};
+			}
+		}
+	}
+	//-----------------------------------------------------------------------------------------------
+	uint32_t TextureRegistry::find(const std::string& path)
+	{
+		auto [it, inserted] = m_indices.try_emplace(path, static_cast<uint32_t>(m_paths.size()));
+		if (inserted) {
+			m_paths.push_back(path);
+			m_resolved.push_back(it->second);
+		}
+		return it->second;
+	}
+	//-----------------------------------------------------------------------------------------------
+	void TextureRegistry::merge(const TextureBatch& batch)
+	{
+		ASSERT(batch.size() == m_paths.size());
+		for (size_t i = 0; i < m_paths.size(); ++i) {
+			m_resolved[i] = static_cast<uint32_t>(batch.duplicateOf(i));
+		}
+	}
+	//-----------------------------------------------------------------------------------------------
+	void TextureRegistry::clear()
+	{
+		m_paths.clear();
+		m_indices.clear();
+		m_resolved.clear();
+	}
+}
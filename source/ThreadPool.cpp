@@ -0,0 +1,65 @@
+#include "ThreadPool.h"
+#include <algorithm>
+
+namespace Clan
+{
+	void ThreadPool::init(uint32_t threadCount)
+	{
+		if (threadCount == 0) {
+			threadCount = std::max(1u, std::thread::hardware_concurrency());
+		}
+		m_stop = false;
+		m_threads.reserve(threadCount);
+		for (uint32_t i = 0; i < threadCount; ++i) {
+			m_threads.emplace_back(&ThreadPool::workerLoop, this);
+		}
+	}
+	//-----------------------------------------------------------------------------------------------
+	void ThreadPool::destroy()
+	{
+		{
+			std::lock_guard<std::mutex> lock(m_mutex);
+			m_stop = true;
+		}
+		m_taskReady.notify_all();
+		for (std::thread& thread : m_threads) {
+			thread.join();
+		}
+		m_threads.clear();
+	}
+	//-----------------------------------------------------------------------------------------------
+	void ThreadPool::submit(std::function<void()> task)
+	{
+		ASSERT(!m_threads.empty());
+		{
+			std::lock_guard<std::mutex> lock(m_mutex);
+			m_tasks.push_back(std::move(task));
+			++m_pending;
+		}
+		m_taskReady.notify_one();
+	}
+	//-----------------------------------------------------------------------------------------------
+	void ThreadPool::wait()
+	{
+		std::unique_lock<std::mutex> lock(m_mutex);
+		m_idle.wait(lock, [this]() { return m_pending == 0; });
+	}
+	//-----------------------------------------------------------------------------------------------
+	void ThreadPool::workerLoop()
+	{
+		std::unique_lock<std::mutex> lock(m_mutex);
+		while (true) {
+			m_taskReady.wait(lock, [this]() { return m_stop || !m_tasks.empty(); });
+			//the queue is drained before stopping
+			if (m_tasks.empty()) return;
+			std::function<void()> task = std::move(m_tasks.front());
+			m_tasks.pop_front();
+			lock.unlock();
+			task();
+			lock.lock();
+			if (--m_pending == 0) {
+				m_idle.notify_all();
+			}
+		}
+	}
+}
@@ -0,0 +1,635 @@
+#include <iostream>
+#include <iomanip>
+#include <chrono>
+#include <random>
+#include <bit>
+#include <cmath>
+#include <algorithm>
+#define GLM_FORCE_RADIANS
+#define GLM_FORCE_DEPTH_ZERO_TO_ONE
+#include <glm/gtc/matrix_transform.hpp>
+#include "TransformKernels.h"
+
+#if defined(_M_X64) || defined(_M_IX86) || defined(__x86_64__) || defined(__i386__)
+	#define CLAN_X86
+	#include <immintrin.h>
+	#ifdef _MSC_VER
+		#include <intrin.h>
+	#else
+		#include <cpuid.h>
+	#endif
+#endif
+
+//MSVC emits any intrinsic anywhere, GCC and Clang need the instruction set enabled per function
+#if defined(_MSC_VER) && !defined(__clang__)
+	#define CLAN_TARGET_AVX2
+#else
+	#define CLAN_TARGET_AVX2 __attribute__((target("avx2,fma")))
+#endif
+
+namespace Clan
+{
+	namespace
+	{
+		//-------------------------------------------------------------------------------------------
+		//glm scalar path, also the reference of the benchmark
+		//-------------------------------------------------------------------------------------------
+		void composeScalar(const TransformArrays& t, size_t begin, size_t end, glm::mat4* out)
+		{
+			for (size_t i = begin; i < end; ++i) {
+				glm::mat4 m = glm::mat4_cast(glm::quat(t.rotationW[i], t.rotationX[i], t.rotationY[i], t.rotationZ[i]));
+				m[0] *= t.scaleX[i];
+				m[1] *= t.scaleY[i];
+				m[2] *= t.scaleZ[i];
+				m[3] = glm::vec4(t.positionX[i], t.positionY[i], t.positionZ[i], 1.0f);
+				out[i] = m;
+			}
+		}
+		//-------------------------------------------------------------------------------------------
+		void multiplyScalar(const glm::mat4* a, const glm::mat4* b, glm::mat4* out, size_t count)
+		{
+			for (size_t i = 0; i < count; ++i) {
+				out[i] = a[i] * b[i];
+			}
+		}
+		//-------------------------------------------------------------------------------------------
+		void multiplyLeftScalar(const glm::mat4& a, const glm::mat4* b, glm::mat4* out, size_t count)
+		{
+			for (size_t i = 0; i < count; ++i) {
+				out[i] = a * b[i];
+			}
+		}
+		//-------------------------------------------------------------------------------------------
+		void transformBoundsScalar(const glm::mat4* matrices, const BoundsArrays& local, BoundsArrays& world, size_t begin, size_t end)
+		{
+			for (size_t i = begin; i < end; ++i) {
+				const glm::mat4& m = matrices[i];
+				glm::vec3 center = glm::vec3(m * glm::vec4(local.centerX[i], local.centerY[i], local.centerZ[i], 1.0f));
+				glm::vec3 extent = glm::abs(glm::vec3(m[0])) * local.extentX[i]
+					+ glm::abs(glm::vec3(m[1])) * local.extentY[i]
+					+ glm::abs(glm::vec3(m[2])) * local.extentZ[i];
+				world.centerX[i] = center.x;
+				world.centerY[i] = center.y;
+				world.centerZ[i] = center.z;
+				world.extentX[i] = extent.x;
+				world.extentY[i] = extent.y;
+				world.extentZ[i] = extent.z;
+			}
+		}
+		//-------------------------------------------------------------------------------------------
+		size_t cullBoundsScalar(const Frustum& frustum, const BoundsArrays& bounds, size_t begin, size_t end, uint8_t* visible)
+		{
+			size_t visibleCount = 0;
+			for (size_t i = begin; i < end; ++i) {
+				glm::vec3 center(bounds.centerX[i], bounds.centerY[i], bounds.centerZ[i]);
+				glm::vec3 extent(bounds.extentX[i], bounds.extentY[i], bounds.extentZ[i]);
+				uint8_t inside = 1;
+				for (const glm::vec4& plane : frustum.planes) {
+					float distance = glm::dot(glm::vec3(plane), center) + plane.w;
+					float radius = glm::dot(glm::abs(glm::vec3(plane)), extent);
+					if (distance + radius < 0.0f) {
+						inside = 0;
+						break;
+					}
+				}
+				visible[i] = inside;
+				visibleCount += inside;
+			}
+			return visibleCount;
+		}
+
+#ifdef CLAN_X86
+		//-------------------------------------------------------------------------------------------
+		//SSE2, part of every x64 CPU, 4 objects per iteration
+		//-------------------------------------------------------------------------------------------
+		//Element 'row' of column 'column' of 4 consecutive matrices becomes one vector per row
+		inline void loadColumn4(const float* matrices, int column, __m128& x, __m128& y, __m128& z, __m128& w)
+		{
+			x = _mm_loadu_ps(matrices + column * 4);
+			y = _mm_loadu_ps(matrices + 16 + column * 4);
+			z = _mm_loadu_ps(matrices + 32 + column * 4);
+			w = _mm_loadu_ps(matrices + 48 + column * 4);
+			_MM_TRANSPOSE4_PS(x, y, z, w);
+		}
+		//-------------------------------------------------------------------------------------------
+		//Inverse of loadColumn4
+		inline void storeColumn4(float* matrices, int column, __m128 x, __m128 y, __m128 z, __m128 w)
+		{
+			_MM_TRANSPOSE4_PS(x, y, z, w);
+			_mm_storeu_ps(matrices + column * 4, x);
+			_mm_storeu_ps(matrices + 16 + column * 4, y);
+			_mm_storeu_ps(matrices + 32 + column * 4, z);
+			_mm_storeu_ps(matrices + 48 + column * 4, w);
+		}
+		//-------------------------------------------------------------------------------------------
+		inline __m128 abs4(__m128 v)
+		{
+			return _mm_andnot_ps(_mm_set1_ps(-0.0f), v);
+		}
+		//-------------------------------------------------------------------------------------------
+		inline void multiply4x4SSE(const float* a, const float* b, float* out)
+		{
+			__m128 a0 = _mm_loadu_ps(a);
+			__m128 a1 = _mm_loadu_ps(a + 4);
+			__m128 a2 = _mm_loadu_ps(a + 8);
+			__m128 a3 = _mm_loadu_ps(a + 12);
+			for (int column = 0; column < 4; ++column) {
+				__m128 bc = _mm_loadu_ps(b + column * 4);
+				__m128 r = _mm_mul_ps(a0, _mm_shuffle_ps(bc, bc, _MM_SHUFFLE(0, 0, 0, 0)));
+				r = _mm_add_ps(r, _mm_mul_ps(a1, _mm_shuffle_ps(bc, bc, _MM_SHUFFLE(1, 1, 1, 1))));
+				r = _mm_add_ps(r, _mm_mul_ps(a2, _mm_shuffle_ps(bc, bc, _MM_SHUFFLE(2, 2, 2, 2))));
+				r = _mm_add_ps(r, _mm_mul_ps(a3, _mm_shuffle_ps(bc, bc, _MM_SHUFFLE(3, 3, 3, 3))));
+				_mm_storeu_ps(out + column * 4, r);
+			}
+		}
+		//-------------------------------------------------------------------------------------------
+		void composeSSE(const TransformArrays& t, size_t begin, size_t end, glm::mat4* out)
+		{
+			const __m128 one = _mm_set1_ps(1.0f);
+			const __m128 two = _mm_set1_ps(2.0f);
+			const __m128 zero = _mm_setzero_ps();
+			size_t i = begin;
+			for (; i + 4 <= end; i += 4) {
+				__m128 qx = _mm_loadu_ps(&t.rotationX[i]);
+				__m128 qy = _mm_loadu_ps(&t.rotationY[i]);
+				__m128 qz = _mm_loadu_ps(&t.rotationZ[i]);
+				__m128 qw = _mm_loadu_ps(&t.rotationW[i]);
+				__m128 xx = _mm_mul_ps(qx, qx), yy = _mm_mul_ps(qy, qy), zz = _mm_mul_ps(qz, qz);
+				__m128 xy = _mm_mul_ps(qx, qy), xz = _mm_mul_ps(qx, qz), yz = _mm_mul_ps(qy, qz);
+				__m128 wx = _mm_mul_ps(qw, qx), wy = _mm_mul_ps(qw, qy), wz = _mm_mul_ps(qw, qz);
+				__m128 scaleX = _mm_loadu_ps(&t.scaleX[i]);
+				__m128 scaleY = _mm_loadu_ps(&t.scaleY[i]);
+				__m128 scaleZ = _mm_loadu_ps(&t.scaleZ[i]);
+				//the factor 2 of the rotation matrix is folded into the scale
+				__m128 sx = _mm_mul_ps(scaleX, two);
+				__m128 sy = _mm_mul_ps(scaleY, two);
+				__m128 sz = _mm_mul_ps(scaleZ, two);
+				float* dst = &out[i][0][0];
+				storeColumn4(dst, 0,
+					_mm_sub_ps(scaleX, _mm_mul_ps(sx, _mm_add_ps(yy, zz))),
+					_mm_mul_ps(sx, _mm_add_ps(xy, wz)),
+					_mm_mul_ps(sx, _mm_sub_ps(xz, wy)),
+					zero);
+				storeColumn4(dst, 1,
+					_mm_mul_ps(sy, _mm_sub_ps(xy, wz)),
+					_mm_sub_ps(scaleY, _mm_mul_ps(sy, _mm_add_ps(xx, zz))),
+					_mm_mul_ps(sy, _mm_add_ps(yz, wx)),
+					zero);
+				storeColumn4(dst, 2,
+					_mm_mul_ps(sz, _mm_add_ps(xz, wy)),
+					_mm_mul_ps(sz, _mm_sub_ps(yz, wx)),
+					_mm_sub_ps(scaleZ, _mm_mul_ps(sz, _mm_add_ps(xx, yy))),
+					zero);
+				storeColumn4(dst, 3, _mm_loadu_ps(&t.positionX[i]), _mm_loadu_ps(&t.positionY[i]), _mm_loadu_ps(&t.positionZ[i]), one);
+			}
+			composeScalar(t, i, end, out);
+		}
+		//-------------------------------------------------------------------------------------------
+		void multiplySSE(const glm::mat4* a, const glm::mat4* b, glm::mat4* out, size_t count)
+		{
+			for (size_t i = 0; i < count; ++i) {
+				multiply4x4SSE(&a[i][0][0], &b[i][0][0], &out[i][0][0]);
+			}
+		}
+		//-------------------------------------------------------------------------------------------
+		void multiplyLeftSSE(const glm::mat4& a, const glm::mat4* b, glm::mat4* out, size_t count)
+		{
+			for (size_t i = 0; i < count; ++i) {
+				multiply4x4SSE(&a[0][0], &b[i][0][0], &out[i][0][0]);
+			}
+		}
+		//-------------------------------------------------------------------------------------------
+		void transformBoundsSSE(const glm::mat4* matrices, const BoundsArrays& local, BoundsArrays& world, size_t begin, size_t end)
+		{
+			size_t i = begin;
+			for (; i + 4 <= end; i += 4) {
+				const float* m = &matrices[i][0][0];
+				//mCR is row R of column C
+				__m128 m00, m01, m02, m03, m10, m11, m12, m13, m20, m21, m22, m23, m30, m31, m32, m33;
+				loadColumn4(m, 0, m00, m01, m02, m03);
+				loadColumn4(m, 1, m10, m11, m12, m13);
+				loadColumn4(m, 2, m20, m21, m22, m23);
+				loadColumn4(m, 3, m30, m31, m32, m33);
+				__m128 cx = _mm_loadu_ps(&local.centerX[i]);
+				__m128 cy = _mm_loadu_ps(&local.centerY[i]);
+				__m128 cz = _mm_loadu_ps(&local.centerZ[i]);
+				__m128 ex = _mm_loadu_ps(&local.extentX[i]);
+				__m128 ey = _mm_loadu_ps(&local.extentY[i]);
+				__m128 ez = _mm_loadu_ps(&local.extentZ[i]);
+				_mm_storeu_ps(&world.centerX[i], _mm_add_ps(_mm_add_ps(_mm_mul_ps(m00, cx), _mm_mul_ps(m10, cy)), _mm_add_ps(_mm_mul_ps(m20, cz), m30)));
+				_mm_storeu_ps(&world.centerY[i], _mm_add_ps(_mm_add_ps(_mm_mul_ps(m01, cx), _mm_mul_ps(m11, cy)), _mm_add_ps(_mm_mul_ps(m21, cz), m31)));
+				_mm_storeu_ps(&world.centerZ[i], _mm_add_ps(_mm_add_ps(_mm_mul_ps(m02, cx), _mm_mul_ps(m12, cy)), _mm_add_ps(_mm_mul_ps(m22, cz), m32)));
+				_mm_storeu_ps(&world.extentX[i], _mm_add_ps(_mm_add_ps(_mm_mul_ps(abs4(m00), ex), _mm_mul_ps(abs4(m10), ey)), _mm_mul_ps(abs4(m20), ez)));
+				_mm_storeu_ps(&world.extentY[i], _mm_add_ps(_mm_add_ps(_mm_mul_ps(abs4(m01), ex), _mm_mul_ps(abs4(m11), ey)), _mm_mul_ps(abs4(m21), ez)));
+				_mm_storeu_ps(&world.extentZ[i], _mm_add_ps(_mm_add_ps(_mm_mul_ps(abs4(m02), ex), _mm_mul_ps(abs4(m12), ey)), _mm_mul_ps(abs4(m22), ez)));
+			}
+			transformBoundsScalar(matrices, local, world, i, end);
+		}
+		//-------------------------------------------------------------------------------------------
+		size_t cullBoundsSSE(const Frustum& frustum, const BoundsArrays& bounds, size_t begin, size_t end, uint8_t* visible)
+		{
+			size_t visibleCount = 0;
+			size_t i = begin;
+			for (; i + 4 <= end; i += 4) {
+				__m128 cx = _mm_loadu_ps(&bounds.centerX[i]);
+				__m128 cy = _mm_loadu_ps(&bounds.centerY[i]);
+				__m128 cz = _mm_loadu_ps(&bounds.centerZ[i]);
+				__m128 ex = _mm_loadu_ps(&bounds.extentX[i]);
+				__m128 ey = _mm_loadu_ps(&bounds.extentY[i]);
+				__m128 ez = _mm_loadu_ps(&bounds.extentZ[i]);
+				__m128 inside = _mm_castsi128_ps(_mm_set1_epi32(-1));
+				for (const glm::vec4& plane : frustum.planes) {
+					__m128 distance = _mm_add_ps(_mm_add_ps(_mm_mul_ps(_mm_set1_ps(plane.x), cx), _mm_mul_ps(_mm_set1_ps(plane.y), cy)),
+						_mm_add_ps(_mm_mul_ps(_mm_set1_ps(plane.z), cz), _mm_set1_ps(plane.w)));
+					__m128 radius = _mm_add_ps(_mm_add_ps(_mm_mul_ps(_mm_set1_ps(std::abs(plane.x)), ex), _mm_mul_ps(_mm_set1_ps(std::abs(plane.y)), ey)),
+						_mm_mul_ps(_mm_set1_ps(std::abs(plane.z)), ez));
+					inside = _mm_and_ps(inside, _mm_cmpge_ps(_mm_add_ps(distance, radius), _mm_setzero_ps()));
+				}
+				uint32_t mask = static_cast<uint32_t>(_mm_movemask_ps(inside));
+				for (int lane = 0; lane < 4; ++lane) {
+					visible[i + lane] = static_cast<uint8_t>((mask >> lane) & 1);
+				}
+				visibleCount += std::popcount(mask);
+			}
+			return visibleCount + cullBoundsScalar(frustum, bounds, i, end, visible);
+		}
+
+		//-------------------------------------------------------------------------------------------
+		//AVX2 and FMA, 8 objects per iteration
+		//-------------------------------------------------------------------------------------------
+		CLAN_TARGET_AVX2 inline __m256 combine(__m128 low, __m128 high)
+		{
+			return _mm256_insertf128_ps(_mm256_castps128_ps256(low), high, 1);
+		}
+		//-------------------------------------------------------------------------------------------
+		CLAN_TARGET_AVX2 inline void loadColumn8(const float* matrices, int column, __m256& x, __m256& y, __m256& z, __m256& w)
+		{
+			__m128 x0, y0, z0, w0, x1, y1, z1, w1;
+			loadColumn4(matrices, column, x0, y0, z0, w0);
+			loadColumn4(matrices + 64, column, x1, y1, z1, w1);
+			x = combine(x0, x1);
+			y = combine(y0, y1);
+			z = combine(z0, z1);
+			w = combine(w0, w1);
+		}
+		//-------------------------------------------------------------------------------------------
+		CLAN_TARGET_AVX2 inline void storeColumn8(float* matrices, int column, __m256 x, __m256 y, __m256 z, __m256 w)
+		{
+			storeColumn4(matrices, column, _mm256_castps256_ps128(x), _mm256_castps256_ps128(y),
+				_mm256_castps256_ps128(z), _mm256_castps256_ps128(w));
+			storeColumn4(matrices + 64, column, _mm256_extractf128_ps(x, 1), _mm256_extractf128_ps(y, 1),
+				_mm256_extractf128_ps(z, 1), _mm256_extractf128_ps(w, 1));
+		}
+		//-------------------------------------------------------------------------------------------
+		CLAN_TARGET_AVX2 inline __m256 abs8(__m256 v)
+		{
+			return _mm256_andnot_ps(_mm256_set1_ps(-0.0f), v);
+		}
+		//-------------------------------------------------------------------------------------------
+		//Two output columns per instruction, the columns of 'a' are repeated in both halves
+		CLAN_TARGET_AVX2 inline void multiply4x4AVX2(__m256 a0, __m256 a1, __m256 a2, __m256 a3, const float* b, float* out)
+		{
+			for (int column = 0; column < 4; column += 2) {
+				__m256 bc = _mm256_loadu_ps(b + column * 4);
+				__m256 r = _mm256_mul_ps(a0, _mm256_permute_ps(bc, _MM_SHUFFLE(0, 0, 0, 0)));
+				r = _mm256_fmadd_ps(a1, _mm256_permute_ps(bc, _MM_SHUFFLE(1, 1, 1, 1)), r);
+				r = _mm256_fmadd_ps(a2, _mm256_permute_ps(bc, _MM_SHUFFLE(2, 2, 2, 2)), r);
+				r = _mm256_fmadd_ps(a3, _mm256_permute_ps(bc, _MM_SHUFFLE(3, 3, 3, 3)), r);
+				_mm256_storeu_ps(out + column * 4, r);
+			}
+		}
+		//-------------------------------------------------------------------------------------------
+		CLAN_TARGET_AVX2 void composeAVX2(const TransformArrays& t, size_t begin, size_t end, glm::mat4* out)
+		{
+			const __m256 one = _mm256_set1_ps(1.0f);
+			const __m256 two = _mm256_set1_ps(2.0f);
+			const __m256 zero = _mm256_setzero_ps();
+			size_t i = begin;
+			for (; i + 8 <= end; i += 8) {
+				__m256 qx = _mm256_loadu_ps(&t.rotationX[i]);
+				__m256 qy = _mm256_loadu_ps(&t.rotationY[i]);
+				__m256 qz = _mm256_loadu_ps(&t.rotationZ[i]);
+				__m256 qw = _mm256_loadu_ps(&t.rotationW[i]);
+				__m256 xx = _mm256_mul_ps(qx, qx), yy = _mm256_mul_ps(qy, qy), zz = _mm256_mul_ps(qz, qz);
+				__m256 xy = _mm256_mul_ps(qx, qy), xz = _mm256_mul_ps(qx, qz), yz = _mm256_mul_ps(qy, qz);
+				__m256 wx = _mm256_mul_ps(qw, qx), wy = _mm256_mul_ps(qw, qy), wz = _mm256_mul_ps(qw, qz);
+				__m256 scaleX = _mm256_loadu_ps(&t.scaleX[i]);
+				__m256 scaleY = _mm256_loadu_ps(&t.scaleY[i]);
+				__m256 scaleZ = _mm256_loadu_ps(&t.scaleZ[i]);
+				//the factor 2 of the rotation matrix is folded into the scale
+				__m256 sx = _mm256_mul_ps(scaleX, two);
+				__m256 sy = _mm256_mul_ps(scaleY, two);
+				__m256 sz = _mm256_mul_ps(scaleZ, two);
+				float* dst = &out[i][0][0];
+				storeColumn8(dst, 0,
+					_mm256_fnmadd_ps(sx, _mm256_add_ps(yy, zz), scaleX),
+					_mm256_mul_ps(sx, _mm256_add_ps(xy, wz)),
+					_mm256_mul_ps(sx, _mm256_sub_ps(xz, wy)),
+					zero);
+				storeColumn8(dst, 1,
+					_mm256_mul_ps(sy, _mm256_sub_ps(xy, wz)),
+					_mm256_fnmadd_ps(sy, _mm256_add_ps(xx, zz), scaleY),
+					_mm256_mul_ps(sy, _mm256_add_ps(yz, wx)),
+					zero);
+				storeColumn8(dst, 2,
+					_mm256_mul_ps(sz, _mm256_add_ps(xz, wy)),
+					_mm256_mul_ps(sz, _mm256_sub_ps(yz, wx)),
+					_mm256_fnmadd_ps(sz, _mm256_add_ps(xx, yy), scaleZ),
+					zero);
+				storeColumn8(dst, 3, _mm256_loadu_ps(&t.positionX[i]), _mm256_loadu_ps(&t.positionY[i]), _mm256_loadu_ps(&t.positionZ[i]), one);
+			}
+			composeSSE(t, i, end, out);
+		}
+		//-------------------------------------------------------------------------------------------
+		CLAN_TARGET_AVX2 void multiplyAVX2(const glm::mat4* a, const glm::mat4* b, glm::mat4* out, size_t count)
+		{
+			for (size_t i = 0; i < count; ++i) {
+				const float* pa = &a[i][0][0];
+				multiply4x4AVX2(_mm256_broadcast_ps(reinterpret_cast<const __m128*>(pa)),
+					_mm256_broadcast_ps(reinterpret_cast<const __m128*>(pa + 4)),
+					_mm256_broadcast_ps(reinterpret_cast<const __m128*>(pa + 8)),
+					_mm256_broadcast_ps(reinterpret_cast<const __m128*>(pa + 12)),
+					&b[i][0][0], &out[i][0][0]);
+			}
+		}
+		//-------------------------------------------------------------------------------------------
+		CLAN_TARGET_AVX2 void multiplyLeftAVX2(const glm::mat4& a, const glm::mat4* b, glm::mat4* out, size_t count)
+		{
+			const float* pa = &a[0][0];
+			__m256 a0 = _mm256_broadcast_ps(reinterpret_cast<const __m128*>(pa));
+			__m256 a1 = _mm256_broadcast_ps(reinterpret_cast<const __m128*>(pa + 4));
+			__m256 a2 = _mm256_broadcast_ps(reinterpret_cast<const __m128*>(pa + 8));
+			__m256 a3 = _mm256_broadcast_ps(reinterpret_cast<const __m128*>(pa + 12));
+			for (size_t i = 0; i < count; ++i) {
+				multiply4x4AVX2(a0, a1, a2, a3, &b[i][0][0], &out[i][0][0]);
+			}
+		}
+		//-------------------------------------------------------------------------------------------
+		CLAN_TARGET_AVX2 void transformBoundsAVX2(const glm::mat4* matrices, const BoundsArrays& local, BoundsArrays& world, size_t begin, size_t end)
+		{
+			size_t i = begin;
+			for (; i + 8 <= end; i += 8) {
+				const float* m = &matrices[i][0][0];
+				__m256 m00, m01, m02, m03, m10, m11, m12, m13, m20, m21, m22, m23, m30, m31, m32, m33;
+				loadColumn8(m, 0, m00, m01, m02, m03);
+				loadColumn8(m, 1, m10, m11, m12, m13);
+				loadColumn8(m, 2, m20, m21, m22, m23);
+				loadColumn8(m, 3, m30, m31, m32, m33);
+				__m256 cx = _mm256_loadu_ps(&local.centerX[i]);
+				__m256 cy = _mm256_loadu_ps(&local.centerY[i]);
+				__m256 cz = _mm256_loadu_ps(&local.centerZ[i]);
+				__m256 ex = _mm256_loadu_ps(&local.extentX[i]);
+				__m256 ey = _mm256_loadu_ps(&local.extentY[i]);
+				__m256 ez = _mm256_loadu_ps(&local.extentZ[i]);
+				_mm256_storeu_ps(&world.centerX[i], _mm256_fmadd_ps(m00, cx, _mm256_fmadd_ps(m10, cy, _mm256_fmadd_ps(m20, cz, m30))));
+				_mm256_storeu_ps(&world.centerY[i], _mm256_fmadd_ps(m01, cx, _mm256_fmadd_ps(m11, cy, _mm256_fmadd_ps(m21, cz, m31))));
+				_mm256_storeu_ps(&world.centerZ[i], _mm256_fmadd_ps(m02, cx, _mm256_fmadd_ps(m12, cy, _mm256_fmadd_ps(m22, cz, m32))));
+				_mm256_storeu_ps(&world.extentX[i], _mm256_fmadd_ps(abs8(m00), ex, _mm256_fmadd_ps(abs8(m10), ey, _mm256_mul_ps(abs8(m20), ez))));
+				_mm256_storeu_ps(&world.extentY[i], _mm256_fmadd_ps(abs8(m01), ex, _mm256_fmadd_ps(abs8(m11), ey, _mm256_mul_ps(abs8(m21), ez))));
+				_mm256_storeu_ps(&world.extentZ[i], _mm256_fmadd_ps(abs8(m02), ex, _mm256_fmadd_ps(abs8(m12), ey, _mm256_mul_ps(abs8(m22), ez))));
+			}
+			transformBoundsSSE(matrices, local, world, i, end);
+		}
+		//-------------------------------------------------------------------------------------------
+		CLAN_TARGET_AVX2 size_t cullBoundsAVX2(const Frustum& frustum, const BoundsArrays& bounds, size_t begin, size_t end, uint8_t* visible)
+		{
+			size_t visibleCount = 0;
+			size_t i = begin;
+			for (; i + 8 <= end; i += 8) {
+				__m256 cx = _mm256_loadu_ps(&bounds.centerX[i]);
+				__m256 cy = _mm256_loadu_ps(&bounds.centerY[i]);
+				__m256 cz = _mm256_loadu_ps(&bounds.centerZ[i]);
+				__m256 ex = _mm256_loadu_ps(&bounds.extentX[i]);
+				__m256 ey = _mm256_loadu_ps(&bounds.extentY[i]);
+				__m256 ez = _mm256_loadu_ps(&bounds.extentZ[i]);
+				__m256 inside = _mm256_castsi256_ps(_mm256_set1_epi32(-1));
+				for (const glm::vec4& plane : frustum.planes) {
+					__m256 distance = _mm256_fmadd_ps(_mm256_set1_ps(plane.x), cx,
+						_mm256_fmadd_ps(_mm256_set1_ps(plane.y), cy, _mm256_fmadd_ps(_mm256_set1_ps(plane.z), cz, _mm256_set1_ps(plane.w))));
+					__m256 radius = _mm256_fmadd_ps(_mm256_set1_ps(std::abs(plane.x)), ex,
+						_mm256_fmadd_ps(_mm256_set1_ps(std::abs(plane.y)), ey, _mm256_mul_ps(_mm256_set1_ps(std::abs(plane.z)), ez)));
+					inside = _mm256_and_ps(inside, _mm256_cmp_ps(_mm256_add_ps(distance, radius), _mm256_setzero_ps(), _CMP_GE_OQ));
+				}
+				uint32_t mask = static_cast<uint32_t>(_mm256_movemask_ps(inside));
+				for (int lane = 0; lane < 8; ++lane) {
+					visible[i + lane] = static_cast<uint8_t>((mask >> lane) & 1);
+				}
+				visibleCount += std::popcount(mask);
+			}
+			return visibleCount + cullBoundsSSE(frustum, bounds, i, end, visible);
+		}
+#endif // CLAN_X86
+
+		//-------------------------------------------------------------------------------------------
+		const TransformKernels KERNELS[] = {
+			{ composeScalar, multiplyScalar, multiplyLeftScalar, transformBoundsScalar, cullBoundsScalar, SimdLevel::Scalar },
+#ifdef CLAN_X86
+			{ composeSSE, multiplySSE, multiplyLeftSSE, transformBoundsSSE, cullBoundsSSE, SimdLevel::SSE2 },
+			{ composeAVX2, multiplyAVX2, multiplyLeftAVX2, transformBoundsAVX2, cullBoundsAVX2, SimdLevel::AVX2 },
+#endif
+		};
+	}
+	//-----------------------------------------------------------------------------------------------
+	const char* simdLevelName(SimdLevel level)
+	{
+		switch (level) {
+		case SimdLevel::Scalar: return "glm";
+		case SimdLevel::SSE2: return "sse2";
+		case SimdLevel::AVX2: return "avx2";
+		default: return "unknown";
+		}
+	}
+	//-----------------------------------------------------------------------------------------------
+	SimdLevel detectSimdLevel()
+	{
+		static const SimdLevel level = []() {
+#ifdef CLAN_X86
+			uint32_t leaf1[4]{}, leaf7[4]{};
+	#ifdef _MSC_VER
+			int regs[4];
+			__cpuid(regs, 0);
+			uint32_t maxLeaf = static_cast<uint32_t>(regs[0]);
+			__cpuid(regs, 1);
+			for (int r = 0; r < 4; ++r) leaf1[r] = static_cast<uint32_t>(regs[r]);
+			if (maxLeaf >= 7) {
+				__cpuidex(regs, 7, 0);
+				for (int r = 0; r < 4; ++r) leaf7[r] = static_cast<uint32_t>(regs[r]);
+			}
+	#else
+			uint32_t maxLeaf = __get_cpuid_max(0, nullptr);
+			__get_cpuid(1, &leaf1[0], &leaf1[1], &leaf1[2], &leaf1[3]);
+			if (maxLeaf >= 7) {
+				__get_cpuid_count(7, 0, &leaf7[0], &leaf7[1], &leaf7[2], &leaf7[3]);
+			}
+	#endif
+			const bool fma = (leaf1[2] & (1u << 12)) != 0;
+			const bool osxsave = (leaf1[2] & (1u << 27)) != 0;
+			const bool avx = (leaf1[2] & (1u << 28)) != 0;
+			const bool avx2 = (leaf7[1] & (1u << 5)) != 0;
+			//the OS has to save the YMM registers on context switches
+			bool ymmEnabled = false;
+			if (osxsave) {
+	#ifdef _MSC_VER
+				uint64_t xcr0 = _xgetbv(0);
+	#else
+				uint32_t eax, edx;
+				__asm__ volatile("xgetbv" : "=a"(eax), "=d"(edx) : "c"(0));
+				uint64_t xcr0 = (static_cast<uint64_t>(edx) << 32) | eax;
+	#endif
+				ymmEnabled = (xcr0 & 0x6) == 0x6;
+			}
+			if (avx && avx2 && fma && ymmEnabled) return SimdLevel::AVX2;
+			return SimdLevel::SSE2;
+#else
+			return SimdLevel::Scalar;
+#endif
+		}();
+		return level;
+	}
+	//-----------------------------------------------------------------------------------------------
+	void TransformArrays::resize(size_t count)
+	{
+		for (std::vector<float>* array : { &positionX, &positionY, &positionZ, &rotationX, &rotationY, &rotationZ, &scaleX, &scaleY, &scaleZ }) {
+			array->resize(count, array == &scaleX || array == &scaleY || array == &scaleZ ? 1.0f : 0.0f);
+		}
+		rotationW.resize(count, 1.0f);
+	}
+	//-----------------------------------------------------------------------------------------------
+	void TransformArrays::set(size_t index, const glm::vec3& position, const glm::quat& rotation, const glm::vec3& scale)
+	{
+		positionX[index] = position.x;
+		positionY[index] = position.y;
+		positionZ[index] = position.z;
+		rotationX[index] = rotation.x;
+		rotationY[index] = rotation.y;
+		rotationZ[index] = rotation.z;
+		rotationW[index] = rotation.w;
+		scaleX[index] = scale.x;
+		scaleY[index] = scale.y;
+		scaleZ[index] = scale.z;
+	}
+	//-----------------------------------------------------------------------------------------------
+	void BoundsArrays::resize(size_t count)
+	{
+		for (std::vector<float>* array : { &centerX, &centerY, &centerZ, &extentX, &extentY, &extentZ }) {
+			array->resize(count, 0.0f);
+		}
+	}
+	//-----------------------------------------------------------------------------------------------
+	void BoundsArrays::set(size_t index, const glm::vec3& min, const glm::vec3& max)
+	{
+		glm::vec3 center = (min + max) * 0.5f;
+		glm::vec3 extent = (max - min) * 0.5f;
+		centerX[index] = center.x;
+		centerY[index] = center.y;
+		centerZ[index] = center.z;
+		extentX[index] = extent.x;
+		extentY[index] = extent.y;
+		extentZ[index] = extent.z;
+	}
+	//-----------------------------------------------------------------------------------------------
+	Frustum Frustum::fromMatrix(const glm::mat4& m)
+	{
+		glm::vec4 row0(m[0][0], m[1][0], m[2][0], m[3][0]);
+		glm::vec4 row1(m[0][1], m[1][1], m[2][1], m[3][1]);
+		glm::vec4 row2(m[0][2], m[1][2], m[2][2], m[3][2]);
+		glm::vec4 row3(m[0][3], m[1][3], m[2][3], m[3][3]);
+		Frustum frustum;
+		frustum.planes[0] = row3 + row0;
+		frustum.planes[1] = row3 - row0;
+		frustum.planes[2] = row3 + row1;
+		frustum.planes[3] = row3 - row1;
+		frustum.planes[4] = row2;
+		frustum.planes[5] = row3 - row2;
+		for (glm::vec4& plane : frustum.planes) {
+			plane /= glm::length(glm::vec3(plane));
+		}
+		return frustum;
+	}
+	//-----------------------------------------------------------------------------------------------
+	const TransformKernels& transformKernels(SimdLevel level)
+	{
+		SimdLevel supported = detectSimdLevel();
+		if (level > supported) level = supported;
+		return KERNELS[static_cast<uint8_t>(level)];
+	}
+	//-----------------------------------------------------------------------------------------------
+	const TransformKernels& transformKernels()
+	{
+		return transformKernels(detectSimdLevel());
+	}
+	//-----------------------------------------------------------------------------------------------
+	void benchmarkTransformKernels(uint32_t count, uint32_t iterations)
+	{
+		std::mt19937 random(1234);
+		std::uniform_real_distribution<float> position(-100.0f, 100.0f);
+		std::uniform_real_distribution<float> unit(-1.0f, 1.0f);
+		std::uniform_real_distribution<float> scale(0.5f, 2.0f);
+		TransformArrays transforms;
+		BoundsArrays local;
+		transforms.resize(count);
+		local.resize(count);
+		for (uint32_t i = 0; i < count; ++i) {
+			glm::quat rotation = glm::normalize(glm::quat(unit(random), unit(random), unit(random), unit(random)));
+			transforms.set(i, glm::vec3(position(random), position(random), position(random)), rotation,
+				glm::vec3(scale(random), scale(random), scale(random)));
+			local.set(i, glm::vec3(-1.0f), glm::vec3(1.0f));
+		}
+		glm::mat4 view = glm::lookAt(glm::vec3(0.0f, -150.0f, 50.0f), glm::vec3(0.0f), glm::vec3(0.0f, 0.0f, 1.0f));
+		glm::mat4 projection = glm::perspective(glm::radians(60.0f), 16.0f / 9.0f, 0.1f, 500.0f);
+		glm::mat4 viewProjection = projection * view;
+		Frustum frustum = Frustum::fromMatrix(viewProjection);
+
+		std::vector<glm::mat4> referenceWorld(count), referenceClip(count);
+		const TransformKernels& reference = transformKernels(SimdLevel::Scalar);
+		reference.compose(transforms, 0, count, referenceWorld.data());
+		reference.multiplyLeft(viewProjection, referenceWorld.data(), referenceClip.data(), count);
+
+		std::vector<glm::mat4> world(count), clip(count);
+		BoundsArrays worldBounds;
+		worldBounds.resize(count);
+		std::vector<uint8_t> visible(count);
+
+		std::cout << "transform kernels, " << count << " objects, milliseconds per frame" << std::endl;
+		std::cout << std::setw(8) << "level" << std::setw(10) << "compose" << std::setw(10) << "mvp"
+			<< std::setw(10) << "bounds" << std::setw(10) << "cull" << std::setw(10) << "total"
+			<< std::setw(10) << "visible" << std::setw(12) << "max error" << std::endl;
+		for (uint8_t l = 0; l <= static_cast<uint8_t>(detectSimdLevel()); ++l) {
+			const TransformKernels& kernels = transformKernels(static_cast<SimdLevel>(l));
+			double milliseconds[4]{};
+			size_t visibleCount = 0;
+			for (uint32_t iteration = 0; iteration < iterations; ++iteration) {
+				auto t0 = std::chrono::steady_clock::now();
+				kernels.compose(transforms, 0, count, world.data());
+				auto t1 = std::chrono::steady_clock::now();
+				kernels.multiplyLeft(viewProjection, world.data(), clip.data(), count);
+				auto t2 = std::chrono::steady_clock::now();
+				kernels.transformBounds(world.data(), local, worldBounds, 0, count);
+				auto t3 = std::chrono::steady_clock::now();
+				visibleCount = kernels.cullBounds(frustum, worldBounds, 0, count, visible.data());
+				auto t4 = std::chrono::steady_clock::now();
+				milliseconds[0] += std::chrono::duration<double, std::milli>(t1 - t0).count();
+				milliseconds[1] += std::chrono::duration<double, std::milli>(t2 - t1).count();
+				milliseconds[2] += std::chrono::duration<double, std::milli>(t3 - t2).count();
+				milliseconds[3] += std::chrono::duration<double, std::milli>(t4 - t3).count();
+			}
+			float maxError = 0.0f;
+			for (uint32_t i = 0; i < count; ++i) {
+				for (int c = 0; c < 4; ++c) {
+					for (int r = 0; r < 4; ++r) {
+						maxError = std::max(maxError, std::abs(world[i][c][r] - referenceWorld[i][c][r]));
+						maxError = std::max(maxError, std::abs(clip[i][c][r] - referenceClip[i][c][r]));
+					}
+				}
+			}
+			double total = 0.0;
+			std::cout << std::setw(8) << simdLevelName(kernels.level) << std::fixed << std::setprecision(3);
+			for (double sum : milliseconds) {
+				std::cout << std::setw(10) << sum / iterations;
+				total += sum / iterations;
+			}
+			std::cout << std::setw(10) << total << std::setw(10) << visibleCount
+				<< std::setw(12) << std::scientific << std::setprecision(2) << maxError << std::defaultfloat << std::endl;
+		}
+	}
+}
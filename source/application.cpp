@@ -1,4 +1,5 @@
 #include <iostream>
+#include <iomanip>
 #include <optional>
 #include <unordered_set>
 #include <unordered_map>
@@ -6,19 +7,19 @@
 #include <limits>
 #include <fstream>
 #include <chrono>
+#include <filesystem>
+#include <cstring>
 #define GLM_FORCE_RADIANS
 #define GLM_FORCE_DEPTH_ZERO_TO_ONE
 #include <glm/glm.hpp>
 #include <glm/gtx/hash.hpp>
 #include <glm/gtc/matrix_transform.hpp>
 
-#define STB_IMAGE_IMPLEMENTATION
-#include "stb_image.h"
-
 #define TINYOBJLOADER_IMPLEMENTATION
 #include "tiny_obj_loader.h"
 
 #include "application.h"
+#include "TextureLoader.h"
 #include "macro.h"
 
 namespace std {
@@ -33,19 +34,67 @@ namespace std {
 
 namespace Clan
 {
-	std::vector<Vertex> vertices{};
-	std::vector<uint32_t> indices{};
+	TrackedVector<ActiveRenderPolicy::Vertex, MemoryTag::Geometry> vertices{};
+	TrackedVector<ActiveRenderPolicy::Index, MemoryTag::Geometry> indices{};
 	std::unordered_map<Vertex, uint32_t> uniqueVertices{};
 
+	namespace
+	{
+		//Reads the .mtl files of an OBJ from the asset archive, falling back to loose files
+		class ArchiveMaterialReader : public tinyobj::MaterialReader
+		{
+		public:
+			ArchiveMaterialReader(const AssetArchive& archive, const std::string& directory)
+				: m_archive(archive), m_directory(directory) {}
+
+			bool operator()(const std::string& matId, std::vector<tinyobj::material_t>* materials,
+				std::map<std::string, int>* matMap, std::string* warn, std::string* err) override
+			{
+				std::string path = m_directory + "/" + matId;
+				if (!m_archive.contains(path)) {
+					return tinyobj::MaterialFileReader(m_directory)(matId, materials, matMap, warn, err);
+				}
+				std::vector<char> storage;
+				AssetStream stream(m_archive.load(path, storage));
+				tinyobj::LoadMtl(matMap, materials, &stream, warn, err);
+				return true;
+			}
+
+		private:
+			const AssetArchive& m_archive;
+			std::string m_directory;
+		};
+
+		//Applies the render commands that change the scene graph
+		struct SceneCommandApplier {
+			SceneGraph& scene;
+
+			void operator()(const SetNodeTransformCommand& command) { scene.setTransform(command.node, command.position, command.rotation, command.scale); }
+
+			void operator()(const SetNodePositionCommand& command) { scene.setPosition(command.node, command.position); }
+
+			void operator()(const SetNodeRotationCommand& command) { scene.setRotation(command.node, command.rotation); }
+
+			void operator()(const SetNodeScaleCommand& command) { scene.setScale(command.node, command.scale); }
+		};
+	}
+
 	struct UniformBufferObject {
-		alignas(16) glm::mat4 model;
 		alignas(16) glm::mat4 view;
 		alignas(16) glm::mat4 proj;
 	};
 
+	//DrawConstants of base_vertex.vert
+	struct DrawConstants {
+		uint32_t materialIndex;
+	};
+
 	struct HelloTriangleApplication::QueueFamilyIndices {
 		std::optional<uint32_t> graphicsFamily;
 		std::optional<uint32_t> presentFamily;
+		//dedicated families when the device exposes them, graphics otherwise
+		std::optional<uint32_t> computeFamily;
+		std::optional<uint32_t> transferFamily;
 
 		bool isComplete() {
 			return graphicsFamily.has_value() &&
@@ -85,6 +134,10 @@ namespace Clan
 	//-------------------------------------------------------------------------------------------------
 	std::vector<char> HelloTriangleApplication::readBinaryFile(const std::string& filename)
 	{
+		std::vector<char> archived;
+		if (assetArchive.read(filename, archived)) {
+			return archived;
+		}
 		std::ifstream file(filename, std::ios::ate | std::ios::binary);
 		ASSERT(file.is_open());
 		size_t fileSize = (size_t)file.tellg();
@@ -95,79 +148,216 @@ namespace Clan
 		return buffer;
 	}
 
+	void HelloTriangleApplication::setAntiAliasing(AntiAliasingMode mode)
+	{
+		requestedAntiAliasing = mode;
+	}
+
+	void HelloTriangleApplication::enableAntiAliasingBenchmark(uint32_t framesPerMode)
+	{
+		benchmark = {};
+		benchmark.framesPerMode = framesPerMode;
+		requestedAntiAliasing = AntiAliasingMode::None;
+	}
+
+	void HelloTriangleApplication::setHeadless(bool enabled)
+	{
+		headless = enabled;
+	}
+
+	void HelloTriangleApplication::setStartupReport(const std::string& path)
+	{
+		startupReportPath = path;
+	}
+
+	void HelloTriangleApplication::setMemoryReport(const std::string& path)
+	{
+		memoryReportPath = path;
+		memoryReportAtExit = true;
+	}
+
+	void HelloTriangleApplication::setConfig(const RendererConfig& rendererConfig)
+	{
+		config = rendererConfig;
+	}
+
+	ColdStartFiles HelloTriangleApplication::coldStartFiles()
+	{
+		ColdStartFiles files{};
+		files.caches = { PIPELINE_CACHE_PATH, PIPELINE_KEYS_PATH };
+		files.assets = { ASSET_ARCHIVE_PATH, "resources", SHADER_DIRECTORY };
+		return files;
+	}
+
 	void HelloTriangleApplication::run() {
+		startupProfiler.start();
+		startupProfiler.beginStep("initWindow");
 		initWindow();
 		initVulkan();
-		mainLoop();
+		//until the GPU finished it, the start isn't over before the first image is ready
+		startupProfiler.beginStep("firstFrame");
+		drawFrame();
+		vkDeviceWaitIdle(device);
+		startupProfiler.endStep();
+		std::cout << "started in " << startupProfiler.totalMilliseconds() << " ms" << std::endl;
+		if (!startupReportPath.empty() && !startupProfiler.writeJson(startupReportPath)) {
+			std::cerr << "failed to write " << startupReportPath << std::endl;
+		}
+		if (!headless) {
+			mainLoop();
+		}
 		cleanup();
+		if (memoryReportAtExit && !writeMemoryReport(memoryReportPath)) {
+			std::cerr << "failed to write " << memoryReportPath << std::endl;
+		}
 	}
 
 	void HelloTriangleApplication::initWindow() {
 		glfwInit();
 
 		glfwWindowHint(GLFW_CLIENT_API, GLFW_NO_API);
+		if (headless) {
+			glfwWindowHint(GLFW_VISIBLE, GLFW_FALSE);
+		}
 
-		window = glfwCreateWindow(WINDOW_WIDTH, WINDOW_HEIGHT, "Vulkan", nullptr, nullptr);
+		window = glfwCreateWindow(config.windowWidth, config.windowHeight, "Vulkan", nullptr, nullptr);
 	}
 
 	void HelloTriangleApplication::initVulkan() {
-		createInstance();
-		setupDebugMessenger();
-		createSurface();
-		pickPhysicalDevice();
-		createLogicalDevice();
-		createSwapChain();
-		createImageViews();
-		createRenderPass();
-		createDescriptorSetLayout();
-		createGraphicsPipeline();
-		createDepthResources();
-		createFramebuffers();
-		createCommandPool();
-		createTextureImage();
-		createTextureImageView();
-		createTextureSampler();
-		loadModel();
-		createVertIDBuffer();
-		createUniformBuffers();
-		createDescriptorPool();
-		createDescriptorSets();
-		createCommandBuffers();
-		createSyncObjects();
+		//every step is timed, the names are the ones of the startup report
+		using Step = void (HelloTriangleApplication::*)();
+		const std::pair<const char*, Step> steps[] = {
+			{ "startAssetLoading", &HelloTriangleApplication::startAssetLoading },
+			{ "createInstance", &HelloTriangleApplication::createInstance },
+			{ "setupDebugMessenger", &HelloTriangleApplication::setupDebugMessenger },
+			{ "createSurface", &HelloTriangleApplication::createSurface },
+			{ "pickPhysicalDevice", &HelloTriangleApplication::pickPhysicalDevice },
+			{ "createLogicalDevice", &HelloTriangleApplication::createLogicalDevice },
+			{ "createSwapChain", &HelloTriangleApplication::createSwapChain },
+			{ "createImageViews", &HelloTriangleApplication::createImageViews },
+			{ "createAntiAliasing", &HelloTriangleApplication::createAntiAliasing },
+			{ "createRenderPass", &HelloTriangleApplication::createRenderPass },
+			{ "createDescriptorSetLayout", &HelloTriangleApplication::createDescriptorSetLayout },
+			{ "createPipelineCache", &HelloTriangleApplication::createPipelineCache },
+			{ "createShaderHotReload", &HelloTriangleApplication::createShaderHotReload },
+			{ "createGraphicsPipeline", &HelloTriangleApplication::createGraphicsPipeline },
+			{ "createColorResources", &HelloTriangleApplication::createColorResources },
+			{ "createDepthResources", &HelloTriangleApplication::createDepthResources },
+			{ "createFramebuffers", &HelloTriangleApplication::createFramebuffers },
+			{ "createCommandPool", &HelloTriangleApplication::createCommandPool },
+			{ "loadModel", &HelloTriangleApplication::loadModel },
+			{ "createTextureImage", &HelloTriangleApplication::createTextureImage },
+			{ "createTextureImageView", &HelloTriangleApplication::createTextureImageView },
+			{ "createTextureSampler", &HelloTriangleApplication::createTextureSampler },
+			{ "createScene", &HelloTriangleApplication::createScene },
+			{ "createGeometryArena", &HelloTriangleApplication::createGeometryArena },
+			{ "createDrawCommandBuffers", &HelloTriangleApplication::createDrawCommandBuffers },
+			{ "createUniformBuffers", &HelloTriangleApplication::createUniformBuffers },
+			{ "createDescriptorPool", &HelloTriangleApplication::createDescriptorPool },
+			{ "createDescriptorSets", &HelloTriangleApplication::createDescriptorSets },
+			{ "createCommandBuffers", &HelloTriangleApplication::createCommandBuffers },
+			{ "createSyncObjects", &HelloTriangleApplication::createSyncObjects },
+			{ "startSimulation", &HelloTriangleApplication::startSimulation },
+		};
+		for (const auto& [name, step] : steps) {
+			startupProfiler.beginStep(name);
+			(this->*step)();
+		}
+		startupProfiler.endStep();
+	}
+
+	void HelloTriangleApplication::startAssetLoading() {
+		workerPool.init();
+		assetArchive.open(ASSET_ARCHIVE_PATH);
+		fileReader.init(&workerPool);
+		if (!assetArchive.contains(config.modelPath)) {
+			modelFile.resize(static_cast<size_t>(AsyncFileReader::fileSize(config.modelPath)));
+			fileReader.read({ config.modelPath, 0, modelFile.data(), modelFile.size(), [this](size_t bytesRead, bool success) {
+				modelFile.resize(success ? bytesRead : 0);
+			} });
+			fileReader.submit();
+		}
 	}
 
 	void HelloTriangleApplication::mainLoop() {
 		while (!glfwWindowShouldClose(window)) {
 			glfwPollEvents();
+			bool mousePressed = glfwGetMouseButton(window, GLFW_MOUSE_BUTTON_LEFT) == GLFW_PRESS;
+			if (mousePressed && !mouseWasPressed) {
+				pickObject();
+			}
+			mouseWasPressed = mousePressed;
+			bool memoryKeyPressed = glfwGetKey(window, GLFW_KEY_M) == GLFW_PRESS;
+			if (memoryKeyPressed && !memoryKeyWasPressed) {
+				if (writeMemoryReport(memoryReportPath)) {
+					std::cout << "memory report written to " << memoryReportPath << std::endl;
+				}
+			}
+			memoryKeyWasPressed = memoryKeyPressed;
 			drawFrame();
+			auto now = std::chrono::steady_clock::now();
+			if (now - lastMemoryBudgetCheck >= MEMORY_BUDGET_INTERVAL) {
+				lastMemoryBudgetCheck = now;
+				checkMemoryBudget();
+			}
+			if (benchmark.framesPerMode > 0 && !advanceAntiAliasingBenchmark()) {
+				break;
+			}
 		}
 		vkDeviceWaitIdle(device);
 	}
 
 	void HelloTriangleApplication::cleanup() {
+		simulation.destroy();
 		cleanupSwapChain();
+		shaderHotReload.destroy();
+		pipelineStates.saveKeys(PIPELINE_KEYS_PATH);
+		pipelineStates.destroy();
+		vkDestroyRenderPass(device, renderPass, vulkanAllocator());
+		antiAliasing.destroy();
+		renderGraph.destroy();
+		deletionQueue.retire<VK_OBJECT_TYPE_SWAPCHAIN_KHR>(swapChain, frameScheduler.timeline().lastSubmitted());
+		deletionQueue.flushAll();
 		for (uint32_t i = 0; i < MAX_FRAMES_IN_FLIGHT; ++i) {
-			vkDestroySemaphore(device, imageAvailableSemaphores[i], nullptr);
-			vkDestroySemaphore(device, renderFinishedSemaphores[i], nullptr);
-			vkDestroyFence(device, inFlightFences[i], nullptr);
-			vkDestroyBuffer(device, uniformBuffers[i], nullptr);
-			vkFreeMemory(device, uniformBuffersMemory[i], nullptr);
-		}
-		vkDestroySampler(device, textureSampler, nullptr);
-		vkDestroyImageView(device, textureImageView, nullptr);
-		vkDestroyImage(device, textureImage, nullptr);
-		vkFreeMemory(device, textureImageMemory, nullptr);
-		vkDestroyBuffer(device, VertIDBuffer, nullptr);
-		vkFreeMemory(device, VertIDBufferMemory, nullptr);
-		vkDestroyDescriptorPool(device, descriptorPool, nullptr);
-		vkDestroyDescriptorSetLayout(device, descriptorSetLayout, nullptr);
-		vkDestroyCommandPool(device, commandPool, nullptr);
-		vkDestroyDevice(device, nullptr);
-		vkDestroySurfaceKHR(instance, surface, nullptr);
-		if (enableValidationLayers) {
-			DestroyDebugUtilsMessengerEXT(instance, debugMessenger, nullptr);
-		}
-		vkDestroyInstance(instance, nullptr);
+			vkDestroySemaphore(device, imageAvailableSemaphores[i], vulkanAllocator());
+			vkDestroySemaphore(device, renderFinishedSemaphores[i], vulkanAllocator());
+			vkDestroyBuffer(device, uniformBuffers[i], vulkanAllocator());
+			freeDeviceMemory(device, uniformBuffersMemory[i]);
+			vkUnmapMemory(device, objectBuffersMemory[i]);
+			vkDestroyBuffer(device, objectBuffers[i], vulkanAllocator());
+			freeDeviceMemory(device, objectBuffersMemory[i]);
+			vkUnmapMemory(device, drawCommandBuffersMemory[i]);
+			vkDestroyBuffer(device, drawCommandBuffers[i], vulkanAllocator());
+			freeDeviceMemory(device, drawCommandBuffersMemory[i]);
+		}
+		renderCommands.destroy();
+		scene.destroy();
+		fileReader.destroy();
+		workerPool.destroy();
+		assetArchive.close();
+		samplerCache.destroy();
+		for (Texture& texture : textures) {
+			vkDestroyImageView(device, texture.view, vulkanAllocator());
+			vkDestroyImage(device, texture.image, vulkanAllocator());
+			freeDeviceMemory(device, texture.memory);
+		}
+		geometryArena.destroy();
+		descriptorAllocator.destroy();
+		for (DescriptorAllocator& allocator : frameDescriptors) {
+			allocator.destroy();
+		}
+		layoutCache.destroy();
+		vkDestroyCommandPool(device, commandPool, vulkanAllocator());
+		asyncTransfer.destroy();
+		asyncCompute.destroy();
+		gpuTimer.destroy();
+		frameScheduler.destroy();
+		vkDestroyDevice(device, vulkanAllocator());
+		vkDestroySurfaceKHR(instance, surface, vulkanAllocator());
+		if (config.enableValidation) {
+			DestroyDebugUtilsMessengerEXT(instance, debugMessenger, vulkanAllocator());
+		}
+		vkDestroyInstance(instance, vulkanAllocator());
 
 		glfwDestroyWindow(window);
 		glfwTerminate();
@@ -192,7 +382,7 @@ namespace Clan
 		createInfo.ppEnabledExtensionNames = extensions.data();
 		//specify the desired validation layers
 		VkDebugUtilsMessengerCreateInfoEXT debugCreateInfo{};
-		if (enableValidationLayers) {
+		if (config.enableValidation) {
 			ASSERT(checkValidationLayerSupport());
 			createInfo.enabledLayerCount = (uint32_t)validationLayers.size();
 			createInfo.ppEnabledLayerNames = validationLayers.data();
@@ -203,7 +393,7 @@ namespace Clan
 			createInfo.enabledLayerCount = 0;
 		}
 		
-		VkResult result = vkCreateInstance(&createInfo, nullptr, &instance);
+		VkResult result = vkCreateInstance(&createInfo, vulkanAllocator(), &instance);
 		ASSERT(result == VK_SUCCESS);
 	}
 	//-------------------------------------------------------------------------------------------------
@@ -235,7 +425,7 @@ namespace Clan
 		glfwExtensions = glfwGetRequiredInstanceExtensions(&glfwExtensionCount);
 		std::vector<const char*> extensions(glfwExtensions, glfwExtensions + glfwExtensionCount);
 		//debug callback
-		if (enableValidationLayers) {
+		if (config.enableValidation) {
 			extensions.push_back("VK_EXT_debug_utils");
 		}
 		return extensions;
@@ -267,11 +457,11 @@ namespace Clan
 	//------------------------------------------------------------------------------------------------
 	void HelloTriangleApplication::setupDebugMessenger()
 	{
-		if (!enableValidationLayers) return;
+		if (!config.enableValidation) return;
 		VkDebugUtilsMessengerCreateInfoEXT createInfo{};
 		populateDebugMessengerCreateInfo(createInfo);
 
-		VkResult result = CreateDebugUtilsMessengerEXT(instance, &createInfo, nullptr, &debugMessenger);
+		VkResult result = CreateDebugUtilsMessengerEXT(instance, &createInfo, vulkanAllocator(), &debugMessenger);
 		ASSERT(result == VK_SUCCESS);
 	}
 	//------------------------------------------------------------------------------------------------
@@ -301,6 +491,14 @@ namespace Clan
 		ASSERT(physicalDevice != VK_NULL_HANDLE);
 		vkGetPhysicalDeviceProperties(physicalDevice, &deviceProperties);
 		vkGetPhysicalDeviceFeatures(physicalDevice, &deviceFeatures);
+		//dynamic rendering is optional, the render pass backend is the fallback
+		VkPhysicalDeviceVulkan13Features features13{};
+		features13.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_3_FEATURES;
+		VkPhysicalDeviceFeatures2 features2{};
+		features2.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2;
+		features2.pNext = &features13;
+		vkGetPhysicalDeviceFeatures2(physicalDevice, &features2);
+		useDynamicRendering = preferDynamicRendering && features13.dynamicRendering;
 	}
 	//-----------------------------------------------------------------------------------------------
 	bool HelloTriangleApplication::isDeviceSuitable(const VkPhysicalDevice& physicalDevice)
@@ -311,7 +509,18 @@ namespace Clan
 		//vkGetPhysicalDeviceFeatures(physicalDevice, &deviceFeatures);
 		QueueFamilyIndices indices = findQueueFamilies(physicalDevice);
 		SwapChainSupportDetails details = querySwapChainSupport(physicalDevice);
-		return indices.isComplete() && checkDeviceExtensions(physicalDevice) && details.check();
+		//frame pacing relies on timeline semaphores (core in Vulkan 1.2), the render graph on synchronization2 (1.3)
+		VkPhysicalDeviceVulkan13Features features13{};
+		features13.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_3_FEATURES;
+		VkPhysicalDeviceVulkan12Features features12{};
+		features12.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_2_FEATURES;
+		features12.pNext = &features13;
+		VkPhysicalDeviceFeatures2 features2{};
+		features2.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2;
+		features2.pNext = &features12;
+		vkGetPhysicalDeviceFeatures2(physicalDevice, &features2);
+		return indices.isComplete() && checkDeviceExtensions(physicalDevice) && details.check() &&
+			   features12.timelineSemaphore && features13.synchronization2;
 	}
 	//-----------------------------------------------------------------------------------------------
 	HelloTriangleApplication::QueueFamilyIndices HelloTriangleApplication::findQueueFamilies(const VkPhysicalDevice& physicalDevice)
@@ -322,14 +531,29 @@ namespace Clan
 		std::vector<VkQueueFamilyProperties> queueFamilies(familiesCount);
 		vkGetPhysicalDeviceQueueFamilyProperties(physicalDevice, &familiesCount, queueFamilies.data());
 		for (uint32_t i = 0; i < familiesCount; i++) {
-			if (queueFamilies[i].queueFlags & VK_QUEUE_GRAPHICS_BIT) {
-				indices.graphicsFamily = i;
-			}
+			VkQueueFlags flags = queueFamilies[i].queueFlags;
 			VkBool32 presentSupport = VK_FALSE;
 			vkGetPhysicalDeviceSurfaceSupportKHR(physicalDevice, i, surface, &presentSupport);
-			if (presentSupport) indices.presentFamily = i;
-			if (indices.isComplete()) break;
+			if ((flags & VK_QUEUE_GRAPHICS_BIT) && !indices.graphicsFamily.has_value()) {
+				indices.graphicsFamily = i;
+			}
+			//prefer presenting from the graphics family
+			if (presentSupport && (!indices.presentFamily.has_value() || indices.graphicsFamily == i)) {
+				indices.presentFamily = i;
+			}
+			//copy engine: transfer without graphics and compute
+			if ((flags & VK_QUEUE_TRANSFER_BIT) && !(flags & (VK_QUEUE_GRAPHICS_BIT | VK_QUEUE_COMPUTE_BIT)) &&
+				!indices.transferFamily.has_value()) {
+				indices.transferFamily = i;
+			}
+			//async compute: compute without graphics
+			if ((flags & VK_QUEUE_COMPUTE_BIT) && !(flags & VK_QUEUE_GRAPHICS_BIT) && !indices.computeFamily.has_value()) {
+				indices.computeFamily = i;
+			}
 		}
+		if (!indices.computeFamily.has_value()) indices.computeFamily = indices.graphicsFamily;
+		//without a copy engine the async compute family still copies beside the graphics queue
+		if (!indices.transferFamily.has_value()) indices.transferFamily = indices.computeFamily;
 		return indices;
 	}
 	//-----------------------------------------------------------------------------------------------
@@ -339,6 +563,8 @@ namespace Clan
 		std::unordered_set<uint32_t> queueFamilyIndices = {
 			indices.graphicsFamily.value(),
 			indices.presentFamily.value(),
+			indices.computeFamily.value(),
+			indices.transferFamily.value(),
 		};
 		std::vector<VkDeviceQueueCreateInfo> queueCreateInfos(queueFamilyIndices.size());
 		float queuePriority = 1.0f;
@@ -356,18 +582,46 @@ namespace Clan
 		createInfo.queueCreateInfoCount = (uint32_t)queueCreateInfos.size();
 		createInfo.pQueueCreateInfos = queueCreateInfos.data();
 		createInfo.pEnabledFeatures = &deviceFeatures;
-		createInfo.enabledExtensionCount = (uint32_t)deviceExtensions.size();
-		createInfo.ppEnabledExtensionNames = deviceExtensions.data();
-		VkResult result = vkCreateDevice(physicalDevice, &createInfo, nullptr, &device);
+		//the budget extension is optional, without it the memory is checked against the heap sizes
+		std::vector<const char*> enabledExtensions = deviceExtensions;
+		bool memoryBudgetSupported = checkDeviceExtension(physicalDevice, VK_EXT_MEMORY_BUDGET_EXTENSION_NAME);
+		if (memoryBudgetSupported) {
+			enabledExtensions.push_back(VK_EXT_MEMORY_BUDGET_EXTENSION_NAME);
+		}
+		createInfo.enabledExtensionCount = (uint32_t)enabledExtensions.size();
+		createInfo.ppEnabledExtensionNames = enabledExtensions.data();
+		deviceFeatures12 = {};
+		deviceFeatures12.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_2_FEATURES;
+		deviceFeatures12.timelineSemaphore = VK_TRUE;
+		deviceFeatures13 = {};
+		deviceFeatures13.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_3_FEATURES;
+		deviceFeatures13.synchronization2 = VK_TRUE;
+		deviceFeatures13.dynamicRendering = useDynamicRendering ? VK_TRUE : VK_FALSE;
+		deviceFeatures12.pNext = &deviceFeatures13;
+		createInfo.pNext = &deviceFeatures12;
+		VkResult result = vkCreateDevice(physicalDevice, &createInfo, vulkanAllocator(), &device);
 		ASSERT(result == VK_SUCCESS);
+		initDeviceMemoryTracking(physicalDevice, memoryBudgetSupported);
 
 		vkGetDeviceQueue(device, indices.graphicsFamily.value(), 0, &graphicsQueue);
 		vkGetDeviceQueue(device, indices.presentFamily.value(), 0, &presentQueue);
+		vkGetDeviceQueue(device, indices.computeFamily.value(), 0, &computeQueue);
+		vkGetDeviceQueue(device, indices.transferFamily.value(), 0, &transferQueue);
+		//the graphics timeline is needed as soon as the first upload is submitted
+		frameScheduler.init(device, graphicsQueue, MAX_FRAMES_IN_FLIGHT);
+		deletionQueue.init(device);
+		layoutCache.init(device);
+		renderGraph.init(device, physicalDevice, &deletionQueue, &frameScheduler.timeline());
+		gpuTimer.init(device, physicalDevice, indices.graphicsFamily.value(), MAX_FRAMES_IN_FLIGHT);
+		asyncCompute.init(device, computeQueue, indices.computeFamily.value(), &frameScheduler,
+			indices.graphicsFamily.value(), VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT);
+		asyncTransfer.init(device, transferQueue, indices.transferFamily.value(), &frameScheduler,
+			indices.graphicsFamily.value(), VK_PIPELINE_STAGE_TRANSFER_BIT);
 	}
 	//-----------------------------------------------------------------------------------------------
 	void HelloTriangleApplication::createSurface()
 	{
-		VkResult result = glfwCreateWindowSurface(instance, window, nullptr, &surface);
+		VkResult result = glfwCreateWindowSurface(instance, window, vulkanAllocator(), &surface);
 		ASSERT(result == VK_SUCCESS);
 	}
 	//-----------------------------------------------------------------------------------------------
@@ -384,6 +638,18 @@ namespace Clan
 		return requiredExtensions.empty();
 	}
 	//-----------------------------------------------------------------------------------------------
+	bool HelloTriangleApplication::checkDeviceExtension(const VkPhysicalDevice& physicalDevice, const char* extensionName)
+	{
+		uint32_t extensionCount = 0;
+		vkEnumerateDeviceExtensionProperties(physicalDevice, nullptr, &extensionCount, nullptr);
+		std::vector<VkExtensionProperties> supportedExtensions(extensionCount);
+		vkEnumerateDeviceExtensionProperties(physicalDevice, nullptr, &extensionCount, supportedExtensions.data());
+		for (const auto& extension : supportedExtensions) {
+			if (std::strcmp(extension.extensionName, extensionName) == 0) return true;
+		}
+		return false;
+	}
+	//-----------------------------------------------------------------------------------------------
 	HelloTriangleApplication::SwapChainSupportDetails HelloTriangleApplication::querySwapChainSupport(const VkPhysicalDevice& physicalDevice)
 	{
 		SwapChainSupportDetails details;
@@ -459,11 +725,19 @@ namespace Clan
 		createInfo.presentMode = presentMode;
 
 		createInfo.imageArrayLayers = 1;
-		createInfo.imageUsage = VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT;
+		//the post-process anti-aliasing modes blit their result to the backbuffer
+		createInfo.imageUsage = VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT |
+			(details.capabilities.supportedUsageFlags & VK_IMAGE_USAGE_TRANSFER_DST_BIT);
+		VkFormatProperties formatProperties{};
+		vkGetPhysicalDeviceFormatProperties(physicalDevice, surfaceFormat.format, &formatProperties);
+		swapChainBlitSupported = (createInfo.imageUsage & VK_IMAGE_USAGE_TRANSFER_DST_BIT) &&
+			(formatProperties.optimalTilingFeatures & VK_FORMAT_FEATURE_BLIT_DST_BIT);
 		createInfo.preTransform = details.capabilities.currentTransform;
 		createInfo.compositeAlpha = VK_COMPOSITE_ALPHA_OPAQUE_BIT_KHR;
 		createInfo.clipped = VK_TRUE;
-		createInfo.oldSwapchain = VK_NULL_HANDLE;
+		//hand the retired swapchain over so presentation can continue while it drains
+		VkSwapchainKHR oldSwapChain = swapChain;
+		createInfo.oldSwapchain = oldSwapChain;
 
 		QueueFamilyIndices indices = findQueueFamilies(physicalDevice);
 		uint32_t queueFamilyIndices[] = {
@@ -480,8 +754,11 @@ namespace Clan
 			createInfo.queueFamilyIndexCount = 0;
 			createInfo.pQueueFamilyIndices = nullptr;
 		}
-		VkResult result = vkCreateSwapchainKHR(device, &createInfo, nullptr, &swapChain);
+		VkResult result = vkCreateSwapchainKHR(device, &createInfo, vulkanAllocator(), &swapChain);
 		ASSERT(result == VK_SUCCESS);
+		//the graphics timeline doesn't cover vkQueuePresentKHR, the presents of the old swapchain are
+		//only known to be done once the frames after them have finished
+		deletionQueue.retire<VK_OBJECT_TYPE_SWAPCHAIN_KHR>(oldSwapChain, frameScheduler.timeline().lastSubmitted() + MAX_FRAMES_IN_FLIGHT);
 
 		vkGetSwapchainImagesKHR(device, swapChain, &imageCount, nullptr);
 		swapChainImages.resize(imageCount);
@@ -498,194 +775,72 @@ namespace Clan
 		}
 	}
 	//-----------------------------------------------------------------------------------------------
-	void HelloTriangleApplication::createGraphicsPipeline()
+	void HelloTriangleApplication::createPipelineCache()
 	{
-		//ɱ̹߽׶-----------------
-		std::vector<char> vertShaderCode = readBinaryFile("shaders/base_vertex.spv");
-		std::vector<char> fragShaderCode = readBinaryFile("shaders/base_fragment.spv");
-		VkShaderModule vertShaderModule = createShaderModule(vertShaderCode);
-		VkShaderModule fragShaderModule = createShaderModule(fragShaderCode);
-		VkPipelineShaderStageCreateInfo vertShaderStageCreateInfo{};
-		vertShaderStageCreateInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
-		vertShaderStageCreateInfo.stage = VK_SHADER_STAGE_VERTEX_BIT;
-		vertShaderStageCreateInfo.module = vertShaderModule;
-		vertShaderStageCreateInfo.pName = "main";
-		VkPipelineShaderStageCreateInfo fragShaderStageCreateInfo{};
-		fragShaderStageCreateInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
-		fragShaderStageCreateInfo.stage = VK_SHADER_STAGE_FRAGMENT_BIT;
-		fragShaderStageCreateInfo.module = fragShaderModule;
-		fragShaderStageCreateInfo.pName = "main";
-		VkPipelineShaderStageCreateInfo shaderStages[] = {
-			vertShaderStageCreateInfo,
-			fragShaderStageCreateInfo
-		};
-		//̶߽׶-------------------------
-		//
-		VkVertexInputBindingDescription bindingDescription = Vertex::getBindingDescription();
-		std::array<VkVertexInputAttributeDescription, 3> attributeDescriptions = Vertex::getAttributeDescriptions();
-
-		VkPipelineVertexInputStateCreateInfo vertexInputCreateInfo{};
-		vertexInputCreateInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO;
-		vertexInputCreateInfo.vertexBindingDescriptionCount = 1;
-		vertexInputCreateInfo.pVertexBindingDescriptions = &bindingDescription;
-		vertexInputCreateInfo.vertexAttributeDescriptionCount = static_cast<uint32_t>(attributeDescriptions.size());
-		vertexInputCreateInfo.pVertexAttributeDescriptions = attributeDescriptions.data();
-		//
-		VkPipelineInputAssemblyStateCreateInfo inputAssemblyCreateInfo{};
-		inputAssemblyCreateInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_INPUT_ASSEMBLY_STATE_CREATE_INFO;
-		inputAssemblyCreateInfo.topology = VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST;
-		inputAssemblyCreateInfo.primitiveRestartEnable = VK_FALSE;
-		//ӿü
-		VkViewport viewport{};
-		viewport.x = 0.0f;
-		viewport.y = 0.0f;
-		viewport.width = (float)swapChainExtent.width;
-		viewport.height = (float)swapChainExtent.height;
-		viewport.minDepth = 0.0f;
-		viewport.maxDepth = 1.0f;
-		VkRect2D scissor{};
-		scissor.offset = { 0, 0 };
-		scissor.extent = swapChainExtent;
-		VkPipelineViewportStateCreateInfo viewportState{};
-		viewportState.sType = VK_STRUCTURE_TYPE_PIPELINE_VIEWPORT_STATE_CREATE_INFO;
-		viewportState.viewportCount = 1;
-		viewportState.pViewports = &viewport;
-		viewportState.scissorCount = 1;
-		viewportState.pScissors = &scissor;
-		//դ
-		VkPipelineRasterizationStateCreateInfo rasterizer{};
-		rasterizer.sType = VK_STRUCTURE_TYPE_PIPELINE_RASTERIZATION_STATE_CREATE_INFO;
-		rasterizer.depthClampEnable = VK_FALSE;
-		rasterizer.rasterizerDiscardEnable = VK_FALSE;
-		rasterizer.polygonMode = VK_POLYGON_MODE_FILL;
-		//rasterizer.polygonMode = VK_POLYGON_MODE_POINT;
-		//rasterizer.polygonMode = VK_POLYGON_MODE_LINE;
-		//rasterizer.cullMode = VK_CULL_MODE_BACK_BIT;
-		rasterizer.cullMode = VK_CULL_MODE_NONE;
-		rasterizer.frontFace = VK_FRONT_FACE_COUNTER_CLOCKWISE;
-		rasterizer.depthBiasEnable = VK_FALSE;
-		rasterizer.depthBiasConstantFactor = 0.0f; // Optional
-		rasterizer.depthBiasClamp = 0.0f; // Optional
-		rasterizer.depthBiasSlopeFactor = 0.0f; // Optional
-		rasterizer.lineWidth = 1.0f;
-		//Ⱥģ
-		VkPipelineDepthStencilStateCreateInfo depthStencil{};
-		depthStencil.sType = VK_STRUCTURE_TYPE_PIPELINE_DEPTH_STENCIL_STATE_CREATE_INFO;
-		depthStencil.depthTestEnable = VK_TRUE;
-		depthStencil.depthWriteEnable = VK_TRUE;
-		depthStencil.depthCompareOp = VK_COMPARE_OP_LESS;
-		depthStencil.depthBoundsTestEnable = VK_FALSE;
-		depthStencil.minDepthBounds = 0.0f; // Optional
-		depthStencil.maxDepthBounds = 1.0f; // Optional
-		depthStencil.stencilTestEnable = VK_FALSE;
-		depthStencil.front = {}; // Optional
-		depthStencil.back = {}; // Optional
-		//
-		VkPipelineMultisampleStateCreateInfo multisampling{};
-		multisampling.sType = VK_STRUCTURE_TYPE_PIPELINE_MULTISAMPLE_STATE_CREATE_INFO;
-		multisampling.rasterizationSamples = VK_SAMPLE_COUNT_1_BIT;
-		multisampling.sampleShadingEnable = VK_FALSE;
-		multisampling.minSampleShading = 1.0f; // Optional
-		multisampling.pSampleMask = nullptr; // Optional
-		multisampling.alphaToCoverageEnable = VK_FALSE; // Optional
-		multisampling.alphaToOneEnable = VK_FALSE; // Optional
-		//ɫ
-		VkPipelineColorBlendAttachmentState colorBlendAttachment{};
-		colorBlendAttachment.blendEnable = VK_TRUE;
-		colorBlendAttachment.srcColorBlendFactor = VK_BLEND_FACTOR_SRC_ALPHA;
-		colorBlendAttachment.dstColorBlendFactor = VK_BLEND_FACTOR_ONE_MINUS_SRC_ALPHA;
-		colorBlendAttachment.colorBlendOp = VK_BLEND_OP_ADD;
-		colorBlendAttachment.srcAlphaBlendFactor = VK_BLEND_FACTOR_ONE;
-		colorBlendAttachment.dstAlphaBlendFactor = VK_BLEND_FACTOR_ZERO;
-		colorBlendAttachment.alphaBlendOp = VK_BLEND_OP_ADD;
-		colorBlendAttachment.colorWriteMask = VK_COLOR_COMPONENT_R_BIT | VK_COLOR_COMPONENT_G_BIT | VK_COLOR_COMPONENT_B_BIT | VK_COLOR_COMPONENT_A_BIT;
-		VkPipelineColorBlendStateCreateInfo colorBlending{};
-		colorBlending.sType = VK_STRUCTURE_TYPE_PIPELINE_COLOR_BLEND_STATE_CREATE_INFO;
-		colorBlending.logicOpEnable = VK_FALSE;
-		colorBlending.logicOp = VK_LOGIC_OP_COPY; // Optional
-		colorBlending.attachmentCount = 1;
-		colorBlending.pAttachments = &colorBlendAttachment;
-		colorBlending.blendConstants[0] = 0.0f; // Optional
-		colorBlending.blendConstants[1] = 0.0f; // Optional
-		colorBlending.blendConstants[2] = 0.0f; // Optional
-		colorBlending.blendConstants[3] = 0.0f; // Optional
-		//Dynamic state
-		std::vector<VkDynamicState> dynamicStates = {
-			VK_DYNAMIC_STATE_VIEWPORT,
-			VK_DYNAMIC_STATE_LINE_WIDTH
-		};
-		VkPipelineDynamicStateCreateInfo dynamicState{};
-		dynamicState.sType = VK_STRUCTURE_TYPE_PIPELINE_DYNAMIC_STATE_CREATE_INFO;
-		dynamicState.dynamicStateCount = static_cast<uint32_t>(dynamicStates.size());
-		dynamicState.pDynamicStates = dynamicStates.data();
-		//Pipeline Layout
-		VkPipelineLayoutCreateInfo pipelineLayoutInfo{};
-		pipelineLayoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
-		pipelineLayoutInfo.setLayoutCount = 1;
-		pipelineLayoutInfo.pSetLayouts = &descriptorSetLayout;
-		pipelineLayoutInfo.pushConstantRangeCount = 0; // Optional
-		pipelineLayoutInfo.pPushConstantRanges = nullptr; // Optional
-		VkResult temp_result = vkCreatePipelineLayout(device, &pipelineLayoutInfo, nullptr, &pipelineLayout);
-		ASSERT(temp_result == VK_SUCCESS);
-		//Pipeline
-		VkGraphicsPipelineCreateInfo pipelineInfo{};
-		pipelineInfo.sType = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO;
-		pipelineInfo.stageCount = 2;
-		pipelineInfo.pStages = shaderStages;
-		pipelineInfo.pVertexInputState = &vertexInputCreateInfo;
-		pipelineInfo.pInputAssemblyState = &inputAssemblyCreateInfo;
-		pipelineInfo.pViewportState = &viewportState;
-		pipelineInfo.pRasterizationState = &rasterizer;
-		pipelineInfo.pMultisampleState = &multisampling;
-		pipelineInfo.pDepthStencilState = &depthStencil;
-		pipelineInfo.pColorBlendState = &colorBlending;
-		//pipelineInfo.pDynamicState = &dynamicState; // Optional
-		pipelineInfo.pDynamicState = nullptr; // Optional
-		pipelineInfo.layout = pipelineLayout;
-		pipelineInfo.renderPass = renderPass;
-		pipelineInfo.subpass = 0;
-		pipelineInfo.basePipelineHandle = VK_NULL_HANDLE; // Optional
-		pipelineInfo.basePipelineIndex = -1; // Optional
-		VkResult result = vkCreateGraphicsPipelines(device, VK_NULL_HANDLE, 1, &pipelineInfo, nullptr, &graphicsPipeline);
-		ASSERT(result == VK_SUCCESS);
-
-		vkDestroyShaderModule(device, vertShaderModule, nullptr);
-		vkDestroyShaderModule(device, fragShaderModule, nullptr);
+		pipelineStates.init(device, physicalDevice, &layoutCache, SHADER_DIRECTORY, PIPELINE_CACHE_PATH, &assetArchive);
+		//the variants used last time are built now instead of on their first draw
+		uint32_t precompiled = pipelineStates.precompile(PIPELINE_KEYS_PATH, useDynamicRendering ? VK_NULL_HANDLE : renderPass,
+			antiAliasing.sceneFormat(swapChainImageFormat), antiAliasing.samples());
+		if (precompiled > 0) {
+			std::cout << "precompiled " << precompiled << " pipelines" << std::endl;
+		}
 	}
 	//-----------------------------------------------------------------------------------------------
-	VkShaderModule HelloTriangleApplication::createShaderModule(const std::vector<char>& bytecode)
-	{
-		VkShaderModuleCreateInfo createInfo{};
-		createInfo.sType = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO;
-		createInfo.codeSize = bytecode.size();
-		createInfo.pCode = reinterpret_cast<const uint32_t*>(bytecode.data());
-		VkShaderModule shaderModule;
-		VkResult result = vkCreateShaderModule(device, &createInfo, nullptr, &shaderModule);
-		ASSERT(result == VK_SUCCESS);
-		return shaderModule;
+	void HelloTriangleApplication::createShaderHotReload()
+	{
+		shaderHotReload.init(device, SHADER_DIRECTORY);
+	}
+	//-----------------------------------------------------------------------------------------------
+	void HelloTriangleApplication::createGraphicsPipeline()
+	{
+		forwardKey = {};
+		forwardKey.vertexShader = "base_vertex.spv";
+		forwardKey.fragmentShader = "base_fragment.spv";
+		forwardKey.vertexStride = Policy::VERTEX_STRIDE;
+		forwardKey.blendMode = BlendMode::Alpha;
+		forwardKey.colorFormat = antiAliasing.sceneFormat(swapChainImageFormat);
+		forwardKey.depthFormat = DEPTH_FORMAT;
+		forwardKey.samples = antiAliasing.samples();
+		//USE_VERTEX_COLOR of base_fragment.frag, vertices carry the diffuse color of untextured materials
+		forwardKey.constants = { { 0, VK_TRUE } };
+		VkRenderPass pipelineRenderPass = useDynamicRendering ? VK_NULL_HANDLE : renderPass;
+		//variants are kept, switching back to a mode doesn't build again
+		graphicsPipeline = pipelineStates.get(forwardKey, pipelineRenderPass);
+		ASSERT(graphicsPipeline != VK_NULL_HANDLE);
+		//saving a source rebuilds the pipeline on the hot reload worker, drawFrame swaps it in
+		VkPipelineLayout layout = pipelineStates.layout(forwardKey);
+		shaderHotReload.watch(FORWARD_PIPELINE, { "base_vertex.vert", "base_fragment.frag" },
+			[this, key = forwardKey, pipelineRenderPass, layout](const std::vector<std::vector<char>>& stages) {
+				return pipelineStates.build(key, pipelineRenderPass, layout, stages[0], stages[1]);
+			});
 	}
 	//-----------------------------------------------------------------------------------------------
 	void HelloTriangleApplication::createRenderPass()
 	{
+		if (useDynamicRendering) return;
 		//
+		//with MSAA the samples are resolved to the backbuffer at the end of the subpass and dropped
+		VkSampleCountFlagBits samples = antiAliasing.samples();
+		bool resolve = samples != VK_SAMPLE_COUNT_1_BIT;
 		VkAttachmentDescription colorAttachment{};
-		colorAttachment.format = swapChainImageFormat;
-		colorAttachment.samples = VK_SAMPLE_COUNT_1_BIT;
+		colorAttachment.format = antiAliasing.sceneFormat(swapChainImageFormat);
+		colorAttachment.samples = samples;
 		colorAttachment.loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
-		colorAttachment.storeOp = VK_ATTACHMENT_STORE_OP_STORE;
+		colorAttachment.storeOp = resolve ? VK_ATTACHMENT_STORE_OP_DONT_CARE : VK_ATTACHMENT_STORE_OP_STORE;
 		colorAttachment.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
 		colorAttachment.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
-		colorAttachment.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
-		colorAttachment.finalLayout = VK_IMAGE_LAYOUT_PRESENT_SRC_KHR;
+		//layout transitions are done by the render graph barriers around the pass
+		colorAttachment.initialLayout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+		colorAttachment.finalLayout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
 
 		VkAttachmentDescription depthAttachment{};
-		depthAttachment.format = VK_FORMAT_D32_SFLOAT;
-		depthAttachment.samples = VK_SAMPLE_COUNT_1_BIT;
+		depthAttachment.format = DEPTH_FORMAT;
+		depthAttachment.samples = samples;
 		depthAttachment.loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
-		depthAttachment.storeOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+		depthAttachment.storeOp = antiAliasing.readsDepth() ? VK_ATTACHMENT_STORE_OP_STORE : VK_ATTACHMENT_STORE_OP_DONT_CARE;
 		depthAttachment.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
 		depthAttachment.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
-		depthAttachment.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+		depthAttachment.initialLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
 		depthAttachment.finalLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
 
 		VkAttachmentReference colorAttachmentRef{};
@@ -694,45 +849,58 @@ namespace Clan
 		VkAttachmentReference depthAttachmentRef{};
 		depthAttachmentRef.attachment = 1;
 		depthAttachmentRef.layout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
+		VkAttachmentDescription resolveAttachment{};
+		resolveAttachment.format = swapChainImageFormat;
+		resolveAttachment.samples = VK_SAMPLE_COUNT_1_BIT;
+		resolveAttachment.loadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+		resolveAttachment.storeOp = VK_ATTACHMENT_STORE_OP_STORE;
+		resolveAttachment.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+		resolveAttachment.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+		resolveAttachment.initialLayout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+		resolveAttachment.finalLayout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+		VkAttachmentReference resolveAttachmentRef{};
+		resolveAttachmentRef.attachment = 2;
+		resolveAttachmentRef.layout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
 		//
 		VkSubpassDescription subpass{};
 		subpass.pipelineBindPoint = VK_PIPELINE_BIND_POINT_GRAPHICS;
 		subpass.colorAttachmentCount = 1;
 		subpass.pColorAttachments = &colorAttachmentRef;
 		subpass.pDepthStencilAttachment = &depthAttachmentRef;
+		subpass.pResolveAttachments = resolve ? &resolveAttachmentRef : nullptr;
 
-		VkSubpassDependency dependency{};
-		dependency.srcSubpass = VK_SUBPASS_EXTERNAL;
-		dependency.dstSubpass = 0;
-		dependency.srcStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT | VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT;
-		dependency.srcAccessMask = 0;
-		dependency.dstStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT | VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT;
-		dependency.dstAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
-
-		std::array<VkAttachmentDescription, 2> attachments{
+		std::vector<VkAttachmentDescription> attachments{
 			colorAttachment,
 			depthAttachment,
 		};
+		if (resolve) {
+			attachments.push_back(resolveAttachment);
+		}
 		VkRenderPassCreateInfo renderPassInfo{};
 		renderPassInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_CREATE_INFO;
 		renderPassInfo.attachmentCount = static_cast<uint32_t>(attachments.size());
 		renderPassInfo.pAttachments = attachments.data();
 		renderPassInfo.subpassCount = 1;
 		renderPassInfo.pSubpasses = &subpass;
-		renderPassInfo.dependencyCount = 1;
-		renderPassInfo.pDependencies = &dependency;
-		VkResult result = vkCreateRenderPass(device, &renderPassInfo, nullptr, &renderPass);
+		renderPassInfo.dependencyCount = 0;
+		renderPassInfo.pDependencies = nullptr;
+		VkResult result = vkCreateRenderPass(device, &renderPassInfo, vulkanAllocator(), &renderPass);
 		ASSERT(result == VK_SUCCESS);
 	}
 	//-----------------------------------------------------------------------------------------------
 	void HelloTriangleApplication::createFramebuffers()
 	{
+		if (useDynamicRendering) return;
 		swapChainFramebuffers.resize(swapChainImageViews.size());
 		for (size_t i = 0; i < swapChainImageViews.size(); ++i) {
-			std::array<VkImageView, 2> attachments = {
-				swapChainImageViews[i],
+			//[color, depth, resolve], the backbuffer is the color target unless there is a scene color image
+			std::vector<VkImageView> attachments = {
+				colorImage != VK_NULL_HANDLE ? colorImageView : swapChainImageViews[i],
 				depthImageView,
 			};
+			if (antiAliasing.samples() != VK_SAMPLE_COUNT_1_BIT) {
+				attachments.push_back(swapChainImageViews[i]);
+			}
 			VkFramebufferCreateInfo framebufferInfo{};
 			framebufferInfo.sType = VK_STRUCTURE_TYPE_FRAMEBUFFER_CREATE_INFO;
 			framebufferInfo.renderPass = renderPass;
@@ -741,7 +909,7 @@ namespace Clan
 			framebufferInfo.width = swapChainExtent.width;
 			framebufferInfo.height = swapChainExtent.height;
 			framebufferInfo.layers = 1;
-			VkResult result = vkCreateFramebuffer(device, &framebufferInfo, nullptr, &swapChainFramebuffers[i]);
+			VkResult result = vkCreateFramebuffer(device, &framebufferInfo, vulkanAllocator(), &swapChainFramebuffers[i]);
 			ASSERT(result == VK_SUCCESS);
 		}
 	}
@@ -754,7 +922,7 @@ namespace Clan
 		poolInfo.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
 		poolInfo.flags = VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT;
 		poolInfo.queueFamilyIndex = queueFamilyIndices.graphicsFamily.value();
-		VkResult result = vkCreateCommandPool(device, &poolInfo, nullptr, &commandPool);
+		VkResult result = vkCreateCommandPool(device, &poolInfo, vulkanAllocator(), &commandPool);
 		ASSERT(result == VK_SUCCESS);
 	}
 	//-----------------------------------------------------------------------------------------------
@@ -778,60 +946,286 @@ namespace Clan
 		beginInfo.pInheritanceInfo = nullptr; // Optional
 		VkResult beginResult = vkBeginCommandBuffer(commandBuffer, &beginInfo);
 		ASSERT(beginResult == VK_SUCCESS);
-		//starting a render pass
-		VkRenderPassBeginInfo renderPassInfo{};
-		renderPassInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
-		renderPassInfo.renderPass = renderPass;
-		renderPassInfo.framebuffer = swapChainFramebuffers[imageIndex];
-		renderPassInfo.renderArea.offset = { 0, 0 };
-		renderPassInfo.renderArea.extent = swapChainExtent;
-		std::array<VkClearValue, 2> clearValues{};
-		clearValues[0] = {{{0.0f, 0.0f, 0.0f, 1.0f}}};
-		clearValues[1].depthStencil = { 1.0f, 0 };
-		renderPassInfo.clearValueCount = static_cast<uint32_t>(clearValues.size());
-		renderPassInfo.pClearValues = clearValues.data();
-		vkCmdBeginRenderPass(commandBuffer, &renderPassInfo, VK_SUBPASS_CONTENTS_INLINE);
-		//banding
-		vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, graphicsPipeline);
-		VkDeviceSize offsets[] = { 0 };
-		vkCmdBindVertexBuffers(commandBuffer, 0, 1, &VertIDBuffer, offsets);
-		vkCmdBindIndexBuffer(commandBuffer, VertIDBuffer, sizeof(vertices[0]) * vertices.size(), VK_INDEX_TYPE_UINT32);
-		vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayout, 0, 1, &descriptorSets[currentFrame], 0, nullptr);
-		//Draw
-		vkCmdDrawIndexed(commandBuffer,static_cast<uint32_t>(indices.size()), 1, 0, 0, 0);
-		//Ending Render pass
-		vkCmdEndRenderPass(commandBuffer);
+		gpuTimer.begin(commandBuffer, currentFrame);
+		//take ownership of whatever async compute/transfer produced for this frame
+		asyncCompute.acquireOnGraphics(commandBuffer);
+		asyncTransfer.acquireOnGraphics(commandBuffer);
+		//frame graph: the barriers around every pass are derived from the declared accesses
+		renderGraph.reset();
+		//the acquire semaphore is waited at color output, the transition must not start earlier
+		GraphResource backbuffer = renderGraph.importImage("backbuffer", swapChainImages[imageIndex], swapChainImageViews[imageIndex],
+			VK_IMAGE_ASPECT_COLOR_BIT, { VK_PIPELINE_STAGE_2_COLOR_ATTACHMENT_OUTPUT_BIT, VK_ACCESS_2_NONE, VK_IMAGE_LAYOUT_UNDEFINED },
+			VK_IMAGE_LAYOUT_PRESENT_SRC_KHR);
+		//the depth buffer is shared by the frames in flight, its contents are discarded each frame
+		//unless TAA reads it. Without framebuffers the attachments are graph transients: a resize
+		//only changes their desc, and the ones never stored get lazily allocated memory.
+		VkSampleCountFlagBits samples = antiAliasing.samples();
+		bool resolve = samples != VK_SAMPLE_COUNT_1_BIT;
+		bool sceneTarget = resolve || antiAliasing.isPostProcess();
+		GraphResource depth{};
+		GraphResource color = backbuffer;
+		if (useDynamicRendering) {
+			depth = renderGraph.createImage("depth", { DEPTH_FORMAT, swapChainExtent, samples });
+			if (sceneTarget) {
+				color = renderGraph.createImage("sceneColor", { antiAliasing.sceneFormat(swapChainImageFormat), swapChainExtent, samples });
+			}
+		}
+		else {
+			depth = renderGraph.importImage("depth", depthImage, depthImageView, VK_IMAGE_ASPECT_DEPTH_BIT,
+				{ VK_PIPELINE_STAGE_2_LATE_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT,
+				  VK_ACCESS_2_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT, VK_IMAGE_LAYOUT_UNDEFINED });
+			if (sceneTarget) {
+				color = renderGraph.importImage("sceneColor", colorImage, colorImageView, VK_IMAGE_ASPECT_COLOR_BIT,
+					{ VK_PIPELINE_STAGE_2_COLOR_ATTACHMENT_OUTPUT_BIT | VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT,
+					  VK_ACCESS_2_COLOR_ATTACHMENT_WRITE_BIT, VK_IMAGE_LAYOUT_UNDEFINED });
+			}
+		}
+		renderGraph.addPass("forward",
+			[&](RenderGraph::PassBuilder& builder) {
+				builder.write(color, ImageUsage::ColorAttachment);
+				//the resolve writes the backbuffer as a color attachment
+				if (resolve) builder.write(backbuffer, ImageUsage::ColorAttachment);
+				builder.write(depth, ImageUsage::DepthAttachment);
+			},
+			[this, imageIndex, backbuffer, color, depth, resolve](VkCommandBuffer commandBuffer) {
+				if (useDynamicRendering) {
+					VkRenderingAttachmentInfo colorAttachment{};
+					colorAttachment.sType = VK_STRUCTURE_TYPE_RENDERING_ATTACHMENT_INFO;
+					colorAttachment.imageView = renderGraph.imageView(color);
+					colorAttachment.imageLayout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+					colorAttachment.loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
+					colorAttachment.storeOp = VK_ATTACHMENT_STORE_OP_STORE;
+					colorAttachment.clearValue.color = { {0.0f, 0.0f, 0.0f, 1.0f} };
+					if (resolve) {
+						colorAttachment.storeOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+						colorAttachment.resolveMode = VK_RESOLVE_MODE_AVERAGE_BIT;
+						colorAttachment.resolveImageView = renderGraph.imageView(backbuffer);
+						colorAttachment.resolveImageLayout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+					}
+					VkRenderingAttachmentInfo depthAttachment{};
+					depthAttachment.sType = VK_STRUCTURE_TYPE_RENDERING_ATTACHMENT_INFO;
+					depthAttachment.imageView = renderGraph.imageView(depth);
+					depthAttachment.imageLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
+					depthAttachment.loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
+					depthAttachment.storeOp = antiAliasing.readsDepth() ? VK_ATTACHMENT_STORE_OP_STORE : VK_ATTACHMENT_STORE_OP_DONT_CARE;
+					depthAttachment.clearValue.depthStencil = { 1.0f, 0 };
+					VkRenderingInfo renderingInfo{};
+					renderingInfo.sType = VK_STRUCTURE_TYPE_RENDERING_INFO;
+					renderingInfo.renderArea.offset = { 0, 0 };
+					renderingInfo.renderArea.extent = swapChainExtent;
+					renderingInfo.layerCount = 1;
+					renderingInfo.colorAttachmentCount = 1;
+					renderingInfo.pColorAttachments = &colorAttachment;
+					renderingInfo.pDepthAttachment = &depthAttachment;
+					vkCmdBeginRendering(commandBuffer, &renderingInfo);
+					recordDrawCommands(commandBuffer);
+					vkCmdEndRendering(commandBuffer);
+					return;
+				}
+				//starting a render pass
+				VkRenderPassBeginInfo renderPassInfo{};
+				renderPassInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
+				renderPassInfo.renderPass = renderPass;
+				renderPassInfo.framebuffer = swapChainFramebuffers[imageIndex];
+				renderPassInfo.renderArea.offset = { 0, 0 };
+				renderPassInfo.renderArea.extent = swapChainExtent;
+				std::array<VkClearValue, 2> clearValues{};
+				clearValues[0] = {{{0.0f, 0.0f, 0.0f, 1.0f}}};
+				clearValues[1].depthStencil = { 1.0f, 0 };
+				renderPassInfo.clearValueCount = static_cast<uint32_t>(clearValues.size());
+				renderPassInfo.pClearValues = clearValues.data();
+				vkCmdBeginRenderPass(commandBuffer, &renderPassInfo, VK_SUBPASS_CONTENTS_INLINE);
+				recordDrawCommands(commandBuffer);
+				//Ending Render pass
+				vkCmdEndRenderPass(commandBuffer);
+			});
+		antiAliasing.addPasses(renderGraph, frameDescriptors[currentFrame], swapChainExtent, color, depth, backbuffer, reprojection);
+		renderGraph.markOutput(backbuffer);
+		renderGraph.compile();
+		renderGraph.execute(commandBuffer);
+		gpuTimer.end(commandBuffer, currentFrame);
 		VkResult endResult = vkEndCommandBuffer(commandBuffer);
 		ASSERT(endResult == VK_SUCCESS);
 	}
 	//-----------------------------------------------------------------------------------------------
+	void HelloTriangleApplication::recordDrawCommands(VkCommandBuffer commandBuffer)
+	{
+		//banding
+		vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, graphicsPipeline);
+		VkViewport viewport{};
+		viewport.x = 0.0f;
+		viewport.y = 0.0f;
+		viewport.width = (float)swapChainExtent.width;
+		viewport.height = (float)swapChainExtent.height;
+		viewport.minDepth = 0.0f;
+		viewport.maxDepth = 1.0f;
+		vkCmdSetViewport(commandBuffer, 0, 1, &viewport);
+		VkRect2D scissor{};
+		scissor.offset = { 0, 0 };
+		scissor.extent = swapChainExtent;
+		vkCmdSetScissor(commandBuffer, 0, 1, &scissor);
+		//every mesh lives in the arena, the index buffer is only bound again when the index type changes
+		geometryArena.bindVertices(commandBuffer);
+		VkIndexType boundIndexType = VK_INDEX_TYPE_MAX_ENUM;
+		uint32_t boundMaterial = ~0u;
+		//a descriptor set bind and one multi-draw per material and index type, every command picks its
+		//object's matrix through its first instance, culled meshes have no instance
+		const uint32_t stride = sizeof(VkDrawIndexedIndirectCommand);
+		const VkDrawIndexedIndirectCommand* pCommands = drawCommandsMapped[currentFrame];
+		bool drawIndirect = deviceFeatures.multiDrawIndirect && deviceFeatures.drawIndirectFirstInstance;
+		for (const DrawBatch& batch : drawBatches) {
+			if (batch.visibleCount == 0) continue;
+			if (boundIndexType != batch.indexType) {
+				geometryArena.bindIndices(commandBuffer, batch.indexType);
+				boundIndexType = batch.indexType;
+				boundMaterial = ~0u;
+			}
+			if (boundMaterial != batch.material) {
+				VkDescriptorSet descriptorSet = descriptorSets[currentFrame * materials.size() + batch.material];
+				vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayout, 0, 1, &descriptorSet, 0, nullptr);
+				DrawConstants drawConstants{};
+				drawConstants.materialIndex = batch.material;
+				vkCmdPushConstants(commandBuffer, pipelineLayout, drawConstantStages, 0, sizeof(drawConstants), &drawConstants);
+				boundMaterial = batch.material;
+			}
+			//Draw
+			if (drawIndirect) {
+				vkCmdDrawIndexedIndirect(commandBuffer, drawCommandBuffers[currentFrame], batch.firstDraw * stride, batch.drawCount, stride);
+			}
+			else {
+				//the same commands one by one, direct draws always take a first instance
+				for (uint32_t d = batch.firstDraw; d < batch.firstDraw + batch.drawCount; ++d) {
+					const VkDrawIndexedIndirectCommand& command = pCommands[d];
+					if (command.instanceCount == 0) continue;
+					vkCmdDrawIndexed(commandBuffer, command.indexCount, command.instanceCount, command.firstIndex, command.vertexOffset, command.firstInstance);
+				}
+			}
+		}
+	}
+	//-----------------------------------------------------------------------------------------------
+	void HelloTriangleApplication::createAntiAliasing()
+	{
+		//the .spv files are committed next to their sources, a missing one is reported and its mode falls back to none
+		auto loadPostProcessShader = [this](const std::string& name) {
+			std::string spirvPath = std::string(SHADER_DIRECTORY) + "/" + name + ".spv";
+			if (assetArchive.contains(spirvPath) || std::ifstream(spirvPath).good()) return readBinaryFile(spirvPath);
+			std::cerr << spirvPath << " is missing" << std::endl;
+			return std::vector<char>{};
+		};
+		antiAliasing.init(device, physicalDevice, &deletionQueue, &frameScheduler.timeline(),
+			loadPostProcessShader("fxaa_compute"), loadPostProcessShader("taa_compute"));
+		setAntiAliasingMode(requestedAntiAliasing);
+	}
+	//-----------------------------------------------------------------------------------------------
+	void HelloTriangleApplication::setAntiAliasingMode(AntiAliasingMode mode)
+	{
+		AntiAliasingMode used = antiAliasing.setMode(mode, swapChainBlitSupported);
+		if (used != mode) {
+			std::cerr << antiAliasingModeName(mode) << " isn't available, using " << antiAliasingModeName(used) << std::endl;
+		}
+	}
+	//-----------------------------------------------------------------------------------------------
+	void HelloTriangleApplication::applyAntiAliasing(AntiAliasingMode mode)
+	{
+		//the old objects are retired, frames in flight keep rendering with the previous mode
+		//a hot reload build may use the render pass retired here
+		shaderHotReload.suspend();
+		uint64_t lastUse = frameScheduler.timeline().lastSubmitted();
+		deletionQueue.retire<VK_OBJECT_TYPE_RENDER_PASS>(renderPass, lastUse);
+		cleanupAttachments();
+		setAntiAliasingMode(mode);
+		createRenderPass();
+		createGraphicsPipeline();
+		shaderHotReload.resume();
+		createColorResources();
+		createDepthResources();
+		createFramebuffers();
+	}
+	//-----------------------------------------------------------------------------------------------
+	bool HelloTriangleApplication::advanceAntiAliasingBenchmark()
+	{
+		auto now = std::chrono::steady_clock::now();
+		if (benchmark.frame > ANTI_ALIASING_WARMUP_FRAMES) {
+			benchmark.cpuMilliseconds += std::chrono::duration<double, std::milli>(now - benchmark.lastFrame).count();
+		}
+		benchmark.lastFrame = now;
+		if (++benchmark.frame <= ANTI_ALIASING_WARMUP_FRAMES + benchmark.framesPerMode) {
+			return true;
+		}
+
+		//lazily allocated graph transients only count what was committed, the render pass
+		//backend's own attachments are counted as allocated
+		constexpr double MEGABYTE = 1024.0 * 1024.0;
+		VkDeviceSize allocated = renderGraph.transientMemoryBytes() + antiAliasing.historyMemoryBytes() + attachmentMemoryBytes;
+		VkDeviceSize committed = renderGraph.transientCommittedBytes() + antiAliasing.historyMemoryBytes() + attachmentMemoryBytes;
+		if (benchmark.mode == 0) {
+			std::cout << std::left << std::setw(10) << "mode" << std::setw(10) << "used" << std::setw(10) << "cpu ms"
+				<< std::setw(10) << "gpu ms" << std::setw(14) << "allocated MB" << "committed MB" << std::endl;
+		}
+		std::cout << std::left << std::fixed << std::setprecision(3)
+			<< std::setw(10) << antiAliasingModeName(static_cast<AntiAliasingMode>(benchmark.mode))
+			<< std::setw(10) << antiAliasingModeName(antiAliasing.mode())
+			<< std::setw(10) << benchmark.cpuMilliseconds / benchmark.framesPerMode;
+		if (benchmark.gpuFrames > 0) {
+			std::cout << std::setw(10) << benchmark.gpuMilliseconds / benchmark.gpuFrames;
+		}
+		else {
+			std::cout << std::setw(10) << "n/a";
+		}
+		std::cout << std::setw(14) << allocated / MEGABYTE << committed / MEGABYTE << std::endl;
+
+		uint8_t next = benchmark.mode + 1;
+		if (next == static_cast<uint8_t>(AntiAliasingMode::Count)) {
+			return false;
+		}
+		uint32_t framesPerMode = benchmark.framesPerMode;
+		benchmark = {};
+		benchmark.framesPerMode = framesPerMode;
+		benchmark.mode = next;
+		applyAntiAliasing(static_cast<AntiAliasingMode>(next));
+		return true;
+	}
+	//-----------------------------------------------------------------------------------------------
 	void HelloTriangleApplication::drawFrame()
 	{
-		vkWaitForFences(device, 1, &inFlightFences[currentFrame], VK_TRUE, UINT64_MAX);
+		//only blocks for the frame that last used this slot's command buffer and uniform buffer
+		frameScheduler.beginFrame(currentFrame);
+		deletionQueue.flush(frameScheduler.completedValue());
+		frameDescriptors[currentFrame].reset();
+		//pipelines rebuilt from edited shaders are swapped in between frames
+		for (const ShaderHotReload::ReloadedPipeline& reloaded : shaderHotReload.collect()) {
+			if (reloaded.name == FORWARD_PIPELINE) {
+				//every variant of the edited shaders is stale, the others are rebuilt from the new .spv when needed
+				uint64_t lastUse = frameScheduler.timeline().lastSubmitted();
+				for (const std::string& shader : { forwardKey.vertexShader, forwardKey.fragmentShader }) {
+					for (VkPipeline stale : pipelineStates.invalidateShader(shader)) {
+						deletionQueue.retire<VK_OBJECT_TYPE_PIPELINE>(stale, lastUse);
+					}
+				}
+				pipelineStates.insert(forwardKey, reloaded.pipeline);
+				graphicsPipeline = reloaded.pipeline;
+			}
+		}
+		double gpuMilliseconds = 0.0;
+		if (gpuTimer.collect(currentFrame, gpuMilliseconds) && benchmark.frame > ANTI_ALIASING_WARMUP_FRAMES) {
+			benchmark.gpuMilliseconds += gpuMilliseconds;
+			++benchmark.gpuFrames;
+		}
 		uint32_t imageIndex;
 		VkResult acquireImageResult = vkAcquireNextImageKHR(device, swapChain, UINT64_MAX, imageAvailableSemaphores[currentFrame], VK_NULL_HANDLE, &imageIndex);
 		if (acquireImageResult == VK_ERROR_OUT_OF_DATE_KHR) {
 			recreateSwapChain();
 			return;
 		}
-		vkResetFences(device, 1, &inFlightFences[currentFrame]);
+		//the matrices are needed while recording for the TAA reprojection
+		updateUniformBuffer(imageIndex);
 		vkResetCommandBuffer(commandBuffers[currentFrame], 0);
 		recordCommandBuffer(commandBuffers[currentFrame], imageIndex);
-		updateUniformBuffer(imageIndex);
-		VkSubmitInfo submitInfo{};
-		submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
-		VkSemaphore waitSemaphores[] = { imageAvailableSemaphores[currentFrame] };
-		VkPipelineStageFlags waitStages[] = { VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT };
-		submitInfo.waitSemaphoreCount = 1;
-		submitInfo.pWaitSemaphores = waitSemaphores;
-		submitInfo.pWaitDstStageMask = waitStages;
-		submitInfo.commandBufferCount = 1;
-		submitInfo.pCommandBuffers = &commandBuffers[currentFrame];
+		frameScheduler.addWait(imageAvailableSemaphores[currentFrame], 0, VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT);
+		frameScheduler.addSignal(renderFinishedSemaphores[currentFrame]);
+		frameScheduler.submit(&commandBuffers[currentFrame], 1);
+		antiAliasing.endFrame();
 		VkSemaphore signalSemaphores[] = { renderFinishedSemaphores[currentFrame] };
-		submitInfo.signalSemaphoreCount = 1;
-		submitInfo.pSignalSemaphores = signalSemaphores;
-		VkResult result = vkQueueSubmit(graphicsQueue, 1, &submitInfo, inFlightFences[currentFrame]);
-		ASSERT(result == VK_SUCCESS);
 		VkPresentInfoKHR presentInfo{};
 		presentInfo.sType = VK_STRUCTURE_TYPE_PRESENT_INFO_KHR;
 		presentInfo.waitSemaphoreCount = 1;
@@ -852,20 +1246,27 @@ namespace Clan
 	{
 		imageAvailableSemaphores.resize(MAX_FRAMES_IN_FLIGHT);
 		renderFinishedSemaphores.resize(MAX_FRAMES_IN_FLIGHT);
-		inFlightFences.resize(MAX_FRAMES_IN_FLIGHT);
+		//binary semaphores are still required by the swapchain, frame pacing lives in frameScheduler
 		VkSemaphoreCreateInfo semaphoreInfo{};
 		semaphoreInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
-		VkFenceCreateInfo fenceInfo{};
-		fenceInfo.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
-		fenceInfo.flags = VK_FENCE_CREATE_SIGNALED_BIT;
 		for (uint32_t i = 0; i < MAX_FRAMES_IN_FLIGHT; ++i) {
-			VkResult result1 = vkCreateSemaphore(device, &semaphoreInfo, nullptr, &imageAvailableSemaphores[i]);
-			VkResult result2 = vkCreateSemaphore(device, &semaphoreInfo, nullptr, &renderFinishedSemaphores[i]);
-			VkResult result3 = vkCreateFence(device, &fenceInfo, nullptr, &inFlightFences[i]);
-			ASSERT(result1 == VK_SUCCESS && result2 == VK_SUCCESS && result3 == VK_SUCCESS);
+			VkResult result1 = vkCreateSemaphore(device, &semaphoreInfo, vulkanAllocator(), &imageAvailableSemaphores[i]);
+			VkResult result2 = vkCreateSemaphore(device, &semaphoreInfo, vulkanAllocator(), &renderFinishedSemaphores[i]);
+			ASSERT(result1 == VK_SUCCESS && result2 == VK_SUCCESS);
 		}
 	}
 	//-----------------------------------------------------------------------------------------------
+	void HelloTriangleApplication::startSimulation()
+	{
+		simulation.init(config.simulationRate, SimulationState{}, &HelloTriangleApplication::simulate);
+	}
+	//-----------------------------------------------------------------------------------------------
+	void HelloTriangleApplication::simulate(SimulationState& state, float stepSeconds)
+	{
+		glm::quat spin = glm::angleAxis(stepSeconds * glm::radians(90.0f), glm::vec3(0.0f, 0.0f, 1.0f));
+		state.modelRotation = glm::normalize(spin * state.modelRotation);
+	}
+	//-----------------------------------------------------------------------------------------------
 	void HelloTriangleApplication::recreateSwapChain()
 	{
 		int width = 0, height = 0;
@@ -875,31 +1276,58 @@ namespace Clan
 			glfwWaitEvents();
 		}
 
-		vkDeviceWaitIdle(device);
+		//old resources are retired to the deletion queue, no need to idle the device
+		VkFormat oldFormat = swapChainImageFormat;
 		cleanupSwapChain();
 		createSwapChain();
 		createImageViews();
+		createColorResources();
 		createDepthResources();
-		createRenderPass();
-		createGraphicsPipeline();
+		//viewport and scissor are dynamic, the pipeline and render pass only depend on the format
+		if (swapChainImageFormat != oldFormat) {
+			shaderHotReload.suspend();
+			uint64_t lastUse = frameScheduler.timeline().lastSubmitted();
+			deletionQueue.retire<VK_OBJECT_TYPE_RENDER_PASS>(renderPass, lastUse);
+			createRenderPass();
+			createGraphicsPipeline();
+			shaderHotReload.resume();
+		}
 		createFramebuffers();
 	}
 	//-----------------------------------------------------------------------------------------------
 	void HelloTriangleApplication::cleanupSwapChain()
 	{
-		vkDestroyImageView(device, depthImageView, nullptr);
-		vkDestroyImage(device, depthImage, nullptr);
-		vkFreeMemory(device, depthImageMemory, nullptr);
-		for (auto& framebuffer : swapChainFramebuffers) {
-			vkDestroyFramebuffer(device, framebuffer, nullptr);
-		}
-		vkDestroyRenderPass(device, renderPass, nullptr);
-		vkDestroyPipelineLayout(device, pipelineLayout, nullptr);
-		vkDestroyPipeline(device, graphicsPipeline, nullptr);
+		//everything is freed once the GPU finished the last submitted frame, the swapchain
+		//itself is retired by createSwapChain when it is handed over as oldSwapchain
+		cleanupAttachments();
+		uint64_t lastUse = frameScheduler.timeline().lastSubmitted();
 		for (auto& imageView : swapChainImageViews) {
-			vkDestroyImageView(device, imageView, nullptr);
+			deletionQueue.retire<VK_OBJECT_TYPE_IMAGE_VIEW>(imageView, lastUse);
+		}
+	}
+	//-----------------------------------------------------------------------------------------------
+	void HelloTriangleApplication::cleanupAttachments()
+	{
+		uint64_t lastUse = frameScheduler.timeline().lastSubmitted();
+		if (depthImage != VK_NULL_HANDLE) {
+			deletionQueue.retire<VK_OBJECT_TYPE_IMAGE_VIEW>(depthImageView, lastUse);
+			deletionQueue.retireImage(depthImage, depthImageMemory, lastUse);
+			depthImage = VK_NULL_HANDLE;
+			depthImageView = VK_NULL_HANDLE;
+			depthImageMemory = VK_NULL_HANDLE;
 		}
-		vkDestroySwapchainKHR(device, swapChain, nullptr);
+		if (colorImage != VK_NULL_HANDLE) {
+			deletionQueue.retire<VK_OBJECT_TYPE_IMAGE_VIEW>(colorImageView, lastUse);
+			deletionQueue.retireImage(colorImage, colorImageMemory, lastUse);
+			colorImage = VK_NULL_HANDLE;
+			colorImageView = VK_NULL_HANDLE;
+			colorImageMemory = VK_NULL_HANDLE;
+		}
+		for (auto& framebuffer : swapChainFramebuffers) {
+			deletionQueue.retire<VK_OBJECT_TYPE_FRAMEBUFFER>(framebuffer, lastUse);
+		}
+		swapChainFramebuffers.clear();
+		attachmentMemoryBytes = 0;
 	}
 	//-----------------------------------------------------------------------------------------------
 	void HelloTriangleApplication::createBuffer(VkDeviceSize size, VkBufferUsageFlags usage, VkMemoryPropertyFlags properties, VkBuffer& buffer, VkDeviceMemory& bufferMemory)
@@ -909,7 +1337,7 @@ namespace Clan
 		bufferInfo.size = size;
 		bufferInfo.usage = usage;
 		bufferInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
-		VkResult result1 = vkCreateBuffer(device, &bufferInfo, nullptr, &buffer);
+		VkResult result1 = vkCreateBuffer(device, &bufferInfo, vulkanAllocator(), &buffer);
 		ASSERT(result1 == VK_SUCCESS);
 
 		VkMemoryRequirements memRequirements;
@@ -918,29 +1346,64 @@ namespace Clan
 		allocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
 		allocInfo.allocationSize = memRequirements.size;
 		allocInfo.memoryTypeIndex = findMemoryType(memRequirements.memoryTypeBits, properties);
-		VkResult result2 = vkAllocateMemory(device, &allocInfo, nullptr, &bufferMemory);
+		VkResult result2 = allocateDeviceMemory(device, &allocInfo, &bufferMemory);
 		ASSERT(result2 == VK_SUCCESS);
 
 		vkBindBufferMemory(device, buffer, bufferMemory, 0);
 	}
 	//-----------------------------------------------------------------------------------------------
-	void HelloTriangleApplication::createVertIDBuffer()
+	void HelloTriangleApplication::createGeometryArena()
 	{
-		VkDeviceSize vertexBufferSize = sizeof(vertices[0]) * vertices.size();
-		VkDeviceSize indexBufferSize = sizeof(indices[0]) * indices.size();
-		VkDeviceSize bufferSize = vertexBufferSize + indexBufferSize;
+		//every mesh is aligned to the vertex stride and the index size, that's at most one stride and 4 bytes of padding
+		VkDeviceSize requiredBytes = sizeof(vertices[0]) * vertices.size() + sizeof(uint32_t) * indices.size() +
+			meshes.size() * (Policy::VERTEX_STRIDE + sizeof(uint32_t));
+		geometryArena.init(device, physicalDevice, std::max(GEOMETRY_ARENA_BYTES, requiredBytes), Policy::VERTEX_STRIDE);
+		for (Mesh& mesh : meshes) {
+			bool placed = geometryArena.add(&vertices[mesh.firstVertex], mesh.vertexCount, &indices[mesh.firstIndex], mesh.indexCount, mesh.geometry);
+			ASSERT(placed);
+		}
+		VkDeviceSize bufferSize = geometryArena.pendingSize();
+		if (bufferSize == 0) return;
 		VkBuffer stagingBuffer;
 		VkDeviceMemory stagingMemory;
 		createBuffer(bufferSize, VK_BUFFER_USAGE_TRANSFER_SRC_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, stagingBuffer, stagingMemory);
 		void* data;
 		vkMapMemory(device, stagingMemory, 0, bufferSize, 0, &data);
-		memcpy(data, vertices.data(), vertexBufferSize);
-		memcpy(reinterpret_cast<uint8_t*>(data) + vertexBufferSize, indices.data(), indexBufferSize);
+		VkCommandBuffer commandBuffer = beginSingleTimeCommands();
+		geometryArena.recordUpload(commandBuffer, stagingBuffer, data);
+		endSingleTimeCommands(commandBuffer);
 		vkUnmapMemory(device, stagingMemory);
-		createBuffer(bufferSize, VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_INDEX_BUFFER_BIT | VK_BUFFER_USAGE_VERTEX_BUFFER_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, VertIDBuffer, VertIDBufferMemory);
-		copyBuffer(stagingBuffer, VertIDBuffer, bufferSize);
-		vkDestroyBuffer(device, stagingBuffer, nullptr);
-		vkFreeMemory(device, stagingMemory, nullptr);
+		vkDestroyBuffer(device, stagingBuffer, vulkanAllocator());
+		freeDeviceMemory(device, stagingMemory);
+		std::cout << meshes.size() << " meshes in " << geometryArena.usedBytes() / 1024 << " KB of geometry, 16 bit indices saved "
+			<< geometryArena.savedIndexBytes() / 1024 << " KB" << std::endl;
+	}
+	//-----------------------------------------------------------------------------------------------
+	void HelloTriangleApplication::createDrawCommandBuffers()
+	{
+		//submeshes are sorted by index type and material, so the commands of a multi-draw are adjacent.
+		//The first instance is the mesh's node, gl_InstanceIndex indexes the object buffer with it.
+		std::vector<VkDrawIndexedIndirectCommand> commands(submeshes.size());
+		for (size_t i = 0; i < submeshes.size(); ++i) {
+			const Mesh& mesh = meshes[submeshes[i].mesh];
+			commands[i].indexCount = submeshes[i].indexCount;
+			commands[i].instanceCount = 0;
+			commands[i].firstIndex = mesh.geometry.firstIndex + submeshes[i].firstIndex;
+			commands[i].vertexOffset = mesh.geometry.vertexOffset;
+			commands[i].firstInstance = mesh.node;
+		}
+		//written every frame, so they stay mapped
+		drawCommandBuffers.resize(MAX_FRAMES_IN_FLIGHT);
+		drawCommandBuffersMemory.resize(MAX_FRAMES_IN_FLIGHT);
+		drawCommandsMapped.resize(MAX_FRAMES_IN_FLIGHT);
+		VkDeviceSize bufferSize = sizeof(VkDrawIndexedIndirectCommand) * std::max<size_t>(commands.size(), 1);
+		for (uint32_t i = 0; i < MAX_FRAMES_IN_FLIGHT; ++i) {
+			createBuffer(bufferSize, VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, drawCommandBuffers[i], drawCommandBuffersMemory[i]);
+			void* data;
+			vkMapMemory(device, drawCommandBuffersMemory[i], 0, bufferSize, 0, &data);
+			memcpy(data, commands.data(), sizeof(VkDrawIndexedIndirectCommand) * commands.size());
+			drawCommandsMapped[i] = static_cast<VkDrawIndexedIndirectCommand*>(data);
+		}
 	}
 	//-----------------------------------------------------------------------------------------------
 	uint32_t HelloTriangleApplication::findMemoryType(uint32_t typeFilter, VkMemoryPropertyFlags properties)
@@ -969,28 +1432,19 @@ namespace Clan
 	//-----------------------------------------------------------------------------------------------
 	void HelloTriangleApplication::createDescriptorSetLayout()
 	{
-		VkDescriptorSetLayoutBinding uboLayoutBinding{};
-		uboLayoutBinding.binding = 0;
-		uboLayoutBinding.descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
-		uboLayoutBinding.descriptorCount = 1;
-		uboLayoutBinding.stageFlags = VK_SHADER_STAGE_VERTEX_BIT;
-		uboLayoutBinding.pImmutableSamplers = nullptr;
-		VkDescriptorSetLayoutBinding samplerLayoutBingding{};
-		samplerLayoutBingding.binding = 1;
-		samplerLayoutBingding.descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
-		samplerLayoutBingding.descriptorCount = 1;
-		samplerLayoutBingding.stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT;
-		samplerLayoutBingding.pImmutableSamplers = nullptr;
-		std::array<VkDescriptorSetLayoutBinding, 2> bindings = {
-			uboLayoutBinding,
-			samplerLayoutBingding,
-		};
-		VkDescriptorSetLayoutCreateInfo layoutInfo{};
-		layoutInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
-		layoutInfo.bindingCount = static_cast<uint32_t>(bindings.size());
-		layoutInfo.pBindings = bindings.data();
-		VkResult result = vkCreateDescriptorSetLayout(device, &layoutInfo, nullptr, &descriptorSetLayout);
-		ASSERT(result == VK_SUCCESS);
+		//bindings, push constants and vertex inputs are read from the shaders instead of being repeated here
+		ShaderReflection fragmentReflection{};
+		bool parsed = forwardReflection.parse(readBinaryFile("shaders/base_vertex.spv"))
+			&& fragmentReflection.parse(readBinaryFile("shaders/base_fragment.spv"));
+		ASSERT(parsed);
+		forwardReflection.merge(fragmentReflection);
+		std::vector<VkDescriptorSetLayout> setLayouts;
+		pipelineLayout = layoutCache.pipelineLayout(forwardReflection, &setLayouts);
+		ASSERT(setLayouts.size() == 1);
+		descriptorSetLayout = setLayouts[0];
+		std::vector<VkPushConstantRange> pushConstantRanges = forwardReflection.pushConstantRanges();
+		ASSERT(pushConstantRanges.size() == 1 && pushConstantRanges[0].size >= sizeof(DrawConstants));
+		drawConstantStages = pushConstantRanges[0].stageFlags;
 	}
 	//-----------------------------------------------------------------------------------------------f
 	void HelloTriangleApplication::createUniformBuffers()
@@ -1001,19 +1455,64 @@ namespace Clan
 		for (uint32_t i = 0; i < MAX_FRAMES_IN_FLIGHT; ++i) {
 			createBuffer(bufferSize, VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, uniformBuffers[i], uniformBuffersMemory[i]);
 		}
+		//written every frame, so they stay mapped
+		objectBuffers.resize(MAX_FRAMES_IN_FLIGHT);
+		objectBuffersMemory.resize(MAX_FRAMES_IN_FLIGHT);
+		objectBuffersMapped.resize(MAX_FRAMES_IN_FLIGHT);
+		objectBuffersVersion.assign(MAX_FRAMES_IN_FLIGHT, 0);
+		//node handles index them, every node exists once the scene is created
+		VkDeviceSize objectBufferSize = sizeof(glm::mat4) * scene.nodeCount();
+		for (uint32_t i = 0; i < MAX_FRAMES_IN_FLIGHT; ++i) {
+			createBuffer(objectBufferSize, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, objectBuffers[i], objectBuffersMemory[i]);
+			void* data;
+			vkMapMemory(device, objectBuffersMemory[i], 0, objectBufferSize, 0, &data);
+			objectBuffersMapped[i] = static_cast<glm::mat4*>(data);
+		}
 	}
 	//-----------------------------------------------------------------------------------------------
 	void HelloTriangleApplication::updateUniformBuffer(uint32_t imageIndex)
 	{
-		static auto startTime = std::chrono::high_resolution_clock::now();
-		auto currentTime = std::chrono::high_resolution_clock::now();
-		auto timeSpan = duration_cast<std::chrono::duration<float>>(currentTime - startTime);
-		float time = timeSpan.count();
+		//the simulation thread never holds this up, the state is interpolated from its last two steps
+		SimulationState state = simulation.sample(Simulation::Clock::now());
 		UniformBufferObject ubo{};
-		ubo.model = glm::rotate(glm::mat4(1.0f), time * glm::radians(90.0f), glm::vec3(0.0f, 0.0f, 1.0f));
+		scene.setRotation(modelNode, state.modelRotation);
+		renderCommands.consume(SceneCommandApplier{ scene });
+		scene.update();
+		//the buffer of this frame only misses what changed since it was last in use
+		scene.copyChanged(objectBuffersMapped[currentFrame], objectBuffersVersion[currentFrame]);
+		if (scene.copyChanged(objectWorld.data(), objectWorldVersion) > 0) {
+			transformKernels().transformBounds(objectWorld.data() + modelNode + 1, objectLocalBounds, objectWorldBounds, 0, meshes.size());
+			sceneBvh.refit(objectWorldBounds);
+		}
+		const glm::mat4& model = scene.worldMatrix(modelNode);
 		ubo.view = glm::lookAt(glm::vec3(2.0f, 2.0f, 2.0f), glm::vec3(0.0f, 0.0f, 0.0f), glm::vec3(0.0f, 0.0f, 1.0f));
 		ubo.proj = glm::perspective(glm::radians(45.0f), swapChainExtent.width / (float)swapChainExtent.height, 0.1f, 10.0f);
 		ubo.proj[1][1] *= -1;
+		viewProjection = ubo.proj * ubo.view;
+		visibleObjects.clear();
+		sceneBvh.cullFrustum(Frustum::fromMatrix(viewProjection), visibleObjects);
+		std::fill(meshVisible.begin(), meshVisible.end(), static_cast<uint8_t>(0));
+		for (uint32_t object : visibleObjects) {
+			meshVisible[object] = 1;
+		}
+		//culled meshes keep their commands with no instance, so the batches stay one multi-draw each
+		VkDrawIndexedIndirectCommand* pCommands = drawCommandsMapped[currentFrame];
+		for (DrawBatch& batch : drawBatches) {
+			batch.visibleCount = 0;
+			for (uint32_t d = batch.firstDraw; d < batch.firstDraw + batch.drawCount; ++d) {
+				uint32_t visible = meshVisible[submeshes[d].mesh];
+				pCommands[d].instanceCount = visible;
+				batch.visibleCount += visible;
+			}
+		}
+		//the meshes only move with the model, so reprojecting with its full transform also follows their motion
+		glm::mat4 modelViewProjection = ubo.proj * ubo.view * model;
+		reprojection = previousModelViewProjection * glm::inverse(modelViewProjection);
+		previousModelViewProjection = modelViewProjection;
+		//offset the whole image by the TAA jitter in NDC, clip w is -z_view
+		glm::vec2 jitter = antiAliasing.jitter(swapChainExtent);
+		ubo.proj[2][0] -= jitter.x;
+		ubo.proj[2][1] -= jitter.y;
 		void* data;
 		vkMapMemory(device, uniformBuffersMemory[currentFrame], 0, sizeof(ubo), 0, &data);
 		memcpy(data, &ubo, sizeof(ubo));
@@ -1022,85 +1521,112 @@ namespace Clan
 	//-----------------------------------------------------------------------------------------------
 	void HelloTriangleApplication::createDescriptorPool()
 	{
-		std::array<VkDescriptorPoolSize,2> poolSizes{};
-		poolSizes[0].type = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
-		poolSizes[0].descriptorCount = MAX_FRAMES_IN_FLIGHT;
-		poolSizes[1].type = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
-		poolSizes[1].descriptorCount = MAX_FRAMES_IN_FLIGHT;
-		VkDescriptorPoolCreateInfo poolInfo{};
-		poolInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
-		poolInfo.poolSizeCount = static_cast<uint32_t>(poolSizes.size());
-		poolInfo.pPoolSizes = poolSizes.data();
-		poolInfo.maxSets = MAX_FRAMES_IN_FLIGHT;
-		VkResult result = vkCreateDescriptorPool(device, &poolInfo, nullptr, &descriptorPool);
-		ASSERT(result == VK_SUCCESS);
+		uint32_t setCount = MAX_FRAMES_IN_FLIGHT * static_cast<uint32_t>(materials.size());
+		descriptorAllocator.init(device, setCount, forwardReflection.poolSizes(1));
+		//a frame needs at most the two post-process sets, the pools grow if that changes
+		for (DescriptorAllocator& allocator : frameDescriptors) {
+			allocator.init(device, 2, AntiAliasing::descriptorSizes());
+		}
 	}
 	//-----------------------------------------------------------------------------------------------
 	void HelloTriangleApplication::createDescriptorSets()
 	{
-		descriptorSets.resize(MAX_FRAMES_IN_FLIGHT);
-		std::vector<VkDescriptorSetLayout> layouts(MAX_FRAMES_IN_FLIGHT, descriptorSetLayout);
-		VkDescriptorSetAllocateInfo allocInfo{};
-		allocInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
-		allocInfo.descriptorPool = descriptorPool;
-		allocInfo.descriptorSetCount = MAX_FRAMES_IN_FLIGHT;
-		allocInfo.pSetLayouts = layouts.data();
-		VkResult result = vkAllocateDescriptorSets(device, &allocInfo, descriptorSets.data());
-		ASSERT(result == VK_SUCCESS);
-		for (uint32_t i = 0; i < MAX_FRAMES_IN_FLIGHT; ++i) {
-			VkDescriptorBufferInfo bufferInfo{};
-			bufferInfo.buffer = uniformBuffers[i];
-			bufferInfo.offset = 0;
-			bufferInfo.range = sizeof(UniformBufferObject);
-			VkDescriptorImageInfo imageInfo{};
-			imageInfo.imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
-			imageInfo.imageView = textureImageView;
-			imageInfo.sampler = textureSampler;
-			std::array<VkWriteDescriptorSet, 2> descriptorWrites{};
-			descriptorWrites[0].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
-			descriptorWrites[0].dstSet = descriptorSets[i];
-			descriptorWrites[0].dstBinding = 0;
-			descriptorWrites[0].dstArrayElement = 0;
-			descriptorWrites[0].descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
-			descriptorWrites[0].descriptorCount = 1;
-			descriptorWrites[0].pBufferInfo = &bufferInfo;
-			descriptorWrites[0].pImageInfo = nullptr;
-			descriptorWrites[0].pTexelBufferView = nullptr;
-			descriptorWrites[1].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
-			descriptorWrites[1].dstSet = descriptorSets[i];
-			descriptorWrites[1].dstBinding = 1;
-			descriptorWrites[1].dstArrayElement = 0;
-			descriptorWrites[1].descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
-			descriptorWrites[1].descriptorCount = 1;
-			descriptorWrites[1].pImageInfo = &imageInfo;
-			vkUpdateDescriptorSets(device, static_cast<uint32_t>(descriptorWrites.size()), descriptorWrites.data(), 0, nullptr);
+		uint32_t setCount = MAX_FRAMES_IN_FLIGHT * static_cast<uint32_t>(materials.size());
+		descriptorSets.resize(setCount);
+		//the shaders' variable names give the binding of each resource
+		const ReflectedBinding* pUboBinding = forwardReflection.findBinding("ubo");
+		const ReflectedBinding* pSamplerBinding = forwardReflection.findBinding("texSampler");
+		const ReflectedBinding* pObjectsBinding = forwardReflection.findBinding("objects");
+		ASSERT(pUboBinding && pSamplerBinding && pObjectsBinding);
+		for (uint32_t set = 0; set < setCount; ++set) {
+			uint32_t i = set / static_cast<uint32_t>(materials.size());
+			const Material& material = materials[set % materials.size()];
+			DescriptorWriter writer;
+			writer.buffer(pUboBinding->binding, pUboBinding->type, uniformBuffers[i], 0, sizeof(UniformBufferObject));
+			writer.image(pSamplerBinding->binding, pSamplerBinding->type, textures[material.texture].view, material.sampler,
+				VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
+			writer.buffer(pObjectsBinding->binding, pObjectsBinding->type, objectBuffers[i], 0, VK_WHOLE_SIZE);
+			//materials sharing a texture share their sets
+			descriptorSets[set] = descriptorAllocator.get(descriptorSetLayout, writer);
 		}
 	}
 	//-----------------------------------------------------------------------------------------------
 	void HelloTriangleApplication::createTextureImage()
 	{
-		int texWidth{ 0 }, texHeight{ 0 }, texChannels{ 0 };
-		stbi_uc* pixels = stbi_load(TEXTURE_PATH, &texWidth, &texHeight, &texChannels, STBI_rgb_alpha);
-		VkDeviceSize imageSize = texWidth * texHeight * 4;
-		ASSERT(pixels != nullptr);
+		//all textures share one staging buffer, the workers write into its mapping and every texture
+		//is uploaded on the transfer queue as soon as it's decoded. Its mips are then generated on
+		//the compute queue, which hands the texture to graphics.
+		MipGenerator mipGenerator;
+		std::string mipShaderPath = std::string(SHADER_DIRECTORY) + "/mipmap_compute.spv";
+		if (assetArchive.contains(mipShaderPath) || std::ifstream(mipShaderPath).good()) {
+			mipGenerator.init(device, readBinaryFile(mipShaderPath));
+		}
+		else {
+			std::cerr << mipShaderPath << " is missing, textures have no mips" << std::endl;
+			mipGenerator.init(device, {});
+		}
+		TextureBatch batch;
+		batch.open(textureRegistry.paths(), workerPool, &assetArchive);
+		VkDeviceSize stagingSize = std::max<VkDeviceSize>(batch.stagingSize(), 4);
 		VkBuffer stagingBuffer;
 		VkDeviceMemory stagingMemory;
-		createBuffer(imageSize, VK_BUFFER_USAGE_TRANSFER_SRC_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, stagingBuffer, stagingMemory);
+		createBuffer(stagingSize, VK_BUFFER_USAGE_TRANSFER_SRC_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, stagingBuffer, stagingMemory);
 		void* data;
-		vkMapMemory(device, stagingMemory, 0, imageSize, 0, &data);
-		memcpy(data, pixels, static_cast<size_t>(imageSize));
+		vkMapMemory(device, stagingMemory, 0, stagingSize, 0, &data);
+		uint64_t uploaded = 0;
+		uint64_t generated = 0;
+		//textures with the same contents as an earlier one keep a null image, their materials use the first
+		textureRegistry.merge(batch);
+		for (Material& material : materials) {
+			material.texture = textureRegistry.resolve(material.texture);
+		}
+		TextureLoadStats stats = batch.decode(workerPool, data, [&](size_t i) {
+			Texture& texture = textures[i];
+			const TextureRegion& region = batch.region(i);
+			texture.mipLevels = mipGenerator.isAvailable() ? MipGenerator::mipLevels(region.width, region.height) : 1;
+			bool generateMips = texture.mipLevels > 1;
+			//the mips are written through UNORM storage views of the sRGB image
+			VkImageUsageFlags usage = VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_SAMPLED_BIT | (generateMips ? VK_IMAGE_USAGE_STORAGE_BIT : 0);
+			VkImageCreateFlags flags = generateMips ? VK_IMAGE_CREATE_MUTABLE_FORMAT_BIT | VK_IMAGE_CREATE_EXTENDED_USAGE_BIT : 0;
+			createImage(region.width, region.height, VK_SAMPLE_COUNT_1_BIT, VK_FORMAT_R8G8B8A8_SRGB, VK_IMAGE_TILING_OPTIMAL, usage, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, texture.image, texture.memory, texture.mipLevels, flags);
+			auto upload = [&](VkCommandBuffer commandBuffer) {
+				recordTextureUpload(commandBuffer, stagingBuffer, texture.image, region.width, region.height, region.offset);
+			};
+			if (!generateMips) {
+				uploaded = asyncTransfer.submit(upload, {}, { ImageHandoff{ texture.image } });
+				return;
+			}
+			//level 0 goes to the compute queue, which waits for the copy and samples it for level 1
+			ImageHandoff level0{ texture.image, { VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1 }, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
+				VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_ACCESS_SHADER_READ_BIT };
+			uploaded = asyncTransfer.submitTo(asyncCompute, upload, {}, { level0 });
+			generated = asyncCompute.submit([&](VkCommandBuffer commandBuffer) {
+				mipGenerator.record(commandBuffer, texture.image, region.width, region.height, texture.mipLevels);
+			}, {}, { ImageHandoff{ texture.image } });
+		});
 		vkUnmapMemory(device, stagingMemory);
-		stbi_image_free(pixels);
-		createImage(texWidth, texHeight, VK_FORMAT_R8G8B8A8_SRGB, VK_IMAGE_TILING_OPTIMAL, VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_SAMPLED_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, textureImage, textureImageMemory);
-		transitionImageLayout(textureImage, VK_FORMAT_R8G8B8_SRGB, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL);
-		copyBufferToImage(stagingBuffer, textureImage, static_cast<uint32_t>(texWidth), static_cast<uint32_t>(texHeight));
-		transitionImageLayout(textureImage, VK_FORMAT_R8G8B8_SRGB, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
-		vkDestroyBuffer(device, stagingBuffer, nullptr);
-		vkFreeMemory(device, stagingMemory, nullptr);
-
+		if (stats.failedCount > 0) {
+			std::cerr << "failed to load " << stats.failedCount << " textures" << std::endl;
+		}
+		std::cout << "decoded " << stats.textureCount << " textures on " << workerPool.threadCount() << " threads in " << stats.milliseconds << " ms ("
+			<< stats.fileMegabytesPerSecond() << " MB/s read, " << stats.decodedMegabytesPerSecond() << " MB/s decoded)" << std::endl;
+		if (stats.duplicateCount > 0) {
+			std::cout << stats.duplicateCount << " textures were duplicates of others" << std::endl;
+		}
+		if (stats.copiedCount > 0) {
+			std::cout << stats.copiedCount << " textures were converted by stb and copied into the staging buffer" << std::endl;
+		}
+		batch.close();
+		//the first frame acquires the images, the staging buffer only has to outlive the copies
+		asyncTransfer.timeline().wait(uploaded);
+		vkDestroyBuffer(device, stagingBuffer, vulkanAllocator());
+		freeDeviceMemory(device, stagingMemory);
+		//the views and descriptor sets of the mip passes have to outlive them
+		asyncCompute.timeline().wait(generated);
+		mipGenerator.destroy();
 	}
 	//-----------------------------------------------------------------------------------------------
-	void HelloTriangleApplication::createImage(uint32_t width, uint32_t height, VkFormat format, VkImageTiling tiling, VkImageUsageFlags usage, VkMemoryPropertyFlags properties, VkImage& image, VkDeviceMemory& imageMemory)
+	void HelloTriangleApplication::createImage(uint32_t width, uint32_t height, VkSampleCountFlagBits numSamples, VkFormat format, VkImageTiling tiling, VkImageUsageFlags usage, VkMemoryPropertyFlags properties, VkImage& image, VkDeviceMemory& imageMemory, uint32_t mipLevels, VkImageCreateFlags flags)
 	{
 		VkImageCreateInfo imageInfo{};
 		imageInfo.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
@@ -1108,16 +1634,16 @@ namespace Clan
 		imageInfo.extent.width = width;
 		imageInfo.extent.height = height;
 		imageInfo.extent.depth = 1;
-		imageInfo.mipLevels = 1;
+		imageInfo.mipLevels = mipLevels;
 		imageInfo.arrayLayers = 1;
 		imageInfo.format = format;
 		imageInfo.tiling = tiling;
 		imageInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
 		imageInfo.usage = usage;
 		imageInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
-		imageInfo.samples = VK_SAMPLE_COUNT_1_BIT;
-		imageInfo.flags = 0;
-		VkResult result1 = vkCreateImage(device, &imageInfo, nullptr, &image);
+		imageInfo.samples = numSamples;
+		imageInfo.flags = flags;
+		VkResult result1 = vkCreateImage(device, &imageInfo, vulkanAllocator(), &image);
 		ASSERT(result1 == VK_SUCCESS);
 		VkMemoryRequirements memRequirements{};
 		vkGetImageMemoryRequirements(device, image, &memRequirements);
@@ -1125,7 +1651,7 @@ namespace Clan
 		alloInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
 		alloInfo.allocationSize = memRequirements.size;
 		alloInfo.memoryTypeIndex = findMemoryType(memRequirements.memoryTypeBits, properties);
-		VkResult result2 = vkAllocateMemory(device, &alloInfo, nullptr, &imageMemory);
+		VkResult result2 = allocateDeviceMemory(device, &alloInfo, &imageMemory);
 		ASSERT(result2 == VK_SUCCESS);
 		vkBindImageMemory(device, image, imageMemory, 0);
 	}
@@ -1149,59 +1675,63 @@ namespace Clan
 	void HelloTriangleApplication::endSingleTimeCommands(VkCommandBuffer commandBuffer)
 	{
 		vkEndCommandBuffer(commandBuffer);
-		VkSubmitInfo submitInfo{};
-		submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
-		submitInfo.commandBufferCount = 1;
-		submitInfo.pCommandBuffers = &commandBuffer;
-		vkQueueSubmit(graphicsQueue, 1, &submitInfo, VK_NULL_HANDLE);
-		vkQueueWaitIdle(graphicsQueue);
+		//waits for this submission only, not for every frame queued on the graphics queue
+		Timeline& timeline = frameScheduler.timeline();
+		timeline.wait(timeline.submit(&commandBuffer, 1));
 		vkFreeCommandBuffers(device, commandPool, 1, &commandBuffer);
 	}
 	//-----------------------------------------------------------------------------------------------
 	void HelloTriangleApplication::transitionImageLayout(VkImage image, VkFormat format, VkImageLayout oldLayout, VkImageLayout newLayout)
 	{
 		VkCommandBuffer commandBuffer = beginSingleTimeCommands();
-		VkImageMemoryBarrier barrier{};
-		barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+		//any pair of layouts, the scopes come from the same table the render graph uses
+		ImageState src = imageStateForLayout(oldLayout);
+		ImageState dst = imageStateForLayout(newLayout);
+		VkImageMemoryBarrier2 barrier{};
+		barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER_2;
+		barrier.srcStageMask = src.stage;
+		barrier.srcAccessMask = src.access;
+		barrier.dstStageMask = dst.stage;
+		barrier.dstAccessMask = dst.access;
 		barrier.oldLayout = oldLayout;
 		barrier.newLayout = newLayout;
 		barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
 		barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
 		barrier.image = image;
-		barrier.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+		barrier.subresourceRange.aspectMask = aspectForFormat(format);
 		barrier.subresourceRange.baseMipLevel = 0;
 		barrier.subresourceRange.levelCount = 1;
 		barrier.subresourceRange.baseArrayLayer = 0;
 		barrier.subresourceRange.layerCount = 1;
-		VkPipelineStageFlags sourceStage;
-		VkPipelineStageFlags destinationStage;
-		if (oldLayout == VK_IMAGE_LAYOUT_UNDEFINED && newLayout == VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL) {
-			barrier.srcAccessMask = 0;
-			barrier.dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
-			sourceStage = VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT;
-			destinationStage = VK_PIPELINE_STAGE_TRANSFER_BIT;
-		} else if (oldLayout == VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL && newLayout == VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL) {
-			barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
-			barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
-			sourceStage = VK_PIPELINE_STAGE_TRANSFER_BIT;
-			destinationStage = VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT;
-		} else {
-			ASSERT(false);
-		}
-		vkCmdPipelineBarrier(commandBuffer,
-			sourceStage, destinationStage,
-			0,
-			0, nullptr,
-			0, nullptr,
-			1, &barrier);
+		VkDependencyInfo dependencyInfo{};
+		dependencyInfo.sType = VK_STRUCTURE_TYPE_DEPENDENCY_INFO;
+		dependencyInfo.imageMemoryBarrierCount = 1;
+		dependencyInfo.pImageMemoryBarriers = &barrier;
+		vkCmdPipelineBarrier2(commandBuffer, &dependencyInfo);
 		endSingleTimeCommands(commandBuffer);
 	}
 	//-----------------------------------------------------------------------------------------------
-	void HelloTriangleApplication::copyBufferToImage(VkBuffer buffer, VkImage image, uint32_t width, uint32_t height)
+	void HelloTriangleApplication::recordTextureUpload(VkCommandBuffer commandBuffer, VkBuffer buffer, VkImage image, uint32_t width, uint32_t height, VkDeviceSize bufferOffset)
 	{
-		VkCommandBuffer commandBuffer = beginSingleTimeCommands();
+		VkImageMemoryBarrier2 barrier{};
+		barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER_2;
+		barrier.srcStageMask = VK_PIPELINE_STAGE_2_NONE;
+		barrier.srcAccessMask = 0;
+		barrier.dstStageMask = VK_PIPELINE_STAGE_2_COPY_BIT;
+		barrier.dstAccessMask = VK_ACCESS_2_TRANSFER_WRITE_BIT;
+		barrier.oldLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+		barrier.newLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+		barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+		barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+		barrier.image = image;
+		barrier.subresourceRange = { VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1 };
+		VkDependencyInfo dependencyInfo{};
+		dependencyInfo.sType = VK_STRUCTURE_TYPE_DEPENDENCY_INFO;
+		dependencyInfo.imageMemoryBarrierCount = 1;
+		dependencyInfo.pImageMemoryBarriers = &barrier;
+		vkCmdPipelineBarrier2(commandBuffer, &dependencyInfo);
 		VkBufferImageCopy region{};
-		region.bufferOffset = 0;
+		region.bufferOffset = bufferOffset;
 		region.bufferRowLength = 0;
 		region.bufferImageHeight = 0;
 		region.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
@@ -1211,16 +1741,29 @@ namespace Clan
 		region.imageOffset = { 0,0,0 };
 		region.imageExtent = { width,height,1 };
 		vkCmdCopyBufferToImage(commandBuffer, buffer, image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &region);
-		endSingleTimeCommands(commandBuffer);
+		//chains into the release barrier of the async queue, the graphics queue acquires the image
+		barrier.srcStageMask = VK_PIPELINE_STAGE_2_COPY_BIT;
+		barrier.srcAccessMask = VK_ACCESS_2_TRANSFER_WRITE_BIT;
+		barrier.dstStageMask = VK_PIPELINE_STAGE_2_ALL_TRANSFER_BIT;
+		barrier.dstAccessMask = 0;
+		barrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+		barrier.newLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+		vkCmdPipelineBarrier2(commandBuffer, &dependencyInfo);
 	}
 	//-----------------------------------------------------------------------------------------------
 	void HelloTriangleApplication::createTextureImageView()
 	{
-		textureImageView = createImageView(textureImage, VK_FORMAT_R8G8B8A8_SRGB, VK_IMAGE_ASPECT_COLOR_BIT);
+		for (Texture& texture : textures) {
+			if (texture.image == VK_NULL_HANDLE) continue;
+			//the storage usage of the mip generation isn't supported by the sRGB format
+			texture.view = createImageView(texture.image, VK_FORMAT_R8G8B8A8_SRGB, VK_IMAGE_ASPECT_COLOR_BIT, texture.mipLevels, VK_IMAGE_USAGE_SAMPLED_BIT);
+		}
 	}
 	//-----------------------------------------------------------------------------------------------
 	void HelloTriangleApplication::createTextureSampler()
 	{
+		//one sampler per sampling state, not per material or texture
+		samplerCache.init(device, deviceProperties.limits.maxSamplerAllocationCount);
 		VkSamplerCreateInfo samplerInfo{};
 		samplerInfo.sType = VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO;
 		samplerInfo.magFilter = VK_FILTER_LINEAR;
@@ -1237,32 +1780,91 @@ namespace Clan
 		samplerInfo.mipmapMode = VK_SAMPLER_MIPMAP_MODE_LINEAR;
 		samplerInfo.mipLodBias = 0.0f;
 		samplerInfo.minLod = 0.0f;
-		samplerInfo.maxLod = 0.0f;
-		VkResult result = vkCreateSampler(device, &samplerInfo, nullptr, &textureSampler);
-		ASSERT(result == VK_SUCCESS);
+		samplerInfo.maxLod = VK_LOD_CLAMP_NONE;
+		for (Material& material : materials) {
+			VkSamplerAddressMode addressMode = material.clampToEdge ? VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE : VK_SAMPLER_ADDRESS_MODE_REPEAT;
+			samplerInfo.addressModeU = addressMode;
+			samplerInfo.addressModeV = addressMode;
+			samplerInfo.addressModeW = addressMode;
+			material.sampler = samplerCache.get(samplerInfo);
+		}
+	}
+	//-----------------------------------------------------------------------------------------------
+	void HelloTriangleApplication::createColorResources()
+	{
+		//with dynamic rendering the scene color is a render graph transient
+		if (useDynamicRendering) return;
+		VkSampleCountFlagBits samples = antiAliasing.samples();
+		if (samples == VK_SAMPLE_COUNT_1_BIT && !antiAliasing.isPostProcess()) return;
+		//multisampled color only lives in the render pass, the post-process input is sampled
+		VkFormat format = antiAliasing.sceneFormat(swapChainImageFormat);
+		if (antiAliasing.isPostProcess()) {
+			createImage(swapChainExtent.width, swapChainExtent.height, samples, format, VK_IMAGE_TILING_OPTIMAL,
+				VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_SAMPLED_BIT,
+				VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, colorImage, colorImageMemory);
+		}
+		else {
+			createImage(swapChainExtent.width, swapChainExtent.height, samples, format, VK_IMAGE_TILING_OPTIMAL,
+				VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_TRANSIENT_ATTACHMENT_BIT,
+				transientAttachmentMemory(), colorImage, colorImageMemory);
+		}
+		colorImageView = createImageView(colorImage, format, VK_IMAGE_ASPECT_COLOR_BIT);
+		VkMemoryRequirements requirements{};
+		vkGetImageMemoryRequirements(device, colorImage, &requirements);
+		attachmentMemoryBytes += requirements.size;
 	}
 	//-----------------------------------------------------------------------------------------------
 	void HelloTriangleApplication::createDepthResources()
 	{
-		createImage(swapChainExtent.width, swapChainExtent.height, VK_FORMAT_D32_SFLOAT, VK_IMAGE_TILING_OPTIMAL, VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, depthImage, depthImageMemory);
-		depthImageView = createImageView(depthImage, VK_FORMAT_D32_SFLOAT, VK_IMAGE_ASPECT_DEPTH_BIT);
-
+		//with dynamic rendering the depth buffer is a render graph transient
+		if (useDynamicRendering) return;
+		VkSampleCountFlagBits samples = antiAliasing.samples();
+		if (antiAliasing.readsDepth()) {
+			createImage(swapChainExtent.width, swapChainExtent.height, samples, DEPTH_FORMAT, VK_IMAGE_TILING_OPTIMAL,
+				VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT | VK_IMAGE_USAGE_SAMPLED_BIT,
+				VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, depthImage, depthImageMemory);
+		}
+		else {
+			createImage(swapChainExtent.width, swapChainExtent.height, samples, DEPTH_FORMAT, VK_IMAGE_TILING_OPTIMAL,
+				VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT | VK_IMAGE_USAGE_TRANSIENT_ATTACHMENT_BIT,
+				transientAttachmentMemory(), depthImage, depthImageMemory);
+		}
+		depthImageView = createImageView(depthImage, DEPTH_FORMAT, VK_IMAGE_ASPECT_DEPTH_BIT);
+		VkMemoryRequirements requirements{};
+		vkGetImageMemoryRequirements(device, depthImage, &requirements);
+		attachmentMemoryBytes += requirements.size;
+	}
+	//-----------------------------------------------------------------------------------------------
+	VkMemoryPropertyFlags HelloTriangleApplication::transientAttachmentMemory()
+	{
+		VkPhysicalDeviceMemoryProperties memProperties;
+		vkGetPhysicalDeviceMemoryProperties(physicalDevice, &memProperties);
+		for (uint32_t i = 0; i < memProperties.memoryTypeCount; i++) {
+			if (memProperties.memoryTypes[i].propertyFlags & VK_MEMORY_PROPERTY_LAZILY_ALLOCATED_BIT) {
+				return VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT | VK_MEMORY_PROPERTY_LAZILY_ALLOCATED_BIT;
+			}
+		}
+		return VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT;
 	}
 	//-----------------------------------------------------------------------------------------------
-	VkImageView HelloTriangleApplication::createImageView(VkImage image, VkFormat format, VkImageAspectFlags aspectFlags)
+	VkImageView HelloTriangleApplication::createImageView(VkImage image, VkFormat format, VkImageAspectFlags aspectFlags, uint32_t mipLevels, VkImageUsageFlags usage)
 	{
+		VkImageViewUsageCreateInfo usageInfo{};
+		usageInfo.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_USAGE_CREATE_INFO;
+		usageInfo.usage = usage;
 		VkImageViewCreateInfo viewInfo{};
 		viewInfo.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
+		viewInfo.pNext = usage != 0 ? &usageInfo : nullptr;
 		viewInfo.image = image;
 		viewInfo.viewType = VK_IMAGE_VIEW_TYPE_2D;
 		viewInfo.format = format;
 		viewInfo.subresourceRange.aspectMask = aspectFlags;
 		viewInfo.subresourceRange.baseMipLevel = 0;
-		viewInfo.subresourceRange.levelCount = 1;
+		viewInfo.subresourceRange.levelCount = mipLevels;
 		viewInfo.subresourceRange.baseArrayLayer = 0;
 		viewInfo.subresourceRange.layerCount = 1;
 		VkImageView imageView{};
-		VkResult result = vkCreateImageView(device, &viewInfo, nullptr, &imageView);
+		VkResult result = vkCreateImageView(device, &viewInfo, vulkanAllocator(), &imageView);
 		ASSERT(result == VK_SUCCESS);
 		return imageView;
 	}
@@ -1271,29 +1873,225 @@ namespace Clan
 	{
 		tinyobj::attrib_t attrib{};
 		std::vector<tinyobj::shape_t> shapes{};
-		std::vector<tinyobj::material_t> materials{};
+		std::vector<tinyobj::material_t> objMaterials{};
 		std::string warn, err;
-		bool result = tinyobj::LoadObj(&attrib, &shapes, &materials, &warn, &err, MODEL_PATH);
+		//map_Kd paths are relative to the model
+		std::filesystem::path directory = std::filesystem::path(config.modelPath).parent_path();
+		std::vector<char> storage;
+		AssetSpan source{};
+		if (assetArchive.contains(config.modelPath)) {
+			source = assetArchive.load(config.modelPath, storage);
+		}
+		else {
+			fileReader.wait();
+			source = AssetSpan{ reinterpret_cast<const uint8_t*>(modelFile.data()), modelFile.size() };
+		}
+		bool result = false;
+		if (source.data != nullptr && source.size > 0) {
+			AssetStream stream(source);
+			ArchiveMaterialReader materialReader(assetArchive, directory.string());
+			result = tinyobj::LoadObj(&attrib, &shapes, &objMaterials, &warn, &err, &stream, &materialReader);
+		}
+		else {
+			result = tinyobj::LoadObj(&attrib, &shapes, &objMaterials, &warn, &err, config.modelPath.c_str(), directory.string().c_str());
+		}
+		std::vector<char>().swap(modelFile);
 		ASSERT(result == true);
+		if (!warn.empty()) {
+			std::cerr << warn << std::endl;
+		}
+		auto findTexture = [&](const std::string& path) {
+			uint32_t index = textureRegistry.find(path);
+			if (index == textures.size()) {
+				textures.push_back(Texture{ path });
+			}
+			return index;
+		};
+		//textured materials leave the vertex color white, the others get a white texel and Kd
+		std::vector<glm::vec3> diffuseColors{};
+		for (const tinyobj::material_t& objMaterial : objMaterials) {
+			Material material{};
+			if (!objMaterial.diffuse_texname.empty()) {
+				material.texture = findTexture((directory / objMaterial.diffuse_texname).string());
+				material.clampToEdge = objMaterial.diffuse_texopt.clamp;
+				diffuseColors.emplace_back(1.0f);
+			}
+			else {
+				material.texture = findTexture("");
+				diffuseColors.emplace_back(objMaterial.diffuse[0], objMaterial.diffuse[1], objMaterial.diffuse[2]);
+			}
+			materials.push_back(material);
+		}
+		//faces without a material, and models without an MTL file, use the default texture
+		uint32_t defaultMaterial = ~0u;
+		auto faceMaterial = [&](int materialId) {
+			if (materialId >= 0 && materialId < static_cast<int>(materials.size())) return static_cast<uint32_t>(materialId);
+			if (defaultMaterial == ~0u) {
+				defaultMaterial = static_cast<uint32_t>(materials.size());
+				materials.push_back(Material{ .texture = findTexture(config.texturePath) });
+				diffuseColors.emplace_back(1.0f);
+			}
+			return defaultMaterial;
+		};
+		//every shape is a mesh of its own, small enough for 16 bit indices in most models, its indices
+		//are split by material. A shape with more vertices than the index type addresses is split into
+		//several meshes between faces.
+		struct ShapeRange {
+			uint32_t material{ 0 };
+			std::vector<uint32_t> indices{};
+		};
+		Mesh mesh{};
+		std::vector<ShapeRange> ranges{};
+		std::unordered_map<uint32_t, size_t> shapeRanges{};
+		auto beginMesh = [&]() {
+			mesh = Mesh{};
+			mesh.firstVertex = static_cast<uint32_t>(vertices.size());
+			mesh.firstIndex = static_cast<uint32_t>(indices.size());
+			ranges.clear();
+			shapeRanges.clear();
+			uniqueVertices.clear();
+		};
+		auto endMesh = [&]() {
+			if (ranges.empty()) return;
+			mesh.vertexCount = static_cast<uint32_t>(vertices.size()) - mesh.firstVertex;
+			for (const ShapeRange& range : ranges) {
+				uint32_t firstIndex = static_cast<uint32_t>(indices.size()) - mesh.firstIndex;
+				submeshes.push_back(Submesh{ static_cast<uint32_t>(meshes.size()), firstIndex, static_cast<uint32_t>(range.indices.size()), range.material });
+				indices.insert(indices.end(), range.indices.begin(), range.indices.end());
+			}
+			mesh.indexCount = static_cast<uint32_t>(indices.size()) - mesh.firstIndex;
+			meshes.push_back(mesh);
+		};
+		uint32_t splitShapes = 0;
 		for (const auto& shape : shapes) {
-			for (const auto& index : shape.mesh.indices) {
-				Vertex vertex{};
-				vertex.position = {
-					attrib.vertices[3 * index.vertex_index + 0],
-					attrib.vertices[3 * index.vertex_index + 1],
-					attrib.vertices[3 * index.vertex_index + 2],
-				};
-				vertex.texCoord = {
-					attrib.texcoords[2 * index.texcoord_index + 0],
-					1.0f - attrib.texcoords[2 * index.texcoord_index + 1],
-				};
-				vertex.color = { 1.0f, 1.0f, 1.0f };
-				if (uniqueVertices.find(vertex) == uniqueVertices.end()) {
-					uniqueVertices[vertex] = static_cast<uint32_t>(vertices.size());
-					vertices.push_back(vertex);
+			beginMesh();
+			bool split = false;
+			size_t indexOffset = 0;
+			for (size_t face = 0; face < shape.mesh.num_face_vertices.size(); ++face) {
+				//at worst every corner of the face is a new vertex
+				size_t faceVertices = shape.mesh.num_face_vertices[face];
+				if (vertices.size() - mesh.firstVertex + faceVertices > Policy::MAX_VERTICES) {
+					endMesh();
+					beginMesh();
+					split = true;
+				}
+				uint32_t material = faceMaterial(shape.mesh.material_ids[face]);
+				auto [it, inserted] = shapeRanges.try_emplace(material, ranges.size());
+				if (inserted) {
+					ranges.push_back(ShapeRange{ .material = material });
+				}
+				std::vector<uint32_t>& rangeIndices = ranges[it->second].indices;
+				for (size_t v = 0; v < faceVertices; ++v) {
+					const tinyobj::index_t& index = shape.mesh.indices[indexOffset + v];
+					Vertex vertex{};
+					vertex.position = {
+						attrib.vertices[3 * index.vertex_index + 0],
+						attrib.vertices[3 * index.vertex_index + 1],
+						attrib.vertices[3 * index.vertex_index + 2],
+					};
+					if (index.texcoord_index >= 0) {
+						vertex.texCoord = {
+							attrib.texcoords[2 * index.texcoord_index + 0],
+							1.0f - attrib.texcoords[2 * index.texcoord_index + 1],
+						};
+					}
+					vertex.color = diffuseColors[material];
+					if (uniqueVertices.find(vertex) == uniqueVertices.end()) {
+						uniqueVertices[vertex] = static_cast<uint32_t>(vertices.size() - mesh.firstVertex);
+						vertices.push_back(vertex);
+					}
+					rangeIndices.push_back(uniqueVertices[vertex]);
 				}
-				indices.push_back(uniqueVertices[vertex]);
+				indexOffset += faceVertices;
 			}
+			endMesh();
+			splitShapes += split ? 1 : 0;
+		}
+		uniqueVertices.clear();
+		if (splitShapes > 0) {
+			std::cout << splitShapes << " shapes had more than " << Policy::MAX_VERTICES << " vertices and were split for "
+				<< sizeof(Policy::Index) * 8 << " bit indices" << std::endl;
+		}
+		//grouped by index type, then by material, for one multi-draw per material and at most one index
+		//buffer bind per type, ordered by mesh inside a material
+		auto indexType = [this](const Submesh& submesh) {
+			return GeometryArena::indexTypeFor(meshes[submesh.mesh].vertexCount);
+		};
+		std::stable_sort(submeshes.begin(), submeshes.end(), [&indexType](const Submesh& a, const Submesh& b) {
+			VkIndexType typeA = indexType(a);
+			VkIndexType typeB = indexType(b);
+			if (typeA != typeB) return typeA < typeB;
+			return a.material != b.material ? a.material < b.material : a.mesh < b.mesh;
+		});
+		for (uint32_t d = 0; d < submeshes.size(); ++d) {
+			VkIndexType type = indexType(submeshes[d]);
+			const Submesh& submesh = submeshes[d];
+			if (drawBatches.empty() || drawBatches.back().indexType != type || drawBatches.back().material != submesh.material) {
+				DrawBatch batch{};
+				batch.indexType = type;
+				batch.material = submesh.material;
+				batch.firstDraw = d;
+				drawBatches.push_back(batch);
+			}
+			++drawBatches.back().drawCount;
+		}
+		//the descriptor sets need at least one material
+		if (materials.empty()) {
+			faceMaterial(-1);
+		}
+	}
+	//-----------------------------------------------------------------------------------------------
+	void HelloTriangleApplication::createScene()
+	{
+		//the model and its meshes are every node, the other threads only move them
+		scene.init(static_cast<uint32_t>(meshes.size()) + 1);
+		renderCommands.init(RENDER_COMMAND_CHUNKS);
+		modelNode = scene.createNode();
+		//a node per mesh below the model, created in mesh order right after it
+		objectLocalBounds.resize(meshes.size());
+		for (uint32_t i = 0; i < meshes.size(); ++i) {
+			Mesh& mesh = meshes[i];
+			mesh.node = scene.createNode(modelNode);
+			ASSERT(mesh.node == modelNode + 1 + i);
+			glm::vec3 min(std::numeric_limits<float>::max()), max(-std::numeric_limits<float>::max());
+			for (uint32_t v = mesh.firstVertex; v < mesh.firstVertex + mesh.vertexCount; ++v) {
+				min = glm::min(min, vertices[v].position);
+				max = glm::max(max, vertices[v].position);
+			}
+			objectLocalBounds.set(i, min, max);
+		}
+		objectWorld.assign(scene.nodeCount(), glm::mat4(1.0f));
+		objectWorldBounds.resize(meshes.size());
+		meshVisible.assign(meshes.size(), 0);
+		scene.update();
+		scene.copyChanged(objectWorld.data(), objectWorldVersion);
+		//the matrices of the mesh nodes are adjacent, in the order of the boxes
+		transformKernels().transformBounds(objectWorld.data() + modelNode + 1, objectLocalBounds, objectWorldBounds, 0, meshes.size());
+		sceneBvh.build(objectWorldBounds);
+	}
+	//-----------------------------------------------------------------------------------------------
+	void HelloTriangleApplication::pickObject()
+	{
+		double cursorX = 0.0, cursorY = 0.0;
+		int width = 0, height = 0;
+		glfwGetCursorPos(window, &cursorX, &cursorY);
+		glfwGetWindowSize(window, &width, &height);
+		if (width == 0 || height == 0) return;
+		//the projection is flipped, so window y already points the way of NDC y
+		glm::vec2 ndc(2.0f * static_cast<float>(cursorX) / width - 1.0f, 2.0f * static_cast<float>(cursorY) / height - 1.0f);
+		glm::mat4 inverseViewProjection = glm::inverse(viewProjection);
+		glm::vec4 nearPoint = inverseViewProjection * glm::vec4(ndc, 0.0f, 1.0f);
+		glm::vec4 farPoint = inverseViewProjection * glm::vec4(ndc, 1.0f, 1.0f);
+		Ray ray{};
+		ray.origin = glm::vec3(nearPoint) / nearPoint.w;
+		ray.direction = glm::vec3(farPoint) / farPoint.w - ray.origin;
+		//the direction spans the frustum, so distances are fractions of its depth
+		RayHit hit{};
+		if (sceneBvh.raycast(ray, 1.0f, hit)) {
+			std::cout << "picked mesh " << hit.object << " at " << hit.distance * glm::length(ray.direction) << std::endl;
+		}
+		else {
+			std::cout << "picked nothing" << std::endl;
 		}
 	}
 }
@@ -1,8 +1,121 @@
+#include <cstring>
+#include <cstdlib>
+#include <cctype>
+#include <iostream>
 #include "application.h"
+#include "TransformKernels.h"
+#include "AssetArchive.h"
+#include "RendererConfig.h"
+#include "LockFreeQueue.h"
+#include "RenderCommandStream.h"
+#include "Simulation.h"
 
-int main()
+int main(int argc, char** argv)
 {
 	Clan::HelloTriangleApplication app;
+	//renderer.cfg next to the executable is optional, the options below override it
+	Clan::RendererConfig config;
+	config.load("renderer.cfg");
+	//--config <file>, reads the window size, model and validation settings
+	//--set <key=value>, overrides one of those settings
+	//--aa <none|msaa2x|msaa4x|msaa8x|fxaa|taa>
+	//--benchmark-aa [frames per mode]
+	//--benchmark-transforms [object count], runs without a window and quits
+	//--benchmark-queues [items per thread], times the lock-free queues and the render command stream and quits,
+	//  flags lost items and commands out of writer order. A ThreadSanitizer build checks the synchronization.
+	//--benchmark-simulation [publishes], checks the triple buffer under contention and the simulation step
+	//  timing and quits. A ThreadSanitizer build checks the synchronization.
+	//--pack-assets [archive], packs the resources and shaders directories and quits
+	//--headless, hidden window, quits after the first frame
+	//--startup-report <file>, writes the startup step times as JSON
+	//--benchmark-startup [runs], times cold and warm headless starts and quits
+	//--memory-report <file>, writes host and device memory use as JSON at exit, M writes it while running
+	for (int i = 1; i < argc; ++i) {
+		if (std::strcmp(argv[i], "--config") == 0 && i + 1 < argc) {
+			if (!config.load(argv[++i])) {
+				std::cerr << "failed to read " << argv[i] << std::endl;
+			}
+		}
+		else if (std::strcmp(argv[i], "--set") == 0 && i + 1 < argc) {
+			if (!config.set(argv[++i])) {
+				std::cerr << "bad setting: " << argv[i] << std::endl;
+			}
+		}
+		else if (std::strcmp(argv[i], "--aa") == 0 && i + 1 < argc) {
+			Clan::AntiAliasingMode mode{};
+			if (Clan::parseAntiAliasingMode(argv[++i], mode)) {
+				app.setAntiAliasing(mode);
+			}
+			else {
+				std::cerr << "unknown anti-aliasing mode: " << argv[i] << std::endl;
+			}
+		}
+		else if (std::strcmp(argv[i], "--benchmark-aa") == 0) {
+			uint32_t framesPerMode = 600;
+			if (i + 1 < argc && std::isdigit(static_cast<unsigned char>(argv[i + 1][0]))) {
+				framesPerMode = static_cast<uint32_t>(std::atoi(argv[++i]));
+			}
+			app.enableAntiAliasingBenchmark(framesPerMode);
+		}
+		else if (std::strcmp(argv[i], "--benchmark-transforms") == 0) {
+			uint32_t count = 100000;
+			if (i + 1 < argc && std::isdigit(static_cast<unsigned char>(argv[i + 1][0]))) {
+				count = static_cast<uint32_t>(std::atoi(argv[++i]));
+			}
+			Clan::benchmarkTransformKernels(count, 100);
+			return 0;
+		}
+		else if (std::strcmp(argv[i], "--benchmark-queues") == 0) {
+			uint32_t count = 1000000;
+			if (i + 1 < argc && std::isdigit(static_cast<unsigned char>(argv[i + 1][0]))) {
+				count = static_cast<uint32_t>(std::atoi(argv[++i]));
+			}
+			Clan::benchmarkQueues(count);
+			Clan::benchmarkRenderCommandStream(count);
+			return 0;
+		}
+		else if (std::strcmp(argv[i], "--benchmark-simulation") == 0) {
+			uint32_t count = 1000000;
+			if (i + 1 < argc && std::isdigit(static_cast<unsigned char>(argv[i + 1][0]))) {
+				count = static_cast<uint32_t>(std::atoi(argv[++i]));
+			}
+			Clan::benchmarkSimulation(count);
+			return 0;
+		}
+		else if (std::strcmp(argv[i], "--headless") == 0) {
+			app.setHeadless(true);
+		}
+		else if (std::strcmp(argv[i], "--startup-report") == 0 && i + 1 < argc) {
+			app.setStartupReport(argv[++i]);
+		}
+		else if (std::strcmp(argv[i], "--memory-report") == 0 && i + 1 < argc) {
+			app.setMemoryReport(argv[++i]);
+		}
+		else if (std::strcmp(argv[i], "--benchmark-startup") == 0) {
+			uint32_t runs = 5;
+			if (i + 1 < argc && std::isdigit(static_cast<unsigned char>(argv[i + 1][0]))) {
+				runs = static_cast<uint32_t>(std::atoi(argv[++i]));
+			}
+			bool finished = Clan::benchmarkStartup(argv[0], runs, Clan::HelloTriangleApplication::coldStartFiles(), "startup_benchmark.json");
+			return finished ? 0 : 1;
+		}
+		else if (std::strcmp(argv[i], "--pack-assets") == 0) {
+			const char* archivePath = "assets.pak";
+			if (i + 1 < argc && argv[i + 1][0] != '-') {
+				archivePath = argv[++i];
+			}
+			Clan::AssetArchiveWriter writer;
+			writer.addDirectory("resources");
+			writer.addDirectory("shaders");
+			if (!writer.write(archivePath)) {
+				std::cerr << "failed to write " << archivePath << std::endl;
+				return 1;
+			}
+			std::cout << "packed " << writer.size() << " files into " << archivePath << std::endl;
+			return 0;
+		}
+	}
+	app.setConfig(config);
 	app.run();
 
 	return 0;